@@ -1309,7 +1309,7 @@ ac_nir_lower_ngg_nogs(nir_shader *shader,
 
    if (can_cull) {
       /* We need divergence info for culling shaders. */
-      nir_divergence_analysis(shader);
+      nir_metadata_require(impl, nir_metadata_divergence);
       analyze_shader_before_culling(shader, &state);
       save_reusable_variables(b, &state);
    }
@@ -3577,7 +3577,7 @@ radv_create_shaders(struct radv_pipeline *pipeline, struct radv_pipeline_layout
          if (nir[i]->info.bit_sizes_int & (8 | 16)) {
             if (device->physical_device->rad_info.chip_class >= GFX8) {
                nir_convert_to_lcssa(nir[i], true, true);
-               nir_divergence_analysis(nir[i]);
+               nir_metadata_require(nir_shader_get_entrypoint(nir[i]), nir_metadata_divergence);
             }
 
             if (nir_lower_bit_size(nir[i], lower_bit_size_callback, device)) {
@@ -197,10 +197,17 @@ clc_libclc_deserialize(const void *serialized, size_t serialized_size)
 
    glsl_type_singleton_init_or_ref();
 
-   struct blob_reader tmp;
-   blob_reader_init(&tmp, serialized, serialized_size);
+   /* The caller owns serialized, so keep our own copy around for the
+    * function impls that are only read on demand.
+    */
+   void *data = malloc(serialized_size);
+   if (!data) {
+      ralloc_free(ctx);
+      return NULL;
+   }
+   memcpy(data, serialized, serialized_size);
 
-   nir_shader *s = nir_deserialize(NULL, NULL, &tmp);
+   nir_shader *s = nir_deserialize_lazy(NULL, NULL, data, serialized_size, true);
    if (!s) {
       ralloc_free(ctx);
       return NULL;
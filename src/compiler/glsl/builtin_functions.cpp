@@ -75,6 +75,7 @@
 
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include "main/mtypes.h"
 #include "main/shaderobj.h"
 #include "ir_builder.h"
@@ -7769,6 +7770,15 @@ builtin_builder::_helper_invocation()
 static builtin_builder builtins;
 static uint32_t builtin_users = 0;
 
+static void
+release_builtin_functions_at_exit(void)
+{
+   mtx_lock(&builtins_lock);
+   if (builtin_users == 0 && builtins.shader != NULL)
+      builtins.release();
+   mtx_unlock(&builtins_lock);
+}
+
 /**
  * External API (exposing the built-in module to the rest of the compiler):
  *  @{
@@ -7776,19 +7786,28 @@ static uint32_t builtin_users = 0;
 extern "C" void
 _mesa_glsl_builtin_functions_init_or_ref()
 {
+   static bool registered_atexit = false;
+
    mtx_lock(&builtins_lock);
    if (builtin_users++ == 0)
       builtins.initialize();
+   if (!registered_atexit) {
+      atexit(release_builtin_functions_at_exit);
+      registered_atexit = true;
+   }
    mtx_unlock(&builtins_lock);
 }
 
 extern "C" void
 _mesa_glsl_builtin_functions_decref()
 {
+   /* The built-in library is immutable once created, so keep it around when
+    * the last user goes away rather than regenerating it for the next
+    * context (or glReleaseShaderCompiler() cycle).  It is released at exit.
+    */
    mtx_lock(&builtins_lock);
    assert(builtin_users != 0);
-   if (--builtin_users == 0)
-      builtins.release();
+   builtin_users--;
    mtx_unlock(&builtins_lock);
 }
 
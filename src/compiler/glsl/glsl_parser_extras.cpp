@@ -33,6 +33,7 @@
 #include "util/u_atomic.h" /* for p_atomic_cmpxchg */
 #include "util/ralloc.h"
 #include "util/disk_cache.h"
+#include "util/hash_table.h"
 #include "util/mesa-sha1.h"
 #include "ast.h"
 #include "glsl_parser_extras.h"
@@ -2064,6 +2065,88 @@ add_builtin_defines(struct _mesa_glsl_parse_state *state,
    }
 }
 
+/* Bounds the memory held by ctx->GLSLPreprocessCache.  Once full, the cache
+ * is simply flushed; applications that benefit from it tend to compile the
+ * same handful of sources over and over.
+ */
+#define GLSL_PREPROCESS_CACHE_MAX_ENTRIES 256
+
+struct glsl_preprocess_entry {
+   unsigned char key[20];
+   char *output;
+   char *info_log;
+   int error;
+};
+
+static uint32_t
+preprocess_key_hash(const void *key)
+{
+   return _mesa_hash_data(key, 20);
+}
+
+static bool
+preprocess_key_equal(const void *a, const void *b)
+{
+   return memcmp(a, b, 20) == 0;
+}
+
+/**
+ * Runs glcpp on the source, reusing the result of an earlier run on the same
+ * context when possible.
+ */
+static int
+preprocess_shader(struct gl_context *ctx, struct _mesa_glsl_parse_state *state,
+                  const char **source, bool cacheable)
+{
+   if (!cacheable) {
+      return glcpp_preprocess(state, source, &state->info_log,
+                              add_builtin_defines, state, ctx);
+   }
+
+   unsigned char key[20];
+   struct mesa_sha1 sha1_ctx;
+   _mesa_sha1_init(&sha1_ctx);
+   _mesa_sha1_update(&sha1_ctx, &state->stage, sizeof(state->stage));
+   _mesa_sha1_update(&sha1_ctx, *source, strlen(*source));
+   _mesa_sha1_final(&sha1_ctx, key);
+
+   struct hash_table *cache = ctx->GLSLPreprocessCache;
+   struct hash_entry *he =
+      cache ? _mesa_hash_table_search(cache, key) : NULL;
+   if (he) {
+      const struct glsl_preprocess_entry *entry =
+         (const struct glsl_preprocess_entry *) he->data;
+      *source = ralloc_strdup(state, entry->output);
+      ralloc_strcat(&state->info_log, entry->info_log);
+      return entry->error;
+   }
+
+   char *info_log = ralloc_strdup(state, "");
+   int error = glcpp_preprocess(state, source, &info_log,
+                                add_builtin_defines, state, ctx);
+   ralloc_strcat(&state->info_log, info_log);
+
+   if (cache && cache->entries >= GLSL_PREPROCESS_CACHE_MAX_ENTRIES) {
+      ralloc_free(cache);
+      cache = NULL;
+   }
+   if (!cache) {
+      cache = _mesa_hash_table_create(NULL, preprocess_key_hash,
+                                      preprocess_key_equal);
+   }
+   ctx->GLSLPreprocessCache = cache;
+
+   struct glsl_preprocess_entry *entry =
+      ralloc(cache, struct glsl_preprocess_entry);
+   memcpy(entry->key, key, sizeof(key));
+   entry->output = ralloc_strdup(entry, *source);
+   entry->info_log = ralloc_strdup(entry, info_log);
+   entry->error = error;
+   _mesa_hash_table_insert(cache, entry->key, entry);
+
+   return error;
+}
+
 /* Implements parsing checks that we can't do during parsing */
 static void
 do_late_parsing_checks(struct _mesa_glsl_parse_state *state)
@@ -2210,9 +2293,12 @@ _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader,
       (void) p_atomic_cmpxchg(&ir_variable::temporaries_allocate_names,
                               false, true);
 
+   /* The output of shaders with includes depends on the include tree, which
+    * may change between compiles, so those are never cached.
+    */
    if (!source_has_shader_include || !force_recompile) {
-      state->error = glcpp_preprocess(state, &source, &state->info_log,
-                                      add_builtin_defines, state, ctx);
+      state->error = preprocess_shader(ctx, state, &source,
+                                       !source_has_shader_include);
    }
 
    /* Now that we have run the preprocessor we can check the shader cache and
@@ -3802,9 +3802,17 @@ create_shader_variable(struct gl_shader_program *shProg,
    return out;
 }
 
+/**
+ * Add resources for \p var, recursing into structs and arrays of aggregates.
+ *
+ * The intermediate names built while recursing are only needed until the
+ * leaf's gl_shader_variable copies its name, so they come from \p lin_ctx,
+ * the temporary linear context of build_program_resource_list().
+ */
 static bool
 add_shader_variable(const struct gl_context *ctx,
                     struct gl_shader_program *shProg,
+                    void *lin_ctx,
                     struct set *resource_set,
                     unsigned stage_mask,
                     GLenum programInterface, ir_variable *var,
@@ -3847,7 +3855,7 @@ add_shader_variable(const struct gl_context *ctx,
             interface_name = interface_type->fields.array->name;
          }
 
-         name = ralloc_asprintf(shProg, "%s.%s", interface_name, name);
+         name = linear_asprintf(lin_ctx, "%s.%s", interface_name, name);
       }
    }
 
@@ -3868,8 +3876,9 @@ add_shader_variable(const struct gl_context *ctx,
       unsigned field_location = location;
       for (unsigned i = 0; i < type->length; i++) {
          const struct glsl_struct_field *field = &type->fields.structure[i];
-         char *field_name = ralloc_asprintf(shProg, "%s.%s", name, field->name);
-         if (!add_shader_variable(ctx, shProg, resource_set,
+         char *field_name = linear_asprintf(lin_ctx, "%s.%s", name,
+                                            field->name);
+         if (!add_shader_variable(ctx, shProg, lin_ctx, resource_set,
                                   stage_mask, programInterface,
                                   var, field_name, field->type,
                                   use_implicit_location, field_location,
@@ -3904,8 +3913,8 @@ add_shader_variable(const struct gl_context *ctx,
          unsigned stride = inouts_share_location ? 0 :
                            array_type->count_attribute_slots(false);
          for (unsigned i = 0; i < type->length; i++) {
-            char *elem = ralloc_asprintf(shProg, "%s[%d]", name, i);
-            if (!add_shader_variable(ctx, shProg, resource_set,
+            char *elem = linear_asprintf(lin_ctx, "%s[%d]", name, i);
+            if (!add_shader_variable(ctx, shProg, lin_ctx, resource_set,
                                      stage_mask, programInterface,
                                      var, elem, array_type,
                                      use_implicit_location, elem_location,
@@ -3955,6 +3964,7 @@ inout_has_same_location(const ir_variable *var, unsigned stage)
 static bool
 add_interface_variables(const struct gl_context *ctx,
                         struct gl_shader_program *shProg,
+                        void *lin_ctx,
                         struct set *resource_set,
                         unsigned stage, GLenum programInterface)
 {
@@ -4005,7 +4015,7 @@ add_interface_variables(const struct gl_context *ctx,
          (stage == MESA_SHADER_VERTEX && var->data.mode == ir_var_shader_in) ||
          (stage == MESA_SHADER_FRAGMENT && var->data.mode == ir_var_shader_out);
 
-      if (!add_shader_variable(ctx, shProg, resource_set,
+      if (!add_shader_variable(ctx, shProg, lin_ctx, resource_set,
                                1 << stage, programInterface,
                                var, var->name, var->type, vs_input_or_fs_output,
                                var->data.location - loc_bias,
@@ -4018,6 +4028,7 @@ add_interface_variables(const struct gl_context *ctx,
 static bool
 add_packed_varyings(const struct gl_context *ctx,
                     struct gl_shader_program *shProg,
+                    void *lin_ctx,
                     struct set *resource_set,
                     int stage, GLenum type)
 {
@@ -4044,7 +4055,7 @@ add_packed_varyings(const struct gl_context *ctx,
          if (type == iface) {
             const int stage_mask =
                build_stageref(shProg, var->name, var->data.mode);
-            if (!add_shader_variable(ctx, shProg, resource_set,
+            if (!add_shader_variable(ctx, shProg, lin_ctx, resource_set,
                                      stage_mask,
                                      iface, var, var->name, var->type, false,
                                      var->data.location - VARYING_SLOT_VAR0,
@@ -4059,6 +4070,7 @@ add_packed_varyings(const struct gl_context *ctx,
 static bool
 add_fragdata_arrays(const struct gl_context *ctx,
                     struct gl_shader_program *shProg,
+                    void *lin_ctx,
                     struct set *resource_set)
 {
    struct gl_linked_shader *sh = shProg->_LinkedShaders[MESA_SHADER_FRAGMENT];
@@ -4071,7 +4083,7 @@ add_fragdata_arrays(const struct gl_context *ctx,
       if (var) {
          assert(var->data.mode == ir_var_shader_out);
 
-         if (!add_shader_variable(ctx, shProg, resource_set,
+         if (!add_shader_variable(ctx, shProg, lin_ctx, resource_set,
                                   1 << MESA_SHADER_FRAGMENT,
                                   GL_PROGRAM_OUTPUT, var, var->name, var->type,
                                   true, var->data.location - FRAG_RESULT_DATA0,
@@ -4116,33 +4128,36 @@ build_program_resource_list(struct gl_context *ctx,
    if (input_stage == MESA_SHADER_STAGES && output_stage == 0)
       return;
 
-   struct set *resource_set = _mesa_pointer_set_create(NULL);
+   /* Temporaries of the resource list build, freed when it's done */
+   void *mem_ctx = ralloc_context(NULL);
+   void *lin_ctx = linear_alloc_parent(mem_ctx, 0);
+   struct set *resource_set = _mesa_pointer_set_create(mem_ctx);
 
    /* Program interface needs to expose varyings in case of SSO. */
    if (shProg->SeparateShader) {
-      if (!add_packed_varyings(ctx, shProg, resource_set,
+      if (!add_packed_varyings(ctx, shProg, lin_ctx, resource_set,
                                input_stage, GL_PROGRAM_INPUT))
          return;
 
-      if (!add_packed_varyings(ctx, shProg, resource_set,
+      if (!add_packed_varyings(ctx, shProg, lin_ctx, resource_set,
                                output_stage, GL_PROGRAM_OUTPUT))
          return;
    }
 
    if (add_packed_varyings_only) {
-      _mesa_set_destroy(resource_set, NULL);
+      ralloc_free(mem_ctx);
       return;
    }
 
-   if (!add_fragdata_arrays(ctx, shProg, resource_set))
+   if (!add_fragdata_arrays(ctx, shProg, lin_ctx, resource_set))
       return;
 
    /* Add inputs and outputs to the resource list. */
-   if (!add_interface_variables(ctx, shProg, resource_set,
+   if (!add_interface_variables(ctx, shProg, lin_ctx, resource_set,
                                 input_stage, GL_PROGRAM_INPUT))
       return;
 
-   if (!add_interface_variables(ctx, shProg, resource_set,
+   if (!add_interface_variables(ctx, shProg, lin_ctx, resource_set,
                                 output_stage, GL_PROGRAM_OUTPUT))
       return;
 
@@ -4285,7 +4300,7 @@ build_program_resource_list(struct gl_context *ctx,
       }
    }
 
-   _mesa_set_destroy(resource_set, NULL);
+   ralloc_free(mem_ctx);
 }
 
 /**
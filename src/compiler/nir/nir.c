@@ -100,6 +100,161 @@ nir_component_mask_reinterpret(nir_component_mask_t mask,
    return new_mask;
 }
 
+/* Instructions are carved out of per-shader pages instead of going through
+ * malloc: allocating is a pointer bump or a pop from a size-bucketed free
+ * list, and instructions created together by a pass, nir_clone or
+ * nir_deserialize end up next to each other in memory.
+ */
+#define NIR_ARENA_PAGE_SIZE (32 * 1024)
+#define NIR_ARENA_BUCKET_SIZE 32
+#define NIR_ARENA_NUM_BUCKETS 16
+
+struct nir_instr_arena {
+   /* free blocks of each size, linked through their first pointer */
+   void *free[NIR_ARENA_NUM_BUCKETS];
+   /* unused tail of the current page */
+   char *next, *end;
+   /* all pages, linked through their first pointer */
+   void *pages;
+};
+
+typedef union {
+   struct {
+      struct nir_instr_arena *arena;
+      /* NIR_ARENA_NUM_BUCKETS for blocks that were malloc'd directly */
+      unsigned bucket;
+   };
+   /* keep whatever follows the header 16-byte aligned */
+   uint64_t align[2];
+} nir_arena_header;
+
+static struct nir_instr_arena *
+instr_arena_create(void)
+{
+   return calloc(1, sizeof(struct nir_instr_arena));
+}
+
+static void
+instr_arena_destroy(struct nir_instr_arena *arena)
+{
+   if (!arena)
+      return;
+
+   void *page = arena->pages;
+   while (page) {
+      void *next = *(void **)page;
+      free(page);
+      page = next;
+   }
+   free(arena);
+}
+
+static void *
+instr_arena_alloc(struct nir_instr_arena *arena, size_t size, bool zero)
+{
+   size_t block_size = sizeof(nir_arena_header) + size;
+   unsigned bucket = DIV_ROUND_UP(block_size, NIR_ARENA_BUCKET_SIZE) - 1;
+   nir_arena_header *header;
+
+   if (bucket >= NIR_ARENA_NUM_BUCKETS) {
+      header = malloc(block_size);
+      if (!header)
+         return NULL;
+      bucket = NIR_ARENA_NUM_BUCKETS;
+   } else if (arena->free[bucket]) {
+      header = arena->free[bucket];
+      arena->free[bucket] = *(void **)header;
+   } else {
+      block_size = (bucket + 1) * NIR_ARENA_BUCKET_SIZE;
+      if ((size_t)(arena->end - arena->next) < block_size) {
+         char *page = malloc(NIR_ARENA_PAGE_SIZE);
+         if (!page)
+            return NULL;
+         *(void **)page = arena->pages;
+         arena->pages = page;
+         /* the page link takes up the first header-sized slot */
+         arena->next = page + sizeof(nir_arena_header);
+         arena->end = page + NIR_ARENA_PAGE_SIZE;
+      }
+      header = (nir_arena_header *)arena->next;
+      arena->next += block_size;
+   }
+
+   header->arena = arena;
+   header->bucket = bucket;
+   if (zero)
+      memset(header + 1, 0, size);
+   return header + 1;
+}
+
+static void
+instr_arena_free(void *ptr)
+{
+   nir_arena_header *header = (nir_arena_header *)ptr - 1;
+
+   if (header->bucket == NIR_ARENA_NUM_BUCKETS) {
+      free(header);
+      return;
+   }
+
+   struct nir_instr_arena *arena = header->arena;
+   unsigned bucket = header->bucket;
+   *(void **)header = arena->free[bucket];
+   arena->free[bucket] = header;
+}
+
+static struct nir_instr_arena *
+instr_arena_of(const nir_instr *instr)
+{
+   return ((const nir_arena_header *)instr - 1)->arena;
+}
+
+static void
+use_array_init(nir_use_array *uses)
+{
+   uses->count = 0;
+   uses->capacity = NIR_USE_ARRAY_INLINE;
+}
+
+/** Frees an SSA value's out-of-line uses and leaves the array empty */
+static void
+ssa_use_array_free(nir_use_array *uses)
+{
+   if (uses->capacity > NIR_USE_ARRAY_INLINE)
+      instr_arena_free(uses->srcs);
+
+   use_array_init(uses);
+}
+
+/* Makes room for src, which is about to be added to uses. */
+void
+nir_use_array_grow(nir_use_array *uses, const nir_src *src)
+{
+   /* Capacities of 6, 14, 30, ... fill an arena bucket header included. */
+   uint32_t capacity = MAX2(uses->capacity * 2 + 2, 6);
+   nir_src **old_srcs = nir_use_array_srcs(uses);
+   nir_src **srcs;
+
+   if (src->is_ssa) {
+      srcs = instr_arena_alloc(instr_arena_of(src->ssa->parent_instr),
+                               capacity * sizeof(*srcs), false);
+   } else {
+      srcs = ralloc_array(src->reg.reg, nir_src *, capacity);
+   }
+
+   memcpy(srcs, old_srcs, uses->count * sizeof(*srcs));
+
+   if (uses->capacity > NIR_USE_ARRAY_INLINE) {
+      if (src->is_ssa)
+         instr_arena_free(old_srcs);
+      else
+         ralloc_free(old_srcs);
+   }
+
+   uses->srcs = srcs;
+   uses->capacity = capacity;
+}
+
 static void
 nir_shader_destructor(void *ptr)
 {
@@ -109,6 +264,7 @@ nir_shader_destructor(void *ptr)
    list_for_each_entry_safe(nir_instr, instr, &shader->gc_list, gc_node) {
       nir_instr_free(instr);
    }
+   instr_arena_destroy(shader->instr_arena);
 }
 
 nir_shader *
@@ -134,6 +290,7 @@ nir_shader_create(void *mem_ctx,
    exec_list_make_empty(&shader->functions);
 
    list_inithead(&shader->gc_list);
+   shader->instr_arena = instr_arena_create();
 
    shader->num_inputs = 0;
    shader->num_outputs = 0;
@@ -147,9 +304,9 @@ reg_create(void *mem_ctx, struct exec_list *list)
 {
    nir_register *reg = ralloc(mem_ctx, nir_register);
 
-   list_inithead(&reg->uses);
+   use_array_init(&reg->uses);
    list_inithead(&reg->defs);
-   list_inithead(&reg->if_uses);
+   use_array_init(&reg->if_uses);
 
    reg->num_components = 0;
    reg->bit_size = 32;
@@ -461,6 +618,7 @@ nir_function_impl_create_bare(nir_shader *shader)
    impl->ssa_alloc = 0;
    impl->num_blocks = 0;
    impl->valid_metadata = nir_metadata_none;
+   impl->range_ht = NULL;
    impl->structured = true;
 
    /* create start & end blocks */
@@ -605,8 +763,8 @@ nir_alu_instr *
 nir_alu_instr_create(nir_shader *shader, nir_op op)
 {
    unsigned num_srcs = nir_op_infos[op].num_inputs;
-   /* TODO: don't use calloc */
-   nir_alu_instr *instr = calloc(1, sizeof(nir_alu_instr) + num_srcs * sizeof(nir_alu_src));
+   nir_alu_instr *instr =
+      instr_arena_alloc(shader->instr_arena, sizeof(nir_alu_instr) + num_srcs * sizeof(nir_alu_src), true);
 
    instr_init(&instr->instr, nir_instr_type_alu);
    instr->op = op;
@@ -622,7 +780,7 @@ nir_alu_instr_create(nir_shader *shader, nir_op op)
 nir_deref_instr *
 nir_deref_instr_create(nir_shader *shader, nir_deref_type deref_type)
 {
-   nir_deref_instr *instr = calloc(1, sizeof(*instr));
+   nir_deref_instr *instr = instr_arena_alloc(shader->instr_arena, sizeof(*instr), true);
 
    instr_init(&instr->instr, nir_instr_type_deref);
 
@@ -644,7 +802,7 @@ nir_deref_instr_create(nir_shader *shader, nir_deref_type deref_type)
 nir_jump_instr *
 nir_jump_instr_create(nir_shader *shader, nir_jump_type type)
 {
-   nir_jump_instr *instr = malloc(sizeof(*instr));
+   nir_jump_instr *instr = instr_arena_alloc(shader->instr_arena, sizeof(*instr), false);
    instr_init(&instr->instr, nir_instr_type_jump);
    src_init(&instr->condition);
    instr->type = type;
@@ -661,7 +819,7 @@ nir_load_const_instr_create(nir_shader *shader, unsigned num_components,
                             unsigned bit_size)
 {
    nir_load_const_instr *instr =
-      calloc(1, sizeof(*instr) + num_components * sizeof(*instr->value));
+      instr_arena_alloc(shader->instr_arena, sizeof(*instr) + num_components * sizeof(*instr->value), true);
    instr_init(&instr->instr, nir_instr_type_load_const);
 
    nir_ssa_def_init(&instr->instr, &instr->def, num_components, bit_size);
@@ -675,9 +833,8 @@ nir_intrinsic_instr *
 nir_intrinsic_instr_create(nir_shader *shader, nir_intrinsic_op op)
 {
    unsigned num_srcs = nir_intrinsic_infos[op].num_srcs;
-   /* TODO: don't use calloc */
    nir_intrinsic_instr *instr =
-      calloc(1, sizeof(nir_intrinsic_instr) + num_srcs * sizeof(nir_src));
+      instr_arena_alloc(shader->instr_arena, sizeof(nir_intrinsic_instr) + num_srcs * sizeof(nir_src), true);
 
    instr_init(&instr->instr, nir_instr_type_intrinsic);
    instr->intrinsic = op;
@@ -698,7 +855,7 @@ nir_call_instr_create(nir_shader *shader, nir_function *callee)
 {
    const unsigned num_params = callee->num_params;
    nir_call_instr *instr =
-      calloc(1, sizeof(*instr) + num_params * sizeof(instr->params[0]));
+      instr_arena_alloc(shader->instr_arena, sizeof(*instr) + num_params * sizeof(instr->params[0]), true);
 
    instr_init(&instr->instr, nir_instr_type_call);
    instr->callee = callee;
@@ -722,7 +879,7 @@ static int8_t default_tg4_offsets[4][2] =
 nir_tex_instr *
 nir_tex_instr_create(nir_shader *shader, unsigned num_srcs)
 {
-   nir_tex_instr *instr = calloc(1, sizeof(*instr));
+   nir_tex_instr *instr = instr_arena_alloc(shader->instr_arena, sizeof(*instr), true);
    instr_init(&instr->instr, nir_instr_type_tex);
 
    dest_init(&instr->dest);
@@ -791,7 +948,7 @@ nir_tex_instr_has_explicit_tg4_offsets(nir_tex_instr *tex)
 nir_phi_instr *
 nir_phi_instr_create(nir_shader *shader)
 {
-   nir_phi_instr *instr = malloc(sizeof(*instr));
+   nir_phi_instr *instr = instr_arena_alloc(shader->instr_arena, sizeof(*instr), false);
    instr_init(&instr->instr, nir_instr_type_phi);
 
    dest_init(&instr->dest);
@@ -808,7 +965,7 @@ nir_phi_instr_create(nir_shader *shader)
  * Note that this does not update the def/use relationship for src, assuming
  * that the instr is not in the shader.  If it is, you have to do:
  *
- * list_addtail(&phi_src->src.use_link, &src.ssa->uses);
+ * nir_use_array_add(&src.ssa->uses, &phi_src->src);
  */
 nir_phi_src *
 nir_phi_instr_add_src(nir_phi_instr *instr, nir_block *pred, nir_src src)
@@ -827,7 +984,7 @@ nir_phi_instr_add_src(nir_phi_instr *instr, nir_block *pred, nir_src src)
 nir_parallel_copy_instr *
 nir_parallel_copy_instr_create(nir_shader *shader)
 {
-   nir_parallel_copy_instr *instr = malloc(sizeof(*instr));
+   nir_parallel_copy_instr *instr = instr_arena_alloc(shader->instr_arena, sizeof(*instr), false);
    instr_init(&instr->instr, nir_instr_type_parallel_copy);
 
    exec_list_make_empty(&instr->entries);
@@ -842,7 +999,7 @@ nir_ssa_undef_instr_create(nir_shader *shader,
                            unsigned num_components,
                            unsigned bit_size)
 {
-   nir_ssa_undef_instr *instr = malloc(sizeof(*instr));
+   nir_ssa_undef_instr *instr = instr_arena_alloc(shader->instr_arena, sizeof(*instr), false);
    instr_init(&instr->instr, nir_instr_type_ssa_undef);
 
    nir_ssa_def_init(&instr->instr, &instr->def, num_components, bit_size);
@@ -991,8 +1148,7 @@ add_use_cb(nir_src *src, void *state)
    nir_instr *instr = state;
 
    src->parent_instr = instr;
-   list_addtail(&src->use_link,
-                src->is_ssa ? &src->ssa->uses : &src->reg.reg->uses);
+   nir_use_array_add(nir_src_use_array(src, false), src);
 
    return true;
 }
@@ -1114,7 +1270,7 @@ remove_use_cb(nir_src *src, void *state)
    (void) state;
 
    if (src_is_valid(src))
-      list_del(&src->use_link);
+      nir_use_array_remove(nir_src_use_array(src, false), src);
 
    return true;
 }
@@ -1139,6 +1295,12 @@ remove_defs_uses(nir_instr *instr)
 
 void nir_instr_remove_v(nir_instr *instr)
 {
+   if (instr->type == nir_instr_type_alu && instr->block) {
+      nir_function_impl *impl =
+         nir_cf_node_get_function(&instr->block->cf_node);
+      impl->valid_metadata &= ~nir_metadata_range_analysis;
+   }
+
    remove_defs_uses(instr);
    exec_node_remove(&instr->node);
 
@@ -1160,10 +1322,18 @@ static bool free_dest_indirects_cb(nir_dest *dest, void *state)
    return true;
 }
 
+static bool free_ssa_def_uses_cb(nir_ssa_def *def, void *state)
+{
+   ssa_use_array_free(&def->uses);
+   ssa_use_array_free(&def->if_uses);
+   return true;
+}
+
 void nir_instr_free(nir_instr *instr)
 {
    nir_foreach_src(instr, free_src_indirects_cb, NULL);
    nir_foreach_dest(instr, free_dest_indirects_cb, NULL);
+   nir_foreach_ssa_def(instr, free_ssa_def_uses_cb, NULL);
 
    switch (instr->type) {
    case nir_instr_type_tex:
@@ -1183,7 +1353,7 @@ void nir_instr_free(nir_instr *instr)
    }
 
    list_del(&instr->gc_node);
-   free(instr);
+   instr_arena_free(instr);
 }
 
 void
@@ -1231,7 +1401,7 @@ nir_instr_dce_add_dead_srcs_cb(nir_src *src, void *state)
    nir_instr_worklist *wl = state;
 
    if (src->is_ssa) {
-      list_del(&src->use_link);
+      nir_use_array_remove(&src->ssa->uses, src);
       if (!nir_instr_free_and_dce_is_live(src->ssa->parent_instr))
          nir_instr_worklist_push_tail(wl, src->ssa->parent_instr);
 
@@ -1511,13 +1681,13 @@ nir_src_is_dynamically_uniform(nir_src src)
 }
 
 static void
-src_remove_all_uses(nir_src *src)
+src_remove_all_uses(nir_src *src, bool is_if_use)
 {
    for (; src; src = src->is_ssa ? NULL : src->reg.indirect) {
       if (!src_is_valid(src))
          continue;
 
-      list_del(&src->use_link);
+      nir_use_array_remove(nir_src_use_array(src, is_if_use), src);
    }
 }
 
@@ -1530,17 +1700,11 @@ src_add_all_uses(nir_src *src, nir_instr *parent_instr, nir_if *parent_if)
 
       if (parent_instr) {
          src->parent_instr = parent_instr;
-         if (src->is_ssa)
-            list_addtail(&src->use_link, &src->ssa->uses);
-         else
-            list_addtail(&src->use_link, &src->reg.reg->uses);
+         nir_use_array_add(nir_src_use_array(src, false), src);
       } else {
          assert(parent_if);
          src->parent_if = parent_if;
-         if (src->is_ssa)
-            list_addtail(&src->use_link, &src->ssa->if_uses);
-         else
-            list_addtail(&src->use_link, &src->reg.reg->if_uses);
+         nir_use_array_add(nir_src_use_array(src, true), src);
       }
    }
 }
@@ -1550,7 +1714,7 @@ nir_instr_rewrite_src(nir_instr *instr, nir_src *src, nir_src new_src)
 {
    assert(!src_is_valid(src) || src->parent_instr == instr);
 
-   src_remove_all_uses(src);
+   src_remove_all_uses(src, false);
    nir_src_copy(src, &new_src);
    src_add_all_uses(src, instr, NULL);
 }
@@ -1560,9 +1724,9 @@ nir_instr_move_src(nir_instr *dest_instr, nir_src *dest, nir_src *src)
 {
    assert(!src_is_valid(dest) || dest->parent_instr == dest_instr);
 
-   src_remove_all_uses(dest);
+   src_remove_all_uses(dest, false);
    src_free_indirects(dest);
-   src_remove_all_uses(src);
+   src_remove_all_uses(src, false);
    *dest = *src;
    *src = NIR_SRC_INIT;
    src_add_all_uses(dest, dest_instr, NULL);
@@ -1574,7 +1738,7 @@ nir_if_rewrite_condition(nir_if *if_stmt, nir_src new_src)
    nir_src *src = &if_stmt->condition;
    assert(!src_is_valid(src) || src->parent_if == if_stmt);
 
-   src_remove_all_uses(src);
+   src_remove_all_uses(src, true);
    nir_src_copy(src, &new_src);
    src_add_all_uses(src, NULL, if_stmt);
 }
@@ -1585,10 +1749,11 @@ nir_instr_rewrite_dest(nir_instr *instr, nir_dest *dest, nir_dest new_dest)
    if (dest->is_ssa) {
       /* We can only overwrite an SSA destination if it has no uses. */
       assert(nir_ssa_def_is_unused(&dest->ssa));
+      free_ssa_def_uses_cb(&dest->ssa, NULL);
    } else {
       list_del(&dest->reg.def_link);
       if (dest->reg.indirect)
-         src_remove_all_uses(dest->reg.indirect);
+         src_remove_all_uses(dest->reg.indirect, false);
    }
 
    /* We can't re-write with an SSA def */
@@ -1610,8 +1775,8 @@ nir_ssa_def_init(nir_instr *instr, nir_ssa_def *def,
                  unsigned bit_size)
 {
    def->parent_instr = instr;
-   list_inithead(&def->uses);
-   list_inithead(&def->if_uses);
+   use_array_init(&def->uses);
+   use_array_init(&def->if_uses);
    def->num_components = num_components;
    def->bit_size = bit_size;
    def->divergent = true; /* This is the safer default */
@@ -1638,15 +1803,38 @@ nir_ssa_dest_init(nir_instr *instr, nir_dest *dest,
    nir_ssa_def_init(instr, &dest->ssa, num_components, bit_size);
 }
 
+/* Retargets every src in from at new_ssa and moves them all into to, which
+ * belongs to new_ssa.  from is left empty.
+ */
+static void
+use_array_move(nir_use_array *from, nir_ssa_def *new_ssa, nir_use_array *to)
+{
+   nir_src **srcs = nir_use_array_srcs(from);
+
+   for (uint32_t i = 0; i < from->count; i++) {
+      assert(srcs[i]->is_ssa && srcs[i]->use_index == i);
+      srcs[i]->ssa = new_ssa;
+   }
+
+   if (to->count == 0) {
+      /* The srcs keep their slots, so the whole array can change hands. */
+      ssa_use_array_free(to);
+      *to = *from;
+      use_array_init(from);
+   } else {
+      for (uint32_t i = 0; i < from->count; i++)
+         nir_use_array_add(to, srcs[i]);
+      ssa_use_array_free(from);
+   }
+}
+
 void
 nir_ssa_def_rewrite_uses(nir_ssa_def *def, nir_ssa_def *new_ssa)
 {
    assert(def != new_ssa);
-   nir_foreach_use_safe(use_src, def)
-      nir_instr_rewrite_src_ssa(use_src->parent_instr, use_src, new_ssa);
 
-   nir_foreach_if_use_safe(use_src, def)
-      nir_if_rewrite_condition_ssa(use_src->parent_if, use_src, new_ssa);
+   use_array_move(&def->uses, new_ssa, &new_ssa->uses);
+   use_array_move(&def->if_uses, new_ssa, &new_ssa->if_uses);
 }
 
 void
@@ -1757,7 +1945,7 @@ nir_ssa_def_components_read(const nir_ssa_def *def)
 {
    nir_component_mask_t read_mask = 0;
 
-   if (!list_is_empty(&def->if_uses))
+   if (def->if_uses.count)
       read_mask |= 1;
 
    nir_foreach_use(use, def) {
@@ -2150,7 +2338,7 @@ nir_function_impl_lower_instructions(nir_function_impl *impl,
 
       assert(nir_foreach_dest(instr, dest_is_ssa, NULL));
       nir_ssa_def *old_def = nir_instr_ssa_def(instr);
-      struct list_head old_uses, old_if_uses;
+      nir_use_array old_uses, old_if_uses;
       if (old_def != NULL) {
          /* We're about to ask the callback to generate a replacement for instr.
           * Save off the uses from instr's SSA def so we know what uses to
@@ -2164,10 +2352,10 @@ nir_function_impl_lower_instructions(nir_function_impl *impl,
           * that we rewrite the correct set efficiently.
           */
 
-         list_replace(&old_def->uses, &old_uses);
-         list_inithead(&old_def->uses);
-         list_replace(&old_def->if_uses, &old_if_uses);
-         list_inithead(&old_def->if_uses);
+         old_uses = old_def->uses;
+         old_if_uses = old_def->if_uses;
+         use_array_init(&old_def->uses);
+         use_array_init(&old_def->if_uses);
       }
 
       b.cursor = nir_after_instr(instr);
@@ -2178,12 +2366,8 @@ nir_function_impl_lower_instructions(nir_function_impl *impl,
          if (new_def->parent_instr->block != instr->block)
             preserved = nir_metadata_none;
 
-         nir_src new_src = nir_src_for_ssa(new_def);
-         list_for_each_entry_safe(nir_src, use_src, &old_uses, use_link)
-            nir_instr_rewrite_src(use_src->parent_instr, use_src, new_src);
-
-         list_for_each_entry_safe(nir_src, use_src, &old_if_uses, use_link)
-            nir_if_rewrite_condition(use_src->parent_if, new_src);
+         use_array_move(&old_uses, new_def, &new_def->uses);
+         use_array_move(&old_if_uses, new_def, &new_def->if_uses);
 
          if (nir_ssa_def_is_unused(old_def)) {
             iter = nir_instr_free_and_dce(instr);
@@ -2194,8 +2378,8 @@ nir_function_impl_lower_instructions(nir_function_impl *impl,
       } else {
          /* We didn't end up lowering after all.  Put the uses back */
          if (old_def) {
-            list_replace(&old_uses, &old_def->uses);
-            list_replace(&old_if_uses, &old_def->if_uses);
+            use_array_move(&old_uses, old_def, &old_def->uses);
+            use_array_move(&old_if_uses, old_def, &old_def->if_uses);
          }
          if (new_def == NIR_LOWER_INSTR_PROGRESS_REPLACE) {
             /* Only instructions without a return value can be removed like this */
@@ -735,6 +735,33 @@ nir_variable_is_global(const nir_variable *var)
    return var->data.mode != nir_var_function_temp;
 }
 
+struct nir_src;
+
+/** Number of uses a nir_use_array holds before it spills out of line */
+#define NIR_USE_ARRAY_INLINE 1
+
+/**
+ * Unordered set of the nir_srcs reading an SSA value or register
+ *
+ * Each src records its slot in nir_src::use_index, so adding and removing a
+ * use are O(1) and a walk over the uses reads one contiguous array instead
+ * of chasing a pointer through every user.  The first NIR_USE_ARRAY_INLINE
+ * uses are stored in place.  Past that, an SSA value's array lives in the
+ * shader's instruction arena and a register's is ralloc'd off the register.
+ */
+typedef struct {
+   union {
+      /** Used while capacity <= NIR_USE_ARRAY_INLINE */
+      struct nir_src *inline_srcs[NIR_USE_ARRAY_INLINE];
+
+      /** Used once capacity > NIR_USE_ARRAY_INLINE */
+      struct nir_src **srcs;
+   };
+
+   uint32_t count;
+   uint32_t capacity;
+} nir_use_array;
+
 typedef struct nir_register {
    struct exec_node node;
 
@@ -754,13 +781,13 @@ typedef struct nir_register {
    unsigned index;
 
    /** set of nir_srcs where this register is used (read from) */
-   struct list_head uses;
+   nir_use_array uses;
 
    /** set of nir_dests where this register is defined (written to) */
    struct list_head defs;
 
    /** set of nir_ifs where this register is used as a condition */
-   struct list_head if_uses;
+   nir_use_array if_uses;
 } nir_register;
 
 #define nir_foreach_register(reg, reg_list) \
@@ -833,10 +860,10 @@ typedef struct nir_ssa_def {
    nir_instr *parent_instr;
 
    /** set of nir_instrs where this register is used (read from) */
-   struct list_head uses;
+   nir_use_array uses;
 
    /** set of nir_ifs where this register is used as a condition */
-   struct list_head if_uses;
+   nir_use_array if_uses;
 
    /** generic SSA definition index. */
    unsigned index;
@@ -853,8 +880,6 @@ typedef struct nir_ssa_def {
    bool divergent;
 } nir_ssa_def;
 
-struct nir_src;
-
 typedef struct {
    nir_register *reg;
    struct nir_src *indirect; /** < NULL for no indirect offset */
@@ -883,13 +908,14 @@ typedef struct nir_src {
       struct nir_if *parent_if;
    };
 
-   struct list_head use_link;
-
    union {
       nir_reg_src reg;
       nir_ssa_def *ssa;
    };
 
+   /** Slot in the uses or if_uses array of the SSA value or register */
+   uint32_t use_index;
+
    bool is_ssa;
 } nir_src;
 
@@ -902,17 +928,82 @@ nir_src_init(void)
 
 #define NIR_SRC_INIT nir_src_init()
 
+static inline nir_src **
+nir_use_array_srcs(const nir_use_array *uses)
+{
+   return uses->capacity > NIR_USE_ARRAY_INLINE ?
+          uses->srcs : (nir_src **)uses->inline_srcs;
+}
+
+/** Returns the use in slot i, or NULL if i is out of range */
+static inline nir_src *
+nir_use_array_get(const nir_use_array *uses, uint32_t i)
+{
+   return i < uses->count ? nir_use_array_srcs(uses)[i] : NULL;
+}
+
+void nir_use_array_grow(nir_use_array *uses, const nir_src *src);
+
+/** Adds src to uses, which must belong to whatever src reads */
+static inline void
+nir_use_array_add(nir_use_array *uses, nir_src *src)
+{
+   if (uses->count == uses->capacity)
+      nir_use_array_grow(uses, src);
+
+   src->use_index = uses->count++;
+   nir_use_array_srcs(uses)[src->use_index] = src;
+}
+
+static inline void
+nir_use_array_remove(nir_use_array *uses, nir_src *src)
+{
+   nir_src **srcs = nir_use_array_srcs(uses);
+
+   assert(src->use_index < uses->count && srcs[src->use_index] == src);
+
+   /* Uses are unordered, so the last one fills the hole. */
+   nir_src *last = srcs[--uses->count];
+   srcs[src->use_index] = last;
+   last->use_index = src->use_index;
+}
+
+/** Returns the array src belongs in as an instruction or if-condition use */
+static inline nir_use_array *
+nir_src_use_array(const nir_src *src, bool is_if_use)
+{
+   if (src->is_ssa)
+      return is_if_use ? &src->ssa->if_uses : &src->ssa->uses;
+   else
+      return is_if_use ? &src->reg.reg->if_uses : &src->reg.reg->uses;
+}
+
+/* Uses come in no particular order.  The _safe variants walk backwards so
+ * that removing the current use only moves an already visited one into its
+ * slot; uses added by the loop body are not visited.
+ */
+#define nir_foreach_use_in_array(src, use_array) \
+   for (nir_src *src = nir_use_array_get(use_array, 0); src; \
+        src = nir_use_array_get(use_array, src->use_index + 1))
+
+#define nir_foreach_use_in_array_safe(src, use_array) \
+   for (nir_src *src = nir_use_array_get(use_array, (use_array)->count - 1), \
+                *_prev_##src = src ? nir_use_array_get(use_array, src->use_index - 1) : NULL; \
+        src; \
+        src = _prev_##src, \
+        _prev_##src = src ? nir_use_array_get(use_array, src->use_index - 1) : NULL)
+
 #define nir_foreach_use(src, reg_or_ssa_def) \
-   list_for_each_entry(nir_src, src, &(reg_or_ssa_def)->uses, use_link)
+   nir_foreach_use_in_array(src, &(reg_or_ssa_def)->uses)
 
 #define nir_foreach_use_safe(src, reg_or_ssa_def) \
-   list_for_each_entry_safe(nir_src, src, &(reg_or_ssa_def)->uses, use_link)
+   nir_foreach_use_in_array_safe(src, &(reg_or_ssa_def)->uses)
 
 #define nir_foreach_if_use(src, reg_or_ssa_def) \
-   list_for_each_entry(nir_src, src, &(reg_or_ssa_def)->if_uses, use_link)
+   nir_foreach_use_in_array(src, &(reg_or_ssa_def)->if_uses)
 
 #define nir_foreach_if_use_safe(src, reg_or_ssa_def) \
-   list_for_each_entry_safe(nir_src, src, &(reg_or_ssa_def)->if_uses, use_link)
+   nir_foreach_use_in_array_safe(src, &(reg_or_ssa_def)->if_uses)
 
 typedef struct {
    union {
@@ -3191,6 +3282,24 @@ typedef enum {
     */
    nir_metadata_instr_index = 0x20,
 
+   /** Indicates that nir_ssa_def::divergent and nir_loop::divergent are valid.
+    *
+    * This is only ever computed for the entrypoint, see
+    * nir_divergence_analysis().  New SSA defs start out divergent, which is
+    * always safe, so adding instructions keeps it valid.  A pass can preserve
+    * this metadata type if it doesn't rewrite any uses or touch the CFG.
+    */
+   nir_metadata_divergence = 0x40,
+
+   /** Indicates that the nir_analyze_range() cache in
+    * nir_function_impl::range_ht is valid.
+    *
+    * Removing an ALU instruction invalidates it automatically, since the
+    * memory may be reused for a new instruction.  A pass can preserve this
+    * metadata type if it never rewrites the sources of ALU instructions.
+    */
+   nir_metadata_range_analysis = 0x80,
+
    /** All metadata
     *
     * This includes all nir_metadata flags except not_properly_reset.  Passes
@@ -3234,6 +3343,9 @@ typedef struct {
    bool structured;
 
    nir_metadata valid_metadata;
+
+   /** Cache for nir_analyze_range(), see nir_metadata_range_analysis */
+   struct hash_table *range_ht;
 } nir_function_impl;
 
 #define nir_foreach_function_temp_variable(var, impl) \
@@ -3827,7 +3939,11 @@ typedef struct nir_shader {
 
    struct exec_list functions; /** < list of nir_function */
 
+   /** Function impls not read yet, see nir_deserialize_lazy() */
+   struct nir_lazy_impls *lazy_impls;
+
    struct list_head gc_list; /** < list of all nir_instrs allocated on the shader but not yet freed. */
+   struct nir_instr_arena *instr_arena; /** < backing memory for the instrs on gc_list */
 
    /**
     * The size of the variable space for load_input_*, load_uniform_*, etc.
@@ -4301,9 +4417,9 @@ nir_instr_rewrite_src_ssa(ASSERTED nir_instr *instr,
 {
    assert(src->parent_instr == instr);
    assert(src->is_ssa && src->ssa);
-   list_del(&src->use_link);
+   nir_use_array_remove(&src->ssa->uses, src);
    src->ssa = new_ssa;
-   list_addtail(&src->use_link, &new_ssa->uses);
+   nir_use_array_add(&new_ssa->uses, src);
 }
 
 void nir_instr_rewrite_src(nir_instr *instr, nir_src *src, nir_src new_src);
@@ -4315,9 +4431,9 @@ nir_if_rewrite_condition_ssa(ASSERTED nir_if *if_stmt,
 {
    assert(src->parent_if == if_stmt);
    assert(src->is_ssa && src->ssa);
-   list_del(&src->use_link);
+   nir_use_array_remove(&src->ssa->if_uses, src);
    src->ssa = new_ssa;
-   list_addtail(&src->use_link, &new_ssa->if_uses);
+   nir_use_array_add(&new_ssa->if_uses, src);
 }
 
 void nir_if_rewrite_condition(nir_if *if_stmt, nir_src new_src);
@@ -4349,7 +4465,7 @@ nir_component_mask_t nir_ssa_def_components_read(const nir_ssa_def *def);
 static inline bool
 nir_ssa_def_is_unused(nir_ssa_def *ssa)
 {
-   return list_is_empty(&ssa->uses) && list_is_empty(&ssa->if_uses);
+   return ssa->uses.count == 0 && ssa->if_uses.count == 0;
 }
 
 
@@ -4468,6 +4584,21 @@ void nir_shader_replace(nir_shader *dest, nir_shader *src);
 
 void nir_shader_serialize_deserialize(nir_shader *s);
 
+nir_function_impl *nir_function_get_impl(nir_function *fxn);
+void nir_shader_materialize_impls(nir_shader *shader);
+
+typedef void (*nir_shader_task_func)(nir_shader *shader, void *data);
+
+/** Runs func on each shader, possibly concurrently on worker threads.
+ *
+ * The shaders must not share any ralloc context that func allocates from,
+ * and func must not call back into nir_shaders_run_parallel.  Returns once
+ * every shader has been processed.  Setting NIR_PARALLEL=false runs
+ * everything serially on the calling thread.
+ */
+void nir_shaders_run_parallel(nir_shader **shaders, unsigned num_shaders,
+                              nir_shader_task_func func, void *data);
+
 #ifndef NDEBUG
 void nir_validate_shader(nir_shader *shader, const char *when);
 void nir_validate_ssa_dominance(nir_shader *shader, const char *when);
@@ -4573,6 +4704,71 @@ static inline bool should_print_nir(nir_shader *shader) { return false; }
 
 #define NIR_SKIP(name) should_skip_nir(#name)
 
+#define NIR_OPT_LOOP_MAX_PASSES 64
+
+/**
+ * State for an optimization loop built out of NIR_LOOP_PASS.
+ *
+ * A pass that ran without making progress can't make progress again until
+ * some other pass has changed the shader, so it is skipped until then.  This
+ * mostly saves the final iteration of the usual do { } while (progress)
+ * loop, where every pass gets re-run to prove that nothing changed.
+ *
+ * Every pass in the loop must go through NIR_LOOP_PASS, since progress made
+ * behind the loop's back would leave passes wrongly marked as clean.
+ * Setting NIR_LOOP_STATS prints per-pass runs, skips, progress and time once
+ * the loop finishes.
+ */
+typedef struct nir_opt_loop {
+   /** Bumped every time a pass makes progress */
+   unsigned generation;
+   /** Index of the next pass in the current iteration */
+   unsigned pass_idx;
+   unsigned iterations;
+   /** Whether any pass made progress in the current iteration */
+   bool progress;
+   bool stats;
+
+   struct {
+      const char *name;
+      /** generation + 1 when the pass last ran without progress */
+      unsigned clean_generation;
+      unsigned runs;
+      unsigned skips;
+      unsigned progress;
+      uint64_t time_ns;
+   } passes[NIR_OPT_LOOP_MAX_PASSES];
+} nir_opt_loop;
+
+void nir_opt_loop_init(nir_opt_loop *loop);
+bool nir_opt_loop_should_run(nir_opt_loop *loop, unsigned idx, const char *name);
+int64_t nir_opt_loop_pass_start(nir_opt_loop *loop);
+void nir_opt_loop_pass_end(nir_opt_loop *loop, unsigned idx, bool progress,
+                           bool repeat, int64_t start);
+bool nir_opt_loop_continue(nir_opt_loop *loop, nir_shader *shader);
+
+#define _NIR_LOOP_PASS(loop, repeat, nir, pass, ...) do {             \
+   unsigned _loop_idx = (loop)->pass_idx++;                          \
+   if (nir_opt_loop_should_run((loop), _loop_idx, #pass)) {          \
+      bool _loop_progress = false;                                   \
+      int64_t _loop_start = nir_opt_loop_pass_start(loop);           \
+      NIR_PASS(_loop_progress, nir, pass, ##__VA_ARGS__);            \
+      nir_opt_loop_pass_end((loop), _loop_idx, _loop_progress,       \
+                            (repeat), _loop_start);                  \
+   }                                                                 \
+} while (0)
+
+#define NIR_LOOP_PASS(loop, nir, pass, ...) \
+   _NIR_LOOP_PASS(loop, true, nir, pass, ##__VA_ARGS__)
+
+/**
+ * Like NIR_LOOP_PASS, for passes whose progress doesn't need another
+ * iteration of the loop by itself, like NIR_PASS_V in a plain loop.  The
+ * other passes still see the shader as changed.
+ */
+#define NIR_LOOP_PASS_NO_REPEAT(loop, nir, pass, ...) \
+   _NIR_LOOP_PASS(loop, false, nir, pass, ##__VA_ARGS__)
+
 /** An instruction filtering callback with writemask
  *
  * Returns true if the instruction should be processed with the associated
@@ -1033,6 +1033,10 @@ class TreeAutomaton(object):
          new_opcodes.clear()
          process_new_states()
 
+def c_string(s):
+   """Escapes s for use inside a C string literal."""
+   return s.replace('\\', '\\\\').replace('"', '\\"')
+
 _algebraic_pass_template = mako.template.Template("""
 #include "nir.h"
 #include "nir_builder.h"
@@ -1056,7 +1060,7 @@ _algebraic_pass_template = mako.template.Template("""
 % if state_xforms: # avoid emitting a 0-length array for MSVC
 static const struct transform ${pass_name}_state${state_id}_xforms[] = {
 % for i in state_xforms:
-  { ${xforms[i].search.c_ptr(cache)}, ${xforms[i].replace.c_value_ptr(cache)}, ${xforms[i].condition_index} },
+  { ${xforms[i].search.c_ptr(cache)}, ${xforms[i].replace.c_value_ptr(cache)}, ${xforms[i].condition_index}, ${i} },
 % endfor
 };
 % endif
@@ -1086,6 +1090,23 @@ static const struct per_op_table ${pass_name}_table[nir_num_search_ops] = {
 % endfor
 };
 
+#ifndef NDEBUG
+static const char *const ${pass_name}_rule_names[] = {
+% for xform in xforms:
+   "${c_string(str(xform.search) + ' => ' + str(xform.replace))}",
+% endfor
+};
+
+static struct nir_algebraic_rule_stats ${pass_name}_rule_stats[${len(xforms)}];
+
+static struct nir_algebraic_stats ${pass_name}_stats = {
+   .pass_name = "${pass_name}",
+   .num_rules = ${len(xforms)},
+   .rule_names = ${pass_name}_rule_names,
+   .rules = ${pass_name}_rule_stats,
+};
+#endif
+
 const struct transform *${pass_name}_transforms[] = {
 % for i in range(len(automaton.state_patterns)):
    % if automaton.state_patterns[i]:
@@ -1120,12 +1141,17 @@ ${pass_name}(nir_shader *shader)
    condition_flags[${index}] = ${condition};
    % endfor
 
+   struct nir_algebraic_stats *stats = NULL;
+#ifndef NDEBUG
+   stats = nir_algebraic_stats_register(&${pass_name}_stats);
+#endif
+
    nir_foreach_function(function, shader) {
       if (function->impl) {
          progress |= nir_algebraic_impl(function->impl, condition_flags,
                                         ${pass_name}_transforms,
                                         ${pass_name}_transform_counts,
-                                        ${pass_name}_table);
+                                        ${pass_name}_table, stats);
       }
    }
 
@@ -1202,4 +1228,5 @@ class AlgebraicPass(object):
                                              condition_list=condition_list,
                                              automaton=self.automaton,
                                              get_c_opcode=get_c_opcode,
+                                             c_string=c_string,
                                              itertools=itertools)
@@ -0,0 +1,682 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * A standalone executable that runs a driver-like optimization pipeline
+ * over a corpus of SPIR-V (.spv) or serialized NIR (.nir) shaders and
+ * reports per-pass wall time, instruction count deltas and instruction
+ * allocation deltas as JSON.  Meant for bisecting compile-time regressions
+ * offline.
+ */
+
+#include "nir.h"
+#include "nir_serialize.h"
+#include "spirv/nir_spirv.h"
+#include "util/hash_table.h"
+#include "util/os_file.h"
+#include "util/os_time.h"
+
+#include <dirent.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define WORD_SIZE 4
+
+struct bench_pass {
+   const char *name;
+   unsigned runs;
+   unsigned progress;
+   uint64_t time_ns;
+   int64_t instr_delta;
+   int64_t alloc_delta;
+};
+
+struct bench_shader {
+   char *path;
+   uint64_t time_ns;
+   unsigned instrs_before;
+   unsigned instrs_after;
+};
+
+struct bench {
+   /* pass name -> bench_pass */
+   struct hash_table *passes;
+   struct bench_pass **pass_order;
+   unsigned num_passes;
+
+   struct bench_shader *shaders;
+   unsigned num_shaders;
+
+   /* Indices into bench_pass_names, replaces the default optimization loop */
+   unsigned *custom_passes;
+   unsigned num_custom_passes;
+
+   gl_shader_stage stage;
+   const char *entry_point;
+   unsigned iterations;
+   bool scalar;
+};
+
+static const nir_shader_compiler_options vector_options = {
+   .lower_fdph = true,
+   .lower_flrp32 = true,
+   .lower_flrp64 = true,
+   .lower_fmod = true,
+   .max_unroll_iterations = 32,
+};
+
+static const nir_shader_compiler_options scalar_options = {
+   .lower_fdph = true,
+   .lower_flrp32 = true,
+   .lower_flrp64 = true,
+   .lower_fmod = true,
+   .lower_to_scalar = true,
+   .max_unroll_iterations = 32,
+};
+
+static unsigned
+count_instrs(nir_shader *nir)
+{
+   unsigned count = 0;
+   nir_foreach_function(func, nir) {
+      if (!func->impl)
+         continue;
+      nir_foreach_block(block, func->impl) {
+         nir_foreach_instr(instr, block)
+            count++;
+      }
+   }
+   return count;
+}
+
+static struct bench_pass *
+get_pass(struct bench *bench, const char *name)
+{
+   struct hash_entry *entry = _mesa_hash_table_search(bench->passes, name);
+   if (entry)
+      return entry->data;
+
+   struct bench_pass *pass = calloc(1, sizeof(*pass));
+   pass->name = name;
+   _mesa_hash_table_insert(bench->passes, name, pass);
+
+   bench->pass_order = realloc(bench->pass_order,
+                               (bench->num_passes + 1) * sizeof(*bench->pass_order));
+   bench->pass_order[bench->num_passes++] = pass;
+   return pass;
+}
+
+struct pass_sample {
+   uint64_t start;
+   unsigned instrs;
+   unsigned allocs;
+};
+
+static struct pass_sample
+pass_begin(nir_shader *nir)
+{
+   struct pass_sample sample;
+   sample.instrs = count_instrs(nir);
+   sample.allocs = list_length(&nir->gc_list);
+   sample.start = os_time_get_nano();
+   return sample;
+}
+
+static void
+pass_end(struct bench *bench, const char *name, nir_shader *nir,
+         const struct pass_sample *sample, bool progress)
+{
+   uint64_t time = os_time_get_nano() - sample->start;
+   struct bench_pass *pass = get_pass(bench, name);
+
+   pass->runs++;
+   pass->progress += progress;
+   pass->time_ns += time;
+   pass->instr_delta += (int64_t)count_instrs(nir) - sample->instrs;
+   pass->alloc_delta += (int64_t)list_length(&nir->gc_list) - sample->allocs;
+}
+
+/* Only the pass itself is timed, instruction counting happens outside. */
+#define BENCH_PASS(progress, bench, nir, pass, ...) do {               \
+   struct pass_sample _sample = pass_begin(nir);                       \
+   bool _progress = false;                                             \
+   NIR_PASS(_progress, nir, pass, ##__VA_ARGS__);                      \
+   pass_end(bench, #pass, nir, &_sample, _progress);                   \
+   progress |= _progress;                                              \
+} while (0)
+
+/* Passes that can be selected with --passes, along with their arguments. */
+#define BENCH_PASS_LIST(X)                                             \
+   X(nir_lower_vars_to_ssa)                                            \
+   X(nir_lower_alu_to_scalar, NULL, NULL)                              \
+   X(nir_lower_phis_to_scalar, false)                                  \
+   X(nir_copy_prop)                                                    \
+   X(nir_opt_copy_prop_vars)                                           \
+   X(nir_opt_dead_write_vars)                                          \
+   X(nir_opt_combine_stores, nir_var_all)                              \
+   X(nir_opt_remove_phis)                                              \
+   X(nir_opt_dce)                                                      \
+   X(nir_opt_dead_cf)                                                  \
+   X(nir_opt_cse)                                                      \
+   X(nir_opt_gcm, false)                                               \
+   X(nir_opt_if, false)                                                \
+   X(nir_opt_peephole_select, 8, true, true)                           \
+   X(nir_opt_algebraic)                                                \
+   X(nir_opt_algebraic_late)                                           \
+   X(nir_opt_constant_folding)                                         \
+   X(nir_opt_undef)                                                    \
+   X(nir_opt_loop_unroll)                                              \
+   X(nir_opt_trivial_continues)                                        \
+   X(nir_opt_shrink_vectors, false)
+
+static const char *const bench_pass_names[] = {
+#define BENCH_PASS_NAME(pass, ...) #pass,
+   BENCH_PASS_LIST(BENCH_PASS_NAME)
+#undef BENCH_PASS_NAME
+};
+
+static unsigned
+bench_pass_index(const char *name)
+{
+   for (unsigned i = 0; i < ARRAY_SIZE(bench_pass_names); i++) {
+      /* Allow leaving out the nir_ prefix */
+      if (!strcmp(name, bench_pass_names[i]) ||
+          !strcmp(name, bench_pass_names[i] + strlen("nir_")))
+         return i;
+   }
+   return ~0u;
+}
+
+static bool
+run_pass_by_index(struct bench *bench, nir_shader *nir, unsigned index)
+{
+   bool progress = false;
+   unsigned i = 0;
+
+#define BENCH_PASS_RUN(pass, ...)                                      \
+   if (index == i++) {                                                 \
+      BENCH_PASS(progress, bench, nir, pass, ##__VA_ARGS__);           \
+      return progress;                                                 \
+   }
+   BENCH_PASS_LIST(BENCH_PASS_RUN)
+#undef BENCH_PASS_RUN
+
+   unreachable("invalid pass index");
+}
+
+static void
+run_pipeline(struct bench *bench, nir_shader *nir)
+{
+   bool progress = false;
+
+   BENCH_PASS(progress, bench, nir, nir_lower_variable_initializers,
+              nir_var_function_temp);
+   BENCH_PASS(progress, bench, nir, nir_lower_returns);
+   BENCH_PASS(progress, bench, nir, nir_inline_functions);
+   BENCH_PASS(progress, bench, nir, nir_copy_prop);
+   BENCH_PASS(progress, bench, nir, nir_opt_deref);
+
+   foreach_list_typed_safe(nir_function, func, node, &nir->functions) {
+      if (!func->is_entrypoint)
+         exec_node_remove(&func->node);
+   }
+
+   BENCH_PASS(progress, bench, nir, nir_lower_variable_initializers,
+              ~nir_var_function_temp);
+   BENCH_PASS(progress, bench, nir, nir_split_var_copies);
+   BENCH_PASS(progress, bench, nir, nir_lower_global_vars_to_local);
+   BENCH_PASS(progress, bench, nir, nir_lower_var_copies);
+
+   if (bench->num_custom_passes) {
+      do {
+         progress = false;
+         for (unsigned i = 0; i < bench->num_custom_passes; i++)
+            progress |= run_pass_by_index(bench, nir, bench->custom_passes[i]);
+      } while (progress);
+
+      nir_sweep(nir);
+      return;
+   }
+
+   do {
+      progress = false;
+
+      BENCH_PASS(progress, bench, nir, nir_lower_vars_to_ssa);
+      if (bench->scalar) {
+         BENCH_PASS(progress, bench, nir, nir_lower_alu_to_scalar, NULL, NULL);
+         BENCH_PASS(progress, bench, nir, nir_lower_phis_to_scalar, false);
+      }
+      BENCH_PASS(progress, bench, nir, nir_copy_prop);
+      BENCH_PASS(progress, bench, nir, nir_opt_remove_phis);
+      BENCH_PASS(progress, bench, nir, nir_opt_dce);
+      BENCH_PASS(progress, bench, nir, nir_opt_dead_cf);
+      BENCH_PASS(progress, bench, nir, nir_opt_cse);
+      BENCH_PASS(progress, bench, nir, nir_opt_peephole_select, 8, true, true);
+      BENCH_PASS(progress, bench, nir, nir_opt_algebraic);
+      BENCH_PASS(progress, bench, nir, nir_opt_constant_folding);
+      BENCH_PASS(progress, bench, nir, nir_opt_undef);
+      BENCH_PASS(progress, bench, nir, nir_opt_loop_unroll);
+   } while (progress);
+
+   do {
+      progress = false;
+      BENCH_PASS(progress, bench, nir, nir_opt_algebraic_late);
+      if (progress) {
+         BENCH_PASS(progress, bench, nir, nir_copy_prop);
+         BENCH_PASS(progress, bench, nir, nir_opt_dce);
+         BENCH_PASS(progress, bench, nir, nir_opt_cse);
+      }
+   } while (progress);
+
+   nir_sweep(nir);
+}
+
+static gl_shader_stage
+stage_from_path(const char *path, gl_shader_stage fallback)
+{
+   static const struct {
+      const char *ext;
+      gl_shader_stage stage;
+   } exts[] = {
+      { ".vert", MESA_SHADER_VERTEX },
+      { ".tesc", MESA_SHADER_TESS_CTRL },
+      { ".tese", MESA_SHADER_TESS_EVAL },
+      { ".geom", MESA_SHADER_GEOMETRY },
+      { ".frag", MESA_SHADER_FRAGMENT },
+      { ".comp", MESA_SHADER_COMPUTE },
+      { ".task", MESA_SHADER_TASK },
+      { ".mesh", MESA_SHADER_MESH },
+      { ".cl", MESA_SHADER_KERNEL },
+   };
+
+   /* Look at the extension in front of .spv in the file name only, so that
+    * e.g. a "foo.comp/" directory doesn't turn every shader in it into a
+    * compute shader.
+    */
+   const char *base = strrchr(path, '/');
+   base = base ? base + 1 : path;
+
+   const char *ext_end = strrchr(base, '.');
+   if (!ext_end)
+      return fallback;
+
+   const char *ext = NULL;
+   for (const char *c = base; c < ext_end; c++) {
+      if (*c == '.')
+         ext = c;
+   }
+   if (!ext)
+      return fallback;
+
+   size_t ext_len = ext_end - ext;
+   for (unsigned i = 0; i < ARRAY_SIZE(exts); i++) {
+      if (strlen(exts[i].ext) == ext_len &&
+          !strncmp(ext, exts[i].ext, ext_len))
+         return exts[i].stage;
+   }
+
+   return fallback;
+}
+
+static bool
+has_suffix(const char *str, const char *suffix)
+{
+   size_t len = strlen(str), suffix_len = strlen(suffix);
+   return len >= suffix_len && !strcmp(str + len - suffix_len, suffix);
+}
+
+static nir_shader *
+load_shader(struct bench *bench, const char *path,
+            const void *data, size_t size)
+{
+   const nir_shader_compiler_options *options =
+      bench->scalar ? &scalar_options : &vector_options;
+
+   if (has_suffix(path, ".nir")) {
+      struct blob_reader reader;
+      blob_reader_init(&reader, data, size);
+      return nir_deserialize(NULL, options, &reader);
+   }
+
+   if (size % WORD_SIZE != 0) {
+      fprintf(stderr, "%s: file length isn't a multiple of the word size\n",
+              path);
+      return NULL;
+   }
+
+   gl_shader_stage stage = stage_from_path(path, bench->stage);
+   struct spirv_to_nir_options spirv_opts = {
+      .environment = NIR_SPIRV_VULKAN,
+   };
+
+   if (stage == MESA_SHADER_KERNEL) {
+      spirv_opts.environment = NIR_SPIRV_OPENCL;
+      spirv_opts.caps.address = true;
+      spirv_opts.caps.float64 = true;
+      spirv_opts.caps.int8 = true;
+      spirv_opts.caps.int16 = true;
+      spirv_opts.caps.int64 = true;
+      spirv_opts.caps.kernel = true;
+   }
+
+   return spirv_to_nir(data, size / WORD_SIZE, NULL, 0, stage,
+                       bench->entry_point, &spirv_opts, options);
+}
+
+static void
+bench_file(struct bench *bench, const char *path)
+{
+   if (!has_suffix(path, ".spv") && !has_suffix(path, ".nir"))
+      return;
+
+   size_t size;
+   char *data = os_read_file(path, &size);
+   if (!data) {
+      fprintf(stderr, "%s: failed to read\n", path);
+      return;
+   }
+
+   for (unsigned i = 0; i < bench->iterations; i++) {
+      uint64_t start = os_time_get_nano();
+
+      nir_shader *nir = load_shader(bench, path, data, size);
+      if (!nir) {
+         fprintf(stderr, "%s: failed to load\n", path);
+         break;
+      }
+
+      unsigned instrs_before = count_instrs(nir);
+      run_pipeline(bench, nir);
+
+      if (i == 0) {
+         bench->shaders = realloc(bench->shaders, (bench->num_shaders + 1) *
+                                                  sizeof(*bench->shaders));
+         struct bench_shader *shader = &bench->shaders[bench->num_shaders++];
+         shader->path = strdup(path);
+         shader->time_ns = 0;
+         shader->instrs_before = instrs_before;
+         shader->instrs_after = count_instrs(nir);
+      }
+
+      ralloc_free(nir);
+
+      bench->shaders[bench->num_shaders - 1].time_ns +=
+         os_time_get_nano() - start;
+   }
+
+   free(data);
+}
+
+static void
+bench_path(struct bench *bench, const char *path)
+{
+   struct stat st;
+   if (stat(path, &st) != 0) {
+      fprintf(stderr, "%s: no such file or directory\n", path);
+      return;
+   }
+
+   if (!S_ISDIR(st.st_mode)) {
+      bench_file(bench, path);
+      return;
+   }
+
+   struct dirent **entries;
+   int n = scandir(path, &entries, NULL, alphasort);
+   for (int i = 0; i < n; i++) {
+      if (entries[i]->d_name[0] != '.') {
+         char *child;
+         if (asprintf(&child, "%s/%s", path, entries[i]->d_name) > 0) {
+            bench_path(bench, child);
+            free(child);
+         }
+      }
+      free(entries[i]);
+   }
+   if (n >= 0)
+      free(entries);
+}
+
+static void
+print_json_string(FILE *f, const char *str)
+{
+   fputc('"', f);
+   for (; *str; str++) {
+      if (*str == '"' || *str == '\\')
+         fputc('\\', f);
+      fputc(*str, f);
+   }
+   fputc('"', f);
+}
+
+static void
+print_json(struct bench *bench, FILE *f)
+{
+   uint64_t total_ns = 0;
+   for (unsigned i = 0; i < bench->num_shaders; i++)
+      total_ns += bench->shaders[i].time_ns;
+
+   fprintf(f, "{\n");
+   fprintf(f, "  \"iterations\": %u,\n", bench->iterations);
+   fprintf(f, "  \"total_ms\": %.3f,\n", total_ns / 1000000.0);
+
+   fprintf(f, "  \"passes\": [\n");
+   for (unsigned i = 0; i < bench->num_passes; i++) {
+      const struct bench_pass *pass = bench->pass_order[i];
+      fprintf(f, "    { \"name\": ");
+      print_json_string(f, pass->name);
+      fprintf(f, ", \"runs\": %u, \"progress\": %u, \"time_ms\": %.3f, "
+                 "\"instr_delta\": %" PRId64 ", \"alloc_delta\": %" PRId64 " }%s\n",
+              pass->runs, pass->progress, pass->time_ns / 1000000.0,
+              pass->instr_delta, pass->alloc_delta,
+              i + 1 < bench->num_passes ? "," : "");
+   }
+   fprintf(f, "  ],\n");
+
+   fprintf(f, "  \"shaders\": [\n");
+   for (unsigned i = 0; i < bench->num_shaders; i++) {
+      const struct bench_shader *shader = &bench->shaders[i];
+      fprintf(f, "    { \"path\": ");
+      print_json_string(f, shader->path);
+      fprintf(f, ", \"time_ms\": %.3f, \"instrs_before\": %u, "
+                 "\"instrs_after\": %u }%s\n",
+              shader->time_ns / 1000000.0, shader->instrs_before,
+              shader->instrs_after, i + 1 < bench->num_shaders ? "," : "");
+   }
+   fprintf(f, "  ]\n");
+   fprintf(f, "}\n");
+}
+
+static bool
+parse_passes(struct bench *bench, const char *list)
+{
+   char *dup = strdup(list);
+   char *save = NULL;
+   bool ok = true;
+
+   for (char *name = strtok_r(dup, ",", &save); name;
+        name = strtok_r(NULL, ",", &save)) {
+      unsigned index = bench_pass_index(name);
+      if (index == ~0u) {
+         fprintf(stderr, "Unknown pass \"%s\", valid passes are:\n", name);
+         for (unsigned i = 0; i < ARRAY_SIZE(bench_pass_names); i++)
+            fprintf(stderr, "  %s\n", bench_pass_names[i]);
+         ok = false;
+         break;
+      }
+
+      bench->custom_passes = realloc(bench->custom_passes,
+                                     (bench->num_custom_passes + 1) *
+                                     sizeof(*bench->custom_passes));
+      bench->custom_passes[bench->num_custom_passes++] = index;
+   }
+
+   free(dup);
+   return ok;
+}
+
+static void
+print_usage(char *exec_name, FILE *f)
+{
+   fprintf(f,
+"Usage: %s [options] <file or directory>...\n"
+"Runs a generic NIR optimization pipeline over every .spv and .nir file\n"
+"and prints per-pass statistics as JSON.\n"
+"Options:\n"
+"  -h, --help              Print this help.\n"
+"  -s, --stage <stage>     Stage for SPIR-V files whose name doesn't end in\n"
+"                          .vert.spv, .frag.spv, .comp.spv, etc.  Valid\n"
+"                          stages are vertex, tess-ctrl, tess-eval, geometry,\n"
+"                          fragment, task, mesh, compute and kernel.\n"
+"  -e, --entry <name>      Specify the SPIR-V entry-point name.\n"
+"  -n, --iterations <n>    Compile each shader n times.\n"
+"      --scalar            Use scalar compiler options.\n"
+"  -p, --passes <list>     Comma-separated list of passes to repeat until\n"
+"                          none of them makes progress, instead of the\n"
+"                          default optimization loop.  The nir_ prefix may\n"
+"                          be left out.  Run with an unknown pass name to\n"
+"                          list the available passes.\n"
+"  -o, --output <file>     Write the JSON report to file instead of stdout.\n"
+   , exec_name);
+}
+
+static gl_shader_stage
+stage_to_enum(const char *stage)
+{
+   static const char *names[] = {
+      [MESA_SHADER_VERTEX] = "vertex",
+      [MESA_SHADER_TESS_CTRL] = "tess-ctrl",
+      [MESA_SHADER_TESS_EVAL] = "tess-eval",
+      [MESA_SHADER_GEOMETRY] = "geometry",
+      [MESA_SHADER_FRAGMENT] = "fragment",
+      [MESA_SHADER_COMPUTE] = "compute",
+      [MESA_SHADER_TASK] = "task",
+      [MESA_SHADER_MESH] = "mesh",
+      [MESA_SHADER_KERNEL] = "kernel",
+   };
+
+   for (unsigned i = 0; i < ARRAY_SIZE(names); i++) {
+      if (names[i] && !strcmp(stage, names[i]))
+         return i;
+   }
+   return MESA_SHADER_NONE;
+}
+
+int main(int argc, char **argv)
+{
+   struct bench bench = {
+      .stage = MESA_SHADER_FRAGMENT,
+      .entry_point = "main",
+      .iterations = 1,
+   };
+   const char *output = NULL;
+   int ch;
+
+   static struct option long_options[] =
+     {
+       {"help",             no_argument, 0, 'h'},
+       {"stage",      required_argument, 0, 's'},
+       {"entry",      required_argument, 0, 'e'},
+       {"iterations", required_argument, 0, 'n'},
+       {"scalar",           no_argument, 0, 'S'},
+       {"passes",     required_argument, 0, 'p'},
+       {"output",     required_argument, 0, 'o'},
+       {0, 0, 0, 0}
+     };
+
+   while ((ch = getopt_long(argc, argv, "hs:e:n:p:o:", long_options, NULL)) != -1)
+   {
+      switch (ch)
+      {
+      case 'h':
+         print_usage(argv[0], stdout);
+         return 0;
+      case 's':
+         bench.stage = stage_to_enum(optarg);
+         if (bench.stage == MESA_SHADER_NONE) {
+            fprintf(stderr, "Unknown stage \"%s\"\n", optarg);
+            print_usage(argv[0], stderr);
+            return 1;
+         }
+         break;
+      case 'e':
+         bench.entry_point = optarg;
+         break;
+      case 'n':
+         bench.iterations = MAX2(atoi(optarg), 1);
+         break;
+      case 'S':
+         bench.scalar = true;
+         break;
+      case 'p':
+         if (!parse_passes(&bench, optarg))
+            return 1;
+         break;
+      case 'o':
+         output = optarg;
+         break;
+      default:
+         print_usage(argv[0], stderr);
+         return 1;
+      }
+   }
+
+   if (optind >= argc) {
+      print_usage(argv[0], stderr);
+      return 1;
+   }
+
+   glsl_type_singleton_init_or_ref();
+
+   bench.passes = _mesa_hash_table_create(NULL, _mesa_hash_string,
+                                          _mesa_key_string_equal);
+
+   for (int i = optind; i < argc; i++)
+      bench_path(&bench, argv[i]);
+
+   FILE *f = output ? fopen(output, "w") : stdout;
+   if (!f) {
+      fprintf(stderr, "Failed to open %s\n", output);
+      return 1;
+   }
+   print_json(&bench, f);
+   if (output)
+      fclose(f);
+
+   for (unsigned i = 0; i < bench.num_passes; i++)
+      free(bench.pass_order[i]);
+   free(bench.pass_order);
+   for (unsigned i = 0; i < bench.num_shaders; i++)
+      free(bench.shaders[i].path);
+   free(bench.shaders);
+   free(bench.custom_passes);
+   _mesa_hash_table_destroy(bench.passes, NULL);
+
+   glsl_type_singleton_decref();
+
+   return 0;
+}
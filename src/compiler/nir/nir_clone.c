@@ -23,6 +23,7 @@
 
 #include "nir.h"
 #include "nir_control_flow.h"
+#include "util/u_dynarray.h"
 
 /* Secret Decoder Ring:
  *   clone_foo():
@@ -45,8 +46,8 @@ typedef struct {
    /* maps orig ptr -> cloned ptr: */
    struct hash_table *remap_table;
 
-   /* List of phi sources. */
-   struct list_head phi_srcs;
+   /* Array of nir_phi_src pointers waiting for fixup_phi_srcs(). */
+   struct util_dynarray phi_srcs;
 
    /* new shader object, used as memctx for just about everything else: */
    nir_shader *ns;
@@ -65,13 +66,14 @@ init_clone_state(clone_state *state, struct hash_table *remap_table,
       state->remap_table = _mesa_pointer_hash_table_create(NULL);
    }
 
-   list_inithead(&state->phi_srcs);
+   util_dynarray_init(&state->phi_srcs, NULL);
 }
 
 static void
 free_clone_state(clone_state *state)
 {
    _mesa_hash_table_destroy(state->remap_table, NULL);
+   util_dynarray_fini(&state->phi_srcs);
 }
 
 static inline void *
@@ -214,9 +216,9 @@ clone_register(clone_state *state, const nir_register *reg)
    nreg->index = reg->index;
 
    /* reconstructing uses/defs/if_uses handled by nir_instr_insert() */
-   list_inithead(&nreg->uses);
+   nreg->uses.capacity = NIR_USE_ARRAY_INLINE;
    list_inithead(&nreg->defs);
-   list_inithead(&nreg->if_uses);
+   nreg->if_uses.capacity = NIR_USE_ARRAY_INLINE;
 
    return nreg;
 }
@@ -450,10 +452,10 @@ clone_phi(clone_state *state, const nir_phi_instr *phi, nir_block *nblk)
    foreach_list_typed(nir_phi_src, src, node, &phi->srcs) {
       nir_phi_src *nsrc = nir_phi_instr_add_src(nphi, src->pred, src->src);
 
-      /* Stash it in the list of phi sources.  We'll walk this list and fix up
+      /* Stash it in the array of phi sources.  We'll walk it and fix up
        * sources at the very end of clone_function_impl.
        */
-      list_add(&nsrc->src.use_link, &state->phi_srcs);
+      util_dynarray_append(&state->phi_srcs, nir_phi_src *, nsrc);
    }
 
    return nphi;
@@ -618,21 +620,18 @@ clone_cf_list(clone_state *state, struct exec_list *dst,
 static void
 fixup_phi_srcs(clone_state *state)
 {
-   list_for_each_entry_safe(nir_phi_src, src, &state->phi_srcs, src.use_link) {
+   util_dynarray_foreach(&state->phi_srcs, nir_phi_src *, src_ptr) {
+      nir_phi_src *src = *src_ptr;
       src->pred = remap_local(state, src->pred);
 
-      /* Remove from this list */
-      list_del(&src->src.use_link);
-
-      if (src->src.is_ssa) {
+      if (src->src.is_ssa)
          src->src.ssa = remap_local(state, src->src.ssa);
-         list_addtail(&src->src.use_link, &src->src.ssa->uses);
-      } else {
+      else
          src->src.reg.reg = remap_reg(state, src->src.reg.reg);
-         list_addtail(&src->src.use_link, &src->src.reg.reg->uses);
-      }
+
+      nir_use_array_add(nir_src_use_array(&src->src, false), &src->src);
    }
-   assert(list_is_empty(&state->phi_srcs));
+   util_dynarray_clear(&state->phi_srcs);
 }
 
 void
@@ -664,6 +663,8 @@ nir_cf_list_clone(nir_cf_list *dst, nir_cf_list *src, nir_cf_node *parent,
 
    if (!remap_table)
       free_clone_state(&state);
+   else
+      util_dynarray_fini(&state.phi_srcs);
 }
 
 static nir_function_impl *
@@ -675,7 +676,7 @@ clone_function_impl(clone_state *state, const nir_function_impl *fi)
    clone_reg_list(state, &nfi->registers, &fi->registers);
    nfi->reg_alloc = fi->reg_alloc;
 
-   assert(list_is_empty(&state->phi_srcs));
+   assert(util_dynarray_num_elements(&state->phi_srcs, nir_phi_src *) == 0);
 
    clone_cf_list(state, &nfi->body, &fi->body);
 
@@ -730,6 +731,8 @@ clone_function(clone_state *state, const nir_function *fxn, nir_shader *ns)
 nir_shader *
 nir_shader_clone(void *mem_ctx, const nir_shader *s)
 {
+   nir_shader_materialize_impls((nir_shader *)s);
+
    clone_state state;
    init_clone_state(&state, NULL, true, false);
 
@@ -785,6 +788,8 @@ nir_shader_clone(void *mem_ctx, const nir_shader *s)
 void
 nir_shader_replace(nir_shader *dst, nir_shader *src)
 {
+   nir_shader_materialize_impls(src);
+
    /* Delete all of dest's ralloc children */
    void *dead_ctx = ralloc_context(NULL);
    ralloc_adopt(dead_ctx, dst);
@@ -797,7 +802,12 @@ nir_shader_replace(nir_shader *dst, nir_shader *src)
    /* Re-parent all of src's ralloc children to dst */
    ralloc_adopt(dst, src);
 
+   /* src's instrs live in its arena, so dst takes that over and hands its
+    * own (now empty) arena to src to be destroyed with it
+    */
+   struct nir_instr_arena *dead_arena = dst->instr_arena;
    memcpy(dst, src, sizeof(*dst));
+   src->instr_arena = dead_arena;
 
    /* We have to move all the linked lists over separately because we need the
     * pointers in the list elements to point to the lists in dst and not src.
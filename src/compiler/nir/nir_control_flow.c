@@ -241,7 +241,7 @@ nir_insert_phi_undef(nir_block *block, nir_block *pred)
                                     phi->dest.ssa.bit_size);
       nir_instr_insert_before_cf_list(&impl->body, &undef->instr);
       nir_phi_src *src = nir_phi_instr_add_src(phi, pred, nir_src_for_ssa(&undef->def));
-      list_addtail(&src->src.use_link, &undef->def.uses);
+      nir_use_array_add(&undef->def.uses, &src->src);
    }
 }
 
@@ -438,7 +438,7 @@ remove_phi_src(nir_block *block, nir_block *pred)
       nir_phi_instr *phi = nir_instr_as_phi(instr);
       nir_foreach_phi_src_safe(src, phi) {
          if (src->pred == pred) {
-            list_del(&src->src.use_link);
+            nir_use_array_remove(nir_src_use_array(&src->src, false), &src->src);
             exec_node_remove(&src->node);
             free(src);
          }
@@ -534,13 +534,8 @@ update_if_uses(nir_cf_node *node)
    nir_if *if_stmt = nir_cf_node_as_if(node);
 
    if_stmt->condition.parent_if = if_stmt;
-   if (if_stmt->condition.is_ssa) {
-      list_addtail(&if_stmt->condition.use_link,
-                   &if_stmt->condition.ssa->if_uses);
-   } else {
-      list_addtail(&if_stmt->condition.use_link,
-                   &if_stmt->condition.reg.reg->if_uses);
-   }
+   nir_use_array_add(nir_src_use_array(&if_stmt->condition, true),
+                     &if_stmt->condition);
 }
 
 /**
@@ -646,7 +641,8 @@ cleanup_cf_node(nir_cf_node *node, nir_function_impl *impl)
       foreach_list_typed(nir_cf_node, child, node, &if_stmt->else_list)
          cleanup_cf_node(child, impl);
 
-      list_del(&if_stmt->condition.use_link);
+      nir_use_array_remove(nir_src_use_array(&if_stmt->condition, true),
+                           &if_stmt->condition);
       break;
    }
 
@@ -1108,7 +1108,7 @@ opt_deref_cast(nir_builder *b, nir_deref_instr *cast)
    }
 
    /* If uses would be a bit crazy */
-   assert(list_is_empty(&cast->dest.ssa.if_uses));
+   assert(cast->dest.ssa.if_uses.count == 0);
 
    if (nir_deref_instr_remove_if_unused(cast))
       progress = true;
@@ -994,7 +994,9 @@ nir_divergence_analysis(nir_shader *shader)
       .first_visit = true,
    };
 
-   visit_cf_list(&nir_shader_get_entrypoint(shader)->body, &state);
+   nir_function_impl *impl = nir_shader_get_entrypoint(shader);
+   visit_cf_list(&impl->body, &state);
+   impl->valid_metadata |= nir_metadata_divergence;
 }
 
 bool nir_update_instr_divergence(nir_shader *shader, nir_instr *instr)
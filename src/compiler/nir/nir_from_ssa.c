@@ -1038,10 +1038,7 @@ dest_replace_ssa_with_reg(nir_dest *dest, void *void_state)
 
    nir_ssa_def_rewrite_uses_src(&dest->ssa, nir_src_for_reg(reg));
 
-   nir_instr *instr = dest->ssa.parent_instr;
-   *dest = nir_dest_for_reg(reg);
-   dest->reg.parent_instr = instr;
-   list_addtail(&dest->reg.def_link, &reg->defs);
+   nir_instr_rewrite_dest(dest->ssa.parent_instr, dest, nir_dest_for_reg(reg));
 
    state->progress = true;
 
@@ -1059,7 +1056,7 @@ ssa_def_is_local_to_block(nir_ssa_def *def, UNUSED void *state)
       }
    }
 
-   if (!list_is_empty(&def->if_uses))
+   if (def->if_uses.count != 0)
       return false;
 
    return true;
@@ -1970,8 +1970,8 @@ lower_explicit_io_deref(nir_builder *b, nir_deref_instr *deref,
     * one deref which could break our list walking since we walk the list
     * backwards.
     */
-   assert(list_is_empty(&deref->dest.ssa.if_uses));
-   if (list_is_empty(&deref->dest.ssa.uses)) {
+   assert(deref->dest.ssa.if_uses.count == 0);
+   if (deref->dest.ssa.uses.count == 0) {
       nir_instr_remove(&deref->instr);
       return;
    }
@@ -153,7 +153,7 @@ nir_lower_to_source_mods_block(nir_block *block,
       if (!(options & nir_lower_float_source_mods))
          continue;
 
-      if (!list_is_empty(&alu->dest.dest.ssa.if_uses))
+      if (alu->dest.dest.ssa.if_uses.count != 0)
          continue;
 
       bool all_children_are_sat = true;
@@ -152,7 +152,7 @@ try_coalesce(nir_alu_instr *vec, unsigned start_idx, void *_data)
          return 0;
    }
 
-   if (!list_is_empty(&vec->src[start_idx].src.ssa->if_uses))
+   if (vec->src[start_idx].src.ssa->if_uses.count != 0)
       return 0;
 
    if (vec->src[start_idx].src.ssa->parent_instr->type != nir_instr_type_alu)
@@ -49,6 +49,16 @@ nir_metadata_require(nir_function_impl *impl, nir_metadata required, ...)
       nir_loop_analyze_impl(impl, va_arg(ap, nir_variable_mode));
       va_end(ap);
    }
+   if (NEEDS_UPDATE(nir_metadata_divergence)) {
+      assert(impl == nir_shader_get_entrypoint(impl->function->shader));
+      nir_divergence_analysis(impl->function->shader);
+   }
+   if (NEEDS_UPDATE(nir_metadata_range_analysis)) {
+      if (impl->range_ht)
+         _mesa_hash_table_clear(impl->range_ht, NULL);
+      else
+         impl->range_ht = _mesa_pointer_hash_table_create(impl);
+   }
 
 #undef NEEDS_UPDATE
 
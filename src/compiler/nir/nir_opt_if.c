@@ -493,11 +493,11 @@ opt_split_alu_of_phi(nir_builder *b, nir_loop *loop)
 
       if (!is_prev_result_undef && !is_prev_result_const) {
          /* check if the only user is a trivial bcsel */
-         if (!list_is_empty(&alu->dest.dest.ssa.if_uses) ||
-             !list_is_singular(&alu->dest.dest.ssa.uses))
+         if (alu->dest.dest.ssa.if_uses.count != 0 ||
+             alu->dest.dest.ssa.uses.count != 1)
             continue;
 
-         nir_src *use = list_first_entry(&alu->dest.dest.ssa.uses, nir_src, use_link);
+         nir_src *use = nir_use_array_get(&alu->dest.dest.ssa.uses, 0);
          if (!is_trivial_bcsel(use->parent_instr, true))
             continue;
       }
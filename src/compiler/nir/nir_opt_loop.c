@@ -0,0 +1,108 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "nir.h"
+#include "util/log.h"
+#include "util/os_time.h"
+
+void
+nir_opt_loop_init(nir_opt_loop *loop)
+{
+   memset(loop, 0, sizeof(*loop));
+   loop->stats = env_var_as_boolean("NIR_LOOP_STATS", false);
+}
+
+bool
+nir_opt_loop_should_run(nir_opt_loop *loop, unsigned idx, const char *name)
+{
+   if (idx >= NIR_OPT_LOOP_MAX_PASSES)
+      return true;
+
+   /* The loop body took a different path than last time: this slot now
+    * belongs to another pass, whose state is unknown.
+    */
+   if (loop->passes[idx].name != name) {
+      loop->passes[idx].name = name;
+      loop->passes[idx].clean_generation = 0;
+   }
+
+   if (loop->passes[idx].clean_generation == loop->generation + 1) {
+      loop->passes[idx].skips++;
+      return false;
+   }
+   return true;
+}
+
+int64_t
+nir_opt_loop_pass_start(nir_opt_loop *loop)
+{
+   return loop->stats ? os_time_get_nano() : 0;
+}
+
+void
+nir_opt_loop_pass_end(nir_opt_loop *loop, unsigned idx, bool progress,
+                      bool repeat, int64_t start)
+{
+   if (progress) {
+      loop->generation++;
+      loop->progress |= repeat;
+   }
+   if (idx >= NIR_OPT_LOOP_MAX_PASSES)
+      return;
+
+   if (!progress)
+      loop->passes[idx].clean_generation = loop->generation + 1;
+   loop->passes[idx].runs++;
+   loop->passes[idx].progress += progress;
+   if (loop->stats)
+      loop->passes[idx].time_ns += os_time_get_nano() - start;
+}
+
+static void
+print_stats(nir_opt_loop *loop, nir_shader *shader)
+{
+   mesa_logi("NIR optimization loop (%s shader, %u iterations):",
+             _mesa_shader_stage_to_abbrev(shader->info.stage), loop->iterations);
+   for (unsigned i = 0; i < NIR_OPT_LOOP_MAX_PASSES && loop->passes[i].name; i++) {
+      mesa_logi("  %-32s %4u runs %4u skips %4u progress %8.3f ms",
+                loop->passes[i].name, loop->passes[i].runs, loop->passes[i].skips,
+                loop->passes[i].progress, loop->passes[i].time_ns / 1000000.0);
+   }
+}
+
+/**
+ * Ends an iteration of the loop, returning whether another one is needed.
+ */
+bool
+nir_opt_loop_continue(nir_opt_loop *loop, nir_shader *shader)
+{
+   bool progress = loop->progress;
+
+   loop->iterations++;
+   loop->pass_idx = 0;
+   loop->progress = false;
+
+   if (!progress && loop->stats)
+      print_stats(loop, shader);
+   return progress;
+}
@@ -224,7 +224,7 @@ block_check_for_allowed_instrs(nir_block *block, unsigned *count,
                return false;
 
             /* It cannot have any if-uses */
-            if (!list_is_empty(&mov->dest.dest.ssa.if_uses))
+            if (mov->dest.dest.ssa.if_uses.count != 0)
                return false;
 
             /* The only uses of this definition must be phis in the successor */
@@ -216,7 +216,7 @@ try_move_narrowing_dst(nir_builder *b, nir_phi_instr *phi)
    /* an if_uses means the phi is used directly in a conditional, ie.
     * without a conversion
     */
-   if (!list_is_empty(&phi->dest.ssa.if_uses))
+   if (phi->dest.ssa.if_uses.count != 0)
       return false;
 
    /* If the phi has no uses, then nothing to do: */
@@ -245,9 +245,10 @@ optimize_and_rewrite_atomic(nir_builder *b, nir_intrinsic_instr *intrin)
    ASSERTED bool original_result_divergent = intrin->dest.ssa.divergent;
    bool return_prev = !nir_ssa_def_is_unused(&intrin->dest.ssa);
 
+   /* The copy takes the use arrays along; re-initializing the dest below
+    * leaves the intrinsic with none.
+    */
    nir_ssa_def old_result = intrin->dest.ssa;
-   list_replace(&intrin->dest.ssa.uses, &old_result.uses);
-   list_replace(&intrin->dest.ssa.if_uses, &old_result.if_uses);
    nir_ssa_dest_init(&intrin->instr, &intrin->dest, 1, intrin->dest.ssa.bit_size, NULL);
 
    nir_ssa_def *result = optimize_atomic(b, intrin, return_prev);
@@ -263,6 +264,9 @@ optimize_and_rewrite_atomic(nir_builder *b, nir_intrinsic_instr *intrin)
    if (result) {
       assert(result->divergent == original_result_divergent);
       nir_ssa_def_rewrite_uses(&old_result, result);
+   } else {
+      /* Nothing used the old result, but its use arrays still need an owner */
+      nir_ssa_def_rewrite_uses(&old_result, &intrin->dest.ssa);
    }
 }
 
@@ -313,13 +317,16 @@ nir_opt_uniform_atomics(nir_shader *shader)
        shader->info.workgroup_size[2] == 1)
       return false;
 
+   nir_metadata_require(nir_shader_get_entrypoint(shader), nir_metadata_divergence);
+
    nir_foreach_function(function, shader) {
       if (!function->impl)
          continue;
 
       if (opt_uniform_atomics(function->impl)) {
          progress = true;
-         nir_metadata_preserve(function->impl, 0);
+         /* the builder computes the divergence of everything it adds */
+         nir_metadata_preserve(function->impl, nir_metadata_divergence);
       } else {
          nir_metadata_preserve(function->impl, nir_metadata_all);
       }
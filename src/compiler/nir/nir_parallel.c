@@ -0,0 +1,114 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Runs a callback over a set of independent shaders on a shared worker
+ * queue.  Two shaders are independent when they share no ralloc parent that
+ * passes allocate from, which holds for the stages of a linked program and
+ * for separately created kernels.  The calling thread executes the first
+ * shader itself and then waits for the rest, so callers never have to care
+ * whether the queue exists.
+ */
+
+#include "nir.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_queue.h"
+
+#define NIR_PARALLEL_MAX_THREADS 8
+
+struct nir_parallel_job {
+   nir_shader *shader;
+   nir_shader_task_func func;
+   void *data;
+   struct util_queue_fence fence;
+};
+
+static struct util_queue nir_parallel_queue;
+static bool nir_parallel_queue_ok;
+static once_flag nir_parallel_once = ONCE_FLAG_INIT;
+
+static void
+nir_parallel_queue_init(void)
+{
+   if (!env_var_as_boolean("NIR_PARALLEL", true))
+      return;
+
+   util_cpu_detect();
+   unsigned num_threads =
+      MIN2(util_get_cpu_caps()->nr_cpus, NIR_PARALLEL_MAX_THREADS);
+   if (num_threads < 2)
+      return;
+
+   /* The queue is torn down by the util_queue atexit handler. */
+   nir_parallel_queue_ok =
+      util_queue_init(&nir_parallel_queue, "nir_opt", MESA_SHADER_STAGES * 4,
+                      num_threads, UTIL_QUEUE_INIT_RESIZE_IF_FULL, NULL);
+}
+
+static void
+nir_parallel_execute(void *data, void *gdata, int thread_index)
+{
+   struct nir_parallel_job *job = data;
+   job->func(job->shader, job->data);
+}
+
+void
+nir_shaders_run_parallel(nir_shader **shaders, unsigned num_shaders,
+                         nir_shader_task_func func, void *data)
+{
+   if (num_shaders == 0)
+      return;
+
+   if (num_shaders > 1)
+      call_once(&nir_parallel_once, nir_parallel_queue_init);
+
+   if (num_shaders == 1 || !nir_parallel_queue_ok) {
+      for (unsigned i = 0; i < num_shaders; i++)
+         func(shaders[i], data);
+      return;
+   }
+
+   struct nir_parallel_job *jobs = calloc(num_shaders, sizeof(*jobs));
+   if (!jobs) {
+      for (unsigned i = 0; i < num_shaders; i++)
+         func(shaders[i], data);
+      return;
+   }
+
+   for (unsigned i = 1; i < num_shaders; i++) {
+      jobs[i].shader = shaders[i];
+      jobs[i].func = func;
+      jobs[i].data = data;
+      util_queue_fence_init(&jobs[i].fence);
+      util_queue_add_job(&nir_parallel_queue, &jobs[i], &jobs[i].fence,
+                         nir_parallel_execute, NULL, 0);
+   }
+
+   func(shaders[0], data);
+
+   for (unsigned i = 1; i < num_shaders; i++) {
+      util_queue_fence_wait(&jobs[i].fence);
+      util_queue_fence_destroy(&jobs[i].fence);
+   }
+   free(jobs);
+}
@@ -30,6 +30,9 @@
 #include "nir_builder.h"
 #include "nir_worklist.h"
 #include "util/half_float.h"
+#include "util/log.h"
+#include "util/simple_mtx.h"
+#include "util/u_atomic.h"
 
 /* This should be the same as nir_search_max_comm_ops in nir_algebraic.py. */
 #define NIR_SEARCH_MAX_COMM_OPS 8
@@ -51,7 +54,7 @@ struct match_state {
 static bool
 match_expression(const nir_search_expression *expr, nir_alu_instr *instr,
                  unsigned num_components, const uint8_t *swizzle,
-                 struct match_state *state);
+                 struct match_state *state, bool is_root);
 static bool
 nir_algebraic_automaton(nir_instr *instr, struct util_dynarray *states,
                         const struct per_op_table *pass_op_table);
@@ -290,7 +293,7 @@ match_value(const nir_search_value *value, nir_alu_instr *instr, unsigned src,
 
       return match_expression(nir_search_value_as_expression(value),
                               nir_instr_as_alu(instr->src[src].src.ssa->parent_instr),
-                              num_components, new_swizzle, state);
+                              num_components, new_swizzle, state, false);
 
    case nir_search_value_variable: {
       nir_search_variable *var = nir_search_value_as_variable(value);
@@ -388,12 +391,16 @@ match_value(const nir_search_value *value, nir_alu_instr *instr, unsigned src,
    }
 }
 
+/**
+ * \param is_root  The caller has already checked expr's condition and bit
+ *                 size against instr, see nir_replace_instr().
+ */
 static bool
 match_expression(const nir_search_expression *expr, nir_alu_instr *instr,
                  unsigned num_components, const uint8_t *swizzle,
-                 struct match_state *state)
+                 struct match_state *state, bool is_root)
 {
-   if (expr->cond && !expr->cond(instr))
+   if (!is_root && expr->cond && !expr->cond(instr))
       return false;
 
    if (!nir_op_matches_search_op(instr->op, expr->opcode))
@@ -401,7 +408,7 @@ match_expression(const nir_search_expression *expr, nir_alu_instr *instr,
 
    assert(instr->dest.dest.is_ssa);
 
-   if (expr->value.bit_size > 0 &&
+   if (!is_root && expr->value.bit_size > 0 &&
        instr->dest.dest.ssa.bit_size != expr->value.bit_size)
       return false;
 
@@ -699,6 +706,17 @@ nir_replace_instr(nir_builder *build, nir_alu_instr *instr,
 
    assert(instr->dest.dest.is_ssa);
 
+   /* The root's bit size and condition don't depend on which way around the
+    * commutative sources are matched, so don't re-check them (the condition
+    * can walk all uses of the instruction) for every combination below.
+    */
+   if (search->value.bit_size > 0 &&
+       instr->dest.dest.ssa.bit_size != search->value.bit_size)
+      return NULL;
+
+   if (search->cond && !search->cond(instr))
+      return NULL;
+
    struct match_state state;
    state.inexact_match = false;
    state.has_exact_alu = false;
@@ -720,7 +738,7 @@ nir_replace_instr(nir_builder *build, nir_alu_instr *instr,
 
       if (match_expression(search, instr,
                            instr->dest.dest.ssa.num_components,
-                           swizzle, &state)) {
+                           swizzle, &state, true)) {
          found = true;
          break;
       }
@@ -855,6 +873,63 @@ nir_algebraic_automaton(nir_instr *instr, struct util_dynarray *states,
    }
 }
 
+static simple_mtx_t stats_mtx = _SIMPLE_MTX_INITIALIZER_NP;
+static struct nir_algebraic_stats *stats_list;
+
+static void
+nir_algebraic_stats_dump(void)
+{
+   simple_mtx_lock(&stats_mtx);
+   for (struct nir_algebraic_stats *stats = stats_list; stats;
+        stats = stats->next) {
+      unsigned never_hit = 0;
+
+      mesa_logi("%s: %8s %8s  rule", stats->pass_name, "attempts", "hits");
+      for (unsigned i = 0; i < stats->num_rules; i++) {
+         const struct nir_algebraic_rule_stats *rule = &stats->rules[i];
+         if (!rule->hits)
+            never_hit++;
+
+         mesa_logi("%s: %8u %8u  %s", stats->pass_name, rule->attempts,
+                   rule->hits, stats->rule_names[i]);
+      }
+      mesa_logi("%s: %u of %u rules never fired", stats->pass_name,
+                never_hit, stats->num_rules);
+   }
+   simple_mtx_unlock(&stats_mtx);
+}
+
+/**
+ * Returns stats if NIR_ALGEBRAIC_STATS is set, making sure they get dumped
+ * at exit, and NULL otherwise.
+ */
+struct nir_algebraic_stats *
+nir_algebraic_stats_register(struct nir_algebraic_stats *stats)
+{
+   static int enabled = -1;
+   if (enabled < 0)
+      enabled = env_var_as_boolean("NIR_ALGEBRAIC_STATS", false);
+
+   if (!enabled)
+      return NULL;
+
+   if (p_atomic_read(&stats->registered))
+      return stats;
+
+   simple_mtx_lock(&stats_mtx);
+   if (!stats->registered) {
+      if (!stats_list)
+         atexit(nir_algebraic_stats_dump);
+
+      stats->next = stats_list;
+      stats_list = stats;
+      p_atomic_set(&stats->registered, true);
+   }
+   simple_mtx_unlock(&stats_mtx);
+
+   return stats;
+}
+
 static bool
 nir_algebraic_instr(nir_builder *build, nir_instr *instr,
                     struct hash_table *range_ht,
@@ -863,7 +938,8 @@ nir_algebraic_instr(nir_builder *build, nir_instr *instr,
                     const uint16_t *transform_counts,
                     struct util_dynarray *states,
                     const struct per_op_table *pass_op_table,
-                    nir_instr_worklist *worklist)
+                    nir_instr_worklist *worklist,
+                    struct nir_algebraic_stats *stats)
 {
 
    if (instr->type != nir_instr_type_alu)
@@ -884,10 +960,18 @@ nir_algebraic_instr(nir_builder *build, nir_instr *instr,
                                           alu->dest.dest.ssa.index);
    for (uint16_t i = 0; i < transform_counts[xform_idx]; i++) {
       const struct transform *xform = &transforms[xform_idx][i];
-      if (condition_flags[xform->condition_offset] &&
-          !(xform->search->inexact && ignore_inexact) &&
-          nir_replace_instr(build, alu, range_ht, states, pass_op_table,
+      if (!condition_flags[xform->condition_offset] ||
+          (xform->search->inexact && ignore_inexact))
+         continue;
+
+      if (stats)
+         p_atomic_inc(&stats->rules[xform->rule].attempts);
+
+      if (nir_replace_instr(build, alu, range_ht, states, pass_op_table,
                             xform->search, xform->replace, worklist)) {
+         if (stats)
+            p_atomic_inc(&stats->rules[xform->rule].hits);
+
          _mesa_hash_table_clear(range_ht, NULL);
          return true;
       }
@@ -901,7 +985,8 @@ nir_algebraic_impl(nir_function_impl *impl,
                    const bool *condition_flags,
                    const struct transform **transforms,
                    const uint16_t *transform_counts,
-                   const struct per_op_table *pass_op_table)
+                   const struct per_op_table *pass_op_table,
+                   struct nir_algebraic_stats *stats)
 {
    bool progress = false;
 
@@ -919,7 +1004,8 @@ nir_algebraic_impl(nir_function_impl *impl,
    }
    memset(states.data, 0, states.size);
 
-   struct hash_table *range_ht = _mesa_pointer_hash_table_create(NULL);
+   nir_metadata_require(impl, nir_metadata_range_analysis);
+   struct hash_table *range_ht = impl->range_ht;
 
    nir_instr_worklist *worklist = nir_instr_worklist_create();
 
@@ -953,11 +1039,10 @@ nir_algebraic_impl(nir_function_impl *impl,
       progress |= nir_algebraic_instr(&build, instr,
                                       range_ht, condition_flags,
                                       transforms, transform_counts, &states,
-                                      pass_op_table, worklist);
+                                      pass_op_table, worklist, stats);
    }
 
    nir_instr_worklist_destroy(worklist);
-   ralloc_free(range_ht);
    util_dynarray_fini(&states);
 
    if (progress) {
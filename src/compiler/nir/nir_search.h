@@ -178,6 +178,28 @@ struct transform {
    const nir_search_expression *search;
    const nir_search_value *replace;
    unsigned condition_offset;
+   /* Index of the transform in the pass, for NIR_ALGEBRAIC_STATS */
+   unsigned rule;
+};
+
+struct nir_algebraic_rule_stats {
+   /* Times the search pattern was tried after the automaton matched */
+   uint32_t attempts;
+   /* Times the search pattern matched and got replaced */
+   uint32_t hits;
+};
+
+/* Per-pass transform statistics, dumped at exit with NIR_ALGEBRAIC_STATS so
+ * that rules which never fire can be found and pruned.
+ */
+struct nir_algebraic_stats {
+   const char *pass_name;
+   unsigned num_rules;
+   const char *const *rule_names;
+   struct nir_algebraic_rule_stats *rules;
+
+   bool registered;
+   struct nir_algebraic_stats *next;
 };
 
 /* Note: these must match the start states created in
@@ -210,6 +232,10 @@ nir_algebraic_impl(nir_function_impl *impl,
                    const bool *condition_flags,
                    const struct transform **transforms,
                    const uint16_t *transform_counts,
-                   const struct per_op_table *pass_op_table);
+                   const struct per_op_table *pass_op_table,
+                   struct nir_algebraic_stats *stats);
+
+struct nir_algebraic_stats *
+nir_algebraic_stats_register(struct nir_algebraic_stats *stats);
 
 #endif /* _NIR_SEARCH_ */
@@ -294,20 +294,20 @@ is_not_const_and_not_fsign(struct hash_table *ht, const nir_alu_instr *instr,
 static inline bool
 is_used_once(nir_alu_instr *instr)
 {
-   bool zero_if_use = list_is_empty(&instr->dest.dest.ssa.if_uses);
-   bool zero_use = list_is_empty(&instr->dest.dest.ssa.uses);
+   bool zero_if_use = instr->dest.dest.ssa.if_uses.count == 0;
+   bool zero_use = instr->dest.dest.ssa.uses.count == 0;
 
    if (zero_if_use && zero_use)
       return false;
 
-   if (!zero_if_use && list_is_singular(&instr->dest.dest.ssa.uses))
+   if (!zero_if_use && instr->dest.dest.ssa.uses.count == 1)
      return false;
 
-   if (!zero_use && list_is_singular(&instr->dest.dest.ssa.if_uses))
+   if (!zero_use && instr->dest.dest.ssa.if_uses.count == 1)
      return false;
 
-   if (!list_is_singular(&instr->dest.dest.ssa.if_uses) &&
-       !list_is_singular(&instr->dest.dest.ssa.uses))
+   if (instr->dest.dest.ssa.if_uses.count != 1 &&
+       instr->dest.dest.ssa.uses.count != 1)
       return false;
 
    return true;
@@ -316,13 +316,13 @@ is_used_once(nir_alu_instr *instr)
 static inline bool
 is_used_by_if(nir_alu_instr *instr)
 {
-   return !list_is_empty(&instr->dest.dest.ssa.if_uses);
+   return instr->dest.dest.ssa.if_uses.count != 0;
 }
 
 static inline bool
 is_not_used_by_if(nir_alu_instr *instr)
 {
-   return list_is_empty(&instr->dest.dest.ssa.if_uses);
+   return instr->dest.dest.ssa.if_uses.count == 0;
 }
 
 static inline bool
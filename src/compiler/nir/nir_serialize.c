@@ -23,6 +23,8 @@
 
 #include "nir_serialize.h"
 #include "nir_control_flow.h"
+#include "util/simple_mtx.h"
+#include "util/u_atomic.h"
 #include "util/u_dynarray.h"
 #include "util/u_math.h"
 
@@ -78,8 +80,15 @@ typedef struct {
    /* map from index to deserialized pointer */
    void **idx_table;
 
-   /* List of phi sources. */
-   struct list_head phi_srcs;
+   /* When reading a single function impl out of a lazily deserialized
+    * shader, objects below local_base are the shader-level variables and
+    * functions in globals and idx_table only covers the impl's own objects.
+    */
+   uint32_t local_base;
+   void **globals;
+
+   /* Array of nir_phi_src pointers waiting for read_fixup_phis(). */
+   struct util_dynarray phi_srcs;
 
    /* The last deserialized type. */
    const struct glsl_type *last_type;
@@ -103,18 +112,26 @@ write_lookup_object(write_ctx *ctx, const void *obj)
    return (uint32_t)(uintptr_t) entry->data;
 }
 
+static void **
+read_object_slot(read_ctx *ctx, uint32_t idx)
+{
+   if (idx < ctx->local_base)
+      return &ctx->globals[idx];
+
+   assert(idx - ctx->local_base < ctx->idx_table_len);
+   return &ctx->idx_table[idx - ctx->local_base];
+}
+
 static void
 read_add_object(read_ctx *ctx, void *obj)
 {
-   assert(ctx->next_idx < ctx->idx_table_len);
-   ctx->idx_table[ctx->next_idx++] = obj;
+   *read_object_slot(ctx, ctx->next_idx++) = obj;
 }
 
 static void *
 read_lookup_object(read_ctx *ctx, uint32_t idx)
 {
-   assert(idx < ctx->idx_table_len);
-   return ctx->idx_table[idx];
+   return *read_object_slot(ctx, idx);
 }
 
 static void *
@@ -454,9 +471,11 @@ read_register(read_ctx *ctx)
    reg->num_array_elems = blob_read_uint32(ctx->blob);
    reg->index = blob_read_uint32(ctx->blob);
 
-   list_inithead(&reg->uses);
+   reg->uses.count = 0;
+   reg->uses.capacity = NIR_USE_ARRAY_INLINE;
    list_inithead(&reg->defs);
-   list_inithead(&reg->if_uses);
+   reg->if_uses.count = 0;
+   reg->if_uses.capacity = NIR_USE_ARRAY_INLINE;
 
    return reg;
 }
@@ -1638,10 +1657,10 @@ read_phi(read_ctx *ctx, nir_block *blk, union packed_instr header)
        */
       src->src.parent_instr = &phi->instr;
 
-      /* Stash it in the list of phi sources.  We'll walk this list and fix up
+      /* Stash it in the array of phi sources.  We'll walk it and fix up
        * sources at the very end of read_function_impl.
        */
-      list_add(&src->src.use_link, &ctx->phi_srcs);
+      util_dynarray_append(&ctx->phi_srcs, nir_phi_src *, src);
    }
 
    return phi;
@@ -1650,16 +1669,14 @@ read_phi(read_ctx *ctx, nir_block *blk, union packed_instr header)
 static void
 read_fixup_phis(read_ctx *ctx)
 {
-   list_for_each_entry_safe(nir_phi_src, src, &ctx->phi_srcs, src.use_link) {
+   util_dynarray_foreach(&ctx->phi_srcs, nir_phi_src *, src_ptr) {
+      nir_phi_src *src = *src_ptr;
       src->pred = read_lookup_object(ctx, (uintptr_t)src->pred);
       src->src.ssa = read_lookup_object(ctx, (uintptr_t)src->src.ssa);
 
-      /* Remove from this list */
-      list_del(&src->src.use_link);
-
-      list_addtail(&src->src.use_link, &src->src.ssa->uses);
+      nir_use_array_add(&src->src.ssa->uses, &src->src);
    }
-   assert(list_is_empty(&ctx->phi_srcs));
+   util_dynarray_clear(&ctx->phi_srcs);
 }
 
 static void
@@ -1943,9 +1960,24 @@ read_cf_list(read_ctx *ctx, struct exec_list *cf_list)
       read_cf_node(ctx, cf_list);
 }
 
+/* Each impl is preceded by its first object index, its object count and
+ * its size in bytes, and doesn't depend on the type/variable delta state of
+ * whatever was written before it.  That lets nir_deserialize_lazy() skip
+ * over impls and read them back individually.
+ */
 static void
 write_function_impl(write_ctx *ctx, const nir_function_impl *fi)
 {
+   blob_write_uint32(ctx->blob, ctx->next_idx);
+   size_t num_objects_offset = blob_reserve_uint32(ctx->blob);
+   size_t size_offset = blob_reserve_uint32(ctx->blob);
+   uint32_t first_idx = ctx->next_idx;
+   size_t start = ctx->blob->size;
+
+   ctx->last_type = NULL;
+   ctx->last_interface_type = NULL;
+   memset(&ctx->last_var_data, 0, sizeof(ctx->last_var_data));
+
    blob_write_uint8(ctx->blob, fi->structured);
 
    write_var_list(ctx, &fi->locals);
@@ -1954,6 +1986,26 @@ write_function_impl(write_ctx *ctx, const nir_function_impl *fi)
 
    write_cf_list(ctx, &fi->body);
    write_fixup_phis(ctx);
+
+   blob_overwrite_uint32(ctx->blob, num_objects_offset,
+                         ctx->next_idx - first_idx);
+   blob_overwrite_uint32(ctx->blob, size_offset, ctx->blob->size - start);
+}
+
+struct impl_header {
+   uint32_t first_idx;
+   uint32_t num_objects;
+   uint32_t size;
+};
+
+static struct impl_header
+read_impl_header(read_ctx *ctx)
+{
+   struct impl_header header;
+   header.first_idx = blob_read_uint32(ctx->blob);
+   header.num_objects = blob_read_uint32(ctx->blob);
+   header.size = blob_read_uint32(ctx->blob);
+   return header;
 }
 
 static nir_function_impl *
@@ -1962,6 +2014,10 @@ read_function_impl(read_ctx *ctx, nir_function *fxn)
    nir_function_impl *fi = nir_function_impl_create_bare(ctx->nir);
    fi->function = fxn;
 
+   ctx->last_type = NULL;
+   ctx->last_interface_type = NULL;
+   memset(&ctx->last_var_data, 0, sizeof(ctx->last_var_data));
+
    fi->structured = blob_read_uint8(ctx->blob);
 
    read_var_list(ctx, &fi->locals);
@@ -2039,6 +2095,9 @@ read_function(read_ctx *ctx)
 void
 nir_serialize(struct blob *blob, const nir_shader *nir, bool strip)
 {
+   /* Reading the pending impls doesn't change what the shader is. */
+   nir_shader_materialize_impls((nir_shader *)nir);
+
    write_ctx ctx = {0};
    ctx.remap_table = _mesa_pointer_hash_table_create(NULL);
    ctx.blob = blob;
@@ -2089,14 +2148,47 @@ nir_serialize(struct blob *blob, const nir_shader *nir, bool strip)
    util_dynarray_fini(&ctx.phi_fixups);
 }
 
-nir_shader *
-nir_deserialize(void *mem_ctx,
-                const struct nir_shader_compiler_options *options,
-                struct blob_reader *blob)
+struct nir_lazy_impl {
+   size_t offset;
+   uint32_t first_idx;
+   uint32_t num_objects;
+};
+
+struct nir_lazy_impls {
+   simple_mtx_t lock;
+
+   const uint8_t *data;
+   size_t size;
+   bool owns_data;
+
+   /* Shader-level variables and functions, by object index. */
+   void **globals;
+   uint32_t num_globals;
+
+   /* nir_function -> nir_lazy_impl for impls not read yet */
+   struct hash_table *pending;
+};
+
+static void
+lazy_impls_destroy(void *ptr)
+{
+   struct nir_lazy_impls *lazy = ptr;
+
+   simple_mtx_destroy(&lazy->lock);
+   free(lazy->globals);
+   if (lazy->owns_data)
+      free((void *)lazy->data);
+}
+
+static nir_shader *
+read_shader(void *mem_ctx,
+            const struct nir_shader_compiler_options *options,
+            struct blob_reader *blob,
+            struct nir_lazy_impls *lazy)
 {
    read_ctx ctx = {0};
    ctx.blob = blob;
-   list_inithead(&ctx.phi_srcs);
+   util_dynarray_init(&ctx.phi_srcs, NULL);
    ctx.idx_table_len = blob_read_uint32(blob);
    ctx.idx_table = calloc(ctx.idx_table_len, sizeof(uintptr_t));
 
@@ -2125,9 +2217,37 @@ nir_deserialize(void *mem_ctx,
    for (unsigned i = 0; i < num_functions; i++)
       read_function(&ctx);
 
-   nir_foreach_function(fxn, ctx.nir) {
-      if (fxn->impl == NIR_SERIALIZE_FUNC_HAS_IMPL)
-         fxn->impl = read_function_impl(&ctx, fxn);
+   if (lazy) {
+      /* Impls only ever reference shader-level objects and their own, so
+       * that is all we need to keep around.
+       */
+      lazy->num_globals = ctx.next_idx;
+      lazy->globals = realloc(ctx.idx_table,
+                              MAX2(ctx.next_idx, 1) * sizeof(uintptr_t));
+      ctx.idx_table = NULL;
+
+      nir_foreach_function(fxn, ctx.nir) {
+         if (fxn->impl != NIR_SERIALIZE_FUNC_HAS_IMPL)
+            continue;
+
+         struct impl_header header = read_impl_header(&ctx);
+         struct nir_lazy_impl *impl = ralloc(lazy, struct nir_lazy_impl);
+         impl->offset = blob->current - blob->data;
+         impl->first_idx = header.first_idx;
+         impl->num_objects = header.num_objects;
+         _mesa_hash_table_insert(lazy->pending, fxn, impl);
+
+         fxn->impl = NULL;
+         blob_skip_bytes(blob, header.size);
+      }
+   } else {
+      nir_foreach_function(fxn, ctx.nir) {
+         if (fxn->impl == NIR_SERIALIZE_FUNC_HAS_IMPL) {
+            ASSERTED struct impl_header header = read_impl_header(&ctx);
+            assert(header.first_idx == ctx.next_idx);
+            fxn->impl = read_function_impl(&ctx, fxn);
+         }
+      }
    }
 
    ctx.nir->constant_data_size = blob_read_uint32(blob);
@@ -2139,12 +2259,119 @@ nir_deserialize(void *mem_ctx,
    }
 
    free(ctx.idx_table);
-
-   nir_validate_shader(ctx.nir, "after deserialize");
+   util_dynarray_fini(&ctx.phi_srcs);
 
    return ctx.nir;
 }
 
+nir_shader *
+nir_deserialize(void *mem_ctx,
+                const struct nir_shader_compiler_options *options,
+                struct blob_reader *blob)
+{
+   nir_shader *nir = read_shader(mem_ctx, options, blob, NULL);
+
+   nir_validate_shader(nir, "after deserialize");
+
+   return nir;
+}
+
+/**
+ * Deserialize everything but the function impls, which are read out of
+ * data on first use through nir_function_get_impl().
+ *
+ * This is meant for large libraries such as libclc, where a user only ever
+ * pulls in a handful of functions.  data must stay valid for the lifetime
+ * of the shader.  If take_data is set, it must have been allocated with
+ * malloc() and is freed along with the shader.
+ */
+nir_shader *
+nir_deserialize_lazy(void *mem_ctx,
+                     const struct nir_shader_compiler_options *options,
+                     const void *data, size_t size, bool take_data)
+{
+   struct nir_lazy_impls *lazy = rzalloc(NULL, struct nir_lazy_impls);
+   simple_mtx_init(&lazy->lock, mtx_plain);
+   lazy->data = data;
+   lazy->size = size;
+   lazy->owns_data = take_data;
+   lazy->pending = _mesa_pointer_hash_table_create(lazy);
+   ralloc_set_destructor(lazy, lazy_impls_destroy);
+
+   struct blob_reader blob;
+   blob_reader_init(&blob, data, size);
+   nir_shader *nir = read_shader(mem_ctx, options, &blob, lazy);
+
+   ralloc_steal(nir, lazy);
+   nir->lazy_impls = lazy;
+
+   nir_validate_shader(nir, "after lazy deserialize");
+
+   return nir;
+}
+
+nir_function_impl *
+nir_function_get_impl(nir_function *fxn)
+{
+   struct nir_lazy_impls *lazy = fxn->shader->lazy_impls;
+   if (!lazy)
+      return fxn->impl;
+
+   /* Pairs with the release store below, so that a thread which sees the
+    * pointer also sees the fully deserialized impl.
+    */
+   nir_function_impl *fi = p_atomic_read(&fxn->impl);
+   if (fi)
+      return fi;
+
+   simple_mtx_lock(&lazy->lock);
+
+   struct hash_entry *entry = _mesa_hash_table_search(lazy->pending, fxn);
+   if (entry) {
+      struct nir_lazy_impl *impl = entry->data;
+
+      struct blob_reader blob;
+      blob_reader_init(&blob, lazy->data, lazy->size);
+      blob.current += impl->offset;
+
+      read_ctx ctx = {0};
+      ctx.nir = fxn->shader;
+      ctx.blob = &blob;
+      util_dynarray_init(&ctx.phi_srcs, NULL);
+      ctx.globals = lazy->globals;
+      ctx.local_base = impl->first_idx;
+      ctx.next_idx = impl->first_idx;
+      ctx.idx_table_len = impl->num_objects;
+      ctx.idx_table = calloc(ctx.idx_table_len, sizeof(uintptr_t));
+
+      nir_function_impl *new_impl = read_function_impl(&ctx, fxn);
+      assert(!blob.overrun);
+      free(ctx.idx_table);
+      util_dynarray_fini(&ctx.phi_srcs);
+
+      _mesa_hash_table_remove(lazy->pending, entry);
+      ralloc_free(impl);
+
+      p_atomic_set(&fxn->impl, new_impl);
+   }
+
+   fi = fxn->impl;
+   simple_mtx_unlock(&lazy->lock);
+
+   return fi;
+}
+
+/** Reads in all impls still pending in a lazily deserialized shader. */
+void
+nir_shader_materialize_impls(nir_shader *shader)
+{
+   if (!shader->lazy_impls)
+      return;
+
+   nir_foreach_function(fxn, shader)
+      nir_function_get_impl(fxn);
+}
+
 void
 nir_shader_serialize_deserialize(nir_shader *shader)
 {
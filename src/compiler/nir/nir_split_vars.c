@@ -1571,7 +1571,7 @@ shrink_vec_var_access_impl(nir_function_impl *impl,
                /* The SSA def is now only used by the swizzle.  It's safe to
                 * shrink the number of components.
                 */
-               assert(list_length(&intrin->dest.ssa.uses) == c);
+               assert(intrin->dest.ssa.uses.count == c);
                intrin->num_components = c;
                intrin->dest.ssa.num_components = c;
             } else {
@@ -163,6 +163,8 @@ nir_sweep(nir_shader *nir)
    assert(list_is_empty(&instr_gc_list));
 
    ralloc_steal(nir, nir->constant_data);
+   if (nir->lazy_impls)
+      ralloc_steal(nir, nir->lazy_impls);
 
    /* Free everything we didn't steal back. */
    ralloc_free(rubbish);
@@ -286,6 +286,18 @@ validate_reg_dest(nir_reg_dest *dest, validate_state *state,
    }
 }
 
+static void
+validate_use_array(nir_use_array *uses, validate_state *state)
+{
+   validate_assert(state, uses->capacity >= NIR_USE_ARRAY_INLINE);
+   validate_assert(state, uses->count <= uses->capacity);
+
+   /* nir_foreach_use() steps through the array by the srcs' slots */
+   nir_src **srcs = nir_use_array_srcs(uses);
+   for (uint32_t i = 0; i < uses->count; i++)
+      validate_assert(state, srcs[i] && srcs[i]->use_index == i);
+}
+
 static void
 validate_ssa_def(nir_ssa_def *def, validate_state *state)
 {
@@ -296,7 +308,7 @@ validate_ssa_def(nir_ssa_def *def, validate_state *state)
    validate_assert(state, def->parent_instr == state->instr);
    validate_num_components(state, def->num_components);
 
-   list_validate(&def->uses);
+   validate_use_array(&def->uses, state);
    nir_foreach_use(src, def) {
       validate_assert(state, src->is_ssa);
       validate_assert(state, src->ssa == def);
@@ -306,7 +318,7 @@ validate_ssa_def(nir_ssa_def *def, validate_state *state)
       validate_assert(state, !already_seen);
    }
 
-   list_validate(&def->if_uses);
+   validate_use_array(&def->if_uses, state);
    nir_foreach_if_use(src, def) {
       validate_assert(state, src->is_ssa);
       validate_assert(state, src->ssa == def);
@@ -531,7 +543,7 @@ validate_deref_instr(nir_deref_instr *instr, validate_state *state)
     * conditions expect well-formed Booleans.  If you want to compare with
     * NULL, an explicit comparison operation should be used.
     */
-   validate_assert(state, list_is_empty(&instr->dest.ssa.if_uses));
+   validate_assert(state, instr->dest.ssa.if_uses.count == 0);
 
    /* Certain modes cannot be used as sources for phi instructions because
     * way too many passes assume that they can always chase deref chains.
@@ -1390,9 +1402,9 @@ prevalidate_reg_decl(nir_register *reg, validate_state *state)
    validate_num_components(state, reg->num_components);
    BITSET_SET(state->regs_found, reg->index);
 
-   list_validate(&reg->uses);
+   validate_use_array(&reg->uses, state);
    list_validate(&reg->defs);
-   list_validate(&reg->if_uses);
+   validate_use_array(&reg->if_uses, state);
 
    reg_validate_state *reg_state = ralloc(state->regs, reg_validate_state);
    reg_state->uses = _mesa_pointer_set_create(reg_state);
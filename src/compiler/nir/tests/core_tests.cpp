@@ -142,4 +142,23 @@ TEST_F(nir_core_test, nir_instr_free_and_dce_multiple_src_test)
    nir_validate_shader(b->shader, "after remove_and_dce");
 }
 
+TEST_F(nir_core_test, divergence_metadata)
+{
+   nir_ssa_def *uniform = nir_iadd_imm(b, nir_imm_int(b, 1), 2);
+   nir_ssa_def *divergent = nir_iadd_imm(b, nir_load_local_invocation_index(b), 2);
+
+   nir_metadata_require(b->impl, nir_metadata_divergence);
+   EXPECT_FALSE(uniform->divergent);
+   EXPECT_TRUE(divergent->divergent);
+
+   /* Still valid: nir_metadata_require() must not run the analysis again. */
+   uniform->divergent = true;
+   nir_metadata_require(b->impl, nir_metadata_divergence);
+   EXPECT_TRUE(uniform->divergent);
+
+   nir_metadata_preserve(b->impl, nir_metadata_block_index);
+   nir_metadata_require(b->impl, nir_metadata_divergence);
+   EXPECT_FALSE(uniform->divergent);
+}
+
 }
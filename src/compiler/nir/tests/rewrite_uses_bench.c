@@ -0,0 +1,120 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Times nir_ssa_def_rewrite_uses(), which splices the whole use list over,
+ * against moving the same uses one at a time with nir_instr_rewrite_src_ssa().
+ *
+ *    nir_rewrite_uses_bench [num_rounds]
+ *
+ * Every def's uses are interleaved with the uses of the other defs, as in a
+ * real shader, so that the neighbours in a use list live in unrelated
+ * instructions.  Prints the time per moved use for a few use-list lengths.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "nir.h"
+#include "nir_builder.h"
+#include "util/os_time.h"
+
+#define NUM_DEFS 64
+
+static const nir_shader_compiler_options options = { 0 };
+
+static void
+rewrite_uses_per_src(nir_ssa_def *def, nir_ssa_def *new_ssa)
+{
+   nir_foreach_use_safe(use_src, def)
+      nir_instr_rewrite_src_ssa(use_src->parent_instr, use_src, new_ssa);
+
+   nir_foreach_if_use_safe(use_src, def)
+      nir_if_rewrite_condition_ssa(use_src->parent_if, use_src, new_ssa);
+}
+
+/* Returns the best time in ns per moved use out of a few tries. */
+static double
+run(unsigned uses_per_def, unsigned num_rounds, bool per_src)
+{
+   double best = 0;
+
+   for (unsigned try = 0; try < 5; try++) {
+      nir_builder b = nir_builder_init_simple_shader(MESA_SHADER_COMPUTE,
+                                                     &options, "bench");
+      nir_ssa_def *defs[NUM_DEFS], *other[NUM_DEFS];
+      for (unsigned i = 0; i < NUM_DEFS; i++) {
+         defs[i] = nir_imm_int(&b, i);
+         other[i] = nir_imm_int(&b, NUM_DEFS + i);
+      }
+
+      for (unsigned i = 0; i < NUM_DEFS * uses_per_def; i++)
+         nir_iadd(&b, defs[i % NUM_DEFS], defs[(i * 7 + 3) % NUM_DEFS]);
+
+      uint64_t start = os_time_get_nano();
+      for (unsigned r = 0; r < num_rounds; r++) {
+         for (unsigned i = 0; i < NUM_DEFS; i++) {
+            if (per_src) {
+               rewrite_uses_per_src(defs[i], other[i]);
+               rewrite_uses_per_src(other[i], defs[i]);
+            } else {
+               nir_ssa_def_rewrite_uses(defs[i], other[i]);
+               nir_ssa_def_rewrite_uses(other[i], defs[i]);
+            }
+         }
+      }
+      uint64_t time = os_time_get_nano() - start;
+
+      ralloc_free(b.shader);
+
+      /* Each def has 2 * uses_per_def uses, moved twice per round. */
+      double per_use = (double)time /
+                       ((double)num_rounds * NUM_DEFS * 4 * uses_per_def);
+      if (try == 0 || per_use < best)
+         best = per_use;
+   }
+
+   return best;
+}
+
+int
+main(int argc, char **argv)
+{
+   unsigned num_rounds = argc > 1 ? atoi(argv[1]) : 0;
+   static const unsigned uses_per_def[] = { 4, 64, 1024 };
+
+   glsl_type_singleton_init_or_ref();
+
+   printf("%8s %10s %10s %10s\n", "uses/def", "per-src", "splice", "speedup");
+   for (unsigned i = 0; i < ARRAY_SIZE(uses_per_def); i++) {
+      /* By default move about the same number of uses for every length. */
+      unsigned rounds = num_rounds ? num_rounds :
+                        MAX2(65536 / uses_per_def[i], 1);
+
+      double per_src = run(uses_per_def[i], rounds, true);
+      double splice = run(uses_per_def[i], rounds, false);
+      printf("%8u %8.2fns %8.2fns %9.2fx\n", uses_per_def[i], per_src, splice,
+             per_src / splice);
+   }
+
+   glsl_type_singleton_decref();
+   return 0;
+}
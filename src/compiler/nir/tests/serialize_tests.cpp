@@ -279,3 +279,46 @@ TEST_P(nir_serialize_all_but_one_test, single_channel)
 
    ASSERT_SWIZZLE_EQ(vec_alu, vec_alu_dup, 1, 0);
 }
+
+TEST_P(nir_serialize_all_test, lazy_function_impl)
+{
+   nir_function *helper = nir_function_create(b->shader, "helper");
+   helper->impl = nir_function_impl_create(helper);
+
+   nir_builder hb;
+   nir_builder_init(&hb, helper->impl);
+   hb.cursor = nir_after_cf_list(&helper->impl->body);
+   nir_variable *tmp =
+      nir_local_variable_create(helper->impl, glsl_vec_type(GetParam()), "tmp");
+   nir_store_var(&hb, tmp, nir_imm_zero(&hb, GetParam(), 32),
+                 BITFIELD_MASK(GetParam()));
+
+   nir_call_instr *call = nir_call_instr_create(b->shader, helper);
+   nir_builder_instr_insert(b, &call->instr);
+
+   struct blob blob;
+   blob_init(&blob);
+   nir_serialize(&blob, b->shader, false);
+
+   dup = nir_deserialize_lazy(b->shader, &options, blob.data, blob.size, false);
+
+   nir_function *dup_helper = NULL;
+   nir_foreach_function(fxn, dup) {
+      if (fxn->name && strcmp(fxn->name, "helper") == 0)
+         dup_helper = fxn;
+   }
+   ASSERT_NE(dup_helper, nullptr);
+   ASSERT_EQ(dup_helper->impl, nullptr);
+
+   nir_function_impl *impl = nir_function_get_impl(dup_helper);
+   ASSERT_NE(impl, nullptr);
+   ASSERT_EQ(dup_helper->impl, impl);
+   ASSERT_EQ(exec_list_length(&impl->locals), 1u);
+
+   nir_shader_materialize_impls(dup);
+   nir_foreach_function(fxn, dup)
+      ASSERT_NE(fxn->impl, nullptr);
+   nir_validate_shader(dup, "after materializing impls");
+
+   blob_finish(&blob);
+}
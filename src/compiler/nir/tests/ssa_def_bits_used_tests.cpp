@@ -50,8 +50,8 @@ protected:
 static bool
 is_used_once(const nir_ssa_def *def)
 {
-   return list_is_singular(&def->uses) &&
-          list_is_empty(&def->if_uses);
+   return def->uses.count == 1 &&
+          def->if_uses.count == 0;
 }
 
 nir_alu_instr *
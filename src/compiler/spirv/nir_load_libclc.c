@@ -261,10 +261,11 @@ nir_load_libclc_shader(unsigned ptr_bit_size,
       size_t buffer_size;
       uint8_t *buffer = disk_cache_get(disk_cache, cache_key, &buffer_size);
       if (buffer) {
-         struct blob_reader blob;
-         blob_reader_init(&blob, buffer, buffer_size);
-         nir_shader *nir = nir_deserialize(NULL, nir_options, &blob);
-         free(buffer);
+         /* Users only inline a handful of libclc functions, so leave the
+          * rest in the cache buffer until they are needed.
+          */
+         nir_shader *nir = nir_deserialize_lazy(NULL, nir_options,
+                                                buffer, buffer_size, true);
          close_clc_data(&clc);
          return nir;
       }
@@ -38,6 +38,7 @@ lower_clc_call_instr(nir_instr *instr, nir_builder *b,
 {
    nir_call_instr *call = nir_instr_as_call(instr);
    nir_function *func = NULL;
+   nir_function_impl *impl = NULL;
 
    if (!call->callee->name)
       return false;
@@ -48,7 +49,9 @@ lower_clc_call_instr(nir_instr *instr, nir_builder *b,
          break;
       }
    }
-   if (!func || !func->impl) {
+   if (func)
+      impl = nir_function_get_impl(func);
+   if (!impl) {
       return false;
    }
 
@@ -60,7 +63,7 @@ lower_clc_call_instr(nir_instr *instr, nir_builder *b,
    }
 
    b->cursor = nir_instr_remove(&call->instr);
-   nir_inline_function_impl(b, func->impl, params, copy_vars);
+   nir_inline_function_impl(b, impl, params, copy_vars);
 
    ralloc_free(params);
 
@@ -6273,9 +6273,7 @@ spirv_to_nir(const uint32_t *words, size_t word_count,
       b->shader->info.workgroup_size[2] = const_size[2].u32;
    }
 
-   /* Set types on all vtn_values */
-   vtn_foreach_instruction(b, words, word_end, vtn_set_instruction_result_type);
-
+   /* Set types on all vtn_values and gather the functions and blocks */
    vtn_build_cfg(b, words, word_end);
 
    if (!options->create_library) {
@@ -6289,7 +6287,13 @@ spirv_to_nir(const uint32_t *words, size_t word_count,
       vtn_foreach_cf_node(node, &b->functions) {
          struct vtn_function *func = vtn_cf_node_as_function(node);
          if ((options->create_library || func->referenced) && !func->emitted) {
-            b->const_table = _mesa_pointer_hash_table_create(b);
+            /* Constants are materialized per function impl, so the cache
+             * has to start out empty, but the table itself can be reused.
+             */
+            if (b->const_table)
+               _mesa_hash_table_clear(b->const_table, NULL);
+            else
+               b->const_table = _mesa_pointer_hash_table_create(b);
 
             vtn_function_emit(b, func, vtn_handle_body_instruction);
             progress = true;
@@ -152,6 +152,11 @@ static bool
 vtn_cfg_handle_prepass_instruction(struct vtn_builder *b, SpvOp opcode,
                                    const uint32_t *w, unsigned count)
 {
+   /* Result types are gathered in the same walk over the function bodies
+    * instead of in a separate pass.
+    */
+   vtn_set_instruction_result_type(b, opcode, w, count);
+
    switch (opcode) {
    case SpvOpFunction: {
       vtn_assert(b->func == NULL);
@@ -573,13 +578,13 @@ vtn_process_block(struct vtn_builder *b,
    if (!list_is_empty(cf_list)) {
       /* vtn_process_block() acts like an iterator: it processes the given
        * block and then returns the next block to process.  For a given
-       * control-flow construct, vtn_build_cfg() calls vtn_process_block()
-       * repeatedly until it finally returns NULL.  Therefore, we know that
-       * the only blocks on which vtn_process_block() can be called are either
-       * the first block in a construct or a block that vtn_process_block()
-       * returned for the current construct.  If cf_list is empty then we know
-       * that we're processing the first block in the construct and we have to
-       * add it to the list.
+       * control-flow construct, vtn_build_structured_cfg() calls
+       * vtn_process_block() repeatedly until it finally returns NULL.
+       * Therefore, we know that the only blocks on which vtn_process_block()
+       * can be called are either the first block in a construct or a block
+       * that vtn_process_block() returned for the current construct.  If
+       * cf_list is empty then we know that we're processing the first block
+       * in the construct and we have to add it to the list.
        *
        * If cf_list is not empty, then it must be the block returned by the
        * previous call to vtn_process_block().  We know a priori that
@@ -828,42 +833,43 @@ vtn_process_block(struct vtn_builder *b,
    }
 }
 
-void
-vtn_build_cfg(struct vtn_builder *b, const uint32_t *words, const uint32_t *end)
+/* Builds the structured CFG of a single function.  This is deferred until
+ * the function is emitted so that functions which are never reached from the
+ * entry point don't pay for it.
+ */
+static void
+vtn_build_structured_cfg(struct vtn_builder *b, struct vtn_function *func)
 {
-   vtn_foreach_instruction(b, words, end,
-                           vtn_cfg_handle_prepass_instruction);
-
-   if (b->shader->info.stage == MESA_SHADER_KERNEL)
-      return;
+   /* We build the CFG for each function by doing a breadth-first search on
+    * the control-flow graph.  We keep track of our state using a worklist.
+    * Doing a BFS ensures that we visit each structured control-flow
+    * construct and its merge node before we visit the stuff inside the
+    * construct.
+    */
+   struct list_head work_list;
+   list_inithead(&work_list);
+   vtn_add_cfg_work_item(b, &work_list, &func->node, &func->body,
+                         func->start_block);
 
-   vtn_foreach_cf_node(func_node, &b->functions) {
-      struct vtn_function *func = vtn_cf_node_as_function(func_node);
+   while (!list_is_empty(&work_list)) {
+      struct vtn_cfg_work_item *work =
+         list_first_entry(&work_list, struct vtn_cfg_work_item, link);
+      list_del(&work->link);
 
-      /* We build the CFG for each function by doing a breadth-first search on
-       * the control-flow graph.  We keep track of our state using a worklist.
-       * Doing a BFS ensures that we visit each structured control-flow
-       * construct and its merge node before we visit the stuff inside the
-       * construct.
-       */
-      struct list_head work_list;
-      list_inithead(&work_list);
-      vtn_add_cfg_work_item(b, &work_list, &func->node, &func->body,
-                            func->start_block);
-
-      while (!list_is_empty(&work_list)) {
-         struct vtn_cfg_work_item *work =
-            list_first_entry(&work_list, struct vtn_cfg_work_item, link);
-         list_del(&work->link);
-
-         for (struct vtn_block *block = work->start_block; block; ) {
-            block = vtn_process_block(b, &work_list, work->cf_parent,
-                                      work->cf_list, block);
-         }
+      for (struct vtn_block *block = work->start_block; block; ) {
+         block = vtn_process_block(b, &work_list, work->cf_parent,
+                                   work->cf_list, block);
       }
    }
 }
 
+void
+vtn_build_cfg(struct vtn_builder *b, const uint32_t *words, const uint32_t *end)
+{
+   vtn_foreach_instruction(b, words, end,
+                           vtn_cfg_handle_prepass_instruction);
+}
+
 static bool
 vtn_handle_phis_first_pass(struct vtn_builder *b, SpvOp opcode,
                            const uint32_t *w, unsigned count)
@@ -1380,6 +1386,7 @@ vtn_function_emit(struct vtn_builder *b, struct vtn_function *func,
       impl->structured = false;
       vtn_emit_cf_func_unstructured(b, func, instruction_handler);
    } else {
+      vtn_build_structured_cfg(b, func);
       vtn_emit_cf_list_structured(b, &func->body, NULL, NULL,
                                   instruction_handler);
    }
@@ -1407,5 +1414,8 @@ vtn_function_emit(struct vtn_builder *b, struct vtn_function *func,
    if (func->nir_func->impl->structured)
       nir_repair_ssa_impl(impl);
 
+   _mesa_hash_table_destroy(b->phi_table, NULL);
+   b->phi_table = NULL;
+
    func->emitted = true;
 }
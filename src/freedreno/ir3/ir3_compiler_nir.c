@@ -455,7 +455,7 @@ emit_alu(struct ir3_context *ctx, nir_alu_instr *alu)
        * to eliminate.
        */
       if (alu->src[0].src.is_ssa && is_sat_compatible(src[0]->opc) &&
-          (list_length(&alu->src[0].src.ssa->uses) == 1)) {
+          (alu->src[0].src.ssa->uses.count == 1)) {
          src[0]->flags |= IR3_INSTR_SAT;
          dst[0] = ir3_MOV(b, src[0], dst_type);
       } else {
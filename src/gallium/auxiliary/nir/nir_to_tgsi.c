@@ -268,7 +268,7 @@ ntt_output_decl(struct ntt_compile *c, nir_intrinsic_instr *instr, uint32_t *fra
  */
 static bool
 ntt_try_store_in_tgsi_output(struct ntt_compile *c, struct ureg_dst *dst,
-                             struct list_head *uses, struct list_head *if_uses)
+                             nir_use_array *uses, nir_use_array *if_uses)
 {
    *dst = ureg_dst_undef();
 
@@ -284,10 +284,10 @@ ntt_try_store_in_tgsi_output(struct ntt_compile *c, struct ureg_dst *dst,
       return false;
    }
 
-   if (!list_is_empty(if_uses) || !list_is_singular(uses))
+   if (if_uses->count != 0 || uses->count != 1)
       return false;
 
-   nir_src *src = list_first_entry(uses, nir_src, use_link);
+   nir_src *src = nir_use_array_get(uses, 0);
 
    if (src->parent_instr->type != nir_instr_type_intrinsic)
       return false;
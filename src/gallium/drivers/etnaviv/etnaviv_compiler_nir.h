@@ -126,7 +126,7 @@ real_dest(nir_dest *dest, unsigned *swiz, unsigned *mask)
    if (!dest || !dest->is_ssa)
       return dest;
 
-   bool can_bypass_src = !list_length(&dest->ssa.if_uses);
+   bool can_bypass_src = !dest->ssa.if_uses.count;
    nir_instr *p_instr = dest->ssa.parent_instr;
 
    /* if used by a vecN, the "real" destination becomes the vecN destination
@@ -160,7 +160,7 @@ real_dest(nir_dest *dest, unsigned *swiz, unsigned *mask)
       case nir_op_vec2:
       case nir_op_vec3:
       case nir_op_vec4:
-         assert(list_length(&dest->ssa.if_uses) == 0);
+         assert(dest->ssa.if_uses.count == 0);
          nir_foreach_use(use_src, &dest->ssa)
             assert(use_src->parent_instr == instr);
 
@@ -174,7 +174,7 @@ real_dest(nir_dest *dest, unsigned *swiz, unsigned *mask)
          default:
             continue;
          }
-         if (list_length(&dest->ssa.if_uses) || list_length(&dest->ssa.uses) > 1)
+         if (dest->ssa.if_uses.count || dest->ssa.uses.count > 1)
             continue;
 
          update_swiz_mask(alu, NULL, swiz, mask);
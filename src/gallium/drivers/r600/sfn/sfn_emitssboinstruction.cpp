@@ -112,7 +112,7 @@ bool EmitSSBOInstruction::do_emit(nir_instr* instr)
 
 bool EmitSSBOInstruction::emit_atomic(const nir_intrinsic_instr* instr)
 {
-   bool read_result = !instr->dest.is_ssa || !list_is_empty(&instr->dest.ssa.uses);
+   bool read_result = !instr->dest.is_ssa || instr->dest.ssa.uses.count != 0;
 
    ESDOp op = read_result ? get_opcode(instr->intrinsic) :
                             get_opcode_wo(instr->intrinsic);
@@ -144,7 +144,7 @@ bool EmitSSBOInstruction::emit_atomic(const nir_intrinsic_instr* instr)
 
 bool EmitSSBOInstruction::emit_unary_atomic(const nir_intrinsic_instr* instr)
 {
-   bool read_result = !instr->dest.is_ssa || !list_is_empty(&instr->dest.ssa.uses);
+   bool read_result = !instr->dest.is_ssa || instr->dest.ssa.uses.count != 0;
 
    ESDOp op = read_result ? get_opcode(instr->intrinsic) : get_opcode_wo(instr->intrinsic);
 
@@ -315,7 +315,7 @@ bool EmitSSBOInstruction::load_atomic_inc_limits()
 
 bool EmitSSBOInstruction::emit_atomic_inc(const nir_intrinsic_instr* instr)
 {
-   bool read_result = !instr->dest.is_ssa || !list_is_empty(&instr->dest.ssa.uses);
+   bool read_result = !instr->dest.is_ssa || instr->dest.ssa.uses.count != 0;
    PValue uav_id = from_nir(instr->src[0], 0);
    GPRVector dest = read_result ? make_dest(instr): GPRVector(0, {7,7,7,7});
    auto ir = new GDSInstr(read_result ? DS_OP_ADD_RET : DS_OP_ADD, dest,
@@ -469,7 +469,7 @@ EmitSSBOInstruction::emit_ssbo_atomic_op(const nir_intrinsic_instr *intrin)
    else
       image_offset = from_nir(intrin->src[0], 0);
 
-   bool read_result = !intrin->dest.is_ssa || !list_is_empty(&intrin->dest.ssa.uses);
+   bool read_result = !intrin->dest.is_ssa || intrin->dest.ssa.uses.count != 0;
    auto opcode = read_result ? get_rat_opcode(intrin->intrinsic, PIPE_FORMAT_R32_UINT) :
                                get_rat_opcode_wo(intrin->intrinsic, PIPE_FORMAT_R32_UINT);
 
@@ -541,7 +541,7 @@ EmitSSBOInstruction::emit_image_load(const nir_intrinsic_instr *intrin)
    else
       image_offset = from_nir(intrin->src[0], 0);
 
-   bool read_retvalue = !intrin->dest.is_ssa || !list_is_empty(&intrin->dest.ssa.uses);
+   bool read_retvalue = !intrin->dest.is_ssa || intrin->dest.ssa.uses.count != 0;
    auto rat_op = read_retvalue ? get_rat_opcode(intrin->intrinsic, nir_intrinsic_format(intrin)):
                                  get_rat_opcode_wo(intrin->intrinsic, nir_intrinsic_format(intrin));
 
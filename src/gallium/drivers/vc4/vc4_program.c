@@ -822,11 +822,10 @@ ntq_src_is_only_ssa_def_user(nir_src *src)
         if (!src->is_ssa)
                 return false;
 
-        if (!list_is_empty(&src->ssa->if_uses))
+        if (src->ssa->if_uses.count != 0)
                 return false;
 
-        return (src->ssa->uses.next == &src->use_link &&
-                src->ssa->uses.next->next == &src->ssa->uses);
+        return src->ssa->uses.count == 1;
 }
 
 /**
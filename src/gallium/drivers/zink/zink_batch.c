@@ -12,6 +12,7 @@
 #include "zink_surface.h"
 
 #include "util/hash_table.h"
+#include "util/os_time.h"
 #include "util/u_debug.h"
 #include "util/set.h"
 
@@ -131,6 +132,35 @@ zink_clear_batch_state(struct zink_context *ctx, struct zink_batch_state *bs)
    unref_resources(zink_screen(ctx->base.screen), bs);
 }
 
+/* free states are kept on a lock-free stack so that recycling them never contends
+ * with fence checks from other threads holding batch_mtx
+ */
+static void
+push_free_batch_state(struct zink_context *ctx, struct zink_batch_state *bs)
+{
+   struct zink_batch_state *head;
+   do {
+      head = p_atomic_read(&ctx->free_batch_states);
+      bs->next = head;
+   } while (p_atomic_cmpxchg(&ctx->free_batch_states, head, bs) != head);
+}
+
+static struct zink_batch_state *
+pop_free_batch_state(struct zink_context *ctx)
+{
+   /* only the context thread pops, so a popped state can't be pushed back
+    * between reading head->next and the cmpxchg (no ABA)
+    */
+   struct zink_batch_state *bs;
+   do {
+      bs = p_atomic_read(&ctx->free_batch_states);
+      if (!bs)
+         return NULL;
+   } while (p_atomic_cmpxchg(&ctx->free_batch_states, bs, bs->next) != bs);
+   bs->next = NULL;
+   return bs;
+}
+
 static void
 pop_batch_state(struct zink_context *ctx)
 {
@@ -150,7 +180,7 @@ zink_batch_reset_all(struct zink_context *ctx)
       bs->fence.completed = true;
       pop_batch_state(ctx);
       zink_reset_batch_state(ctx, bs);
-      util_dynarray_append(&ctx->free_batch_states, struct zink_batch_state *, bs);
+      push_free_batch_state(ctx, bs);
    }
    simple_mtx_unlock(&ctx->batch_mtx);
 }
@@ -269,20 +299,19 @@ static struct zink_batch_state *
 get_batch_state(struct zink_context *ctx, struct zink_batch *batch)
 {
    struct zink_screen *screen = zink_screen(ctx->base.screen);
-   struct zink_batch_state *bs = NULL;
+   struct zink_batch_state *bs = pop_free_batch_state(ctx);
 
-   simple_mtx_lock(&ctx->batch_mtx);
-   if (util_dynarray_num_elements(&ctx->free_batch_states, struct zink_batch_state*))
-      bs = util_dynarray_pop(&ctx->free_batch_states, struct zink_batch_state*);
-   if (!bs && ctx->batch_states) {
+   if (!bs) {
+      simple_mtx_lock(&ctx->batch_mtx);
       /* states are stored sequentially, so if the first one doesn't work, none of them will */
-      if (zink_screen_check_last_finished(screen, ctx->batch_states->fence.batch_id) ||
-          find_unused_state(ctx->batch_states)) {
+      if (ctx->batch_states &&
+          (zink_screen_check_last_finished(screen, ctx->batch_states->fence.batch_id) ||
+           find_unused_state(ctx->batch_states))) {
          bs = ctx->batch_states;
          pop_batch_state(ctx);
       }
+      simple_mtx_unlock(&ctx->batch_mtx);
    }
-   simple_mtx_unlock(&ctx->batch_mtx);
    if (bs) {
       if (bs->fence.submitted && !bs->fence.completed)
          /* this fence is already done, so we need vulkan to release the cmdbuf */
@@ -290,10 +319,14 @@ get_batch_state(struct zink_context *ctx, struct zink_batch *batch)
       zink_reset_batch_state(ctx, bs);
    } else {
       if (!batch->state) {
-         /* this is batch init, so create a few more states for later use */
-         for (int i = 0; i < 3; i++) {
+         /* this is batch init, so create a few more states for later use:
+          * with a submit thread, enough to keep its queue full without allocating
+          */
+         unsigned count = screen->threaded ? 8 : 3;
+         for (unsigned i = 0; i < count; i++) {
             struct zink_batch_state *state = create_batch_state(ctx);
-            util_dynarray_append(&ctx->free_batch_states, struct zink_batch_state *, state);
+            if (state)
+               push_free_batch_state(ctx, state);
          }
       }
       bs = create_batch_state(ctx);
@@ -451,6 +484,8 @@ submit_queue(void *data, void *gdata, int thread_index)
    }
    simple_mtx_unlock(&screen->queue_lock);
    bs->submit_count++;
+   p_atomic_add(&ctx->submit_stats.submit_latency_ns, (uint64_t)(os_time_get_nano() - bs->submit_start));
+   p_atomic_inc(&ctx->submit_stats.submits);
 end:
    cnd_broadcast(&bs->usage.flush);
 
@@ -484,7 +519,7 @@ zink_end_batch(struct zink_context *ctx, struct zink_batch *batch)
             zink_vkfence_wait(screen, &bs->fence, PIPE_TIMEOUT_INFINITE);
          pop_batch_state(ctx);
          zink_reset_batch_state(ctx, bs);
-         util_dynarray_append(&ctx->free_batch_states, struct zink_batch_state *, bs);
+         push_free_batch_state(ctx, bs);
       }
       if (ctx->batch_states_count > 50)
          ctx->oom_flush = true;
@@ -511,6 +546,7 @@ zink_end_batch(struct zink_context *ctx, struct zink_batch *batch)
    if (screen->device_lost)
       return;
 
+   bs->submit_start = os_time_get_nano();
    if (screen->threaded) {
       util_queue_add_job(&screen->flush_queue, bs, &bs->flush_completed,
                          submit_queue, post_submit, 0);
@@ -526,6 +562,25 @@ zink_end_batch(struct zink_context *ctx, struct zink_batch *batch)
 #endif
 }
 
+/* submitting part of a frame early lets the gpu start on it while the rest is recorded,
+ * but it's only worth the extra submit overhead if the gpu is otherwise going to sit idle
+ */
+bool
+zink_batch_needs_early_submit(struct zink_context *ctx)
+{
+   struct zink_screen *screen = zink_screen(ctx->base.screen);
+   if (!screen->early_submit_threshold || ctx->batch.work_count < screen->early_submit_threshold)
+      return false;
+   if (!ctx->last_fence)
+      return true;
+   struct zink_fence *fence = ctx->last_fence;
+   /* previous submit is still queued on the flush thread: the gpu has work lined up */
+   if (!p_atomic_read(&fence->submitted))
+      return false;
+   return zink_screen_check_last_finished(screen, fence->batch_id) ||
+          zink_check_batch_completion(ctx, fence->batch_id, false);
+}
+
 void
 zink_batch_resource_usage_set(struct zink_batch *batch, struct zink_resource *res, bool write)
 {
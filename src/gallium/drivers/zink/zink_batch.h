@@ -98,6 +98,8 @@ struct zink_batch_state {
     /* this is a monotonic int used to disambiguate internal fences from their tc fence references */
    unsigned submit_count;
 
+   int64_t submit_start; //os_time_get_nano() at zink_end_batch, used for submit latency stats
+
    bool is_device_lost;
    bool have_timelines;
    bool has_barriers;
@@ -146,6 +148,9 @@ zink_start_batch(struct zink_context *ctx, struct zink_batch *batch);
 void
 zink_end_batch(struct zink_context *ctx, struct zink_batch *batch);
 
+bool
+zink_batch_needs_early_submit(struct zink_context *ctx);
+
 void
 zink_batch_resource_usage_set(struct zink_batch *batch, struct zink_resource *res, bool write);
 
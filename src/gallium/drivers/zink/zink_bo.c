@@ -33,6 +33,7 @@
 #include "zink_resource.h"
 #include "zink_screen.h"
 #include "util/u_hash_table.h"
+#include "util/os_time.h"
 
 struct zink_bo;
 
@@ -68,6 +69,8 @@ struct zink_slab {
    struct zink_bo *entries;
 };
 
+#define ZINK_BUDGET_REFRESH_NS (100 * 1000 * 1000)
+
 
 ALWAYS_INLINE static struct zink_slab *
 zink_slab(struct pb_slab *pslab)
@@ -131,6 +134,8 @@ bo_destroy(struct zink_screen *screen, struct pb_buffer *pbuf)
    }
 
    VKSCR(FreeMemory)(screen->dev, bo->mem, NULL);
+   /* size is only set once the allocation has succeeded */
+   p_atomic_add(&screen->pb.heap_usage[bo->u.real.heap_idx], -(int64_t)bo->base.size);
 
    simple_mtx_destroy(&bo->lock);
    FREE(bo);
@@ -159,6 +164,7 @@ bo_slab_free(struct zink_screen *screen, struct pb_slab *pslab)
    ASSERTED unsigned slab_size = slab->buffer->base.size;
 
    assert(slab->base.num_entries * slab->entry_size <= slab_size);
+   p_atomic_add(&screen->pb.slab_size[get_slabs(screen, slab->entry_size, 0) - screen->pb.bo_slabs], -(int64_t)slab_size);
    FREE(slab->entries);
    zink_bo_unref(screen, slab->buffer);
    FREE(slab);
@@ -168,13 +174,15 @@ static void
 bo_slab_destroy(struct zink_screen *screen, struct pb_buffer *pbuf)
 {
    struct zink_bo *bo = zink_bo(pbuf);
+   struct pb_slabs *slabs = get_slabs(screen, bo->base.size, 0);
 
    assert(!bo->mem);
+   p_atomic_add(&screen->pb.slab_used[slabs - screen->pb.bo_slabs], -(int64_t)bo->u.slab.entry.entry_size);
 
    //if (bo->base.usage & RADEON_FLAG_ENCRYPTED)
       //pb_slab_free(get_slabs(screen, bo->base.size, RADEON_FLAG_ENCRYPTED), &bo->u.slab.entry);
    //else
-      pb_slab_free(get_slabs(screen, bo->base.size, 0), &bo->u.slab.entry);
+      pb_slab_free(slabs, &bo->u.slab.entry);
 }
 
 static void
@@ -189,6 +197,81 @@ clean_up_buffer_managers(struct zink_screen *screen)
    pb_cache_release_all_buffers(&screen->pb.bo_cache);
 }
 
+static void
+update_heap_budget(struct zink_screen *screen)
+{
+   VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = {0};
+   budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+   VkPhysicalDeviceMemoryProperties2 mem = {0};
+   mem.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+   mem.pNext = &budget;
+   VKSCR(GetPhysicalDeviceMemoryProperties2)(screen->pdev, &mem);
+
+   for (unsigned i = 0; i < mem.memoryProperties.memoryHeapCount; i++) {
+      /* heapUsage includes our own allocations, which are tracked exactly between queries */
+      uint64_t usage = p_atomic_read(&screen->pb.heap_usage[i]);
+      screen->pb.heap_external[i] = budget.heapUsage[i] > usage ? budget.heapUsage[i] - usage : 0;
+      screen->pb.heap_budget[i] = budget.heapBudget[i];
+   }
+}
+
+/* Only called when new device memory is allocated: suballocations and
+ * cache hits compare against the budget from the last query.
+ */
+static void
+refresh_heap_budget(struct zink_screen *screen)
+{
+   if (!screen->info.have_EXT_memory_budget || !VKSCR(GetPhysicalDeviceMemoryProperties2))
+      return;
+
+   int64_t now = os_time_get_nano();
+   if (now - p_atomic_read(&screen->pb.budget_time) > ZINK_BUDGET_REFRESH_NS) {
+      simple_mtx_lock(&screen->pb.budget_lock);
+      if (now - screen->pb.budget_time > ZINK_BUDGET_REFRESH_NS) {
+         update_heap_budget(screen);
+         p_atomic_set(&screen->pb.budget_time, now);
+      }
+      simple_mtx_unlock(&screen->pb.budget_lock);
+   }
+}
+
+static bool
+heap_over_budget(struct zink_screen *screen, enum zink_heap heap, uint64_t size)
+{
+   unsigned heap_idx = screen->info.mem_props.memoryTypes[screen->heap_map[heap]].heapIndex;
+
+   return p_atomic_read(&screen->pb.heap_usage[heap_idx]) + screen->pb.heap_external[heap_idx] + size >
+          screen->pb.heap_budget[heap_idx];
+}
+
+bool
+zink_bo_over_budget(struct zink_screen *screen, enum zink_heap heap, uint64_t size)
+{
+   if (!heap_over_budget(screen, heap, size))
+      return false;
+   /* release idle cached bos and empty slabs before reporting pressure */
+   clean_up_buffer_managers(screen);
+   return heap_over_budget(screen, heap, size);
+}
+
+void
+zink_bo_dump_usage(struct zink_screen *screen)
+{
+   for (unsigned i = 0; i < screen->info.mem_props.memoryHeapCount; i++) {
+      mesa_logi("zink: heap %u: %"PRIu64"KB allocated, %"PRIu64"KB used elsewhere, %"PRIu64"KB budget, %"PRIu64"KB total",
+                i, p_atomic_read(&screen->pb.heap_usage[i]) / 1024, screen->pb.heap_external[i] / 1024,
+                screen->pb.heap_budget[i] / 1024, screen->info.mem_props.memoryHeaps[i].size / 1024);
+   }
+   for (unsigned i = 0; i < NUM_SLAB_ALLOCATORS; i++) {
+      uint64_t size = p_atomic_read(&screen->pb.slab_size[i]);
+      uint64_t used = p_atomic_read(&screen->pb.slab_used[i]);
+      mesa_logi("zink: slab allocator %u (%u-%u bytes): %"PRIu64"KB of %"PRIu64"KB in use (%u%%)",
+                i, 1u << screen->pb.bo_slabs[i].min_order,
+                1u << (screen->pb.bo_slabs[i].min_order + screen->pb.bo_slabs[i].num_orders - 1),
+                used / 1024, size / 1024, size ? (unsigned)(used * 100 / size) : 100);
+   }
+}
+
 static unsigned
 get_optimal_alignment(struct zink_screen *screen, uint64_t size, unsigned alignment)
 {
@@ -279,6 +362,10 @@ demote:
       goto fail;
    }
 
+   bo->u.real.heap_idx = heap_idx;
+   p_atomic_add(&screen->pb.heap_usage[heap_idx], mai.allocationSize);
+   refresh_heap_budget(screen);
+
    if (init_pb_cache) {
       bo->u.real.use_reusable_pool = true;
       pb_cache_init_entry(&screen->pb.bo_cache, bo->cache_entry, &bo->base, heap);
@@ -587,6 +674,8 @@ zink_bo_create(struct zink_screen *screen, uint64_t size, unsigned alignment, en
          unsigned heapidx = screen->info.mem_props.memoryTypes[screen->heap_map[heap]].heapIndex;
          reclaim_all = screen->info.mem_props.memoryHeaps[heapidx].size <= low_bound;
       }
+      /* near the budget, free empty slabs instead of letting sparse ones accumulate */
+      reclaim_all |= heap_over_budget(screen, heap, alloc_size);
       entry = pb_slab_alloc_reclaimed(slabs, alloc_size, heap, reclaim_all);
       if (!entry) {
          /* Clean up buffer managers and try again. */
@@ -595,8 +684,9 @@ zink_bo_create(struct zink_screen *screen, uint64_t size, unsigned alignment, en
          entry = pb_slab_alloc_reclaimed(slabs, alloc_size, heap, true);
       }
       if (!entry)
-         return NULL;
+         goto fail;
 
+      p_atomic_add(&screen->pb.slab_used[slabs - screen->pb.bo_slabs], entry->entry_size);
       bo = container_of(entry, struct zink_bo, u.slab.entry);
       pipe_reference_init(&bo->base.reference, 1);
       bo->base.size = size;
@@ -639,10 +729,17 @@ no_slab:
 
       bo = bo_create_internal(screen, size, alignment, heap, flags, pNext);
       if (!bo)
-         return NULL;
+         goto fail;
    }
 
    return &bo->base;
+
+fail:
+   if (zink_debug & ZINK_DEBUG_MEM) {
+      mesa_loge("zink: failed to allocate %"PRIu64" bytes from heap %u", size, heap);
+      zink_bo_dump_usage(screen);
+   }
+   return NULL;
 }
 
 void *
@@ -886,6 +983,7 @@ bo_slab_alloc(void *priv, unsigned heap, unsigned entry_size, unsigned group_ind
       goto fail;
 
    slab_size = slab->buffer->base.size;
+   p_atomic_add(&screen->pb.slab_size[get_slabs(screen, entry_size, 0) - screen->pb.bo_slabs], slab_size);
 
    slab->base.num_entries = slab_size / entry_size;
    slab->base.num_free = slab->base.num_entries;
@@ -983,12 +1081,20 @@ zink_bo_init(struct zink_screen *screen)
    screen->pb.min_alloc_size = 1 << screen->pb.bo_slabs[0].min_order;
    screen->pb.bo_export_table = util_hash_table_create_ptr_keys();
    simple_mtx_init(&screen->pb.bo_export_table_lock, mtx_plain);
+
+   /* without VK_EXT_memory_budget, the whole heap is the budget */
+   for (uint32_t i = 0; i < screen->info.mem_props.memoryHeapCount; ++i)
+      screen->pb.heap_budget[i] = screen->info.mem_props.memoryHeaps[i].size;
+   simple_mtx_init(&screen->pb.budget_lock, mtx_plain);
+   refresh_heap_budget(screen);
    return true;
 }
 
 void
 zink_bo_deinit(struct zink_screen *screen)
 {
+   if (zink_debug & ZINK_DEBUG_MEM)
+      zink_bo_dump_usage(screen);
    for (unsigned i = 0; i < NUM_SLAB_ALLOCATORS; i++) {
       if (screen->pb.bo_slabs[i].groups)
          pb_slabs_deinit(&screen->pb.bo_slabs[i]);
@@ -996,4 +1102,5 @@ zink_bo_deinit(struct zink_screen *screen)
    pb_cache_deinit(&screen->pb.bo_cache);
    _mesa_hash_table_destroy(screen->pb.bo_export_table, NULL);
    simple_mtx_destroy(&screen->pb.bo_export_table_lock);
+   simple_mtx_destroy(&screen->pb.budget_lock);
 }
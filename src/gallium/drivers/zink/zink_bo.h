@@ -66,6 +66,8 @@ struct zink_bo {
 
          bool is_user_ptr;
          bool use_reusable_pool;
+         /* vk memory heap this was allocated from, for budget tracking */
+         unsigned heap_idx;
 
          /* Whether buffer_get_handle or buffer_from_handle has been called,
           * it can only transition from false to true. Protected by lock.
@@ -193,6 +195,12 @@ zink_bo_get_size(const struct zink_bo *bo)
    return bo->mem ? bo->base.size : bo->u.slab.real->base.size;
 }
 
+bool
+zink_bo_over_budget(struct zink_screen *screen, enum zink_heap heap, uint64_t size);
+
+void
+zink_bo_dump_usage(struct zink_screen *screen);
+
 void *
 zink_bo_map(struct zink_screen *screen, struct zink_bo *bo);
 void
@@ -453,20 +453,21 @@ static void
 optimize_nir(struct nir_shader *s)
 {
    bool progress;
+   nir_opt_loop loop;
+   nir_opt_loop_init(&loop);
    do {
-      progress = false;
-      NIR_PASS_V(s, nir_lower_vars_to_ssa);
-      NIR_PASS(progress, s, nir_copy_prop);
-      NIR_PASS(progress, s, nir_opt_remove_phis);
-      NIR_PASS(progress, s, nir_opt_dce);
-      NIR_PASS(progress, s, nir_opt_dead_cf);
-      NIR_PASS(progress, s, nir_opt_cse);
-      NIR_PASS(progress, s, nir_opt_peephole_select, 8, true, true);
-      NIR_PASS(progress, s, nir_opt_algebraic);
-      NIR_PASS(progress, s, nir_opt_constant_folding);
-      NIR_PASS(progress, s, nir_opt_undef);
-      NIR_PASS(progress, s, zink_nir_lower_b2b);
-   } while (progress);
+      NIR_LOOP_PASS_NO_REPEAT(&loop, s, nir_lower_vars_to_ssa);
+      NIR_LOOP_PASS(&loop, s, nir_copy_prop);
+      NIR_LOOP_PASS(&loop, s, nir_opt_remove_phis);
+      NIR_LOOP_PASS(&loop, s, nir_opt_dce);
+      NIR_LOOP_PASS(&loop, s, nir_opt_dead_cf);
+      NIR_LOOP_PASS(&loop, s, nir_opt_cse);
+      NIR_LOOP_PASS(&loop, s, nir_opt_peephole_select, 8, true, true);
+      NIR_LOOP_PASS(&loop, s, nir_opt_algebraic);
+      NIR_LOOP_PASS(&loop, s, nir_opt_constant_folding);
+      NIR_LOOP_PASS(&loop, s, nir_opt_undef);
+      NIR_LOOP_PASS(&loop, s, zink_nir_lower_b2b);
+   } while (nir_opt_loop_continue(&loop, s));
 
    do {
       progress = false;
@@ -938,11 +939,10 @@ remove_bo_access(nir_shader *shader)
    return nir_shader_instructions_pass(shader, remove_bo_access_instr, nir_metadata_dominance, &bo);
 }
 
-static void
-assign_producer_var_io(gl_shader_stage stage, nir_variable *var, unsigned *reserved, unsigned char *slot_map)
+static bool
+is_builtin_varying(unsigned location)
 {
-   unsigned slot = var->data.location;
-   switch (var->data.location) {
+   switch (location) {
    case VARYING_SLOT_POS:
    case VARYING_SLOT_PNTC:
    case VARYING_SLOT_PSIZ:
@@ -954,11 +954,20 @@ assign_producer_var_io(gl_shader_stage stage, nir_variable *var, unsigned *reser
    case VARYING_SLOT_FACE:
    case VARYING_SLOT_TESS_LEVEL_OUTER:
    case VARYING_SLOT_TESS_LEVEL_INNER:
+      return true;
+   default:
+      return false;
+   }
+}
+
+static void
+assign_producer_var_io(gl_shader_stage stage, nir_variable *var, unsigned *reserved, unsigned char *slot_map)
+{
+   unsigned slot = var->data.location;
+   if (is_builtin_varying(var->data.location)) {
       /* use a sentinel value to avoid counting later */
       var->data.driver_location = UINT_MAX;
-      break;
-
-   default:
+   } else {
       if (var->data.patch) {
          assert(var->data.location >= VARYING_SLOT_PATCH0);
          slot = var->data.location - VARYING_SLOT_PATCH0;
@@ -991,22 +1000,10 @@ is_texcoord(gl_shader_stage stage, const nir_variable *var)
 static bool
 assign_consumer_var_io(gl_shader_stage stage, nir_variable *var, unsigned *reserved, unsigned char *slot_map)
 {
-   switch (var->data.location) {
-   case VARYING_SLOT_POS:
-   case VARYING_SLOT_PNTC:
-   case VARYING_SLOT_PSIZ:
-   case VARYING_SLOT_LAYER:
-   case VARYING_SLOT_PRIMITIVE_ID:
-   case VARYING_SLOT_CLIP_DIST0:
-   case VARYING_SLOT_CULL_DIST0:
-   case VARYING_SLOT_VIEWPORT:
-   case VARYING_SLOT_FACE:
-   case VARYING_SLOT_TESS_LEVEL_OUTER:
-   case VARYING_SLOT_TESS_LEVEL_INNER:
+   if (is_builtin_varying(var->data.location)) {
       /* use a sentinel value to avoid counting later */
       var->data.driver_location = UINT_MAX;
-      break;
-   default:
+   } else {
       if (var->data.patch) {
          assert(var->data.location >= VARYING_SLOT_PATCH0);
          var->data.driver_location = var->data.location - VARYING_SLOT_PATCH0;
@@ -1082,6 +1079,50 @@ zink_compiler_assign_io(nir_shader *producer, nir_shader *consumer)
    optimize_nir(nir);
 }
 
+/* separable io gives every non-builtin varying a fixed location so that vs/fs modules
+ * can be compiled without knowing the other stage:
+ * COL0-TEX7 -> 0-10, BFC0-BFC1 -> 11-12, VARn -> 13+n
+ */
+static int
+separable_slot(unsigned location)
+{
+   if (location >= VARYING_SLOT_VAR0 && location < VARYING_SLOT_PATCH0)
+      return location - VARYING_SLOT_VAR0 + 13;
+   if (location >= VARYING_SLOT_COL0 && location <= VARYING_SLOT_TEX7)
+      return location - VARYING_SLOT_COL0;
+   if (location == VARYING_SLOT_BFC0 || location == VARYING_SLOT_BFC1)
+      return location - VARYING_SLOT_BFC0 + 11;
+   return -1;
+}
+
+static bool
+assign_separable_io(struct zink_screen *screen, struct zink_shader *zs, nir_shader *nir)
+{
+   nir_variable_mode mode = nir->info.stage == MESA_SHADER_VERTEX ? nir_var_shader_out : nir_var_shader_in;
+   unsigned max_slots = (nir->info.stage == MESA_SHADER_VERTEX ?
+                         screen->info.props.limits.maxVertexOutputComponents :
+                         screen->info.props.limits.maxFragmentInputComponents) / 4;
+   uint64_t slots = 0;
+
+   nir_foreach_variable_with_modes(var, nir, mode) {
+      if (is_builtin_varying(var->data.location))
+         continue;
+      int slot = separable_slot(var->data.location);
+      unsigned num_slots = glsl_count_vec4_slots(var->type, false, false);
+      if (slot < 0 || slot + num_slots > MIN2(max_slots, 64))
+         return false;
+      slots |= BITFIELD64_RANGE(slot, num_slots);
+   }
+   nir_foreach_variable_with_modes(var, nir, mode) {
+      if (is_builtin_varying(var->data.location))
+         var->data.driver_location = UINT_MAX;
+      else
+         var->data.driver_location = separable_slot(var->data.location);
+   }
+   zs->separable_slots = slots;
+   return true;
+}
+
 static void
 zink_shader_dump(void *words, size_t size, const char *file)
 {
@@ -1904,6 +1945,13 @@ zink_shader_create(struct zink_screen *screen, struct nir_shader *nir,
    if (so_info && nir->info.outputs_written && nir->info.has_transform_feedback_varyings)
       update_so_info(ret, so_info, nir->info.outputs_written, have_psiz);
 
+   /* linked programs clone the nir and reassign io, so this only affects separable programs */
+   if ((nir->info.stage == MESA_SHADER_VERTEX && !ret->streamout.have_xfb) ||
+       nir->info.stage == MESA_SHADER_FRAGMENT) {
+      list_inithead(&ret->separable_modules);
+      ret->separable = assign_separable_io(screen, ret, nir);
+   }
+
    return ret;
 }
 
@@ -1951,6 +1999,8 @@ zink_shader_free(struct zink_context *ctx, struct zink_shader *shader)
             _mesa_hash_table_remove_key(&ctx->program_cache[prog->stages_present >> 2], prog->shaders);
             prog->base.removed = true;
          }
+         /* the async optimization job reads the program's shaders */
+         util_queue_fence_wait(&prog->optimize_fence);
          prog->shaders[pstage] = NULL;
          if (shader->nir->info.stage == MESA_SHADER_TESS_EVAL && shader->generated)
             /* automatically destroy generated tcs shaders when tes is destroyed */
@@ -1959,6 +2009,13 @@ zink_shader_free(struct zink_context *ctx, struct zink_shader *shader)
       }
    }
    _mesa_set_destroy(shader->programs, NULL);
+   if (shader->separable) {
+      struct zink_screen *screen = zink_screen(ctx->base.screen);
+      list_for_each_entry_safe(struct zink_shader_module, zm, &shader->separable_modules, list) {
+         VKSCR(DestroyShaderModule)(screen->dev, zm->shader, NULL);
+         free(zm);
+      }
+   }
    ralloc_free(shader->nir);
    FREE(shader);
 }
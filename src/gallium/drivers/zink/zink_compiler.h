@@ -89,6 +89,10 @@ struct zink_shader {
    simple_mtx_t lock;
    struct set *programs;
 
+   bool separable; // io uses a fixed layout independent of the other program stages
+   uint64_t separable_slots; // locations used by separable io
+   struct list_head separable_modules; // zink_shader_module list shared by all programs, protected by lock
+
    union {
       struct zink_shader *generated; // a generated shader that this shader "owns"
       bool is_generated; // if this is a driver-created shader (e.g., tcs)
@@ -116,9 +116,12 @@ zink_context_destroy(struct pipe_context *pctx)
       zink_batch_state_destroy(screen, bs);
       bs = bs_next;
    }
-   util_dynarray_foreach(&ctx->free_batch_states, struct zink_batch_state*, bs) {
-      zink_clear_batch_state(ctx, *bs);
-      zink_batch_state_destroy(screen, *bs);
+   bs = ctx->free_batch_states;
+   while (bs) {
+      struct zink_batch_state *bs_next = bs->next;
+      zink_clear_batch_state(ctx, bs);
+      zink_batch_state_destroy(screen, bs);
+      bs = bs_next;
    }
 
    for (unsigned i = 0; i < 2; i++) {
@@ -151,6 +154,8 @@ zink_context_destroy(struct pipe_context *pctx)
 
    u_upload_destroy(pctx->stream_uploader);
    u_upload_destroy(pctx->const_uploader);
+   if (ctx->staging_uploader)
+      u_upload_destroy(ctx->staging_uploader);
    slab_destroy_child(&ctx->transfer_pool);
    for (unsigned i = 0; i < ARRAY_SIZE(ctx->program_cache); i++)
       _mesa_hash_table_clear(&ctx->program_cache[i], NULL);
@@ -2647,6 +2652,11 @@ zink_set_framebuffer_state(struct pipe_context *pctx,
    /* this is an ideal time to oom flush since it won't split a renderpass */
    if (ctx->oom_flush)
       flush_batch(ctx, false);
+   /* it's also the cheapest place to hand a long batch to an idle gpu */
+   else if (zink_batch_needs_early_submit(ctx)) {
+      ctx->submit_stats.early_submits++;
+      flush_batch(ctx, false);
+   }
 }
 
 static void
@@ -4210,8 +4220,6 @@ zink_context_create(struct pipe_screen *pscreen, void *priv, unsigned flags)
    ctx->need_barriers[0] = &ctx->update_barriers[0][0];
    ctx->need_barriers[1] = &ctx->update_barriers[1][0];
 
-   util_dynarray_init(&ctx->free_batch_states, ctx);
-
    ctx->gfx_pipeline_state.have_EXT_extended_dynamic_state = screen->info.have_EXT_extended_dynamic_state;
    ctx->gfx_pipeline_state.have_EXT_extended_dynamic_state2 = screen->info.have_EXT_extended_dynamic_state2;
 
@@ -4220,6 +4228,7 @@ zink_context_create(struct pipe_screen *pscreen, void *priv, unsigned flags)
 
    ctx->base.stream_uploader = u_upload_create_default(&ctx->base);
    ctx->base.const_uploader = u_upload_create_default(&ctx->base);
+   ctx->staging_uploader = u_upload_create(&ctx->base, ZINK_STAGING_RING_SIZE, PIPE_BIND_LINEAR, PIPE_USAGE_STREAM, 0);
    for (int i = 0; i < ARRAY_SIZE(ctx->fb_clears); i++)
       util_dynarray_init(&ctx->fb_clears[i].clears, ctx);
 
@@ -31,6 +31,7 @@
 #define ZINK_DEFAULT_DESC_CLAMP (ZINK_DEFAULT_MAX_DESCS * 0.9)
 
 #define ZINK_MAX_BINDLESS_HANDLES 1024
+#define ZINK_STAGING_RING_SIZE (4 * 1024 * 1024)
 
 #include "zink_clear.h"
 #include "zink_pipeline.h"
@@ -185,6 +186,8 @@ struct zink_context {
    struct threaded_context *tc;
    struct slab_child_pool transfer_pool;
    struct slab_child_pool transfer_pool_unsync;
+   /* suballocated upload space for write-only texture maps */
+   struct u_upload_mgr *staging_uploader;
    struct blitter_context *blitter;
 
    pipe_draw_vbo_func draw_vbo[2]; //batch changed
@@ -198,7 +201,12 @@ struct zink_context {
    struct zink_fence *last_fence; //the last command buffer submitted
    struct zink_batch_state *batch_states; //list of submitted batch states: ordered by increasing timeline id
    unsigned batch_states_count; //number of states in `batch_states`
-   struct util_dynarray free_batch_states; //unused batch states
+   struct zink_batch_state *free_batch_states; //unused batch states: lock-free stack linked through zink_batch_state::next
+   struct {
+      uint64_t submit_latency_ns; //accumulated time between zink_end_batch and vkQueueSubmit returning
+      uint32_t submits;
+      uint32_t early_submits; //submits triggered by zink_batch_needs_early_submit()
+   } submit_stats;
    bool oom_flush;
    bool oom_stall;
    struct zink_batch batch;
@@ -228,7 +228,9 @@ update_gfx_program(struct zink_context *ctx)
       ctx->curr_program = prog;
       ctx->gfx_pipeline_state.final_hash ^= ctx->curr_program->last_variant_hash;
       ctx->gfx_dirty = false;
-   } else if (ctx->dirty_shader_stages & bits) {
+   } else if (ctx->dirty_shader_stages & bits ||
+              /* swap in io-pruned modules once the background compile finishes */
+              unlikely(zink_gfx_program_optimized_ready(ctx->curr_program))) {
       /* remove old hash */
       ctx->gfx_pipeline_state.final_hash ^= ctx->curr_program->last_variant_hash;
       zink_update_gfx_program(ctx, ctx->curr_program);
@@ -82,6 +82,59 @@ shader_module_hash(const struct zink_shader_module *zm)
    return _mesa_hash_data(zm->key, key_size);
 }
 
+static struct zink_shader_module *
+create_shader_module(struct zink_screen *screen, struct zink_shader *zs, nir_shader *nir,
+                     const struct zink_shader_key *key, unsigned base_size)
+{
+   struct zink_shader_module *zm = malloc(sizeof(struct zink_shader_module) + key->size + base_size * sizeof(uint32_t));
+   if (!zm)
+      return NULL;
+   zm->shader = zink_shader_compile(screen, zs, nir, key);
+   if (!zm->shader) {
+      FREE(zm);
+      return NULL;
+   }
+   list_inithead(&zm->list);
+   zm->num_uniforms = base_size;
+   zm->key_size = key->size;
+   memcpy(zm->key, key, key->size);
+   if (base_size)
+      memcpy(zm->key + key->size, &key->base, base_size * sizeof(uint32_t));
+   zm->hash = shader_module_hash(zm);
+   zm->default_variant = false;
+   return zm;
+}
+
+/* separable modules don't depend on the other stages of the program,
+ * so they're cached on the shader and shared by every program that uses it
+ */
+static struct zink_shader_module *
+get_separable_shader_module(struct zink_screen *screen, struct zink_shader *zs,
+                            const struct zink_shader_key *key)
+{
+   struct zink_shader_module *zm = NULL;
+
+   simple_mtx_lock(&zs->lock);
+   list_for_each_entry(struct zink_shader_module, iter, &zs->separable_modules, list) {
+      if (shader_key_matches(iter, key, 0)) {
+         zm = iter;
+         break;
+      }
+   }
+   simple_mtx_unlock(&zs->lock);
+   if (zm)
+      return zm;
+
+   /* compile without the lock: another context racing on the same key just adds a duplicate */
+   zm = create_shader_module(screen, zs, zs->nir, key, 0);
+   if (!zm)
+      return NULL;
+   simple_mtx_lock(&zs->lock);
+   list_add(&zm->list, &zs->separable_modules);
+   simple_mtx_unlock(&zs->lock);
+   return zm;
+}
+
 static struct zink_shader_module *
 get_shader_module_for_stage(struct zink_context *ctx, struct zink_screen *screen,
                             struct zink_shader *zs, struct zink_gfx_program *prog,
@@ -89,7 +142,6 @@ get_shader_module_for_stage(struct zink_context *ctx, struct zink_screen *screen
 {
    gl_shader_stage stage = zs->nir->info.stage;
    enum pipe_shader_type pstage = pipe_shader_type_from_mesa(stage);
-   VkShaderModule mod;
    struct zink_shader_module *zm = NULL;
    unsigned base_size = 0;
    struct zink_shader_key *key = &state->shader_keys.key[pstage];
@@ -102,6 +154,13 @@ get_shader_module_for_stage(struct zink_context *ctx, struct zink_screen *screen
          key->inline_uniforms = false;
    }
 
+   if (prog->separable) {
+      if (prog->using_optimized)
+         return prog->optimized[pstage];
+      if (!base_size)
+         return get_separable_shader_module(screen, zs, key);
+   }
+
    struct zink_shader_module *iter, *next;
    LIST_FOR_EACH_ENTRY_SAFE(iter, next, &prog->shader_cache[pstage][!!base_size], list) {
       if (!shader_key_matches(iter, key, base_size))
@@ -112,23 +171,10 @@ get_shader_module_for_stage(struct zink_context *ctx, struct zink_screen *screen
    }
 
    if (!zm) {
-      zm = malloc(sizeof(struct zink_shader_module) + key->size + base_size * sizeof(uint32_t));
-      if (!zm) {
+      /* separable programs must stay on the separable io layout until they switch to optimized modules */
+      zm = create_shader_module(screen, zs, prog->separable ? zs->nir : prog->nir[stage], key, base_size);
+      if (!zm)
          return NULL;
-      }
-      mod = zink_shader_compile(screen, zs, prog->nir[stage], key);
-      if (!mod) {
-         FREE(zm);
-         return NULL;
-      }
-      zm->shader = mod;
-      list_inithead(&zm->list);
-      zm->num_uniforms = base_size;
-      zm->key_size = key->size;
-      memcpy(zm->key, key, key->size);
-      if (base_size)
-         memcpy(zm->key + key->size, &key->base, base_size * sizeof(uint32_t));
-      zm->hash = shader_module_hash(zm);
       zm->default_variant = !base_size && list_is_empty(&prog->shader_cache[pstage][0]);
       if (base_size)
          prog->inlined_variant_count[pstage]++;
@@ -154,6 +200,28 @@ destroy_shader_cache(struct zink_screen *screen, struct list_head *sc)
    }
 }
 
+/* optimized modules use a linked io layout, so either all stages use them or none do */
+static bool
+can_use_optimized_modules(struct zink_context *ctx, struct zink_gfx_program *prog,
+                          struct zink_gfx_pipeline_state *state)
+{
+   if (prog->optimize_pending) {
+      if (!util_queue_fence_is_signalled(&prog->optimize_fence))
+         return false;
+      prog->optimize_pending = false;
+   }
+   u_foreach_bit(pstage, prog->stages_present) {
+      if (!prog->optimized[pstage])
+         return false;
+      if (prog->shaders[pstage]->nir->info.num_inlinable_uniforms &&
+          ctx->inlinable_uniforms_valid_mask & BITFIELD64_BIT(pstage))
+         return false;
+      if (!shader_key_matches(prog->optimized[pstage], &state->shader_keys.key[pstage], 0))
+         return false;
+   }
+   return true;
+}
+
 static void
 update_gfx_shader_modules(struct zink_context *ctx,
                       struct zink_screen *screen,
@@ -164,6 +232,13 @@ update_gfx_shader_modules(struct zink_context *ctx,
    bool default_variants = true;
    bool first = !prog->modules[PIPE_SHADER_VERTEX];
    uint32_t variant_hash = prog->last_variant_hash;
+   if (prog->separable) {
+      bool use_optimized = can_use_optimized_modules(ctx, prog, state);
+      if (use_optimized != prog->using_optimized) {
+         prog->using_optimized = use_optimized;
+         mask = prog->stages_present;
+      }
+   }
    u_foreach_bit(pstage, mask) {
       assert(prog->shaders[pstage]);
       struct zink_shader_module *zm = get_shader_module_for_stage(ctx, screen, prog->shaders[pstage], prog, state);
@@ -379,10 +454,11 @@ assign_io(struct zink_gfx_program *prog, struct zink_shader *stages[ZINK_SHADER_
          struct zink_shader *consumer = shaders[j];
          if (!consumer)
             continue;
+         /* not parented to prog: this may run on the optimize thread */
          if (!prog->nir[producer->info.stage])
-            prog->nir[producer->info.stage] = nir_shader_clone(prog, producer);
+            prog->nir[producer->info.stage] = nir_shader_clone(NULL, producer);
          if (!prog->nir[j])
-            prog->nir[j] = nir_shader_clone(prog, consumer->nir);
+            prog->nir[j] = nir_shader_clone(NULL, consumer->nir);
          zink_compiler_assign_io(prog->nir[producer->info.stage], prog->nir[j]);
          i = j;
          break;
@@ -390,6 +466,40 @@ assign_io(struct zink_gfx_program *prog, struct zink_shader *stages[ZINK_SHADER_
    }
 }
 
+static void
+optimize_separable_program(void *data, void *gdata, int thread_index)
+{
+   struct zink_gfx_program *prog = data;
+   struct zink_screen *screen = gdata;
+
+   assign_io(prog, prog->shaders);
+   u_foreach_bit(pstage, prog->stages_present) {
+      struct zink_shader *zs = prog->shaders[pstage];
+      struct zink_shader_module *zm = create_shader_module(screen, zs, prog->nir[zs->nir->info.stage],
+                                                           &prog->optimized_keys[pstage], 0);
+      if (!zm)
+         return;
+      /* same key as the separable module: keep pipeline hashes apart */
+      zm->hash = _mesa_hash_data_with_seed(zm->key, zm->key_size, zm->hash);
+      /* owned by the program and destroyed along with the rest of its cache */
+      list_add(&zm->list, &prog->shader_cache[pstage][0]);
+      prog->optimized[pstage] = zm;
+   }
+}
+
+static bool
+can_link_separable(struct zink_shader *stages[ZINK_SHADER_COUNT])
+{
+   struct zink_shader *vs = stages[PIPE_SHADER_VERTEX];
+   struct zink_shader *fs = stages[PIPE_SHADER_FRAGMENT];
+   if (stages[PIPE_SHADER_GEOMETRY] || stages[PIPE_SHADER_TESS_CTRL] || stages[PIPE_SHADER_TESS_EVAL])
+      return false;
+   if (!vs || !fs || !vs->separable || !fs->separable)
+      return false;
+   /* every fs input must be written by the vs */
+   return !(fs->separable_slots & ~vs->separable_slots);
+}
+
 struct zink_gfx_program *
 zink_create_gfx_program(struct zink_context *ctx,
                         struct zink_shader *stages[ZINK_SHADER_COUNT],
@@ -401,6 +511,7 @@ zink_create_gfx_program(struct zink_context *ctx,
       goto fail;
 
    pipe_reference_init(&prog->base.reference, 1);
+   simple_mtx_init(&prog->base.cache_lock, mtx_plain);
 
    for (int i = 0; i < ZINK_SHADER_COUNT; ++i) {
       list_inithead(&prog->shader_cache[i][0]);
@@ -417,7 +528,10 @@ zink_create_gfx_program(struct zink_context *ctx,
       prog->stages_present |= BITFIELD_BIT(PIPE_SHADER_TESS_CTRL);
    }
 
-   assign_io(prog, prog->shaders);
+   util_queue_fence_init(&prog->optimize_fence);
+   prog->separable = can_link_separable(prog->shaders);
+   if (!prog->separable)
+      assign_io(prog, prog->shaders);
 
    if (stages[PIPE_SHADER_GEOMETRY])
       prog->last_vertex_stage = stages[PIPE_SHADER_GEOMETRY];
@@ -451,6 +565,18 @@ zink_create_gfx_program(struct zink_context *ctx,
       goto fail;
 
    zink_screen_get_pipeline_cache(screen, &prog->base);
+   if (prog->separable && screen->threaded) {
+      u_foreach_bit(pstage, prog->stages_present) {
+         struct zink_shader_key *key = &prog->optimized_keys[pstage];
+         *key = ctx->gfx_pipeline_state.shader_keys.key[pstage];
+         /* optimized modules are keyed without uniform values, so they must not bake any in */
+         key->inline_uniforms = false;
+         memset(&key->base, 0, sizeof(key->base));
+      }
+      prog->optimize_pending = true;
+      util_queue_add_job(&screen->optimize_queue, prog, &prog->optimize_fence,
+                         optimize_separable_program, NULL, 0);
+   }
    return prog;
 
 fail:
@@ -510,6 +636,7 @@ zink_create_compute_program(struct zink_context *ctx, struct zink_shader *shader
       goto fail;
 
    pipe_reference_init(&comp->base.reference, 1);
+   simple_mtx_init(&comp->base.cache_lock, mtx_plain);
    comp->base.is_compute = true;
 
    comp->curr = comp->module = CALLOC_STRUCT(zink_shader_module);
@@ -643,6 +770,8 @@ zink_destroy_gfx_program(struct zink_context *ctx,
                          struct zink_gfx_program *prog)
 {
    struct zink_screen *screen = zink_screen(ctx->base.screen);
+   util_queue_fence_wait(&prog->optimize_fence);
+   util_queue_fence_destroy(&prog->optimize_fence);
    if (prog->base.layout)
       VKSCR(DestroyPipelineLayout)(screen->dev, prog->base.layout, NULL);
 
@@ -678,6 +807,7 @@ zink_destroy_gfx_program(struct zink_context *ctx,
    }
    if (prog->base.pipeline_cache)
       VKSCR(DestroyPipelineCache)(screen->dev, prog->base.pipeline_cache, NULL);
+   simple_mtx_destroy(&prog->base.cache_lock);
    screen->descriptor_program_deinit(ctx, &prog->base);
 
    ralloc_free(prog);
@@ -705,6 +835,7 @@ zink_destroy_compute_program(struct zink_context *ctx,
    free(comp->module);
    if (comp->base.pipeline_cache)
       VKSCR(DestroyPipelineCache)(screen->dev, comp->base.pipeline_cache, NULL);
+   simple_mtx_destroy(&comp->base.cache_lock);
    screen->descriptor_program_deinit(ctx, &comp->base);
 
    ralloc_free(comp);
@@ -77,6 +77,7 @@ struct zink_program {
    struct pipe_reference reference;
    unsigned char sha1[20];
    struct util_queue_fence cache_fence;
+   simple_mtx_t cache_lock; /* serializes cache writes */
    VkPipelineCache pipeline_cache;
    size_t pipeline_cache_size;
    struct zink_batch_usage *batch_uses;
@@ -111,6 +112,16 @@ struct zink_gfx_program {
    struct hash_table pipelines[11]; // number of draw modes we support
    uint32_t default_variant_hash;
    uint32_t last_variant_hash;
+
+   /* separable programs link precompiled per-shader modules and only build
+    * io-pruned modules for the keys seen at creation time in the background
+    */
+   bool separable;
+   bool optimize_pending;
+   bool using_optimized;
+   struct util_queue_fence optimize_fence;
+   struct zink_shader_key optimized_keys[ZINK_SHADER_COUNT];
+   struct zink_shader_module *optimized[ZINK_SHADER_COUNT];
 };
 
 struct zink_compute_program {
@@ -199,6 +210,12 @@ zink_program_num_bindings_typed(const struct zink_program *pg, enum zink_descrip
 unsigned
 zink_program_num_bindings(const struct zink_program *pg, bool is_compute);
 
+static inline bool
+zink_gfx_program_optimized_ready(struct zink_gfx_program *prog)
+{
+   return prog->optimize_pending && util_queue_fence_is_signalled(&prog->optimize_fence);
+}
+
 bool
 zink_program_descriptor_is_buffer(struct zink_context *ctx, enum pipe_shader_type stage, enum zink_descriptor_type type, unsigned i);
 
@@ -10,6 +10,7 @@
 #include "util/u_dump.h"
 #include "util/u_inlines.h"
 #include "util/u_memory.h"
+#include "util/u_upload_mgr.h"
 
 #if defined(PIPE_ARCH_X86_64) || defined(PIPE_ARCH_PPC_64) || defined(PIPE_ARCH_AARCH64) || defined(PIPE_ARCH_MIPS64)
 #define NUM_QUERIES 5000
@@ -17,6 +18,18 @@
 #define NUM_QUERIES 500
 #endif
 
+enum zink_driver_query {
+   ZINK_QUERY_SUBMIT_LATENCY = PIPE_QUERY_DRIVER_SPECIFIC,
+   ZINK_QUERY_SUBMIT_QUEUE_DEPTH,
+   ZINK_QUERY_EARLY_SUBMITS,
+};
+
+static const struct pipe_driver_query_info zink_driver_query_list[] = {
+   {"submit-latency", ZINK_QUERY_SUBMIT_LATENCY, {0}, PIPE_DRIVER_QUERY_TYPE_MICROSECONDS, PIPE_DRIVER_QUERY_RESULT_TYPE_AVERAGE},
+   {"submit-queue-depth", ZINK_QUERY_SUBMIT_QUEUE_DEPTH, {0}, PIPE_DRIVER_QUERY_TYPE_UINT, PIPE_DRIVER_QUERY_RESULT_TYPE_AVERAGE},
+   {"early-submits", ZINK_QUERY_EARLY_SUBMITS, {0}, PIPE_DRIVER_QUERY_TYPE_UINT64, PIPE_DRIVER_QUERY_RESULT_TYPE_CUMULATIVE},
+};
+
 struct zink_query_buffer {
    struct list_head list;
    unsigned num_results;
@@ -59,6 +72,9 @@ struct zink_query {
 
    struct zink_resource *predicate;
    bool predicate_dirty;
+
+   uint64_t driver_begin[2]; //counter snapshots for driver-specific queries
+   uint64_t driver_end[2];
 };
 
 static void
@@ -174,6 +190,65 @@ is_so_overflow_query(struct zink_query *query)
    return query->type == PIPE_QUERY_SO_OVERFLOW_ANY_PREDICATE || query->type == PIPE_QUERY_SO_OVERFLOW_PREDICATE;
 }
 
+static bool
+is_driver_query(struct zink_query *query)
+{
+   return query->type >= PIPE_QUERY_DRIVER_SPECIFIC;
+}
+
+static unsigned
+count_inflight_batches(struct zink_context *ctx)
+{
+   struct zink_screen *screen = zink_screen(ctx->base.screen);
+   unsigned count = 0;
+   simple_mtx_lock(&ctx->batch_mtx);
+   for (struct zink_batch_state *bs = ctx->batch_states; bs; bs = bs->next) {
+      if (!bs->fence.batch_id || !zink_screen_check_last_finished(screen, bs->fence.batch_id))
+         count++;
+   }
+   simple_mtx_unlock(&ctx->batch_mtx);
+   return count;
+}
+
+static void
+snapshot_driver_query(struct zink_context *ctx, struct zink_query *query, uint64_t *vals)
+{
+   switch (query->type) {
+   case ZINK_QUERY_SUBMIT_LATENCY:
+      vals[0] = p_atomic_read(&ctx->submit_stats.submit_latency_ns);
+      vals[1] = p_atomic_read(&ctx->submit_stats.submits);
+      break;
+   case ZINK_QUERY_SUBMIT_QUEUE_DEPTH:
+      vals[0] = count_inflight_batches(ctx);
+      break;
+   case ZINK_QUERY_EARLY_SUBMITS:
+      vals[0] = ctx->submit_stats.early_submits;
+      break;
+   default:
+      unreachable("zink: unknown driver query");
+   }
+}
+
+static void
+get_driver_query_result(struct zink_query *query, union pipe_query_result *result)
+{
+   switch (query->type) {
+   case ZINK_QUERY_SUBMIT_LATENCY: {
+      uint64_t submits = query->driver_end[1] - query->driver_begin[1];
+      result->u64 = submits ? (query->driver_end[0] - query->driver_begin[0]) / submits / 1000 : 0;
+      break;
+   }
+   case ZINK_QUERY_SUBMIT_QUEUE_DEPTH:
+      result->u32 = query->driver_end[0];
+      break;
+   case ZINK_QUERY_EARLY_SUBMITS:
+      result->u64 = query->driver_end[0] - query->driver_begin[0];
+      break;
+   default:
+      unreachable("zink: unknown driver query");
+   }
+}
+
 static bool
 is_bool_query(struct zink_query *query)
 {
@@ -286,7 +361,7 @@ zink_create_query(struct pipe_context *pctx,
 
    query->index = index;
    query->type = query_type;
-   if (query->type == PIPE_QUERY_GPU_FINISHED)
+   if (query->type == PIPE_QUERY_GPU_FINISHED || is_driver_query(query))
       return (struct pipe_query *)query;
    query->vkqtype = convert_query_type(query_type, &query->precise);
    if (query->vkqtype == -1)
@@ -507,7 +582,7 @@ get_query_result(struct pipe_context *pctx,
 }
 
 static void
-force_cpu_read(struct zink_context *ctx, struct pipe_query *pquery, enum pipe_query_value_type result_type, struct pipe_resource *pres, unsigned offset)
+force_cpu_read(struct zink_context *ctx, struct pipe_query *pquery, bool wait, enum pipe_query_value_type result_type, struct pipe_resource *pres, unsigned offset)
 {
    struct pipe_context *pctx = &ctx->base;
    unsigned result_size = result_type <= PIPE_QUERY_TYPE_U32 ? sizeof(uint32_t) : sizeof(uint64_t);
@@ -517,9 +592,20 @@ force_cpu_read(struct zink_context *ctx, struct pipe_query *pquery, enum pipe_qu
    if (query->needs_update)
       update_qbo(ctx, query);
 
-   bool success = get_query_result(pctx, pquery, true, &result);
+   if (!wait) {
+      /* the buffer is left untouched if the result isn't available yet */
+      if (zink_batch_usage_is_unflushed(query->batch_id)) {
+         pctx->flush(pctx, NULL, 0);
+         return;
+      }
+      if (!zink_batch_usage_check_completion(ctx, query->batch_id))
+         return;
+   }
+
+   bool success = get_query_result(pctx, pquery, wait, &result);
    if (!success) {
-      debug_printf("zink: getting query result failed\n");
+      if (wait)
+         debug_printf("zink: getting query result failed\n");
       return;
    }
 
@@ -715,6 +801,11 @@ zink_begin_query(struct pipe_context *pctx,
    struct zink_context *ctx = zink_context(pctx);
    struct zink_batch *batch = &ctx->batch;
 
+   if (is_driver_query(query)) {
+      snapshot_driver_query(ctx, query, query->driver_begin);
+      return true;
+   }
+
    query->last_start = query->curr_query;
    /* drop all past results */
    reset_qbo(query);
@@ -782,6 +873,11 @@ zink_end_query(struct pipe_context *pctx,
       return true;
    }
 
+   if (is_driver_query(query)) {
+      snapshot_driver_query(ctx, query, query->driver_end);
+      return true;
+   }
+
    /* FIXME: this can be called from a thread, but it needs to write to the cmdbuf */
    threaded_context_unwrap_sync(pctx);
 
@@ -818,6 +914,11 @@ zink_get_query_result(struct pipe_context *pctx,
       return result->b;
    }
 
+   if (is_driver_query(query)) {
+      get_driver_query_result(query, result);
+      return true;
+   }
+
    if (query->needs_update)
       update_qbo(ctx, query);
 
@@ -826,10 +927,15 @@ zink_get_query_result(struct pipe_context *pctx,
          pctx->flush(pctx, NULL, 0);
       if (!wait)
          return false;
-   } else if (!threaded_query(q)->flushed &&
-              /* timeline drivers can wait during buffer map */
-              !zink_screen(pctx->screen)->info.have_KHR_timeline_semaphore)
-      zink_batch_usage_check_completion(ctx, query->batch_id);
+   } else if (!threaded_query(q)->flushed) {
+      /* when polling, a fence check is much cheaper than failing to map every qbo;
+       * timeline drivers can otherwise wait during buffer map
+       */
+      if (!wait || !zink_screen(pctx->screen)->info.have_KHR_timeline_semaphore) {
+         if (!zink_batch_usage_check_completion(ctx, query->batch_id) && !wait)
+            return false;
+      }
+   }
 
    return get_query_result(pctx, q, wait, result);
 }
@@ -975,7 +1081,7 @@ zink_render_condition(struct pipe_context *pctx,
          copy_results_to_buffer(ctx, query, res, 0, num_results, flags);
       } else {
          /* these need special handling */
-         force_cpu_read(ctx, pquery, PIPE_QUERY_TYPE_U32, &res->base.b, 0);
+         force_cpu_read(ctx, pquery, true, PIPE_QUERY_TYPE_U32, &res->base.b, 0);
       }
       query->predicate_dirty = false;
    }
@@ -1022,9 +1128,18 @@ zink_get_query_result_resource(struct pipe_context *pctx,
             return;
          }
       }
-      struct pipe_resource *staging = pipe_buffer_create(pctx->screen, 0, PIPE_USAGE_STAGING, result_size * 2);
-      copy_results_to_buffer(ctx, query, zink_resource(staging), 0, 1, size_flags | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT | flag);
-      zink_copy_buffer(ctx, res, zink_resource(staging), offset, result_size, result_size);
+      /* availability is polled often: take the scratch space from the stream uploader
+       * instead of creating a buffer for every poll
+       */
+      struct pipe_resource *staging = NULL;
+      unsigned staging_offset;
+      void *ptr;
+      u_upload_alloc(pctx->stream_uploader, 0, result_size * 2, sizeof(uint64_t), &staging_offset, &staging, &ptr);
+      if (!staging)
+         return;
+      copy_pool_results_to_buffer(ctx, query, query->query_pool, query_id, zink_resource(staging), staging_offset,
+                                  1, size_flags | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT | flag);
+      zink_copy_buffer(ctx, res, zink_resource(staging), offset, staging_offset + result_size, result_size);
       pipe_resource_reference(&staging, NULL);
       return;
    }
@@ -1052,7 +1167,7 @@ zink_get_query_result_resource(struct pipe_context *pctx,
    /* unfortunately, there's no way to accumulate results from multiple queries on the gpu without either
     * clobbering all but the last result or writing the results sequentially, so we have to manually write the result
     */
-   force_cpu_read(ctx, pquery, result_type, pres, offset);
+   force_cpu_read(ctx, pquery, wait, result_type, pres, offset);
 }
 
 static uint64_t
@@ -1069,6 +1184,20 @@ zink_get_timestamp(struct pipe_context *pctx)
    return timestamp;
 }
 
+int
+zink_get_driver_query_info(struct pipe_screen *pscreen, unsigned index,
+                           struct pipe_driver_query_info *info)
+{
+   if (!info)
+      return ARRAY_SIZE(zink_driver_query_list);
+
+   if (index >= ARRAY_SIZE(zink_driver_query_list))
+      return 0;
+
+   *info = zink_driver_query_list[index];
+   return 1;
+}
+
 void
 zink_context_query_init(struct pipe_context *pctx)
 {
@@ -26,6 +26,8 @@
 
 #include <stdbool.h>
 
+struct pipe_driver_query_info;
+struct pipe_screen;
 struct zink_batch;
 struct zink_batch_state;
 struct zink_context;
@@ -56,6 +58,10 @@ zink_stop_conditional_render(struct zink_context *ctx);
 
 bool
 zink_check_conditional_render(struct zink_context *ctx);
+
+int
+zink_get_driver_query_info(struct pipe_screen *pscreen, unsigned index,
+                           struct pipe_driver_query_info *info);
 #ifdef __cplusplus
 }
 #endif
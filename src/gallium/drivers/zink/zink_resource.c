@@ -729,6 +729,20 @@ resource_object_create(struct zink_screen *screen, const struct pipe_resource *t
       assert(reqs.memoryTypeBits & BITFIELD_BIT(mai.memoryTypeIndex));
    }
 
+   if (zink_bo_over_budget(screen, heap, reqs.size)) {
+      /* keep vram for images: buffers can live in host memory at the cost of bandwidth */
+      unsigned host_type = screen->heap_map[ZINK_HEAP_HOST_VISIBLE_COHERENT];
+      if (heap == ZINK_HEAP_DEVICE_LOCAL && obj->is_buffer && !whandle && !shared &&
+          reqs.memoryTypeBits & BITFIELD_BIT(host_type) &&
+          screen->info.mem_props.memoryTypes[host_type].heapIndex != screen->info.mem_props.memoryTypes[mai.memoryTypeIndex].heapIndex &&
+          !zink_bo_over_budget(screen, ZINK_HEAP_HOST_VISIBLE_COHERENT, reqs.size)) {
+         if (zink_debug & ZINK_DEBUG_MEM)
+            mesa_logi("zink: vram over budget, placing %"PRIu64" byte buffer in host memory", (uint64_t)reqs.size);
+         heap = ZINK_HEAP_HOST_VISIBLE_COHERENT;
+         mai.memoryTypeIndex = host_type;
+      }
+   }
+
    VkMemoryDedicatedAllocateInfo ded_alloc_info = {
       .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,
       .pNext = mai.pNext,
@@ -1353,13 +1367,14 @@ zink_buffer_map(struct pipe_context *pctx,
 
          /* If we are not called from the driver thread, we have
           * to use the uploader from u_threaded_context, which is
-          * local to the calling thread.
+          * local to the calling thread.  Otherwise share the staging
+          * ring with texture uploads.
           */
          struct u_upload_mgr *mgr;
          if (usage & TC_TRANSFER_MAP_THREADED_UNSYNC)
             mgr = ctx->tc->base.stream_uploader;
          else
-            mgr = ctx->base.stream_uploader;
+            mgr = ctx->staging_uploader;
          u_upload_alloc(mgr, 0, box->width + box->x,
                      screen->info.props.limits.minMemoryMapAlignment, &offset,
                      (struct pipe_resource **)&trans->staging_res, (void **)&ptr);
@@ -1493,12 +1508,31 @@ zink_image_map(struct pipe_context *pctx,
                                                          trans->base.b.stride,
                                                          box->height);
 
+      unsigned staging_size = trans->base.b.layer_stride * box->depth;
+      unsigned blocksize = util_format_get_blocksize(format);
+      /* write-only maps can take their staging space from the upload ring instead of creating a buffer:
+       * the copy offset must be a multiple of the texel size, so this only works for pot blocks,
+       * and ring buffers are untyped R8, so images without transfer_dst that get their data
+       * through a blit need a staging buffer in the image format
+       */
+      if (!(usage & PIPE_MAP_READ) && ctx->staging_uploader && res->obj->transfer_dst &&
+          util_is_power_of_two_nonzero(blocksize)) {
+         unsigned offset;
+         u_upload_alloc(ctx->staging_uploader, 0, staging_size,
+                        MAX2(screen->info.props.limits.minMemoryMapAlignment, blocksize), &offset,
+                        &trans->staging_res, &ptr);
+         if (trans->staging_res) {
+            trans->offset = offset;
+            goto staged;
+         }
+      }
+
       struct pipe_resource templ = *pres;
       templ.format = format;
       templ.usage = usage & PIPE_MAP_READ ? PIPE_USAGE_STAGING : PIPE_USAGE_STREAM;
       templ.target = PIPE_BUFFER;
       templ.bind = PIPE_BIND_LINEAR;
-      templ.width0 = trans->base.b.layer_stride * box->depth;
+      templ.width0 = staging_size;
       templ.height0 = templ.depth0 = 0;
       templ.last_level = 0;
       templ.array_size = 1;
@@ -1520,6 +1554,8 @@ zink_image_map(struct pipe_context *pctx,
       }
 
       ptr = map_resource(screen, staging_res);
+      if (sizeof(void*) == 4)
+         trans->base.b.usage |= ZINK_MAP_TEMPORARY;
    } else {
       assert(!res->optimal_tiling);
       ptr = map_resource(screen, res);
@@ -1556,12 +1592,13 @@ zink_image_map(struct pipe_context *pctx,
          VKSCR(FlushMappedMemoryRanges)(screen->dev, 1, &range);
       }
       ptr = ((uint8_t *)ptr) + offset;
+      if (sizeof(void*) == 4)
+         trans->base.b.usage |= ZINK_MAP_TEMPORARY;
    }
+staged:
    if (!ptr)
       goto fail;
 
-   if (sizeof(void*) == 4)
-      trans->base.b.usage |= ZINK_MAP_TEMPORARY;
    if ((usage & PIPE_MAP_PERSISTENT) && !(usage & PIPE_MAP_COHERENT))
       res->obj->persistent_maps++;
 
@@ -1658,7 +1695,8 @@ zink_image_unmap(struct pipe_context *pctx, struct pipe_transfer *ptrans)
 {
    struct zink_screen *screen = zink_screen(pctx->screen);
    struct zink_transfer *trans = (struct zink_transfer *)ptrans;
-   if (sizeof(void*) == 4)
+   /* upload ring allocations stay mapped for the lifetime of the ring */
+   if (trans->base.b.usage & ZINK_MAP_TEMPORARY)
       do_transfer_unmap(screen, trans);
    transfer_unmap(pctx, ptrans);
 }
@@ -33,6 +33,7 @@
 #include "zink_instance.h"
 #include "zink_program.h"
 #include "zink_public.h"
+#include "zink_query.h"
 #include "zink_resource.h"
 #include "nir_to_spirv/nir_to_spirv.h" // for SPIRV_VERSION
 
@@ -69,6 +70,7 @@ zink_debug_options[] = {
    { "spirv", ZINK_DEBUG_SPIRV, "Dump SPIR-V during program compile" },
    { "tgsi", ZINK_DEBUG_TGSI, "Dump TGSI during program compile" },
    { "validation", ZINK_DEBUG_VALIDATION, "Dump Validation layer output" },
+   { "mem", ZINK_DEBUG_MEM, "Dump heap and slab usage on allocation failure and screen destruction" },
    DEBUG_NAMED_VALUE_END
 };
 
@@ -151,8 +153,7 @@ disk_cache_init(struct zink_screen *screen)
 
    screen->disk_cache = disk_cache_create(buf, screen->info.props.deviceName, 0);
    if (screen->disk_cache) {
-      util_queue_init(&screen->cache_put_thread, "zcq", 8, 1, UTIL_QUEUE_INIT_RESIZE_IF_FULL, screen);
-      util_queue_init(&screen->cache_get_thread, "zcfq", 8, 4, UTIL_QUEUE_INIT_RESIZE_IF_FULL, screen);
+      util_queue_init(&screen->cache_queue, "zcq", 8, 4, UTIL_QUEUE_INIT_RESIZE_IF_FULL, screen);
    }
 #endif
 }
@@ -164,13 +165,15 @@ cache_put_job(void *data, void *gdata, int thread_index)
    struct zink_program *pg = data;
    struct zink_screen *screen = gdata;
    size_t size = 0;
+   void *pipeline_data;
+   simple_mtx_lock(&pg->cache_lock);
    if (VKSCR(GetPipelineCacheData)(screen->dev, pg->pipeline_cache, &size, NULL) != VK_SUCCESS)
-      return;
+      goto out;
    if (pg->pipeline_cache_size == size)
-      return;
-   void *pipeline_data = malloc(size);
+      goto out;
+   pipeline_data = malloc(size);
    if (!pipeline_data)
-      return;
+      goto out;
    if (VKSCR(GetPipelineCacheData)(screen->dev, pg->pipeline_cache, &size, pipeline_data) == VK_SUCCESS) {
       pg->pipeline_cache_size = size;
 
@@ -178,16 +181,22 @@ cache_put_job(void *data, void *gdata, int thread_index)
       disk_cache_compute_key(screen->disk_cache, pg->sha1, sizeof(pg->sha1), key);
       disk_cache_put_nocopy(screen->disk_cache, key, pipeline_data, size, NULL);
    }
+out:
+   simple_mtx_unlock(&pg->cache_lock);
 }
 
 void
 zink_screen_update_pipeline_cache(struct zink_screen *screen, struct zink_program *pg)
 {
-   util_queue_fence_init(&pg->cache_fence);
    if (!screen->disk_cache)
       return;
 
-   util_queue_add_job(&screen->cache_put_thread, pg, NULL, cache_put_job, NULL, 0);
+   /* Writes are background work: let the cache loads that pipeline
+    * creation is waiting for go first, and don't read the pipeline cache
+    * before the load has created it.
+    */
+   util_queue_add_job_ext(&screen->cache_queue, pg, NULL, cache_put_job, NULL, 0,
+                          UTIL_QUEUE_PRIORITY_NORMAL, &pg->cache_fence);
 }
 
 static void
@@ -218,7 +227,8 @@ zink_screen_get_pipeline_cache(struct zink_screen *screen, struct zink_program *
    if (!screen->disk_cache)
       return;
 
-   util_queue_add_job(&screen->cache_get_thread, pg, &pg->cache_fence, cache_get_job, NULL, 0);
+   util_queue_add_job_ext(&screen->cache_queue, pg, &pg->cache_fence, cache_get_job, NULL, 0,
+                          UTIL_QUEUE_PRIORITY_HIGH, NULL);
 }
 
 static int
@@ -1179,11 +1189,9 @@ zink_destroy_screen(struct pipe_screen *pscreen)
    u_transfer_helper_destroy(pscreen->transfer_helper);
 #ifdef ENABLE_SHADER_CACHE
    if (screen->disk_cache) {
-      util_queue_finish(&screen->cache_put_thread);
-      util_queue_finish(&screen->cache_get_thread);
+      util_queue_finish(&screen->cache_queue);
       disk_cache_wait_for_idle(screen->disk_cache);
-      util_queue_destroy(&screen->cache_put_thread);
-      util_queue_destroy(&screen->cache_get_thread);
+      util_queue_destroy(&screen->cache_queue);
    }
 #endif
    disk_cache_destroy(screen->disk_cache);
@@ -1195,8 +1203,10 @@ zink_destroy_screen(struct pipe_screen *pscreen)
    if (screen->prev_sem)
       VKSCR(DestroySemaphore)(screen->dev, screen->prev_sem, NULL);
 
-   if (screen->threaded)
+   if (screen->threaded) {
       util_queue_destroy(&screen->flush_queue);
+      util_queue_destroy(&screen->optimize_queue);
+   }
 
    simple_mtx_destroy(&screen->queue_lock);
    VKSCR(DestroyDevice)(screen->dev, NULL);
@@ -1998,8 +2008,10 @@ zink_internal_create_screen(const struct pipe_screen_config *config)
    }
 
    setup_renderdoc(screen);
-   if (screen->threaded)
+   if (screen->threaded) {
       util_queue_init(&screen->flush_queue, "zfq", 8, 1, UTIL_QUEUE_INIT_RESIZE_IF_FULL, screen);
+      util_queue_init(&screen->optimize_queue, "zopt", 8, 1, UTIL_QUEUE_INIT_RESIZE_IF_FULL | UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY, screen);
+   }
 
    zink_internal_setup_moltenvk(screen);
 
@@ -2041,6 +2053,7 @@ zink_internal_create_screen(const struct pipe_screen_config *config)
    screen->base.get_shader_param = zink_get_shader_param;
    screen->base.get_compiler_options = zink_get_compiler_options;
    screen->base.get_sample_pixel_grid = zink_get_sample_pixel_grid;
+   screen->base.get_driver_query_info = zink_get_driver_query_info;
    screen->base.is_compute_copy_faster = zink_is_compute_copy_faster;
    screen->base.is_format_supported = zink_is_format_supported;
    screen->base.query_dmabuf_modifiers = zink_query_dmabuf_modifiers;
@@ -2090,6 +2103,10 @@ zink_internal_create_screen(const struct pipe_screen_config *config)
       screen->max_fences = 5000;
       break;
    }
+   /* number of recorded draws/dispatches after which a batch is submitted at the next
+    * renderpass boundary if the gpu has already drained all previous work
+    */
+   screen->early_submit_threshold = debug_get_num_option("ZINK_EARLY_SUBMIT", 500);
 
    if (debug_get_bool_option("ZINK_NO_TIMELINES", false))
       screen->info.have_KHR_timeline_semaphore = false;
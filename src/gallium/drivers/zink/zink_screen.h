@@ -66,6 +66,7 @@ enum zink_descriptor_type;
 #define ZINK_DEBUG_SPIRV 0x2
 #define ZINK_DEBUG_TGSI 0x4
 #define ZINK_DEBUG_VALIDATION 0x8
+#define ZINK_DEBUG_MEM 0x10
 
 #define NUM_SLAB_ALLOCATORS 3
 
@@ -90,6 +91,7 @@ struct zink_screen {
    VkSemaphore sem;
    VkSemaphore prev_sem;
    struct util_queue flush_queue;
+   struct util_queue optimize_queue; //background compiles of io-pruned separable program variants
 
    unsigned buffer_rebind_counter;
 
@@ -107,8 +109,7 @@ struct zink_screen {
 
    struct slab_parent_pool transfer_pool;
    struct disk_cache *disk_cache;
-   struct util_queue cache_put_thread;
-   struct util_queue cache_get_thread;
+   struct util_queue cache_queue;
 
    struct util_live_shader_cache shaders;
 
@@ -119,6 +120,16 @@ struct zink_screen {
       struct hash_table *bo_export_table;
       simple_mtx_t bo_export_table_lock;
       uint32_t next_bo_unique_id;
+      /* bytes allocated by this screen from each vk memory heap */
+      uint64_t heap_usage[VK_MAX_MEMORY_HEAPS];
+      /* re-queried from VK_EXT_memory_budget at most every 100ms, when memory is allocated */
+      uint64_t heap_budget[VK_MAX_MEMORY_HEAPS];
+      uint64_t heap_external[VK_MAX_MEMORY_HEAPS];
+      int64_t budget_time;
+      simple_mtx_t budget_lock;
+      /* backing size and live entry size of each slab allocator */
+      uint64_t slab_size[NUM_SLAB_ALLOCATORS];
+      uint64_t slab_used[NUM_SLAB_ALLOCATORS];
    } pb;
    uint8_t heap_map[VK_MAX_MEMORY_TYPES];
    bool resizable_bar;
@@ -147,6 +158,7 @@ struct zink_screen {
    uint32_t max_queues;
    uint32_t timestamp_valid_bits;
    unsigned max_fences;
+   unsigned early_submit_threshold; //min work_count to submit early at a renderpass boundary, 0 disables
    VkDevice dev;
    VkQueue queue; //gfx+compute
    VkQueue thread_queue; //gfx+compute
@@ -36,7 +36,7 @@
 static inline bool
 are_all_uses_fadd(nir_ssa_def *def)
 {
-   if (!list_is_empty(&def->if_uses))
+   if (def->if_uses.count != 0)
       return false;
 
    nir_foreach_use(use_src, def) {
@@ -152,8 +152,8 @@ any_alu_src_is_a_constant(nir_alu_src srcs[])
          nir_load_const_instr *load_const =
             nir_instr_as_load_const (srcs[i].src.ssa->parent_instr);
 
-         if (list_is_singular(&load_const->def.uses) &&
-             list_is_empty(&load_const->def.if_uses)) {
+         if (load_const->def.uses.count == 1 &&
+             load_const->def.if_uses.count == 0) {
             return true;
          }
       }
@@ -253,7 +253,7 @@ brw_nir_opt_peephole_ffma_instr(nir_builder *b,
    nir_ssa_def_rewrite_uses(&add->dest.dest.ssa, &ffma->dest.dest.ssa);
 
    nir_builder_instr_insert(b, &ffma->instr);
-   assert(list_is_empty(&add->dest.dest.ssa.uses));
+   assert(add->dest.dest.ssa.uses.count == 0);
    nir_instr_remove(&add->instr);
 
    return true;
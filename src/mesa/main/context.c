@@ -1326,6 +1326,7 @@ _mesa_free_context_data(struct gl_context *ctx, bool destroy_debug_output)
    free(ctx->VersionString);
 
    ralloc_free(ctx->SoftFP64);
+   ralloc_free(ctx->GLSLPreprocessCache);
 
    /* unbind the context if it's currently bound */
    if (ctx == _mesa_get_current_context()) {
@@ -5434,6 +5434,13 @@ struct gl_context
     */
    struct nir_shader *SoftFP64;
 
+   /**
+    * glcpp output of previously compiled shader sources, keyed on the SHA-1
+    * of the stage and source.  Everything else the preprocessor depends on
+    * is fixed for the lifetime of the context.
+    */
+   struct hash_table *GLSLPreprocessCache;
+
    struct gl_query_state Query;  /**< occlusion, timer queries */
 
    struct gl_transform_feedback_state TransformFeedback;
@@ -619,6 +619,22 @@ st_nir_vectorize_io(nir_shader *producer, nir_shader *consumer)
    NIR_PASS_V(producer, nir_opt_dce);
 }
 
+static void
+st_nir_opts_task(nir_shader *nir, void *data)
+{
+   st_nir_opts(nir);
+}
+
+/* The producer and consumer don't share any IR, so optimize them
+ * concurrently.
+ */
+static void
+st_nir_opts_pair(nir_shader *producer, nir_shader *consumer)
+{
+   nir_shader *shaders[2] = { producer, consumer };
+   nir_shaders_run_parallel(shaders, 2, st_nir_opts_task, NULL);
+}
+
 static void
 st_nir_link_shaders(nir_shader *producer, nir_shader *consumer)
 {
@@ -629,8 +645,7 @@ st_nir_link_shaders(nir_shader *producer, nir_shader *consumer)
 
    nir_lower_io_arrays_to_elements(producer, consumer);
 
-   st_nir_opts(producer);
-   st_nir_opts(consumer);
+   st_nir_opts_pair(producer, consumer);
 
    if (nir_link_opt_varyings(producer, consumer))
       st_nir_opts(consumer);
@@ -642,8 +657,7 @@ st_nir_link_shaders(nir_shader *producer, nir_shader *consumer)
       NIR_PASS_V(producer, nir_lower_global_vars_to_local);
       NIR_PASS_V(consumer, nir_lower_global_vars_to_local);
 
-      st_nir_opts(producer);
-      st_nir_opts(consumer);
+      st_nir_opts_pair(producer, consumer);
 
       /* Optimizations can cause varyings to become unused.
        * nir_compact_varyings() depends on all dead varyings being removed so
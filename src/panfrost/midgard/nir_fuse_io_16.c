@@ -75,7 +75,7 @@ nir_fuse_io_16(nir_shader *shader)
             if (!intr->dest.is_ssa)
                continue;
 
-            if (!list_is_empty(&intr->dest.ssa.if_uses))
+            if (intr->dest.ssa.if_uses.count != 0)
                return false;
 
             bool valid = true;
@@ -90,13 +90,13 @@ pan_has_dest_mod(nir_dest **odest, nir_op op)
       return false;
 
    /* Check the uses. We want a single use, with the op `op` */
-   if (!list_is_empty(&dest->ssa.if_uses))
+   if (dest->ssa.if_uses.count != 0)
       return false;
 
-   if (!list_is_singular(&dest->ssa.uses))
+   if (dest->ssa.uses.count != 1)
       return false;
 
-   nir_src *use = list_first_entry(&dest->ssa.uses, nir_src, use_link);
+   nir_src *use = nir_use_array_get(&dest->ssa.uses, 0);
    nir_instr *parent = use->parent_instr;
 
    /* Check if the op is `op` */
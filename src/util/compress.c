@@ -36,14 +36,104 @@
 
 #ifdef HAVE_ZSTD
 #include "zstd.h"
+#include "zdict.h"
 #endif
 
+#include <stdlib.h>
+
 #include "util/compress.h"
 #include "macros.h"
 
 /* 3 is the recomended level, with 22 as the absolute maximum */
 #define ZSTD_COMPRESSION_LEVEL 3
 
+struct util_compress_dict {
+#ifdef HAVE_ZSTD
+   ZSTD_CDict *cdict;
+   ZSTD_DDict *ddict;
+#endif
+   uint32_t id;
+};
+
+/* Trains a dictionary from num_samples samples stored back to back in
+ * samples.  Returns the size of the dictionary written to dict_data, or 0 if
+ * training failed or the backend has no dictionary trainer.
+ */
+size_t
+util_compress_dict_train(uint8_t *dict_data, size_t dict_capacity,
+                         const uint8_t *samples, const size_t *sample_sizes,
+                         unsigned num_samples)
+{
+#ifdef HAVE_ZSTD
+   size_t ret = ZDICT_trainFromBuffer(dict_data, dict_capacity, samples,
+                                      sample_sizes, num_samples);
+   if (ZDICT_isError(ret))
+      return 0;
+
+   return ret;
+#else
+   return 0;
+#endif
+}
+
+/* Creates a dictionary from data returned by util_compress_dict_train(),
+ * items compressed with it use the given level.  Returns NULL if the data
+ * isn't a valid dictionary.
+ */
+struct util_compress_dict *
+util_compress_dict_create(const uint8_t *dict_data, size_t dict_size,
+                          int level)
+{
+#ifdef HAVE_ZSTD
+   /* Id 0 is reserved for raw content dictionaries, which we never train. */
+   uint32_t id = ZSTD_getDictID_fromDict(dict_data, dict_size);
+   if (id == 0)
+      return NULL;
+
+   struct util_compress_dict *dict = calloc(1, sizeof(*dict));
+   if (!dict)
+      return NULL;
+
+   if (level < 0)
+      level = ZSTD_COMPRESSION_LEVEL;
+   level = MIN2(level, ZSTD_maxCLevel());
+
+   dict->id = id;
+   dict->cdict = ZSTD_createCDict(dict_data, dict_size, level);
+   dict->ddict = ZSTD_createDDict(dict_data, dict_size);
+   if (!dict->cdict || !dict->ddict) {
+      util_compress_dict_destroy(dict);
+      return NULL;
+   }
+
+   return dict;
+#else
+   return NULL;
+#endif
+}
+
+void
+util_compress_dict_destroy(struct util_compress_dict *dict)
+{
+   if (!dict)
+      return;
+
+#ifdef HAVE_ZSTD
+   ZSTD_freeCDict(dict->cdict);
+   ZSTD_freeDDict(dict->ddict);
+#endif
+   free(dict);
+}
+
+/* Returns the non-zero id stored in the dictionary, data compressed with it
+ * can only be decompressed with a dictionary with the same id.
+ */
+uint32_t
+util_compress_dict_id(const struct util_compress_dict *dict)
+{
+   return dict->id;
+}
+
 size_t
 util_compress_max_compressed_len(size_t in_data_size)
 {
@@ -69,19 +159,44 @@ util_compress_max_compressed_len(size_t in_data_size)
 #endif
 }
 
-/* Compress data and return the size of the compressed data */
+/* Compress data and return the size of the compressed data.  The level is
+ * clamped to the range supported by the backend, a negative one selects the
+ * default.  If dict is non-NULL the level it was created with is used
+ * instead.
+ */
 size_t
 util_compress_deflate(const uint8_t *in_data, size_t in_data_size,
-                      uint8_t *out_data, size_t out_buff_size)
+                      uint8_t *out_data, size_t out_buff_size, int level,
+                      const struct util_compress_dict *dict)
 {
 #ifdef HAVE_ZSTD
+   if (dict) {
+      ZSTD_CCtx *cctx = ZSTD_createCCtx();
+      if (!cctx)
+         return 0;
+
+      size_t ret = ZSTD_compress_usingCDict(cctx, out_data, out_buff_size,
+                                            in_data, in_data_size,
+                                            dict->cdict);
+      ZSTD_freeCCtx(cctx);
+      if (ZSTD_isError(ret))
+         return 0;
+
+      return ret;
+   }
+
+   if (level < 0)
+      level = ZSTD_COMPRESSION_LEVEL;
+   level = MIN2(level, ZSTD_maxCLevel());
+
    size_t ret = ZSTD_compress(out_data, out_buff_size, in_data, in_data_size,
-                              ZSTD_COMPRESSION_LEVEL);
+                              level);
    if (ZSTD_isError(ret))
       return 0;
 
    return ret;
 #elif defined(HAVE_ZLIB)
+   assert(!dict);
    size_t compressed_size = 0;
 
    /* allocate deflate state */
@@ -94,7 +209,11 @@ util_compress_deflate(const uint8_t *in_data, size_t in_data_size,
    strm.avail_in = in_data_size;
    strm.avail_out = out_buff_size;
 
-   int ret = deflateInit(&strm, Z_BEST_COMPRESSION);
+   if (level < 0)
+      level = Z_BEST_COMPRESSION;
+   level = MIN2(level, Z_BEST_COMPRESSION);
+
+   int ret = deflateInit(&strm, level);
    if (ret != Z_OK) {
        (void) deflateEnd(&strm);
        return 0;
@@ -118,16 +237,31 @@ util_compress_deflate(const uint8_t *in_data, size_t in_data_size,
 }
 
 /**
- * Decompresses data, returns true if successful.
+ * Decompresses data, returns true if successful.  Data compressed with a
+ * dictionary must be decompressed with the same dictionary.
  */
 bool
 util_compress_inflate(const uint8_t *in_data, size_t in_data_size,
-                      uint8_t *out_data, size_t out_data_size)
+                      uint8_t *out_data, size_t out_data_size,
+                      const struct util_compress_dict *dict)
 {
 #ifdef HAVE_ZSTD
+   if (dict) {
+      ZSTD_DCtx *dctx = ZSTD_createDCtx();
+      if (!dctx)
+         return false;
+
+      size_t ret = ZSTD_decompress_usingDDict(dctx, out_data, out_data_size,
+                                              in_data, in_data_size,
+                                              dict->ddict);
+      ZSTD_freeDCtx(dctx);
+      return !ZSTD_isError(ret);
+   }
+
    size_t ret = ZSTD_decompress(out_data, out_data_size, in_data, in_data_size);
    return !ZSTD_isError(ret);
 #elif defined(HAVE_ZLIB)
+   assert(!dict);
    z_stream strm;
 
    /* allocate inflate state */
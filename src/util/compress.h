@@ -29,12 +29,35 @@
 size_t
 util_compress_max_compressed_len(size_t in_data_size);
 
+/* A trained dictionary, only supported by the zstd backend. */
+struct util_compress_dict;
+
+size_t
+util_compress_dict_train(uint8_t *dict_data, size_t dict_capacity,
+                         const uint8_t *samples, const size_t *sample_sizes,
+                         unsigned num_samples);
+
+struct util_compress_dict *
+util_compress_dict_create(const uint8_t *dict_data, size_t dict_size,
+                          int level);
+
+void
+util_compress_dict_destroy(struct util_compress_dict *dict);
+
+uint32_t
+util_compress_dict_id(const struct util_compress_dict *dict);
+
 bool
 util_compress_inflate(const uint8_t *in_data, size_t in_data_size,
-                      uint8_t *out_data, size_t out_data_size);
+                      uint8_t *out_data, size_t out_data_size,
+                      const struct util_compress_dict *dict);
+
+/* Selects the default compression level of the backend. */
+#define UTIL_COMPRESS_DEFAULT_LEVEL -1
 
 size_t
 util_compress_deflate(const uint8_t *in_data, size_t in_data_size,
-                      uint8_t *out_data, size_t out_buff_size);
+                      uint8_t *out_data, size_t out_buff_size, int level,
+                      const struct util_compress_dict *dict);
 
 #endif
@@ -44,6 +44,8 @@
 #include "util/mesa-sha1.h"
 #include "util/ralloc.h"
 #include "util/compiler.h"
+#include "util/compress.h"
+#include "util/log.h"
 
 #include "disk_cache.h"
 #include "disk_cache_os.h"
@@ -60,7 +62,7 @@
  * - There is no strict requirement that cache versions be backwards
  *   compatible but effort should be taken to limit disruption where possible.
  */
-#define CACHE_VERSION 1
+#define CACHE_VERSION 3
 
 #define DRV_KEY_CPY(_dst, _src, _src_size) \
 do {                                       \
@@ -111,11 +113,6 @@ disk_cache_create(const char *gpu_name, const char *driver_id,
    if (cache->path == NULL)
       goto path_fail;
 
-   if (env_var_as_boolean("MESA_DISK_CACHE_SINGLE_FILE", false)) {
-      if (!disk_cache_load_cache_index(local, cache))
-         goto path_fail;
-   }
-
    if (!disk_cache_mmap_cache_index(local, cache, path))
       goto path_fail;
 
@@ -161,6 +158,18 @@ disk_cache_create(const char *gpu_name, const char *driver_id,
 
    cache->max_size = max_size;
 
+   const char *compression_level_str =
+      getenv("MESA_DISK_CACHE_COMPRESSION_LEVEL");
+   cache->compression_level = compression_level_str ?
+      MAX2(atoi(compression_level_str), 0) : UTIL_COMPRESS_DEFAULT_LEVEL;
+
+   cache->stats = env_var_as_boolean("MESA_DISK_CACHE_STATS", false);
+
+   if (env_var_as_boolean("MESA_DISK_CACHE_SINGLE_FILE", false)) {
+      if (!disk_cache_load_cache_index(local, cache))
+         goto path_fail;
+   }
+
    /* 4 threads were chosen below because just about all modern CPUs currently
     * available that run Mesa have *at least* 4 cores. For these CPUs allowing
     * more threads can result in the queue being processed faster, thus
@@ -212,6 +221,10 @@ disk_cache_create(const char *gpu_name, const char *driver_id,
    DRV_KEY_CPY(drv_key_blob, &ptr_size, ptr_size_size)
    DRV_KEY_CPY(drv_key_blob, &driver_flags, driver_flags_size)
 
+   /* The dictionary file is named after the driver keys. */
+   if (!cache->path_init_failed)
+      disk_cache_init_dict(cache);
+
    /* Seed our rand function */
    s_rand_xorshift128plus(cache->seed_xorshift128plus, true);
 
@@ -227,6 +240,22 @@ disk_cache_create(const char *gpu_name, const char *driver_id,
    return NULL;
 }
 
+static void
+disk_cache_print_stats(struct disk_cache *cache)
+{
+   mesa_logi("disk cache: %" PRIu64 " items written (%" PRIu64
+             " uncompressed, %" PRIu64 " with dictionary), %" PRIu64 " -> %"
+             PRIu64 " bytes (%.1f%%), %.3f ms compressing",
+             cache->stats_items_written, cache->stats_items_uncompressed,
+             cache->stats_items_dict,
+             cache->stats_bytes_in, cache->stats_bytes_out,
+             cache->stats_bytes_in ?
+                100.0 * cache->stats_bytes_out / cache->stats_bytes_in : 0.0,
+             cache->stats_compress_ns / 1000000.0);
+   mesa_logi("disk cache: %" PRIu64 " items read, %.3f ms decompressing",
+             cache->stats_items_read, cache->stats_decompress_ns / 1000000.0);
+}
+
 void
 disk_cache_destroy(struct disk_cache *cache)
 {
@@ -234,6 +263,11 @@ disk_cache_destroy(struct disk_cache *cache)
       util_queue_finish(&cache->cache_queue);
       util_queue_destroy(&cache->cache_queue);
 
+      if (cache->stats)
+         disk_cache_print_stats(cache);
+
+      disk_cache_destroy_dict(cache);
+
       if (env_var_as_boolean("MESA_DISK_CACHE_SINGLE_FILE", false))
          foz_destroy(&cache->foz_db);
 
@@ -295,6 +329,8 @@ create_put_job(struct disk_cache *cache, const cache_key key,
             memcpy(dc_job->cache_item_metadata.keys,
                    cache_item_metadata->keys,
                    sizeof(cache_key) * cache_item_metadata->num_keys);
+         } else {
+            dc_job->cache_item_metadata.keys = NULL;
          }
       } else {
          dc_job->cache_item_metadata.type = CACHE_ITEM_TYPE_UNKNOWN;
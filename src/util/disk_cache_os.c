@@ -35,10 +35,31 @@
 
 #include "util/compress.h"
 #include "util/crc32.h"
+#include "util/os_time.h"
+#include "util/u_atomic.h"
 
+/* Items smaller than this are always stored uncompressed, the overhead of
+ * the compressed format would eat most of the savings.
+ */
+#define CACHE_MIN_COMPRESS_SIZE 64
+
+/* Zstd dictionaries are trained from the first CACHE_DICT_MAX_SAMPLES items
+ * written without one, or fewer if their first CACHE_DICT_MAX_SAMPLE_SIZE
+ * bytes add up to CACHE_DICT_SAMPLES_SIZE.
+ */
+#define CACHE_DICT_SIZE (16 * 1024)
+#define CACHE_DICT_MAX_SAMPLES 128
+#define CACHE_DICT_MAX_SAMPLE_SIZE (8 * 1024)
+#define CACHE_DICT_SAMPLES_SIZE (512 * 1024)
+
+/* Cache items are stored uncompressed iff their stored size matches
+ * uncompressed_size.  dict_id is the id of the dictionary they were
+ * compressed with, or 0 if none was used.
+ */
 struct cache_entry_file_data {
    uint32_t crc32;
    uint32_t uncompressed_size;
+   uint32_t dict_id;
 };
 
 #if DETECT_OS_WINDOWS
@@ -62,6 +83,8 @@ struct cache_entry_file_data {
 #include "util/debug.h"
 #include "util/disk_cache.h"
 #include "util/disk_cache_os.h"
+#include "util/mesa-sha1.h"
+#include "util/os_file.h"
 #include "util/ralloc.h"
 #include "util/rand_xor.h"
 
@@ -358,21 +381,6 @@ make_cache_file_directory(struct disk_cache *cache, const cache_key key)
    free(dir);
 }
 
-static ssize_t
-read_all(int fd, void *buf, size_t count)
-{
-   char *in = buf;
-   ssize_t read_ret;
-   size_t done;
-
-   for (done = 0; done < count; done += read_ret) {
-      read_ret = read(fd, in + done, count - done);
-      if (read_ret == -1 || read_ret == 0)
-         return -1;
-   }
-   return done;
-}
-
 static ssize_t
 write_all(int fd, const void *buf, size_t count)
 {
@@ -454,9 +462,14 @@ disk_cache_evict_item(struct disk_cache *cache, char *filename)
       p_atomic_add(cache->size, - (uint64_t)sb.st_blocks * 512);
 }
 
+/* If metadata is non-NULL, it is filled with the item's metadata, with the
+ * keys pointing into cache_item.
+ */
 static void *
-parse_and_validate_cache_item(struct disk_cache *cache, void *cache_item,
-                              size_t cache_item_size, size_t *size)
+parse_and_validate_cache_item(struct disk_cache *cache,
+                              const void *cache_item, size_t cache_item_size,
+                              size_t *size,
+                              struct cache_item_metadata *metadata)
 {
    uint8_t *uncompressed_data = NULL;
 
@@ -486,13 +499,22 @@ parse_and_validate_cache_item(struct disk_cache *cache, void *cache_item,
       /* The cache item metadata is currently just used for distributing
        * precompiled shaders, they are not used by Mesa so just skip them for
        * now.
-       * TODO: pass the metadata back to the caller and do some basic
-       * validation.
+       * TODO: do some basic validation.
        */
-      const void UNUSED *metadata =
+      const void *keys =
          blob_read_bytes(&ci_blob_reader, num_keys * sizeof(cache_key));
       if (ci_blob_reader.overrun)
          goto fail;
+
+      if (metadata) {
+         metadata->type = md_type;
+         metadata->keys = (cache_key *)keys;
+         metadata->num_keys = num_keys;
+      }
+   } else if (metadata) {
+      metadata->type = md_type;
+      metadata->keys = NULL;
+      metadata->num_keys = 0;
    }
 
    /* Load the CRC that was created when the file was written. */
@@ -509,12 +531,36 @@ parse_and_validate_cache_item(struct disk_cache *cache, void *cache_item,
    if (cf_data->crc32 != util_hash_crc32(data, cache_data_size))
       goto fail;
 
+   /* Items compressed with a dictionary this instance doesn't have, e.g.
+    * because another instance trained it after this one was created, are
+    * treated as a miss.
+    */
+   const struct util_compress_dict *dict = NULL;
+   if (cf_data->dict_id) {
+      dict = p_atomic_read(&cache->dict);
+      if (!dict || util_compress_dict_id(dict) != cf_data->dict_id)
+         goto fail;
+   }
+
    /* Uncompress the cache data */
    uncompressed_data = malloc(cf_data->uncompressed_size);
-   if (!util_compress_inflate(data, cache_data_size, uncompressed_data,
-                              cf_data->uncompressed_size))
+   if (!uncompressed_data)
       goto fail;
 
+   int64_t start = cache->stats ? os_time_get_nano() : 0;
+
+   if (cache_data_size == cf_data->uncompressed_size) {
+      memcpy(uncompressed_data, data, cache_data_size);
+   } else if (!util_compress_inflate(data, cache_data_size, uncompressed_data,
+                                     cf_data->uncompressed_size, dict)) {
+      goto fail;
+   }
+
+   if (cache->stats) {
+      p_atomic_inc(&cache->stats_items_read);
+      p_atomic_add(&cache->stats_decompress_ns, os_time_get_nano() - start);
+   }
+
    if (size)
       *size = cf_data->uncompressed_size;
 
@@ -530,39 +576,38 @@ parse_and_validate_cache_item(struct disk_cache *cache, void *cache_item,
 void *
 disk_cache_load_item(struct disk_cache *cache, char *filename, size_t *size)
 {
-   uint8_t *data = NULL;
+   uint8_t *data = MAP_FAILED;
+   struct stat sb;
 
    int fd = open(filename, O_RDONLY | O_CLOEXEC);
    if (fd == -1)
       goto fail;
 
-   struct stat sb;
-   if (fstat(fd, &sb) == -1)
-      goto fail;
-
-   data = malloc(sb.st_size);
-   if (data == NULL)
+   if (fstat(fd, &sb) == -1 || sb.st_size == 0)
       goto fail;
 
-   /* Read entire file into memory */
-   int ret = read_all(fd, data, sb.st_size);
-   if (ret == -1)
+   /* Cache items are written to a temporary file and renamed into place, so
+    * the file never changes under us and can be parsed straight from the
+    * page cache instead of being copied into a buffer first.
+    */
+   data = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   if (data == MAP_FAILED)
       goto fail;
 
-    uint8_t *uncompressed_data =
-       parse_and_validate_cache_item(cache, data, sb.st_size, size);
+   uint8_t *uncompressed_data =
+      parse_and_validate_cache_item(cache, data, sb.st_size, size, NULL);
    if (!uncompressed_data)
       goto fail;
 
-   free(data);
+   munmap(data, sb.st_size);
    free(filename);
    close(fd);
 
    return uncompressed_data;
 
  fail:
-   if (data)
-      free(data);
+   if (data != MAP_FAILED)
+      munmap(data, sb.st_size);
    if (filename)
       free(filename);
    if (fd != -1)
@@ -592,22 +637,167 @@ disk_cache_get_cache_filename(struct disk_cache *cache, const cache_key key)
    return filename;
 }
 
+static struct util_compress_dict *
+load_dict(struct disk_cache *cache)
+{
+   size_t size;
+   char *data = os_read_file(cache->dict_filename, &size);
+   if (!data)
+      return NULL;
+
+   struct util_compress_dict *dict =
+      util_compress_dict_create((uint8_t *)data, size,
+                                cache->compression_level);
+   free(data);
+   return dict;
+}
+
+/* Trains a dictionary from the gathered samples and makes it the dictionary
+ * of every instance using the same cache directory and driver.  Called with
+ * dict_lock held.
+ */
+static void
+train_dict(struct disk_cache *cache)
+{
+   struct util_compress_dict *dict = NULL;
+   char *filename_tmp = NULL;
+
+   uint8_t *dict_data = malloc(CACHE_DICT_SIZE);
+   if (!dict_data)
+      return;
+
+   size_t dict_size =
+      util_compress_dict_train(dict_data, CACHE_DICT_SIZE,
+                               cache->dict_samples, cache->dict_sample_sizes,
+                               cache->dict_num_samples);
+   if (dict_size == 0)
+      goto done;
+
+   if (asprintf(&filename_tmp, "%s.%u.tmp", cache->dict_filename,
+                (unsigned)getpid()) == -1) {
+      filename_tmp = NULL;
+      goto done;
+   }
+
+   int fd = open(filename_tmp, O_WRONLY | O_CLOEXEC | O_CREAT | O_EXCL, 0644);
+   if (fd == -1)
+      goto done;
+
+   int ret = write_all(fd, dict_data, dict_size);
+   close(fd);
+
+   /* Unlike rename(), link() doesn't replace a dictionary another instance
+    * has published in the meantime, use that one instead so all instances
+    * agree on it.
+    */
+   if (ret != -1 && link(filename_tmp, cache->dict_filename) == 0)
+      dict = util_compress_dict_create(dict_data, dict_size,
+                                       cache->compression_level);
+   else if (ret != -1 && errno == EEXIST)
+      dict = load_dict(cache);
+
+   unlink(filename_tmp);
+
+   if (dict)
+      p_atomic_set(&cache->dict, dict);
+
+ done:
+   free(filename_tmp);
+   free(dict_data);
+}
+
+static void
+add_dict_sample(struct disk_cache *cache, const void *data, size_t size)
+{
+   if (!p_atomic_read(&cache->dict_training))
+      return;
+
+   simple_mtx_lock(&cache->dict_lock);
+
+   if (!cache->dict_training)
+      goto unlock;
+
+   if (!cache->dict_samples) {
+      cache->dict_samples = malloc(CACHE_DICT_SAMPLES_SIZE);
+      cache->dict_sample_sizes =
+         malloc(CACHE_DICT_MAX_SAMPLES * sizeof(*cache->dict_sample_sizes));
+      if (!cache->dict_samples || !cache->dict_sample_sizes)
+         goto stop;
+   }
+
+   size = MIN3(size, CACHE_DICT_MAX_SAMPLE_SIZE,
+               CACHE_DICT_SAMPLES_SIZE - cache->dict_samples_size);
+   memcpy(cache->dict_samples + cache->dict_samples_size, data, size);
+   cache->dict_samples_size += size;
+   cache->dict_sample_sizes[cache->dict_num_samples++] = size;
+
+   if (cache->dict_num_samples < CACHE_DICT_MAX_SAMPLES &&
+       cache->dict_samples_size < CACHE_DICT_SAMPLES_SIZE)
+      goto unlock;
+
+   /* Only try once, items keep being compressed without a dictionary if
+    * training fails.
+    */
+   train_dict(cache);
+
+ stop:
+   p_atomic_set(&cache->dict_training, false);
+   free(cache->dict_samples);
+   free(cache->dict_sample_sizes);
+   cache->dict_samples = NULL;
+   cache->dict_sample_sizes = NULL;
+
+ unlock:
+   simple_mtx_unlock(&cache->dict_lock);
+}
+
 static bool
 create_cache_item_header_and_blob(struct disk_cache_put_job *dc_job,
                                   struct blob *cache_blob)
 {
 
+   struct disk_cache *cache = dc_job->cache;
+   const struct util_compress_dict *dict = p_atomic_read(&cache->dict);
+   void *compressed_data = NULL;
+   size_t compressed_size = 0;
+   int64_t start = cache->stats ? os_time_get_nano() : 0;
+
    /* Compress the cache item data */
-   size_t max_buf = util_compress_max_compressed_len(dc_job->size);
-   void *compressed_data = malloc(max_buf);
-   if (compressed_data == NULL)
-      return false;
+   if (cache->compression_level != 0 &&
+       dc_job->size >= CACHE_MIN_COMPRESS_SIZE) {
+      size_t max_buf = util_compress_max_compressed_len(dc_job->size);
+      compressed_data = malloc(max_buf);
+      if (compressed_data == NULL)
+         return false;
+
+      compressed_size =
+         util_compress_deflate(dc_job->data, dc_job->size,
+                               compressed_data, max_buf,
+                               cache->compression_level, dict);
+   }
 
-   size_t compressed_size =
-      util_compress_deflate(dc_job->data, dc_job->size,
-                            compressed_data, max_buf);
-   if (compressed_size == 0)
-      goto fail;
+   /* Keep the item uncompressed if compression failed or didn't make it
+    * smaller.
+    */
+   const void *item_data = compressed_data;
+   if (compressed_size == 0 || compressed_size >= dc_job->size) {
+      item_data = dc_job->data;
+      compressed_size = dc_job->size;
+   }
+
+   if (cache->stats) {
+      p_atomic_inc(&cache->stats_items_written);
+      if (item_data == dc_job->data)
+         p_atomic_inc(&cache->stats_items_uncompressed);
+      else if (dict)
+         p_atomic_inc(&cache->stats_items_dict);
+      p_atomic_add(&cache->stats_bytes_in, dc_job->size);
+      p_atomic_add(&cache->stats_bytes_out, compressed_size);
+      p_atomic_add(&cache->stats_compress_ns, os_time_get_nano() - start);
+   }
+
+   if (!dict && compressed_data)
+      add_dict_sample(cache, dc_job->data, dc_job->size);
 
    /* Copy the driver_keys_blob, this can be used find information about the
     * mesa version that produced the entry or deal with hash collisions,
@@ -639,14 +829,16 @@ create_cache_item_header_and_blob(struct disk_cache_put_job *dc_job,
     * cache and use it to check for corruption.
     */
    struct cache_entry_file_data cf_data;
-   cf_data.crc32 = util_hash_crc32(compressed_data, compressed_size);
+   cf_data.crc32 = util_hash_crc32(item_data, compressed_size);
    cf_data.uncompressed_size = dc_job->size;
+   cf_data.dict_id = item_data == compressed_data && dict ?
+                     util_compress_dict_id(dict) : 0;
 
    if (!blob_write_bytes(cache_blob, &cf_data, sizeof(cf_data)))
       goto fail;
 
    /* Finally copy the compressed cache blob */
-   if (!blob_write_bytes(cache_blob, compressed_data, compressed_size))
+   if (!blob_write_bytes(cache_blob, item_data, compressed_size))
       goto fail;
 
    free(compressed_data);
@@ -873,13 +1065,31 @@ disk_cache_load_item_foz(struct disk_cache *cache, const cache_key key,
                          size_t *size)
 {
    size_t cache_tem_size = 0;
-   void *cache_item = foz_read_entry(&cache->foz_db, key, &cache_tem_size);
+   bool from_prev_gen;
+   const void *cache_item = foz_read_entry(&cache->foz_db, key,
+                                           &cache_tem_size, &from_prev_gen);
    if (!cache_item)
       return NULL;
 
+   size_t uncompressed_size;
+   struct cache_item_metadata metadata;
    uint8_t *uncompressed_data =
-       parse_and_validate_cache_item(cache, cache_item, cache_tem_size, size);
-   free(cache_item);
+       parse_and_validate_cache_item(cache, cache_item, cache_tem_size,
+                                     &uncompressed_size, &metadata);
+
+   /* Copy items that are still in use forward before the generation they
+    * live in gets evicted.  disk_cache_put() copies the metadata keys, which
+    * point into cache_item.
+    */
+   if (uncompressed_data && from_prev_gen) {
+      disk_cache_put(cache, key, uncompressed_data, uncompressed_size,
+                     &metadata);
+   }
+
+   foz_release_entry(&cache->foz_db, cache_item);
+
+   if (uncompressed_data && size)
+      *size = uncompressed_size;
 
    return uncompressed_data;
 }
@@ -904,7 +1114,7 @@ bool
 disk_cache_load_cache_index(void *mem_ctx, struct disk_cache *cache)
 {
    /* Load cache index into a hash map (from fossilise files) */
-   return foz_prepare(&cache->foz_db, cache->path);
+   return foz_prepare(&cache->foz_db, cache->path, cache->max_size);
 }
 
 bool
@@ -970,6 +1180,44 @@ disk_cache_destroy_mmap(struct disk_cache *cache)
 {
    munmap(cache->index_mmap, cache->index_mmap_size);
 }
+
+void
+disk_cache_init_dict(struct disk_cache *cache)
+{
+   simple_mtx_init(&cache->dict_lock, mtx_plain);
+
+#ifdef HAVE_ZSTD
+   if (cache->compression_level == 0 ||
+       !env_var_as_boolean("MESA_DISK_CACHE_COMPRESSION_DICT", true))
+      return;
+
+   /* Items of different drivers have little in common, give each one its
+    * own dictionary.
+    */
+   uint8_t sha1[20];
+   char buf[41];
+   _mesa_sha1_compute(cache->driver_keys_blob, cache->driver_keys_blob_size,
+                      sha1);
+   _mesa_sha1_format(buf, sha1);
+
+   cache->dict_filename = ralloc_asprintf(cache, "%s/dict_%s", cache->path,
+                                          buf);
+   if (!cache->dict_filename)
+      return;
+
+   cache->dict = load_dict(cache);
+   cache->dict_training = !cache->dict;
+#endif
+}
+
+void
+disk_cache_destroy_dict(struct disk_cache *cache)
+{
+   util_compress_dict_destroy(cache->dict);
+   free(cache->dict_samples);
+   free(cache->dict_sample_sizes);
+   simple_mtx_destroy(&cache->dict_lock);
+}
 #endif
 
 #endif /* ENABLE_SHADER_CACHE */
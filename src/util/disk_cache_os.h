@@ -33,6 +33,7 @@
 #else
 
 #include "util/fossilize_db.h"
+#include "util/simple_mtx.h"
 
 /* Number of bits to mask off from a cache key to get an index. */
 #define CACHE_INDEX_KEY_BITS 16
@@ -69,6 +70,37 @@ struct disk_cache {
    /* Maximum size of all cached objects (in bytes). */
    uint64_t max_size;
 
+   /* Compression level of cache items, 0 stores them uncompressed. */
+   int compression_level;
+
+   /* Compression statistics, only gathered with MESA_DISK_CACHE_STATS. */
+   bool stats;
+   uint64_t stats_items_written;
+   uint64_t stats_items_uncompressed;
+   uint64_t stats_bytes_in;
+   uint64_t stats_bytes_out;
+   uint64_t stats_compress_ns;
+   uint64_t stats_items_dict;
+   uint64_t stats_items_read;
+   uint64_t stats_decompress_ns;
+
+   /* Compression dictionary shared by all instances using this cache
+    * directory and driver, NULL until it has been loaded or trained.  Once
+    * set it is never changed.
+    */
+   struct util_compress_dict *dict;
+   char *dict_filename;
+
+   /* Samples of the items written before there is a dictionary, the
+    * dictionary is trained from them once enough have been gathered.
+    */
+   simple_mtx_t dict_lock;
+   bool dict_training;
+   uint8_t *dict_samples;
+   size_t dict_samples_size;
+   size_t *dict_sample_sizes;
+   unsigned dict_num_samples;
+
    /* Driver cache keys. */
    uint8_t *driver_keys_blob;
    size_t driver_keys_blob_size;
@@ -133,6 +165,12 @@ disk_cache_mmap_cache_index(void *mem_ctx, struct disk_cache *cache,
 void
 disk_cache_destroy_mmap(struct disk_cache *cache);
 
+void
+disk_cache_init_dict(struct disk_cache *cache);
+
+void
+disk_cache_destroy_dict(struct disk_cache *cache);
+
 #endif
 
 #endif /* DISK_CACHE_OS_H */
@@ -37,6 +37,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -44,6 +46,7 @@
 #include "hash_table.h"
 #include "mesa-sha1.h"
 #include "ralloc.h"
+#include "u_math.h"
 
 #define FOZ_REF_MAGIC_SIZE 16
 
@@ -71,6 +74,97 @@ truncate_hash_to_64bits(const uint8_t *cache_key)
    return hash;
 }
 
+/* A read-only mapping of a foz db.  foz_read_entry() returns pointers into
+ * it, so once it has been replaced it is only unmapped when the last of them
+ * has been released.
+ */
+struct foz_map {
+   uint8_t *ptr;
+   size_t size;              /* Size of the mapping */
+   uint64_t file_size;       /* Size of the file when last checked */
+   unsigned refcount;        /* Number of entries returned but not released */
+   struct foz_map *next;     /* Next retired mapping */
+};
+
+/* Foz dbs are mapped with room to grow, with this as the minimum size. */
+#define FOZ_MIN_MAP_SIZE (1024 * 1024)
+
+static void
+foz_free_map(struct foz_map *map)
+{
+   munmap(map->ptr, map->size);
+   free(map);
+}
+
+static void
+foz_unmap(struct foz_db *foz_db, unsigned file_idx)
+{
+   struct foz_map *map = foz_db->map[file_idx];
+   if (!map)
+      return;
+
+   foz_db->map[file_idx] = NULL;
+   if (map->refcount == 0) {
+      foz_free_map(map);
+   } else {
+      map->next = foz_db->retired_maps;
+      foz_db->retired_maps = map;
+   }
+}
+
+/* Returns a mapping of a foz db covering at least its first end bytes, so
+ * that cache hits are served without seeking and reading through stdio.
+ * Foz dbs are append only, so the mapping extends past the end of the file
+ * and only needs to be replaced once it has grown past that.  Must be called
+ * with the mutex held.  Returns NULL if the range can't be mapped.
+ */
+static struct foz_map *
+foz_map_range(struct foz_db *foz_db, unsigned file_idx, uint64_t end)
+{
+   struct foz_map *map = foz_db->map[file_idx];
+   if (map && end <= map->file_size)
+      return map;
+
+   struct stat st;
+   int fd = fileno(foz_db->file[file_idx]);
+   if (fstat(fd, &st) != 0 || end > (uint64_t)st.st_size)
+      return NULL;
+
+   if (map && (uint64_t)st.st_size <= map->size) {
+      map->file_size = st.st_size;
+      return map;
+   }
+
+   uint64_t size = MAX2(util_next_power_of_two64(st.st_size),
+                        FOZ_MIN_MAP_SIZE);
+   void *ptr = size <= SIZE_MAX ?
+      mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+   if (ptr == MAP_FAILED) {
+      /* Retry without room to grow in case we ran out of address space. */
+      size = st.st_size;
+      if (size > SIZE_MAX)
+         return NULL;
+
+      ptr = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+      if (ptr == MAP_FAILED)
+         return NULL;
+   }
+
+   struct foz_map *new_map = calloc(1, sizeof(*new_map));
+   if (!new_map) {
+      munmap(ptr, size);
+      return NULL;
+   }
+
+   new_map->ptr = ptr;
+   new_map->size = size;
+   new_map->file_size = st.st_size;
+
+   foz_unmap(foz_db, file_idx);
+   foz_db->map[file_idx] = new_map;
+   return new_map;
+}
+
 static bool
 check_files_opened_successfully(FILE *file, FILE *db_idx)
 {
@@ -177,6 +271,279 @@ update_foz_index(struct foz_db *foz_db, FILE *db_idx, unsigned file_idx)
    fseek(db_idx, parsed_offset, SEEK_SET);
 }
 
+/* Size of an idx record: hash, payload header and offset of the entry. */
+#define FOZ_IDX_RECORD_SIZE \
+   (FOSSILIZE_BLOB_HASH_LENGTH + sizeof(struct foz_payload_header) + \
+    sizeof(uint64_t))
+
+/* The sorted idx is rewritten once the entries appended to the idx after it
+ * are at least this many, and at least an eighth of the sorted ones.
+ */
+#define FOZ_SORTED_IDX_MIN_UPDATE 64
+
+#define FOZ_SORTED_IDX_VERSION 1
+
+static const uint8_t sorted_idx_magic[8] = {
+   0x81, 'F', 'O', 'Z', 'S', 'O', 'R', 'T',
+};
+
+/* A sorted idx is this header followed by the entries, sorted by key.  It
+ * covers the first idx_size bytes of the idx, and is only used if the last
+ * record of those matches, as the idx may have been replaced since.
+ */
+struct foz_sorted_idx_header {
+   uint8_t magic[8];
+   uint32_t version;
+   uint32_t num_entries;
+   uint64_t idx_size;
+   uint8_t last_record[FOZ_IDX_RECORD_SIZE];
+};
+
+static void
+foz_unmap_sorted_idx(struct foz_db *foz_db, unsigned file_idx)
+{
+   if (foz_db->sorted_idx[file_idx]) {
+      munmap((uint8_t *)foz_db->sorted_idx[file_idx] -
+             sizeof(struct foz_sorted_idx_header),
+             foz_db->sorted_idx_map_size[file_idx]);
+      foz_db->sorted_idx[file_idx] = NULL;
+      foz_db->sorted_idx_count[file_idx] = 0;
+      foz_db->sorted_idx_map_size[file_idx] = 0;
+   }
+}
+
+/* Maps the sorted idx at filename if it matches db_idx.  Returns its header,
+ * or NULL if there is no such sorted idx.
+ */
+static const struct foz_sorted_idx_header *
+map_sorted_idx(const char *filename, FILE *db_idx, size_t *map_size)
+{
+   int fd = open(filename, O_RDONLY | O_CLOEXEC);
+   if (fd == -1)
+      return NULL;
+
+   struct stat st;
+   void *map = MAP_FAILED;
+   if (fstat(fd, &st) == 0 &&
+       st.st_size >= sizeof(struct foz_sorted_idx_header) &&
+       (uint64_t)st.st_size <= SIZE_MAX)
+      map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+   close(fd);
+
+   if (map == MAP_FAILED)
+      return NULL;
+
+   const struct foz_sorted_idx_header *header = map;
+   uint8_t last_record[FOZ_IDX_RECORD_SIZE];
+
+   if (memcmp(header->magic, sorted_idx_magic, sizeof(sorted_idx_magic)) ||
+       header->version != FOZ_SORTED_IDX_VERSION ||
+       st.st_size != sizeof(*header) + (uint64_t)header->num_entries *
+                     sizeof(struct foz_sorted_idx_entry) ||
+       header->idx_size < FOZ_REF_MAGIC_SIZE + FOZ_IDX_RECORD_SIZE ||
+       pread(fileno(db_idx), last_record, sizeof(last_record),
+             header->idx_size - sizeof(last_record)) != sizeof(last_record) ||
+       memcmp(last_record, header->last_record, sizeof(last_record))) {
+      munmap(map, st.st_size);
+      return NULL;
+   }
+
+   *map_size = st.st_size;
+   return header;
+}
+
+/* Loads the sorted idx of a foz db, if it has one, and moves the idx file
+ * position past the records it covers, so that only the records appended
+ * since are parsed into the hash table.
+ */
+static void
+load_sorted_idx(struct foz_db *foz_db, FILE *db_idx, unsigned file_idx,
+                const char *filename)
+{
+   size_t map_size;
+   const struct foz_sorted_idx_header *header =
+      map_sorted_idx(filename, db_idx, &map_size);
+   if (!header)
+      return;
+
+   foz_db->sorted_idx[file_idx] = (const void *)(header + 1);
+   foz_db->sorted_idx_count[file_idx] = header->num_entries;
+   foz_db->sorted_idx_map_size[file_idx] = map_size;
+   fseek(db_idx, header->idx_size, SEEK_SET);
+}
+
+static int
+cmp_sorted_idx_entry(const void *a, const void *b)
+{
+   /* The key is the first member of the entries. */
+   return memcmp(a, b, sizeof(((struct foz_sorted_idx_entry *)0)->key));
+}
+
+static const struct foz_sorted_idx_entry *
+search_sorted_idx(struct foz_db *foz_db, unsigned file_idx,
+                  const uint8_t *cache_key_160bit)
+{
+   if (!foz_db->sorted_idx[file_idx])
+      return NULL;
+
+   return bsearch(cache_key_160bit, foz_db->sorted_idx[file_idx],
+                  foz_db->sorted_idx_count[file_idx],
+                  sizeof(struct foz_sorted_idx_entry), cmp_sorted_idx_entry);
+}
+
+/* Once enough records have been appended to the idx of a foz db since its
+ * sorted idx was written, writes a new one also covering the entries parsed
+ * from them and drops those from the hash table.  Must be called right after
+ * update_foz_index().
+ */
+static void
+update_sorted_idx(struct foz_db *foz_db, FILE *db_idx, unsigned file_idx,
+                  const char *filename)
+{
+   uint32_t num_sorted = foz_db->sorted_idx_count[file_idx];
+   uint32_t num_parsed = 0;
+   hash_table_foreach(foz_db->index_db->table, he) {
+      struct foz_db_entry *entry = he->data;
+      if (entry->file_idx == file_idx)
+         num_parsed++;
+   }
+
+   if (num_parsed < MAX2(FOZ_SORTED_IDX_MIN_UPDATE, num_sorted / 8))
+      return;
+
+   struct foz_sorted_idx_header header;
+   memcpy(header.magic, sorted_idx_magic, sizeof(sorted_idx_magic));
+   header.version = FOZ_SORTED_IDX_VERSION;
+   header.idx_size = ftell(db_idx);
+   if (pread(fileno(db_idx), header.last_record, sizeof(header.last_record),
+             header.idx_size - sizeof(header.last_record)) !=
+       sizeof(header.last_record))
+      return;
+
+   struct foz_sorted_idx_entry *entries =
+      malloc((num_sorted + num_parsed) * sizeof(*entries));
+   if (!entries)
+      return;
+
+   if (num_sorted) {
+      memcpy(entries, foz_db->sorted_idx[file_idx],
+             num_sorted * sizeof(*entries));
+   }
+
+   uint32_t num_entries = num_sorted;
+   hash_table_foreach(foz_db->index_db->table, he) {
+      struct foz_db_entry *entry = he->data;
+      if (entry->file_idx == file_idx) {
+         memcpy(entries[num_entries].key, entry->key, sizeof(entry->key));
+         entries[num_entries].pad = 0;
+         entries[num_entries].offset = entry->offset;
+         num_entries++;
+      }
+   }
+
+   qsort(entries, num_entries, sizeof(*entries), cmp_sorted_idx_entry);
+
+   /* Processes racing to write the same entry may both have appended it. */
+   uint32_t num_unique = 0;
+   for (uint32_t i = 0; i < num_entries; i++) {
+      if (num_unique == 0 ||
+          cmp_sorted_idx_entry(&entries[i], &entries[num_unique - 1]) != 0)
+         entries[num_unique++] = entries[i];
+   }
+   header.num_entries = num_unique;
+
+   /* Write to a temporary file and rename it, so that other processes never
+    * map a partially written sorted idx.
+    */
+   char *filename_tmp = NULL;
+   if (asprintf(&filename_tmp, "%s.%u.tmp", filename,
+                (unsigned)getpid()) == -1) {
+      free(entries);
+      return;
+   }
+
+   bool written = false;
+   FILE *file = fopen(filename_tmp, "wb");
+   if (file) {
+      written =
+         fwrite(&header, 1, sizeof(header), file) == sizeof(header) &&
+         fwrite(entries, sizeof(*entries), num_unique, file) == num_unique;
+      written = fclose(file) == 0 && written;
+   }
+   if (!written || rename(filename_tmp, filename) != 0)
+      unlink(filename_tmp);
+
+   free(filename_tmp);
+   free(entries);
+
+   if (!written)
+      return;
+
+   /* Another process may have replaced it in the meantime, only use it if
+    * it covers all the entries we parsed.
+    */
+   size_t map_size;
+   const struct foz_sorted_idx_header *new_header =
+      map_sorted_idx(filename, db_idx, &map_size);
+   if (!new_header)
+      return;
+
+   if (new_header->idx_size < header.idx_size) {
+      munmap((void *)new_header, map_size);
+      return;
+   }
+
+   foz_unmap_sorted_idx(foz_db, file_idx);
+   foz_db->sorted_idx[file_idx] = (const void *)(new_header + 1);
+   foz_db->sorted_idx_count[file_idx] = new_header->num_entries;
+   foz_db->sorted_idx_map_size[file_idx] = map_size;
+   fseek(db_idx, new_header->idx_size, SEEK_SET);
+
+   hash_table_foreach(foz_db->index_db->table, he) {
+      struct foz_db_entry *entry = he->data;
+      if (entry->file_idx == file_idx) {
+         _mesa_hash_table_remove(foz_db->index_db->table, he);
+         ralloc_free(entry);
+      }
+   }
+}
+
+/* Looks up an entry in the hash table and the sorted idxs, the current
+ * generation of the default foz db first.  Returns false if there is none.
+ */
+static bool
+foz_lookup(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
+           uint8_t *file_idx, uint64_t *offset)
+{
+   struct foz_db_entry *entry =
+      _mesa_hash_table_u64_search(foz_db->index_db,
+                                  truncate_hash_to_64bits(cache_key_160bit));
+
+   /* Check for collision using full 160bit hash for increased assurance
+    * against potential collisions.
+    */
+   if (entry && memcmp(entry->key, cache_key_160bit, sizeof(entry->key)))
+      entry = NULL;
+
+   for (unsigned i = 0; i < FOZ_MAX_DBS; i++) {
+      if (entry && entry->file_idx == i) {
+         *file_idx = i;
+         *offset = entry->offset;
+         return true;
+      }
+
+      const struct foz_sorted_idx_entry *sorted_entry =
+         search_sorted_idx(foz_db, i, cache_key_160bit);
+      if (sorted_entry) {
+         *file_idx = i;
+         *offset = sorted_entry->offset;
+         return true;
+      }
+   }
+
+   return false;
+}
+
 /* exclusive flock with timeout. timeout is in nanoseconds */
 static int lock_file_with_timeout(FILE *f, int64_t timeout)
 {
@@ -195,11 +562,12 @@ static int lock_file_with_timeout(FILE *f, int64_t timeout)
    return err;
 }
 
+/* Checks the magic of a foz db and its idx, writing it out first if the files
+ * are new.
+ */
 static bool
-load_foz_dbs(struct foz_db *foz_db, FILE *db_idx, uint8_t file_idx,
-             bool read_only)
+prepare_foz_db_files(struct foz_db *foz_db, FILE *db_idx, uint8_t file_idx)
 {
-   /* Scan through the archive and get the list of cache entries. */
    fseek(db_idx, 0, SEEK_END);
    size_t len = ftell(db_idx);
    rewind(db_idx);
@@ -249,16 +617,134 @@ load_foz_dbs(struct foz_db *foz_db, FILE *db_idx, uint8_t file_idx,
    }
 
    flock(fileno(foz_db->file[file_idx]), LOCK_UN);
+   return true;
+
+fail:
+   flock(fileno(foz_db->file[file_idx]), LOCK_UN);
+   return false;
+}
 
+static bool
+load_foz_dbs(struct foz_db *foz_db, FILE *db_idx, uint8_t file_idx,
+             const char *sorted_idx_filename)
+{
+   /* Scan through the archive and get the list of cache entries. */
+   if (!prepare_foz_db_files(foz_db, db_idx, file_idx)) {
+      foz_destroy(foz_db);
+      return false;
+   }
+
+   load_sorted_idx(foz_db, db_idx, file_idx, sorted_idx_filename);
    update_foz_index(foz_db, db_idx, file_idx);
+   update_sorted_idx(foz_db, db_idx, file_idx, sorted_idx_filename);
 
    foz_db->alive = true;
    return true;
+}
 
-fail:
-   flock(fileno(foz_db->file[file_idx]), LOCK_UN);
-   foz_destroy(foz_db);
-   return false;
+/* Returns whether another process started a new generation of the default
+ * foz db since we opened it.
+ */
+static bool
+foz_generation_changed(struct foz_db *foz_db)
+{
+   struct stat file_stat, path_stat;
+
+   if (fstat(fileno(foz_db->file[0]), &file_stat) != 0)
+      return false;
+
+   if (stat(foz_db->filename, &path_stat) != 0)
+      return true;
+
+   return file_stat.st_dev != path_stat.st_dev ||
+          file_stat.st_ino != path_stat.st_ino;
+}
+
+/* Switches to a new generation of the default foz db: entries of the
+ * previous generation are evicted and the current one becomes the previous
+ * one.  Must be called with the mutexes held but without the file lock.
+ */
+static bool
+foz_next_generation(struct foz_db *foz_db)
+{
+   FILE *file = fopen(foz_db->filename, "a+b");
+   FILE *db_idx = fopen(foz_db->idx_filename, "a+b");
+   if (!check_files_opened_successfully(file, db_idx))
+      return false;
+
+   hash_table_foreach(foz_db->index_db->table, he) {
+      struct foz_db_entry *entry = he->data;
+
+      if (entry->file_idx == FOZ_PREV_GEN_IDX) {
+         _mesa_hash_table_u64_remove(foz_db->index_db,
+                                     truncate_hash_to_64bits(entry->key));
+         ralloc_free(entry);
+      } else if (entry->file_idx == 0) {
+         entry->file_idx = FOZ_PREV_GEN_IDX;
+      }
+   }
+
+   /* The retired files stay readable through our descriptors even after
+    * another rotation replaces them on disk.
+    */
+   foz_unmap(foz_db, FOZ_PREV_GEN_IDX);
+   if (foz_db->file[FOZ_PREV_GEN_IDX])
+      fclose(foz_db->file[FOZ_PREV_GEN_IDX]);
+   foz_db->file[FOZ_PREV_GEN_IDX] = foz_db->file[0];
+   foz_db->map[FOZ_PREV_GEN_IDX] = foz_db->map[0];
+   foz_db->map[0] = NULL;
+   fclose(foz_db->db_idx);
+
+   foz_unmap_sorted_idx(foz_db, FOZ_PREV_GEN_IDX);
+   foz_db->sorted_idx[FOZ_PREV_GEN_IDX] = foz_db->sorted_idx[0];
+   foz_db->sorted_idx_count[FOZ_PREV_GEN_IDX] = foz_db->sorted_idx_count[0];
+   foz_db->sorted_idx_map_size[FOZ_PREV_GEN_IDX] =
+      foz_db->sorted_idx_map_size[0];
+   foz_db->sorted_idx[0] = NULL;
+   foz_db->sorted_idx_count[0] = 0;
+   foz_db->sorted_idx_map_size[0] = 0;
+
+   foz_db->file[0] = file;
+   foz_db->db_idx = db_idx;
+
+   if (!prepare_foz_db_files(foz_db, db_idx, 0)) {
+      foz_db->alive = false;
+      return false;
+   }
+
+   update_foz_index(foz_db, db_idx, 0);
+   return true;
+}
+
+/* Retires the current generation of the default foz db.  Must be called with
+ * the mutexes and the file lock held, the latter is released.
+ */
+static bool
+foz_rotate(struct foz_db *foz_db)
+{
+   /* The old previous index would describe whatever data file the rename
+    * below replaces, so drop it first.  The data file goes before its index
+    * and is moved back if the index can't follow, so that a foz/idx pair
+    * never ends up split between two generations.  The sorted index is only
+    * used if it matches its idx, so it may fail to follow.
+    */
+   unlink(foz_db->prev_idx_filename);
+   unlink(foz_db->prev_sorted_idx_filename);
+
+   bool renamed = false;
+   if (rename(foz_db->filename, foz_db->prev_filename) == 0) {
+      renamed = rename(foz_db->idx_filename, foz_db->prev_idx_filename) == 0;
+      if (renamed) {
+         rename(foz_db->sorted_idx_filename,
+                foz_db->prev_sorted_idx_filename);
+      } else {
+         rename(foz_db->prev_filename, foz_db->filename);
+      }
+   }
+
+   flock(fileno(foz_db->file[0]), LOCK_UN);
+
+   return renamed && foz_next_generation(foz_db);
 }
 
 /* Here we open mesa cache foz dbs files. If the files exist we load the index
@@ -266,34 +752,78 @@ fail:
  * read cache entries from the foz db containing the actual cache entries.
  */
 bool
-foz_prepare(struct foz_db *foz_db, char *cache_path)
+foz_prepare(struct foz_db *foz_db, char *cache_path, uint64_t max_size)
 {
    char *filename = NULL;
    char *idx_filename = NULL;
    if (!create_foz_db_filenames(cache_path, "foz_cache", &filename, &idx_filename))
       return false;
 
+   char *prev_filename = NULL;
+   char *prev_idx_filename = NULL;
+   if (!create_foz_db_filenames(cache_path, "foz_cache_prev", &prev_filename,
+                                &prev_idx_filename)) {
+      free(filename);
+      free(idx_filename);
+      return false;
+   }
+
    /* Open the default foz dbs for read/write. If the files didn't already exist
     * create them.
     */
    foz_db->file[0] = fopen(filename, "a+b");
    foz_db->db_idx = fopen(idx_filename, "a+b");
 
-   free(filename);
-   free(idx_filename);
-
-   if (!check_files_opened_successfully(foz_db->file[0], foz_db->db_idx))
+   if (!check_files_opened_successfully(foz_db->file[0], foz_db->db_idx)) {
+      free(filename);
+      free(idx_filename);
+      free(prev_filename);
+      free(prev_idx_filename);
       return false;
+   }
 
    simple_mtx_init(&foz_db->mtx, mtx_plain);
    simple_mtx_init(&foz_db->flock_mtx, mtx_plain);
    foz_db->mem_ctx = ralloc_context(NULL);
    foz_db->index_db = _mesa_hash_table_u64_create(NULL);
+   foz_db->max_size = max_size;
+   foz_db->filename = ralloc_strdup(foz_db->mem_ctx, filename);
+   foz_db->idx_filename = ralloc_strdup(foz_db->mem_ctx, idx_filename);
+   foz_db->prev_filename = ralloc_strdup(foz_db->mem_ctx, prev_filename);
+   foz_db->prev_idx_filename =
+      ralloc_strdup(foz_db->mem_ctx, prev_idx_filename);
+   foz_db->sorted_idx_filename =
+      ralloc_asprintf(foz_db->mem_ctx, "%s.sorted", idx_filename);
+   foz_db->prev_sorted_idx_filename =
+      ralloc_asprintf(foz_db->mem_ctx, "%s.sorted", prev_idx_filename);
 
-   if (!load_foz_dbs(foz_db, foz_db->db_idx, 0, false))
+   free(filename);
+   free(idx_filename);
+   free(prev_filename);
+   free(prev_idx_filename);
+
+   if (!load_foz_dbs(foz_db, foz_db->db_idx, 0, foz_db->sorted_idx_filename))
       return false;
 
-   uint8_t file_idx = 1;
+   /* Load the previous generation of a size-bounded cache, if there is one. */
+   if (max_size) {
+      FILE *prev_file = fopen(foz_db->prev_filename, "rb");
+      FILE *db_idx = fopen(foz_db->prev_idx_filename, "rb");
+
+      if (check_files_opened_successfully(prev_file, db_idx)) {
+         foz_db->file[FOZ_PREV_GEN_IDX] = prev_file;
+
+         if (!load_foz_dbs(foz_db, db_idx, FOZ_PREV_GEN_IDX,
+                           foz_db->prev_sorted_idx_filename)) {
+            fclose(db_idx);
+            return false;
+         }
+
+         fclose(db_idx);
+      }
+   }
+
+   uint8_t file_idx = FOZ_PREV_GEN_IDX + 1;
    char *foz_dbs = getenv("MESA_DISK_CACHE_READ_ONLY_FOZ_DBS");
    if (!foz_dbs)
       return true;
@@ -314,18 +844,24 @@ foz_prepare(struct foz_db *foz_db, char *cache_path)
       /* Open files as read only */
       foz_db->file[file_idx] = fopen(filename, "rb");
       FILE *db_idx = fopen(idx_filename, "rb");
+      char *sorted_idx_filename =
+         ralloc_asprintf(NULL, "%s.sorted", idx_filename);
 
       free(filename);
       free(idx_filename);
 
-      if (!check_files_opened_successfully(foz_db->file[file_idx], db_idx))
+      if (!check_files_opened_successfully(foz_db->file[file_idx], db_idx)) {
+         ralloc_free(sorted_idx_filename);
          continue; /* Ignore invalid user provided filename and continue */
+      }
 
-      if (!load_foz_dbs(foz_db, db_idx, file_idx, true)) {
+      if (!load_foz_dbs(foz_db, db_idx, file_idx, sorted_idx_filename)) {
+         ralloc_free(sorted_idx_filename);
          fclose(db_idx);
          return false;
       }
 
+      ralloc_free(sorted_idx_filename);
       fclose(db_idx);
       file_idx++;
 
@@ -342,10 +878,19 @@ foz_destroy(struct foz_db *foz_db)
    if (foz_db->db_idx)
       fclose(foz_db->db_idx);
    for (unsigned i = 0; i < FOZ_MAX_DBS; i++) {
+      foz_unmap(foz_db, i);
+      foz_unmap_sorted_idx(foz_db, i);
       if (foz_db->file[i])
          fclose(foz_db->file[i]);
    }
 
+   /* Entries that were not released are invalidated here. */
+   while (foz_db->retired_maps) {
+      struct foz_map *map = foz_db->retired_maps;
+      foz_db->retired_maps = map->next;
+      foz_free_map(map);
+   }
+
    if (foz_db->mem_ctx) {
       _mesa_hash_table_u64_destroy(foz_db->index_db);
       ralloc_free(foz_db->mem_ctx);
@@ -354,61 +899,69 @@ foz_destroy(struct foz_db *foz_db)
    }
 }
 
-/* Here we lookup a cache entry in the index hash table. If an entry is found
- * we use the retrieved offset to read the cache entry from disk.
+/* Here we lookup a cache entry in the index hash table and the sorted
+ * indexes.  If an entry is found we return a pointer to it in the mapping of
+ * the foz db, which must be released with foz_release_entry().
  */
-void *
+const void *
 foz_read_entry(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
-               size_t *size)
+               size_t *size, bool *from_prev_gen)
 {
-   uint64_t hash = truncate_hash_to_64bits(cache_key_160bit);
-
-   void *data = NULL;
+   if (from_prev_gen)
+      *from_prev_gen = false;
 
    if (!foz_db->alive)
       return NULL;
 
    simple_mtx_lock(&foz_db->mtx);
 
-   struct foz_db_entry *entry =
-      _mesa_hash_table_u64_search(foz_db->index_db, hash);
-   if (!entry) {
+   uint8_t file_idx;
+   uint64_t offset;
+   if (!foz_lookup(foz_db, cache_key_160bit, &file_idx, &offset)) {
       update_foz_index(foz_db, foz_db->db_idx, 0);
-      entry = _mesa_hash_table_u64_search(foz_db->index_db, hash);
-   }
-   if (!entry) {
-      simple_mtx_unlock(&foz_db->mtx);
-      return NULL;
+      if (!foz_lookup(foz_db, cache_key_160bit, &file_idx, &offset))
+         goto fail;
    }
 
-   uint8_t file_idx = entry->file_idx;
-   if (fseek(foz_db->file[file_idx], entry->offset, SEEK_SET) < 0)
+   /* The entry is preceded by its hash, check it in case the index is
+    * stale or corrupt.
+    */
+   uint32_t header_size = sizeof(struct foz_payload_header);
+   if (offset < FOSSILIZE_BLOB_HASH_LENGTH)
       goto fail;
 
-   uint32_t header_size = sizeof(struct foz_payload_header);
-   if (fread(&entry->header, 1, header_size, foz_db->file[file_idx]) !=
-       header_size)
+   struct foz_map *map = foz_map_range(foz_db, file_idx, offset + header_size);
+   if (!map)
       goto fail;
 
-   /* Check for collision using full 160bit hash for increased assurance
-    * against potential collisions.
-    */
-   for (int i = 0; i < 20; i++) {
-      if (cache_key_160bit[i] != entry->key[i])
-         goto fail;
-   }
+   char hash_str[FOSSILIZE_BLOB_HASH_LENGTH + 1];
+   _mesa_sha1_format(hash_str, cache_key_160bit);
+   if (memcmp(map->ptr + offset - FOSSILIZE_BLOB_HASH_LENGTH, hash_str,
+              FOSSILIZE_BLOB_HASH_LENGTH))
+      goto fail;
 
-   uint32_t data_sz = entry->header.payload_size;
-   data = malloc(data_sz);
-   if (fread(data, 1, data_sz, foz_db->file[file_idx]) != data_sz)
+   struct foz_payload_header header;
+   memcpy(&header, map->ptr + offset, header_size);
+
+   uint32_t data_sz = header.payload_size;
+   uint64_t data_offset = offset + header_size;
+   map = foz_map_range(foz_db, file_idx, data_offset + data_sz);
+   if (!map)
       goto fail;
 
+   const uint8_t *data = map->ptr + data_offset;
+
    /* verify checksum */
-   if (entry->header.crc != 0) {
-      if (util_hash_crc32(data, data_sz) != entry->header.crc)
+   if (header.crc != 0) {
+      if (util_hash_crc32(data, data_sz) != header.crc)
          goto fail;
    }
 
+   map->refcount++;
+
+   if (from_prev_gen)
+      *from_prev_gen = file_idx == FOZ_PREV_GEN_IDX;
+
    simple_mtx_unlock(&foz_db->mtx);
 
    if (size)
@@ -417,14 +970,55 @@ foz_read_entry(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
    return data;
 
 fail:
-   free(data);
-
-   /* reading db entry failed. reset the file offset */
    simple_mtx_unlock(&foz_db->mtx);
 
    return NULL;
 }
 
+static bool
+foz_map_contains(const struct foz_map *map, const void *data)
+{
+   return (const uint8_t *)data >= map->ptr &&
+          (const uint8_t *)data < map->ptr + map->size;
+}
+
+/* Releases an entry returned by foz_read_entry(), this must be done before
+ * foz_destroy().
+ */
+void
+foz_release_entry(struct foz_db *foz_db, const void *data)
+{
+   if (!data)
+      return;
+
+   simple_mtx_lock(&foz_db->mtx);
+
+   for (unsigned i = 0; i < FOZ_MAX_DBS; i++) {
+      struct foz_map *map = foz_db->map[i];
+      if (map && foz_map_contains(map, data)) {
+         assert(map->refcount > 0);
+         map->refcount--;
+         simple_mtx_unlock(&foz_db->mtx);
+         return;
+      }
+   }
+
+   for (struct foz_map **map = &foz_db->retired_maps; *map;
+        map = &(*map)->next) {
+      if (foz_map_contains(*map, data)) {
+         assert((*map)->refcount > 0);
+         if (--(*map)->refcount == 0) {
+            struct foz_map *retired = *map;
+            *map = retired->next;
+            foz_free_map(retired);
+         }
+         break;
+      }
+   }
+
+   simple_mtx_unlock(&foz_db->mtx);
+}
+
 /* Here we write the cache entry to disk and store its offset in the index db.
  */
 bool
@@ -436,6 +1030,14 @@ foz_write_entry(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
    if (!foz_db->alive)
       return false;
 
+   /* An entry that doesn't fit in an empty generation would start a new
+    * generation, evicting everything else, on every write.  Don't cache it.
+    */
+   if (foz_db->max_size &&
+       FOZ_REF_MAGIC_SIZE + FOSSILIZE_BLOB_HASH_LENGTH +
+       sizeof(struct foz_payload_header) + blob_size > foz_db->max_size / 2)
+      return false;
+
    /* The flock is per-fd, not per thread, we do it outside of the main mutex to avoid having to
     * wait in the mutex potentially blocking reads. We use the secondary flock_mtx to stop race
     * conditions between the write threads sharing the same file descriptor. */
@@ -449,17 +1051,42 @@ foz_write_entry(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
 
    simple_mtx_lock(&foz_db->mtx);
 
+   /* Another process may have started a new generation while we were
+    * waiting for the lock, in which case we would be appending to the
+    * retired files.
+    */
+   if (foz_db->max_size && foz_generation_changed(foz_db)) {
+      flock(fileno(foz_db->file[0]), LOCK_UN);
+      if (!foz_next_generation(foz_db))
+         goto fail;
+      if (lock_file_with_timeout(foz_db->file[0], 1000000000) == -1)
+         goto fail;
+   }
+
    update_foz_index(foz_db, foz_db->db_idx, 0);
 
-   struct foz_db_entry *entry =
-      _mesa_hash_table_u64_search(foz_db->index_db, hash);
-   if (entry) {
+   /* Entries only found in the previous generation are written again so
+    * that entries which are still in use survive the next rotation.
+    */
+   uint8_t file_idx;
+   uint64_t entry_offset;
+   if (foz_lookup(foz_db, cache_key_160bit, &file_idx, &entry_offset) &&
+       file_idx != FOZ_PREV_GEN_IDX) {
       simple_mtx_unlock(&foz_db->mtx);
       flock(fileno(foz_db->file[0]), LOCK_UN);
       simple_mtx_unlock(&foz_db->flock_mtx);
       return NULL;
    }
 
+   fseek(foz_db->file[0], 0, SEEK_END);
+   if (foz_db->max_size &&
+       ftell(foz_db->file[0]) + blob_size > foz_db->max_size / 2) {
+      if (!foz_rotate(foz_db))
+         goto fail;
+      if (lock_file_with_timeout(foz_db->file[0], 1000000000) == -1)
+         goto fail;
+   }
+
    /* Prepare db entry header and blob ready for writing */
    struct foz_payload_header header;
    header.uncompressed_size = blob_size;
@@ -510,6 +1137,12 @@ foz_write_entry(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
    /* Flush everything to file to reduce chance of cache corruption */
    fflush(foz_db->db_idx);
 
+   /* Replaces the entry of the previous generation, if any. */
+   struct foz_db_entry *entry =
+      _mesa_hash_table_u64_search(foz_db->index_db, hash);
+   if (entry)
+      ralloc_free(entry);
+
    entry = ralloc(foz_db->mem_ctx, struct foz_db_entry);
    entry->header = header;
    entry->offset = offset;
@@ -533,7 +1166,7 @@ fail_file:
 #else
 
 bool
-foz_prepare(struct foz_db *foz_db, char *filename)
+foz_prepare(struct foz_db *foz_db, char *filename, uint64_t max_size)
 {
    fprintf(stderr, "Warning: Mesa single file cache selected but Mesa wasn't "
            "built with single cache file support. Shader cache will be disabled"
@@ -546,13 +1179,18 @@ foz_destroy(struct foz_db *foz_db)
 {
 }
 
-void *
+const void *
 foz_read_entry(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
-               size_t *size)
+               size_t *size, bool *from_prev_gen)
 {
    return false;
 }
 
+void
+foz_release_entry(struct foz_db *foz_db, const void *data)
+{
+}
+
 bool
 foz_write_entry(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
                 const void *blob, size_t size)
@@ -44,7 +44,13 @@
 #include "simple_mtx.h"
 
 /* Max number of DBs our implementation can read from at once */
-#define FOZ_MAX_DBS 9 /* Default DB + 8 Read only DBs */
+#define FOZ_MAX_DBS 10 /* Default DB + previous generation + 8 Read only DBs */
+
+/* Index of the previous generation of the default DB.  When the cache size
+ * is bounded, the default DB is retired to this slot once it reaches half the
+ * maximum size and a new one is started, evicting the older generation.
+ */
+#define FOZ_PREV_GEN_IDX 1
 
 #define FOSSILIZE_BLOB_HASH_LENGTH 40
 
@@ -72,25 +78,52 @@ struct foz_db_entry {
    struct foz_payload_header header;
 };
 
+/* Entry of a sorted idx, written next to a foz db idx so that its entries
+ * can be looked up with a binary search in a shared mapping instead of
+ * parsing the whole idx in every process.
+ */
+struct foz_sorted_idx_entry {
+   uint8_t key[20];
+   uint32_t pad;
+   uint64_t offset;
+};
+
+struct foz_map;
+
 struct foz_db {
    FILE *file[FOZ_MAX_DBS];          /* An array of all foz dbs */
    FILE *db_idx;                     /* The default writable foz db idx */
+   struct foz_map *map[FOZ_MAX_DBS]; /* Read-only mappings of the foz dbs */
+   struct foz_map *retired_maps;     /* Replaced mappings still in use */
+   const struct foz_sorted_idx_entry *sorted_idx[FOZ_MAX_DBS];
+   uint32_t sorted_idx_count[FOZ_MAX_DBS];
+   size_t sorted_idx_map_size[FOZ_MAX_DBS];
    simple_mtx_t mtx;                 /* Mutex for file/hash table read/writes */
    simple_mtx_t flock_mtx;           /* Mutex for flocking the file for writes */
    void *mem_ctx;
-   struct hash_table_u64 *index_db;  /* Hash table of all foz db entries */
+   struct hash_table_u64 *index_db;  /* Hash table of the foz db entries not in a sorted idx */
+   uint64_t max_size;                /* Max size of both generations, 0 if unbounded */
+   char *filename;                   /* Path of the default writable foz db */
+   char *idx_filename;               /* Path of the default writable foz db idx */
+   char *prev_filename;              /* Path of the previous generation foz db */
+   char *prev_idx_filename;          /* Path of the previous generation foz db idx */
+   char *sorted_idx_filename;        /* Path of the default writable foz db sorted idx */
+   char *prev_sorted_idx_filename;   /* Path of the previous generation foz db sorted idx */
    bool alive;
 };
 
 bool
-foz_prepare(struct foz_db *foz_db, char *cache_path);
+foz_prepare(struct foz_db *foz_db, char *cache_path, uint64_t max_size);
 
 void
 foz_destroy(struct foz_db *foz_db);
 
-void *
+const void *
 foz_read_entry(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
-               size_t *size);
+               size_t *size, bool *from_prev_gen);
+
+void
+foz_release_entry(struct foz_db *foz_db, const void *data);
 
 bool
 foz_write_entry(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
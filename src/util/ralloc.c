@@ -536,21 +536,24 @@ ralloc_vasprintf_rewrite_tail(char **str, size_t *start, const char *fmt,
  * Linear allocator for short-lived allocations.
  ***************************************************************************
  *
- * The allocator consists of a parent node (2K buffer), which requires
- * a ralloc parent, and child nodes (allocations). Child nodes can't be freed
- * directly, because the parent doesn't track them. You have to release
- * the parent node in order to release all its children.
+ * The allocator consists of a parent node (2K buffer) and child nodes
+ * (allocations). Child nodes can't be freed directly, because the parent
+ * doesn't track them. You have to release the parent node in order to
+ * release all its children.
  *
- * The allocator uses a fixed-sized buffer with a monotonically increasing
- * offset after each allocation. If the buffer is all used, another buffer
- * is allocated, sharing the same ralloc parent, so all buffers are at
- * the same level in the ralloc hierarchy.
+ * The allocator uses buffers with a monotonically increasing offset after
+ * each allocation, and child nodes have no header. If the buffer is all used,
+ * another one twice as large is allocated (up to MAX_LINEAR_BUFSIZE), sharing
+ * the same ralloc parent, so all buffers are at the same level in the ralloc
+ * hierarchy. Allocations larger than half of the current buffer get a buffer
+ * of their own, so that the space left in the current one isn't wasted.
  *
  * The linear parent node is always the first buffer and keeps track of all
  * other buffers.
  */
 
 #define MIN_LINEAR_BUFSIZE 2048
+#define MAX_LINEAR_BUFSIZE (64 * 1024)
 #define SUBALLOC_ALIGNMENT 8
 #define LMAGIC 0x87b9c7d3
 
@@ -568,35 +571,19 @@ struct
 #endif
    unsigned offset;  /* points to the first unused byte in the buffer */
    unsigned size;    /* size of the buffer */
+   unsigned last_offset;         /* start of the last allocation, for realloc */
    void *ralloc_parent;          /* new buffers will use this */
    struct linear_header *next;   /* next buffer if we have more */
-   struct linear_header *latest; /* the only buffer that has free space */
-
-   /* After this structure, the buffer begins.
-    * Each suballocation consists of linear_size_chunk as its header followed
-    * by the suballocation, so it goes:
-    *
-    * - linear_size_chunk
-    * - allocated space
-    * - linear_size_chunk
-    * - allocated space
-    * etc.
-    *
-    * linear_size_chunk is only needed by linear_realloc.
-    */
-};
+   struct linear_header *latest; /* the buffer used for new allocations */
 
-struct linear_size_chunk {
-   unsigned size; /* for realloc */
-   unsigned _padding;
+   /* After this structure, the buffer begins. */
 };
 
 typedef struct linear_header linear_header;
-typedef struct linear_size_chunk linear_size_chunk;
 
 #define LINEAR_PARENT_TO_HEADER(parent) \
    (linear_header*) \
-   ((char*)(parent) - sizeof(linear_size_chunk) - sizeof(linear_header))
+   ((char*)(parent) - sizeof(linear_header))
 
 /* Allocate the linear buffer with its header. */
 static linear_header *
@@ -604,8 +591,6 @@ create_linear_node(void *ralloc_ctx, unsigned min_size)
 {
    linear_header *node;
 
-   min_size += sizeof(linear_size_chunk);
-
    if (likely(min_size < MIN_LINEAR_BUFSIZE))
       min_size = MIN_LINEAR_BUFSIZE;
 
@@ -618,6 +603,7 @@ create_linear_node(void *ralloc_ctx, unsigned min_size)
 #endif
    node->offset = 0;
    node->size = min_size;
+   node->last_offset = 0;
    node->ralloc_parent = ralloc_ctx;
    node->next = NULL;
    node->latest = node;
@@ -630,33 +616,46 @@ linear_alloc_child(void *parent, unsigned size)
    linear_header *first = LINEAR_PARENT_TO_HEADER(parent);
    linear_header *latest = first->latest;
    linear_header *new_node;
-   linear_size_chunk *ptr;
-   unsigned full_size;
+   char *ptr;
 
    assert(first->magic == LMAGIC);
-   assert(!latest->next);
 
-   size = ALIGN_POT(size, SUBALLOC_ALIGNMENT);
-   full_size = sizeof(linear_size_chunk) + size;
+   /* Round zero-sized requests up so that every child gets its own address. */
+   size = ALIGN_POT(MAX2(size, 1), SUBALLOC_ALIGNMENT);
+
+   if (unlikely(latest->offset + size > latest->size)) {
+      if (size > latest->size / 2) {
+         /* Give large allocations their own buffer and keep using the
+          * current one.
+          */
+         new_node = create_linear_node(latest->ralloc_parent, size);
+         if (unlikely(!new_node))
+            return NULL;
+
+         new_node->offset = size;
+         new_node->next = latest->next;
+         latest->next = new_node;
+         return &new_node[1];
+      }
 
-   if (unlikely(latest->offset + full_size > latest->size)) {
       /* allocate a new node */
-      new_node = create_linear_node(latest->ralloc_parent, size);
+      new_node = create_linear_node(latest->ralloc_parent,
+                                    MIN2(latest->size * 2, MAX_LINEAR_BUFSIZE));
       if (unlikely(!new_node))
          return NULL;
 
-      first->latest = new_node;
-      latest->latest = new_node;
+      new_node->next = latest->next;
       latest->next = new_node;
+      first->latest = new_node;
       latest = new_node;
    }
 
-   ptr = (linear_size_chunk *)((char*)&latest[1] + latest->offset);
-   ptr->size = size;
-   latest->offset += full_size;
+   ptr = (char*)&latest[1] + latest->offset;
+   latest->last_offset = latest->offset;
+   latest->offset += size;
 
-   assert((uintptr_t)&ptr[1] % SUBALLOC_ALIGNMENT == 0);
-   return &ptr[1];
+   assert((uintptr_t)ptr % SUBALLOC_ALIGNMENT == 0);
+   return ptr;
 }
 
 void *
@@ -664,18 +663,13 @@ linear_alloc_parent(void *ralloc_ctx, unsigned size)
 {
    linear_header *node;
 
-   if (unlikely(!ralloc_ctx))
-      return NULL;
-
-   size = ALIGN_POT(size, SUBALLOC_ALIGNMENT);
+   size = ALIGN_POT(MAX2(size, 1), SUBALLOC_ALIGNMENT);
 
    node = create_linear_node(ralloc_ctx, size);
    if (unlikely(!node))
       return NULL;
 
-   return linear_alloc_child((char*)node +
-                             sizeof(linear_header) +
-                             sizeof(linear_size_chunk), size);
+   return linear_alloc_child((char*)node + sizeof(linear_header), size);
 }
 
 void *
@@ -744,19 +738,29 @@ ralloc_parent_of_linear_parent(void *ptr)
 }
 
 void *
-linear_realloc(void *parent, void *old, unsigned new_size)
+linear_realloc(void *parent, void *old, unsigned old_size, unsigned new_size)
 {
-   unsigned old_size = 0;
-   ralloc_header *new_ptr;
+   linear_header *first = LINEAR_PARENT_TO_HEADER(parent);
+   linear_header *latest = first->latest;
+   char *new_ptr;
 
-   new_ptr = linear_alloc_child(parent, new_size);
+   assert(first->magic == LMAGIC);
 
    if (unlikely(!old))
-      return new_ptr;
+      return linear_alloc_child(parent, new_size);
+
+   /* The last allocation can be resized in place. */
+   if ((char*)old == (char*)&latest[1] + latest->last_offset) {
+      unsigned end = latest->last_offset + ALIGN_POT(new_size, SUBALLOC_ALIGNMENT);
 
-   old_size = ((linear_size_chunk*)old)[-1].size;
+      if (end <= latest->size) {
+         latest->offset = MAX2(latest->offset, end);
+         return old;
+      }
+   }
 
-   if (likely(new_ptr && old_size))
+   new_ptr = linear_alloc_child(parent, new_size);
+   if (likely(new_ptr))
       memcpy(new_ptr, old, MIN2(old_size, new_size));
 
    return new_ptr;
@@ -857,7 +861,7 @@ linear_vasprintf_rewrite_tail(void *parent, char **str, size_t *start,
 
    new_length = u_printf_length(fmt, args);
 
-   ptr = linear_realloc(parent, *str, *start + new_length + 1);
+   ptr = linear_realloc(parent, *str, *start, *start + new_length + 1);
    if (unlikely(ptr == NULL))
       return false;
 
@@ -876,7 +880,7 @@ linear_cat(void *parent, char **dest, const char *str, unsigned n)
    assert(dest != NULL && *dest != NULL);
 
    existing_length = strlen(*dest);
-   both = linear_realloc(parent, *dest, existing_length + n + 1);
+   both = linear_realloc(parent, *dest, existing_length, existing_length + n + 1);
    if (unlikely(both == NULL))
       return false;
 
@@ -533,6 +533,8 @@ public:                                                                  \
  * from the allocator's point of view. It can't be freed directly. You have
  * to free the parent or the ralloc parent.
  *
+ * Child nodes have no header, so they can't be used as ralloc contexts.
+ *
  * \param parent   parent node of the linear allocator
  * \param size     size to allocate (max 32 bits)
  */
@@ -543,7 +545,8 @@ void *linear_alloc_child(void *parent, unsigned size);
  * allocation is actually the first child node, but it's also the handle
  * of the parent node. Use it for all child node allocations.
  *
- * \param ralloc_ctx  ralloc context, must not be NULL
+ * \param ralloc_ctx  ralloc context, or NULL to free it with
+ *                    linear_free_parent only
  * \param size        size to allocate (max 32 bits)
  */
 void *linear_alloc_parent(void *ralloc_ctx, unsigned size);
@@ -575,12 +578,13 @@ void ralloc_steal_linear_parent(void *new_ralloc_ctx, void *ptr);
 void *ralloc_parent_of_linear_parent(void *ptr);
 
 /**
- * Same as realloc except that the linear allocator doesn't free child nodes,
- * so it's reduced to memory duplication. It's used in places where
- * reallocation is required. Don't use it often. It's much slower than
- * realloc.
+ * Same as realloc except that the linear allocator doesn't free child nodes
+ * and doesn't know their size. The last allocation is resized in place if
+ * there is space for it, other ones are reduced to memory duplication of
+ * the first \p old_size bytes.
  */
-void *linear_realloc(void *parent, void *old, unsigned new_size);
+void *linear_realloc(void *parent, void *old, unsigned old_size,
+                     unsigned new_size);
 
 /* The functions below have the same semantics as their ralloc counterparts,
  * except that they always allocate a linear child node.
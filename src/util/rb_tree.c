@@ -123,8 +123,13 @@ rb_tree_splice(struct rb_tree *T, struct rb_node *u, struct rb_node *v)
         rb_node_set_parent(v, p);
 }
 
+/*
+ * Rotations only change the subtrees of the two rotated nodes, so they only
+ * need to recompute the augmented data of those, lower node first.
+ */
 static void
-rb_tree_rotate_left(struct rb_tree *T, struct rb_node *x)
+rb_tree_rotate_left(struct rb_tree *T, struct rb_node *x,
+                    rb_augment_cb augment)
 {
     assert(x && x->right);
 
@@ -135,10 +140,16 @@ rb_tree_rotate_left(struct rb_tree *T, struct rb_node *x)
     rb_tree_splice(T, x, y);
     y->left = x;
     rb_node_set_parent(x, y);
+
+    if (augment) {
+        augment(x);
+        augment(y);
+    }
 }
 
 static void
-rb_tree_rotate_right(struct rb_tree *T, struct rb_node *y)
+rb_tree_rotate_right(struct rb_tree *T, struct rb_node *y,
+                     rb_augment_cb augment)
 {
     assert(y && y->left);
 
@@ -149,11 +160,31 @@ rb_tree_rotate_right(struct rb_tree *T, struct rb_node *y)
     rb_tree_splice(T, y, x);
     x->right = y;
     rb_node_set_parent(y, x);
+
+    if (augment) {
+        augment(y);
+        augment(x);
+    }
+}
+
+void
+rb_augmented_tree_update(struct rb_node *n, rb_augment_cb augment)
+{
+    for (; n; n = rb_node_parent(n))
+        augment(n);
 }
 
 void
 rb_tree_insert_at(struct rb_tree *T, struct rb_node *parent,
                   struct rb_node *node, bool insert_left)
+{
+    rb_augmented_tree_insert_at(T, parent, node, insert_left, NULL);
+}
+
+void
+rb_augmented_tree_insert_at(struct rb_tree *T, struct rb_node *parent,
+                            struct rb_node *node, bool insert_left,
+                            rb_augment_cb augment)
 {
     /* This sets null children, parent, and a color of red */
     memset(node, 0, sizeof(*node));
@@ -162,6 +193,8 @@ rb_tree_insert_at(struct rb_tree *T, struct rb_node *parent,
         assert(T->root == NULL);
         T->root = node;
         rb_node_set_black(node);
+        if (augment)
+            augment(node);
         return;
     }
 
@@ -174,6 +207,10 @@ rb_tree_insert_at(struct rb_tree *T, struct rb_node *parent,
     }
     rb_node_set_parent(node, parent);
 
+    /* Bring the path to the root up to date before rotating anything */
+    if (augment)
+        rb_augmented_tree_update(node, augment);
+
     /* Now we do the insertion fixup */
     struct rb_node *z = node;
     while (rb_node_is_red(rb_node_parent(z))) {
@@ -191,7 +228,7 @@ rb_tree_insert_at(struct rb_tree *T, struct rb_node *parent,
             } else {
                 if (z == z_p->right) {
                     z = z_p;
-                    rb_tree_rotate_left(T, z);
+                    rb_tree_rotate_left(T, z, augment);
                     /* We changed z */
                     z_p = rb_node_parent(z);
                     assert(z == z_p->left || z == z_p->right);
@@ -199,7 +236,7 @@ rb_tree_insert_at(struct rb_tree *T, struct rb_node *parent,
                 }
                 rb_node_set_black(z_p);
                 rb_node_set_red(z_p_p);
-                rb_tree_rotate_right(T, z_p_p);
+                rb_tree_rotate_right(T, z_p_p, augment);
             }
         } else {
             struct rb_node *y = z_p_p->left;
@@ -211,7 +248,7 @@ rb_tree_insert_at(struct rb_tree *T, struct rb_node *parent,
             } else {
                 if (z == z_p->left) {
                     z = z_p;
-                    rb_tree_rotate_right(T, z);
+                    rb_tree_rotate_right(T, z, augment);
                     /* We changed z */
                     z_p = rb_node_parent(z);
                     assert(z == z_p->left || z == z_p->right);
@@ -219,7 +256,7 @@ rb_tree_insert_at(struct rb_tree *T, struct rb_node *parent,
                 }
                 rb_node_set_black(z_p);
                 rb_node_set_red(z_p_p);
-                rb_tree_rotate_left(T, z_p_p);
+                rb_tree_rotate_left(T, z_p_p, augment);
             }
         }
     }
@@ -228,6 +265,13 @@ rb_tree_insert_at(struct rb_tree *T, struct rb_node *parent,
 
 void
 rb_tree_remove(struct rb_tree *T, struct rb_node *z)
+{
+    rb_augmented_tree_remove(T, z, NULL);
+}
+
+void
+rb_augmented_tree_remove(struct rb_tree *T, struct rb_node *z,
+                         rb_augment_cb augment)
 {
     /* x_p is always the parent node of X.  We have to track this
      * separately because x may be NULL.
@@ -266,6 +310,12 @@ rb_tree_remove(struct rb_tree *T, struct rb_node *z)
 
     assert(x_p == NULL || x == x_p->left || x == x_p->right);
 
+    /* Every node whose subtree lost z or had y moved around is on the path
+     * from x_p to the root.
+     */
+    if (augment)
+        rb_augmented_tree_update(x_p, augment);
+
     if (!y_was_black)
         return;
 
@@ -276,7 +326,7 @@ rb_tree_remove(struct rb_tree *T, struct rb_node *z)
             if (rb_node_is_red(w)) {
                 rb_node_set_black(w);
                 rb_node_set_red(x_p);
-                rb_tree_rotate_left(T, x_p);
+                rb_tree_rotate_left(T, x_p, augment);
                 assert(x == x_p->left);
                 w = x_p->right;
             }
@@ -287,13 +337,13 @@ rb_tree_remove(struct rb_tree *T, struct rb_node *z)
                 if (rb_node_is_black(w->right)) {
                     rb_node_set_black(w->left);
                     rb_node_set_red(w);
-                    rb_tree_rotate_right(T, w);
+                    rb_tree_rotate_right(T, w, augment);
                     w = x_p->right;
                 }
                 rb_node_copy_color(w, x_p);
                 rb_node_set_black(x_p);
                 rb_node_set_black(w->right);
-                rb_tree_rotate_left(T, x_p);
+                rb_tree_rotate_left(T, x_p, augment);
                 x = T->root;
             }
         } else {
@@ -301,7 +351,7 @@ rb_tree_remove(struct rb_tree *T, struct rb_node *z)
             if (rb_node_is_red(w)) {
                 rb_node_set_black(w);
                 rb_node_set_red(x_p);
-                rb_tree_rotate_right(T, x_p);
+                rb_tree_rotate_right(T, x_p, augment);
                 assert(x == x_p->right);
                 w = x_p->left;
             }
@@ -312,13 +362,13 @@ rb_tree_remove(struct rb_tree *T, struct rb_node *z)
                 if (rb_node_is_black(w->left)) {
                     rb_node_set_black(w->right);
                     rb_node_set_red(w);
-                    rb_tree_rotate_left(T, w);
+                    rb_tree_rotate_left(T, w, augment);
                     w = x_p->left;
                 }
                 rb_node_copy_color(w, x_p);
                 rb_node_set_black(x_p);
                 rb_node_set_black(w->left);
-                rb_tree_rotate_right(T, x_p);
+                rb_tree_rotate_right(T, x_p, augment);
                 x = T->root;
             }
         }
@@ -111,6 +111,31 @@ rb_tree_is_empty(const struct rb_tree *T)
 void rb_tree_insert_at(struct rb_tree *T, struct rb_node *parent,
                        struct rb_node *node, bool insert_left);
 
+/** Callback updating the augmented data of a node
+ *
+ * An augmented tree keeps data in each node that summarizes the subtree
+ * rooted at it, such as the largest key in the subtree.  The callback
+ * recomputes that data for \p n from \p n itself and its children, which
+ * are already up to date when it is called.
+ */
+typedef void (*rb_augment_cb)(struct rb_node *n);
+
+/** Insert a node into an augmented tree at a particular location
+ *
+ * Same as rb_tree_insert_at, but keeps the augmented data up to date by
+ * calling \p augment on every node whose subtree changed.
+ */
+void rb_augmented_tree_insert_at(struct rb_tree *T, struct rb_node *parent,
+                                 struct rb_node *node, bool insert_left,
+                                 rb_augment_cb augment);
+
+/** Update the augmented data from a node up to the root
+ *
+ * This must be called after changing the data a node's augmented data is
+ * computed from, without removing or inserting the node.
+ */
+void rb_augmented_tree_update(struct rb_node *n, rb_augment_cb augment);
+
 /** Insert a node into a tree
  *
  * \param   T       The red-black tree into which to insert the new node
@@ -149,6 +174,14 @@ rb_tree_insert(struct rb_tree *T, struct rb_node *node,
  */
 void rb_tree_remove(struct rb_tree *T, struct rb_node *z);
 
+/** Remove a node from an augmented tree
+ *
+ * Same as rb_tree_remove, but keeps the augmented data up to date by
+ * calling \p augment on every node whose subtree changed.
+ */
+void rb_augmented_tree_remove(struct rb_tree *T, struct rb_node *z,
+                              rb_augment_cb augment);
+
 /** Search the tree for a node
  *
  * If a node with a matching key exists, the first matching node found will
@@ -473,11 +473,38 @@ ra_set_deserialize(void *mem_ctx, struct blob_reader *blob)
    return regs;
 }
 
+/**
+ * Returns the index of the bit for the interference between n1 and n2 in
+ * g->adjacency.  Row n holds the interferences with the nodes below n, so
+ * the rows of a graph with N nodes take N * (N - 1) / 2 bits in total.
+ */
+static inline uint64_t
+ra_get_adjacency_bit(unsigned int n1, unsigned int n2)
+{
+   assert(n1 != n2);
+   if (n1 < n2) {
+      unsigned int tmp = n1;
+      n1 = n2;
+      n2 = tmp;
+   }
+   return (uint64_t)n1 * (n1 - 1) / 2 + n2;
+}
+
+static inline uint64_t
+ra_get_adjacency_words(unsigned int count)
+{
+   return DIV_ROUND_UP((uint64_t)count * (count - 1) / 2, BITSET_WORDBITS);
+}
+
+static inline bool
+ra_test_adjacency(struct ra_graph *g, unsigned int n1, unsigned int n2)
+{
+   return BITSET_TEST(g->adjacency, ra_get_adjacency_bit(n1, n2));
+}
+
 static void
 ra_add_node_adjacency(struct ra_graph *g, unsigned int n1, unsigned int n2)
 {
-   BITSET_SET(g->nodes[n1].adjacency, n2);
-
    assert(n1 != n2);
 
    int n1_class = g->nodes[n1].class;
@@ -490,8 +517,6 @@ ra_add_node_adjacency(struct ra_graph *g, unsigned int n1, unsigned int n2)
 static void
 ra_node_remove_adjacency(struct ra_graph *g, unsigned int n1, unsigned int n2)
 {
-   BITSET_CLEAR(g->nodes[n1].adjacency, n2);
-
    assert(n1 != n2);
 
    int n1_class = g->nodes[n1].class;
@@ -516,19 +541,18 @@ ra_realloc_interference_graph(struct ra_graph *g, unsigned int alloc)
 
    g->nodes = reralloc(g, g->nodes, struct ra_node, alloc);
 
-   unsigned g_bitset_count = BITSET_WORDS(g->alloc);
    unsigned bitset_count = BITSET_WORDS(alloc);
-   /* For nodes already in the graph, we just have to grow the adjacency set */
-   for (unsigned i = 0; i < g->alloc; i++) {
-      assert(g->nodes[i].adjacency != NULL);
-      g->nodes[i].adjacency = rerzalloc(g, g->nodes[i].adjacency, BITSET_WORD,
-                                        g_bitset_count, bitset_count);
-   }
+
+   /* The rows for the new nodes go after the existing ones, so we only have
+    * to zero the new part.
+    */
+   g->adjacency = rerzalloc(g, g->adjacency, BITSET_WORD,
+                            ra_get_adjacency_words(g->alloc),
+                            ra_get_adjacency_words(alloc));
 
    /* For new nodes, we have to fully initialize them */
    for (unsigned i = g->alloc; i < alloc; i++) {
       memset(&g->nodes[i], 0, sizeof(g->nodes[i]));
-      g->nodes[i].adjacency = rzalloc_array(g, BITSET_WORD, bitset_count);
       util_dynarray_init(&g->nodes[i].adjacency_list, g);
       g->nodes[i].q_total = 0;
 
@@ -545,10 +569,8 @@ ra_realloc_interference_graph(struct ra_graph *g, unsigned int alloc)
    g->tmp.reg_assigned = reralloc(g, g->tmp.reg_assigned, BITSET_WORD,
                                   bitset_count);
    g->tmp.pq_test = reralloc(g, g->tmp.pq_test, BITSET_WORD, bitset_count);
-   g->tmp.min_q_total = reralloc(g, g->tmp.min_q_total, unsigned int,
-                                 bitset_count);
-   g->tmp.min_q_node = reralloc(g, g->tmp.min_q_node, unsigned int,
-                                bitset_count);
+   g->tmp.worklist = reralloc(g, g->tmp.worklist, unsigned int, alloc);
+   g->tmp.q_heap = reralloc(g, g->tmp.q_heap, unsigned int, alloc);
 
    g->alloc = alloc;
 }
@@ -571,7 +593,7 @@ ra_resize_interference_graph(struct ra_graph *g, unsigned int count)
 {
    g->count = count;
    if (count > g->alloc)
-      ra_realloc_interference_graph(g, g->alloc * 2);
+      ra_realloc_interference_graph(g, MAX2(count, g->alloc * 2));
 }
 
 void ra_set_select_reg_callback(struct ra_graph *g,
@@ -612,7 +634,8 @@ ra_add_node_interference(struct ra_graph *g,
                          unsigned int n1, unsigned int n2)
 {
    assert(n1 < g->count && n2 < g->count);
-   if (n1 != n2 && !BITSET_TEST(g->nodes[n1].adjacency, n2)) {
+   if (n1 != n2 && !ra_test_adjacency(g, n1, n2)) {
+      BITSET_SET(g->adjacency, ra_get_adjacency_bit(n1, n2));
       ra_add_node_adjacency(g, n1, n2);
       ra_add_node_adjacency(g, n2, n1);
    }
@@ -622,34 +645,108 @@ void
 ra_reset_node_interference(struct ra_graph *g, unsigned int n)
 {
    util_dynarray_foreach(&g->nodes[n].adjacency_list, unsigned int, n2p) {
+      BITSET_CLEAR(g->adjacency, ra_get_adjacency_bit(n, *n2p));
       ra_node_remove_adjacency(g, *n2p, n);
    }
 
-   memset(g->nodes[n].adjacency, 0,
-          BITSET_WORDS(g->count) * sizeof(BITSET_WORD));
    util_dynarray_clear(&g->nodes[n].adjacency_list);
 }
 
+static inline bool
+ra_q_heap_less(struct ra_graph *g, unsigned int n1, unsigned int n2)
+{
+   unsigned int q1 = g->nodes[n1].tmp.q_total;
+   unsigned int q2 = g->nodes[n2].tmp.q_total;
+
+   /* Prefer the node with the highest index among equal q totals. */
+   return q1 < q2 || (q1 == q2 && n1 > n2);
+}
+
+static inline void
+ra_q_heap_set(struct ra_graph *g, unsigned int i, unsigned int n)
+{
+   g->tmp.q_heap[i] = n;
+   g->nodes[n].tmp.q_heap_index = i;
+}
+
+static void
+ra_q_heap_sift_up(struct ra_graph *g, unsigned int i)
+{
+   unsigned int n = g->tmp.q_heap[i];
+
+   while (i > 0) {
+      unsigned int parent = (i - 1) / 2;
+      if (!ra_q_heap_less(g, n, g->tmp.q_heap[parent]))
+         break;
+      ra_q_heap_set(g, i, g->tmp.q_heap[parent]);
+      i = parent;
+   }
+   ra_q_heap_set(g, i, n);
+}
+
+static void
+ra_q_heap_sift_down(struct ra_graph *g, unsigned int i)
+{
+   unsigned int n = g->tmp.q_heap[i];
+
+   for (;;) {
+      unsigned int child = 2 * i + 1;
+      if (child >= g->tmp.q_heap_count)
+         break;
+      if (child + 1 < g->tmp.q_heap_count &&
+          ra_q_heap_less(g, g->tmp.q_heap[child + 1], g->tmp.q_heap[child]))
+         child++;
+      if (!ra_q_heap_less(g, g->tmp.q_heap[child], n))
+         break;
+      ra_q_heap_set(g, i, g->tmp.q_heap[child]);
+      i = child;
+   }
+   ra_q_heap_set(g, i, n);
+}
+
+static void
+ra_q_heap_insert(struct ra_graph *g, unsigned int n)
+{
+   unsigned int i = g->tmp.q_heap_count++;
+
+   ra_q_heap_set(g, i, n);
+   ra_q_heap_sift_up(g, i);
+}
+
+static void
+ra_q_heap_remove(struct ra_graph *g, unsigned int n)
+{
+   unsigned int i = g->nodes[n].tmp.q_heap_index;
+   unsigned int last = g->tmp.q_heap[--g->tmp.q_heap_count];
+
+   g->nodes[n].tmp.q_heap_index = UINT_MAX;
+   if (last == n)
+      return;
+
+   ra_q_heap_set(g, i, last);
+   ra_q_heap_sift_up(g, i);
+   ra_q_heap_sift_down(g, g->nodes[last].tmp.q_heap_index);
+}
+
+/**
+ * Called when n's q_total has decreased.  Moves n to the worklist once it
+ * passes the pq test, and otherwise keeps its place in the heap up to date.
+ */
 static void
 update_pq_info(struct ra_graph *g, unsigned int n)
 {
-   int i = n / BITSET_WORDBITS;
    int n_class = g->nodes[n].class;
    if (g->nodes[n].tmp.q_total < g->regs->classes[n_class]->p) {
-      BITSET_SET(g->tmp.pq_test, n);
-   } else if (g->tmp.min_q_total[i] != UINT_MAX) {
-      /* Only update min_q_total and min_q_node if min_q_total != UINT_MAX so
-       * that we don't update while we have stale data and accidentally mark
-       * it as non-stale.  Also, in order to remain consistent with the old
-       * naive implementation of the algorithm, we do a lexicographical sort
-       * to ensure that we always choose the node with the highest node index.
-       */
-      if (g->nodes[n].tmp.q_total < g->tmp.min_q_total[i] ||
-          (g->nodes[n].tmp.q_total == g->tmp.min_q_total[i] &&
-           n > g->tmp.min_q_node[i])) {
-         g->tmp.min_q_total[i] = g->nodes[n].tmp.q_total;
-         g->tmp.min_q_node[i] = n;
+      if (g->nodes[n].tmp.q_heap_index != UINT_MAX)
+         ra_q_heap_remove(g, n);
+      if (!BITSET_TEST(g->tmp.pq_test, n)) {
+         BITSET_SET(g->tmp.pq_test, n);
+         g->tmp.worklist[g->tmp.worklist_count++] = n;
       }
+   } else if (g->nodes[n].tmp.q_heap_index == UINT_MAX) {
+      ra_q_heap_insert(g, n);
+   } else {
+      ra_q_heap_sift_up(g, g->nodes[n].tmp.q_heap_index);
    }
 }
 
@@ -663,11 +760,12 @@ add_node_to_stack(struct ra_graph *g, unsigned int n)
    util_dynarray_foreach(&g->nodes[n].adjacency_list, unsigned int, n2p) {
       unsigned int n2 = *n2p;
       unsigned int n2_class = g->nodes[n2].class;
+      unsigned int q = g->regs->classes[n2_class]->q[n_class];
 
-      if (!BITSET_TEST(g->tmp.in_stack, n2) &&
+      if (q && !BITSET_TEST(g->tmp.in_stack, n2) &&
           !BITSET_TEST(g->tmp.reg_assigned, n2)) {
-         assert(g->nodes[n2].tmp.q_total >= g->regs->classes[n2_class]->q[n_class]);
-         g->nodes[n2].tmp.q_total -= g->regs->classes[n2_class]->q[n_class];
+         assert(g->nodes[n2].tmp.q_total >= q);
+         g->nodes[n2].tmp.q_total -= q;
          update_pq_info(g, n2);
       }
    }
@@ -675,9 +773,6 @@ add_node_to_stack(struct ra_graph *g, unsigned int n)
    g->tmp.stack[g->tmp.stack_count] = n;
    g->tmp.stack_count++;
    BITSET_SET(g->tmp.in_stack, n);
-
-   /* Flag the min_q_total for n's block as dirty so it gets recalculated */
-   g->tmp.min_q_total[n / BITSET_WORDBITS] = UINT_MAX;
 }
 
 /**
@@ -685,6 +780,9 @@ add_node_to_stack(struct ra_graph *g, unsigned int n)
  * trivially-colorable nodes into a stack of nodes to be colored,
  * removing them from the graph, and rinsing and repeating.
  *
+ * Nodes are put on a worklist as soon as they pass the pq test, so that
+ * each step only looks at the neighbors of the node just removed.
+ *
  * If we encounter a case where we can't push any nodes on the stack, then
  * we optimistically choose a node and push it on the stack. We heuristically
  * push the node with the lowest total q value, since it has the fewest
@@ -693,99 +791,47 @@ add_node_to_stack(struct ra_graph *g, unsigned int n)
 static void
 ra_simplify(struct ra_graph *g)
 {
-   bool progress = true;
    unsigned int stack_optimistic_start = UINT_MAX;
 
-   /* Figure out the high bit and bit mask for the first iteration of a loop
-    * over BITSET_WORDs.
-    */
-   const unsigned int top_word_high_bit = (g->count - 1) % BITSET_WORDBITS;
-
-   /* Do a quick pre-pass to set things up */
    g->tmp.stack_count = 0;
-   for (int i = BITSET_WORDS(g->count) - 1, high_bit = top_word_high_bit;
-        i >= 0; i--, high_bit = BITSET_WORDBITS - 1) {
-      g->tmp.in_stack[i] = 0;
-      g->tmp.reg_assigned[i] = 0;
-      g->tmp.pq_test[i] = 0;
-      g->tmp.min_q_total[i] = UINT_MAX;
-      g->tmp.min_q_node[i] = UINT_MAX;
-      for (int j = high_bit; j >= 0; j--) {
-         unsigned int n = i * BITSET_WORDBITS + j;
-         g->nodes[n].reg = g->nodes[n].forced_reg;
-         g->nodes[n].tmp.q_total = g->nodes[n].q_total;
-         if (g->nodes[n].reg != NO_REG)
-            g->tmp.reg_assigned[i] |= BITSET_BIT(j);
+   g->tmp.worklist_count = 0;
+   g->tmp.q_heap_count = 0;
+
+   memset(g->tmp.in_stack, 0, BITSET_WORDS(g->count) * sizeof(BITSET_WORD));
+   memset(g->tmp.reg_assigned, 0,
+          BITSET_WORDS(g->count) * sizeof(BITSET_WORD));
+   memset(g->tmp.pq_test, 0, BITSET_WORDS(g->count) * sizeof(BITSET_WORD));
+
+   /* Add the nodes in increasing order so that, like the stack, the
+    * worklist hands out the highest numbered nodes first.
+    */
+   for (unsigned int n = 0; n < g->count; n++) {
+      g->nodes[n].reg = g->nodes[n].forced_reg;
+      g->nodes[n].tmp.q_total = g->nodes[n].q_total;
+      g->nodes[n].tmp.q_heap_index = UINT_MAX;
+      if (g->nodes[n].reg != NO_REG)
+         BITSET_SET(g->tmp.reg_assigned, n);
+      else
          update_pq_info(g, n);
-      }
    }
 
-   while (progress) {
-      unsigned int min_q_total = UINT_MAX;
-      unsigned int min_q_node = UINT_MAX;
-
-      progress = false;
-
-      for (int i = BITSET_WORDS(g->count) - 1, high_bit = top_word_high_bit;
-           i >= 0; i--, high_bit = BITSET_WORDBITS - 1) {
-         BITSET_WORD mask = ~(BITSET_WORD)0 >> (31 - high_bit);
-
-         BITSET_WORD skip = g->tmp.in_stack[i] | g->tmp.reg_assigned[i];
-         if (skip == mask)
-            continue;
-
-         BITSET_WORD pq = g->tmp.pq_test[i] & ~skip;
-         if (pq) {
-            /* In this case, we have stuff we can immediately take off the
-             * stack.  This also means that we're guaranteed to make progress
-             * and we don't need to bother updating lowest_q_total because we
-             * know we're going to loop again before attempting to do anything
-             * optimistic.
-             */
-            for (int j = high_bit; j >= 0; j--) {
-               if (pq & BITSET_BIT(j)) {
-                  unsigned int n = i * BITSET_WORDBITS + j;
-                  assert(n < g->count);
-                  add_node_to_stack(g, n);
-                  /* add_node_to_stack() may update pq_test for this word so
-                   * we need to update our local copy.
-                   */
-                  pq = g->tmp.pq_test[i] & ~skip;
-                  progress = true;
-               }
-            }
-         } else if (!progress) {
-            if (g->tmp.min_q_total[i] == UINT_MAX) {
-               /* The min_q_total and min_q_node are dirty because we added
-                * one of these nodes to the stack.  It needs to be
-                * recalculated.
-                */
-               for (int j = high_bit; j >= 0; j--) {
-                  if (skip & BITSET_BIT(j))
-                     continue;
-
-                  unsigned int n = i * BITSET_WORDBITS + j;
-                  assert(n < g->count);
-                  if (g->nodes[n].tmp.q_total < g->tmp.min_q_total[i]) {
-                     g->tmp.min_q_total[i] = g->nodes[n].tmp.q_total;
-                     g->tmp.min_q_node[i] = n;
-                  }
-               }
-            }
-            if (g->tmp.min_q_total[i] < min_q_total) {
-               min_q_node = g->tmp.min_q_node[i];
-               min_q_total = g->tmp.min_q_total[i];
-            }
-         }
-      }
+   for (;;) {
+      unsigned int n;
+
+      if (g->tmp.worklist_count) {
+         n = g->tmp.worklist[--g->tmp.worklist_count];
+      } else {
+         if (g->tmp.q_heap_count == 0)
+            break;
+
+         n = g->tmp.q_heap[0];
+         ra_q_heap_remove(g, n);
 
-      if (!progress && min_q_total != UINT_MAX) {
          if (stack_optimistic_start == UINT_MAX)
             stack_optimistic_start = g->tmp.stack_count;
-
-         add_node_to_stack(g, min_q_node);
-         progress = true;
       }
+
+      add_node_to_stack(g, n);
    }
 
    g->tmp.stack_optimistic_start = stack_optimistic_start;
@@ -806,28 +852,11 @@ ra_class_allocations_conflict(struct ra_class *c1, unsigned int r1,
    }
 }
 
-static struct ra_node *
-ra_find_conflicting_neighbor(struct ra_graph *g, unsigned int n, unsigned int r)
-{
-   util_dynarray_foreach(&g->nodes[n].adjacency_list, unsigned int, n2p) {
-      unsigned int n2 = *n2p;
-
-      /* If our adjacent node is in the stack, it's not allocated yet. */
-      if (!BITSET_TEST(g->tmp.in_stack, n2) &&
-          ra_class_allocations_conflict(g->regs->classes[g->nodes[n].class], r,
-                                        g->regs->classes[g->nodes[n2].class], g->nodes[n2].reg)) {
-         return &g->nodes[n2];
-      }
-   }
-
-   return NULL;
-}
-
 /* Computes a bitfield of what regs are available for a given register
  * selection.
  *
- * This lets drivers implement a more complicated policy than our simple first
- * or round robin policies (which don't require knowing the whole bitset)
+ * This is used by our simple first or round robin policies, and lets drivers
+ * implement a more complicated policy through the select_reg callback.
  */
 static bool
 ra_compute_available_regs(struct ra_graph *g, unsigned int n, BITSET_WORD *regs)
@@ -865,6 +894,30 @@ ra_compute_available_regs(struct ra_graph *g, unsigned int n, BITSET_WORD *regs)
    return false;
 }
 
+/* Returns the first register set in regs, starting the search at start and
+ * wrapping around.  regs must not be empty.
+ */
+static unsigned int
+ra_find_first_reg_from(const BITSET_WORD *regs, unsigned int count,
+                       unsigned int start)
+{
+   unsigned int words = BITSET_WORDS(count);
+   unsigned int w = (start % count) / BITSET_WORDBITS;
+   BITSET_WORD word = regs[w] & (~(BITSET_WORD)0 << (start % count %
+                                                    BITSET_WORDBITS));
+
+   /* The last iteration looks at the bits of the first word below start. */
+   for (unsigned int i = 0; i <= words; i++) {
+      if (word)
+         return w * BITSET_WORDBITS + ffs(word) - 1;
+
+      w = (w + 1) % words;
+      word = regs[w];
+   }
+
+   unreachable("no register available");
+}
+
 /**
  * Pops nodes from the stack back into the graph, coloring them with
  * registers as they go.
@@ -876,58 +929,33 @@ static bool
 ra_select(struct ra_graph *g)
 {
    int start_search_reg = 0;
-   BITSET_WORD *select_regs = NULL;
-
-   if (g->select_reg_callback)
-      select_regs = malloc(BITSET_WORDS(g->regs->count) * sizeof(BITSET_WORD));
+   BITSET_WORD *select_regs =
+      malloc(BITSET_WORDS(g->regs->count) * sizeof(BITSET_WORD));
 
    while (g->tmp.stack_count != 0) {
-      unsigned int ri;
-      unsigned int r = -1;
+      unsigned int r;
       int n = g->tmp.stack[g->tmp.stack_count - 1];
-      struct ra_class *c = g->regs->classes[g->nodes[n].class];
 
       /* set this to false even if we return here so that
        * ra_get_best_spill_node() considers this node later.
        */
       BITSET_CLEAR(g->tmp.in_stack, n);
 
-      if (g->select_reg_callback) {
-         if (!ra_compute_available_regs(g, n, select_regs)) {
-            free(select_regs);
-            return false;
-         }
+      if (!ra_compute_available_regs(g, n, select_regs)) {
+         free(select_regs);
+         return false;
+      }
 
+      if (g->select_reg_callback) {
          r = g->select_reg_callback(n, select_regs, g->select_reg_callback_data);
          assert(r < g->regs->count);
       } else {
          /* Find the lowest-numbered reg which is not used by a member
-          * of the graph adjacent to us.
+          * of the graph adjacent to us.  Building the set of available regs
+          * once walks the neighbors once, instead of once per candidate reg.
           */
-         for (ri = 0; ri < g->regs->count; ri++) {
-            r = (start_search_reg + ri) % g->regs->count;
-            if (!reg_belongs_to_class(r, c))
-               continue;
-
-            struct ra_node *conflicting = ra_find_conflicting_neighbor(g, n, r);
-            if (!conflicting) {
-               /* Found a reg! */
-               break;
-            }
-            if (g->regs->classes[conflicting->class]->contig_len) {
-               /* Skip to point at the last base reg of the conflicting reg
-                * allocation -- the loop will increment us to check the next reg
-                * after the conflicting allocaiton.
-                */
-               unsigned conflicting_end = (conflicting->reg +
-                                           g->regs->classes[conflicting->class]->contig_len - 1);
-               assert(conflicting_end >= r);
-               ri += conflicting_end - r;
-            }
-         }
-
-         if (ri >= g->regs->count)
-            return false;
+         r = ra_find_first_reg_from(select_regs, g->regs->count,
+                                    start_search_reg);
       }
 
       g->nodes[n].reg = r;
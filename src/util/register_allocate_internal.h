@@ -87,15 +87,11 @@ struct ra_class {
 };
 
 struct ra_node {
-   /** @{
-    *
+   /**
     * List of which nodes this node interferes with.  This should be
     * symmetric with the other node.
     */
-   BITSET_WORD *adjacency;
-
    struct util_dynarray adjacency_list;
-   /** @} */
 
    unsigned int class;
 
@@ -123,6 +119,9 @@ struct ra_node {
        * into the stack.
        */
       unsigned int q_total;
+
+      /** Index of the node in ra_graph::tmp::q_heap, or UINT_MAX if not in it */
+      unsigned int q_heap_index;
    } tmp;
 };
 
@@ -136,6 +135,13 @@ struct ra_graph {
 
    unsigned int alloc; /**< count of nodes allocated. */
 
+   /**
+    * Interference matrix, as the lower triangle of a bit matrix (see
+    * ra_get_adjacency_bit()).  Nodes are added at the end of it, so growing
+    * the graph doesn't move any existing bits.
+    */
+   BITSET_WORD *adjacency;
+
    ra_select_reg_callback select_reg_callback;
    void *select_reg_callback_data;
 
@@ -150,17 +156,22 @@ struct ra_graph {
       /** Bit-set indicating, for each register, if it pre-assigned */
       BITSET_WORD *reg_assigned;
 
-      /** Bit-set indicating, for each register, the value of the pq test */
+      /**
+       * Bit-set indicating, for each register, whether it passed the pq test
+       * and was added to the worklist.
+       */
       BITSET_WORD *pq_test;
 
-      /** For each BITSET_WORD, the minimum q value or ~0 if unknown */
-      unsigned int *min_q_total;
+      /** Nodes that passed the pq test but aren't in the stack yet */
+      unsigned int *worklist;
+      unsigned int worklist_count;
 
-      /*
-       * * For each BITSET_WORD, the node with the minimum q_total if
-       * min_q_total[i] != ~0.
+      /**
+       * Min-heap by q_total of the nodes that fail the pq test, for picking
+       * the node to push optimistically.
        */
-      unsigned int *min_q_node;
+      unsigned int *q_heap;
+      unsigned int q_heap_count;
 
       /**
        * Tracks the start of the set of optimistically-colored registers in the
@@ -19,6 +19,11 @@
 #include "u_endian.h"
 #include "sha1.h"
 
+#ifdef USE_SHA_NI
+#include "c11/threads.h"
+#include "util/u_cpu_detect.h"
+#endif
+
 #define rol(value, bits) (((value) << (bits)) | ((value) >> (32 - (bits))))
 
 /*
@@ -101,6 +106,40 @@ SHA1Transform(uint32_t state[5], const uint8_t buffer[SHA1_BLOCK_LENGTH])
 }
 
 
+static void
+SHA1TransformBlocks(uint32_t state[5], const uint8_t *data, size_t nblocks)
+{
+	for (; nblocks; nblocks--, data += SHA1_BLOCK_LENGTH)
+		SHA1Transform(state, data);
+}
+
+#ifdef USE_SHA_NI
+static void (*sha1_transform_blocks)(uint32_t [5], const uint8_t *, size_t) =
+    SHA1TransformBlocks;
+static once_flag sha1_once_flag = ONCE_FLAG_INIT;
+
+static void
+sha1_select_transform(void)
+{
+	util_cpu_detect();
+	if (util_get_cpu_caps()->has_sha && util_get_cpu_caps()->has_sse4_1)
+		sha1_transform_blocks = SHA1TransformBlocksNI;
+}
+
+/*
+ * Pick the block transform on first use.
+ */
+static inline void
+sha1_transform_dispatch(uint32_t state[5], const uint8_t *data, size_t nblocks)
+{
+	call_once(&sha1_once_flag, sha1_select_transform);
+	sha1_transform_blocks(state, data, nblocks);
+}
+#else
+#define sha1_transform_dispatch SHA1TransformBlocks
+#endif
+
+
 /*
  * SHA1Init - Initialize new context
  */
@@ -130,9 +169,12 @@ SHA1Update(SHA1_CTX *context, const uint8_t *data, size_t len)
 	context->count += (len << 3);
 	if ((j + len) > 63) {
 		(void)memcpy(&context->buffer[j], data, (i = 64-j));
-		SHA1Transform(context->state, context->buffer);
-		for ( ; i + 63 < len; i += 64)
-			SHA1Transform(context->state, (uint8_t *)&data[i]);
+		sha1_transform_dispatch(context->state, context->buffer, 1);
+		if (len - i > 63) {
+			sha1_transform_dispatch(context->state, &data[i],
+			    (len - i) / 64);
+			i += (len - i) & ~(size_t)63;
+		}
 		j = 0;
 	} else {
 		i = 0;
@@ -147,16 +189,18 @@ SHA1Update(SHA1_CTX *context, const uint8_t *data, size_t len)
 void
 SHA1Pad(SHA1_CTX *context)
 {
+	/* A 0x80 byte, then zeroes up to 8 bytes before the end of a block */
+	static const uint8_t padding[SHA1_BLOCK_LENGTH] = { 0x80 };
 	uint8_t finalcount[8];
+	size_t used;
 	uint32_t i;
 
 	for (i = 0; i < 8; i++) {
 		finalcount[i] = (uint8_t)((context->count >>
 		    ((7 - (i & 7)) * 8)) & 255);	/* Endian independent */
 	}
-	SHA1Update(context, (uint8_t *)"\200", 1);
-	while ((context->count & 504) != 448)
-		SHA1Update(context, (uint8_t *)"\0", 1);
+	used = (size_t)((context->count >> 3) & 63);
+	SHA1Update(context, padding, (used < 56 ? 56 : 120) - used);
 	SHA1Update(context, finalcount, 8); /* Should cause a SHA1Transform() */
 }
 
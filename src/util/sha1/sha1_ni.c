@@ -0,0 +1,76 @@
+/*
+ * SHA-1 block transform using the x86 SHA extensions (SHA-NI).
+ * 100% Public Domain
+ *
+ * This file is built with -msse4.1 -msha and must only be called after
+ * checking util_cpu_caps.has_sha and has_sse4_1. It produces exactly the
+ * same digest as SHA1Transform().
+ */
+
+#include <immintrin.h>
+#include "sha1.h"
+
+/*
+ * Four rounds of SHA-1, with the message schedule for later rounds
+ * computed on the fly. msg[] holds the current 16 message words; the
+ * conditions only depend on the constant round number j and get folded.
+ */
+#define SHA1_NI_ROUNDS4(j)                                              \
+	do {                                                            \
+		if ((j) == 0)                                           \
+			e[0] = _mm_add_epi32(e[0], msg[0]);             \
+		else                                                    \
+			e[(j) & 1] = _mm_sha1nexte_epu32(e[(j) & 1],    \
+			    msg[(j) & 3]);                              \
+		e[((j) + 1) & 1] = abcd;                                \
+		if ((j) >= 3 && (j) <= 18)                              \
+			msg[((j) + 1) & 3] = _mm_sha1msg2_epu32(        \
+			    msg[((j) + 1) & 3], msg[(j) & 3]);          \
+		abcd = _mm_sha1rnds4_epu32(abcd, e[(j) & 1], (j) / 5);  \
+		if ((j) >= 1 && (j) <= 16)                              \
+			msg[((j) + 3) & 3] = _mm_sha1msg1_epu32(        \
+			    msg[((j) + 3) & 3], msg[(j) & 3]);          \
+		if ((j) >= 2 && (j) <= 17)                              \
+			msg[((j) + 2) & 3] = _mm_xor_si128(             \
+			    msg[((j) + 2) & 3], msg[(j) & 3]);          \
+	} while (0)
+
+void
+SHA1TransformBlocksNI(uint32_t state[5], const uint8_t *data, size_t nblocks)
+{
+	const __m128i bswap = _mm_set_epi64x(0x0001020304050607ULL,
+	    0x08090a0b0c0d0e0fULL);
+	__m128i abcd, abcd_save, e_save;
+	__m128i e[2], msg[4];
+
+	abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)state), 0x1b);
+	e[0] = _mm_set_epi32(state[4], 0, 0, 0);
+
+	for (; nblocks; nblocks--, data += SHA1_BLOCK_LENGTH) {
+		abcd_save = abcd;
+		e_save = e[0];
+
+		for (unsigned i = 0; i < 4; i++) {
+			msg[i] = _mm_shuffle_epi8(_mm_loadu_si128(
+			    (const __m128i *)(data + i * 16)), bswap);
+		}
+
+		SHA1_NI_ROUNDS4(0);  SHA1_NI_ROUNDS4(1);
+		SHA1_NI_ROUNDS4(2);  SHA1_NI_ROUNDS4(3);
+		SHA1_NI_ROUNDS4(4);  SHA1_NI_ROUNDS4(5);
+		SHA1_NI_ROUNDS4(6);  SHA1_NI_ROUNDS4(7);
+		SHA1_NI_ROUNDS4(8);  SHA1_NI_ROUNDS4(9);
+		SHA1_NI_ROUNDS4(10); SHA1_NI_ROUNDS4(11);
+		SHA1_NI_ROUNDS4(12); SHA1_NI_ROUNDS4(13);
+		SHA1_NI_ROUNDS4(14); SHA1_NI_ROUNDS4(15);
+		SHA1_NI_ROUNDS4(16); SHA1_NI_ROUNDS4(17);
+		SHA1_NI_ROUNDS4(18); SHA1_NI_ROUNDS4(19);
+
+		/* Add this block's result to the running state */
+		e[0] = _mm_sha1nexte_epu32(e[0], e_save);
+		abcd = _mm_add_epi32(abcd, abcd_save);
+	}
+
+	_mm_storeu_si128((__m128i *)state, _mm_shuffle_epi32(abcd, 0x1b));
+	state[4] = _mm_extract_epi32(e[0], 3);
+}
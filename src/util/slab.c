@@ -28,6 +28,9 @@
 #include <stdbool.h>
 #include <string.h>
 
+/* Maximum number of free pages kept by a parent pool for reuse. */
+#define SLAB_MAX_CACHED_PAGES 8
+
 #define SLAB_MAGIC_ALLOCATED 0xcafe4321
 #define SLAB_MAGIC_FREE 0x7ee01234
 
@@ -59,7 +62,7 @@ struct slab_element_header {
 /* The page is an array of allocations in one block. */
 struct slab_page_header {
    union {
-      /* Next page in the same child pool. */
+      /* Next page in the same child pool, or in the parent's page cache. */
       struct slab_page_header *next;
 
       /* Number of remaining, non-freed elements (for orphaned pages). */
@@ -79,11 +82,28 @@ slab_get_element(struct slab_parent_pool *parent,
           ((uint8_t*)&page[1] + (parent->element_size * index));
 }
 
+/* Keep an empty page for reuse by another child pool, or free it if the
+ * parent already has enough of them. The parent mutex must be held.
+ */
+static void
+slab_recycle_page_locked(struct slab_parent_pool *parent,
+                         struct slab_page_header *page)
+{
+   if (parent->num_cached_pages >= SLAB_MAX_CACHED_PAGES) {
+      free(page);
+      return;
+   }
+
+   page->u.next = parent->cached_pages;
+   parent->cached_pages = page;
+   p_atomic_set(&parent->num_cached_pages, parent->num_cached_pages + 1);
+}
+
 /* The given object/element belongs to an orphaned page (i.e. the owning child
- * pool has been destroyed). Mark the element as freed and free the whole page
+ * pool has been destroyed). Mark the element as freed and return the page
  * when no elements are left in it.
  */
-static void
+static struct slab_page_header *
 slab_free_orphaned(struct slab_element_header *elt)
 {
    struct slab_page_header *page;
@@ -92,7 +112,8 @@ slab_free_orphaned(struct slab_element_header *elt)
 
    page = (struct slab_page_header *)(elt->owner & ~(intptr_t)1);
    if (!p_atomic_dec_return(&page->u.num_remaining))
-      free(page);
+      return page;
+   return NULL;
 }
 
 /**
@@ -110,11 +131,19 @@ slab_create_parent(struct slab_parent_pool *parent,
    parent->element_size = ALIGN_POT(sizeof(struct slab_element_header) + item_size,
                                     sizeof(intptr_t));
    parent->num_elements = num_items;
+   parent->num_migrating = 0;
+   parent->cached_pages = NULL;
+   parent->num_cached_pages = 0;
 }
 
 void
 slab_destroy_parent(struct slab_parent_pool *parent)
 {
+   while (parent->cached_pages) {
+      struct slab_page_header *page = parent->cached_pages;
+      parent->cached_pages = page->u.next;
+      free(page);
+   }
    simple_mtx_destroy(&parent->mutex);
 }
 
@@ -138,36 +167,54 @@ void slab_create_child(struct slab_child_pool *pool,
  */
 void slab_destroy_child(struct slab_child_pool *pool)
 {
-   if (!pool->parent)
+   struct slab_parent_pool *parent = pool->parent;
+
+   if (!parent)
       return; /* the slab probably wasn't even created */
 
-   simple_mtx_lock(&pool->parent->mutex);
+   simple_mtx_lock(&parent->mutex);
 
    while (pool->pages) {
       struct slab_page_header *page = pool->pages;
       pool->pages = page->u.next;
-      p_atomic_set(&page->u.num_remaining, pool->parent->num_elements);
+      p_atomic_set(&page->u.num_remaining, parent->num_elements);
 
-      for (unsigned i = 0; i < pool->parent->num_elements; ++i) {
-         struct slab_element_header *elt = slab_get_element(pool->parent, page, i);
+      for (unsigned i = 0; i < parent->num_elements; ++i) {
+         struct slab_element_header *elt = slab_get_element(parent, page, i);
          p_atomic_set(&elt->owner, (intptr_t)page | 1);
       }
    }
 
+   /* Frees from other threads that still saw this pool as the owner may be
+    * adding to the migrated list. Wait for them, the ones that come after
+    * see the orphaned pages. The atomic add orders this against the owner
+    * updates above.
+    */
+   while (p_atomic_add_return(&parent->num_migrating, 0))
+      thrd_yield();
+
    while (pool->migrated) {
       struct slab_element_header *elt = pool->migrated;
+      struct slab_page_header *page;
+
       pool->migrated = elt->next;
-      slab_free_orphaned(elt);
+      page = slab_free_orphaned(elt);
+      if (page)
+         slab_recycle_page_locked(parent, page);
    }
 
-   simple_mtx_unlock(&pool->parent->mutex);
-
    while (pool->free) {
       struct slab_element_header *elt = pool->free;
+      struct slab_page_header *page;
+
       pool->free = elt->next;
-      slab_free_orphaned(elt);
+      page = slab_free_orphaned(elt);
+      if (page)
+         slab_recycle_page_locked(parent, page);
    }
 
+   simple_mtx_unlock(&parent->mutex);
+
    /* Guard against use-after-free. */
    pool->parent = NULL;
 }
@@ -175,8 +222,27 @@ void slab_destroy_child(struct slab_child_pool *pool)
 static bool
 slab_add_new_page(struct slab_child_pool *pool)
 {
-   struct slab_page_header *page = malloc(sizeof(struct slab_page_header) +
-      pool->parent->num_elements * pool->parent->element_size);
+   struct slab_parent_pool *parent = pool->parent;
+   struct slab_page_header *page = NULL;
+
+   /* Reuse a page of a destroyed child pool if there is one. */
+   if (p_atomic_read_relaxed(&parent->num_cached_pages)) {
+      simple_mtx_lock(&parent->mutex);
+      page = parent->cached_pages;
+      if (page) {
+         parent->cached_pages = page->u.next;
+         p_atomic_set(&parent->num_cached_pages, parent->num_cached_pages - 1);
+      }
+      simple_mtx_unlock(&parent->mutex);
+   }
+
+   /* New pages are first written by the thread that allocates from them,
+    * which places them on its NUMA node with the default first-touch policy.
+    */
+   if (!page) {
+      page = malloc(sizeof(struct slab_page_header) +
+                    parent->num_elements * parent->element_size);
+   }
 
    if (!page)
       return false;
@@ -211,10 +277,16 @@ slab_alloc(struct slab_child_pool *pool)
       /* First, collect elements that belong to us but were freed from a
        * different child pool.
        */
-      simple_mtx_lock(&pool->parent->mutex);
-      pool->free = pool->migrated;
-      pool->migrated = NULL;
-      simple_mtx_unlock(&pool->parent->mutex);
+      elt = p_atomic_read(&pool->migrated);
+      while (elt) {
+         struct slab_element_header *prev =
+            p_atomic_cmpxchg(&pool->migrated, elt,
+                             (struct slab_element_header *)NULL);
+         if (prev == elt)
+            break;
+         elt = prev;
+      }
+      pool->free = elt;
 
       /* Now allocate a new page. */
       if (!pool->free && !slab_add_new_page(pool))
@@ -256,9 +328,14 @@ void slab_free(struct slab_child_pool *pool, void *ptr)
       return;
    }
 
-   /* The slow case: migration or an orphaned page. */
-   if (pool->parent)
-      simple_mtx_lock(&pool->parent->mutex);
+   /* The slow case: migration or an orphaned page.
+    *
+    * num_migrating keeps the owning child pool from being destroyed while
+    * the element is added to its migrated list.
+    */
+   struct slab_parent_pool *parent = pool->parent;
+   if (parent)
+      p_atomic_inc(&parent->num_migrating);
 
    /* Note: we _must_ re-read elt->owner here because the owning child pool
     * may have been destroyed by another thread in the meantime.
@@ -267,15 +344,33 @@ void slab_free(struct slab_child_pool *pool, void *ptr)
 
    if (!(owner_int & 1)) {
       struct slab_child_pool *owner = (struct slab_child_pool *)owner_int;
-      elt->next = owner->migrated;
-      owner->migrated = elt;
-      if (pool->parent)
-         simple_mtx_unlock(&pool->parent->mutex);
-   } else {
-      if (pool->parent)
-         simple_mtx_unlock(&pool->parent->mutex);
+      struct slab_element_header *head = p_atomic_read(&owner->migrated);
+
+      while (true) {
+         elt->next = head;
+         struct slab_element_header *prev =
+            p_atomic_cmpxchg(&owner->migrated, head, elt);
+         if (prev == head)
+            break;
+         head = prev;
+      }
 
-      slab_free_orphaned(elt);
+      if (parent)
+         p_atomic_dec(&parent->num_migrating);
+   } else {
+      if (parent)
+         p_atomic_dec(&parent->num_migrating);
+
+      struct slab_page_header *page = slab_free_orphaned(elt);
+      if (page) {
+         if (parent) {
+            simple_mtx_lock(&parent->mutex);
+            slab_recycle_page_locked(parent, page);
+            simple_mtx_unlock(&parent->mutex);
+         } else {
+            free(page);
+         }
+      }
    }
 }
 
@@ -32,8 +32,12 @@
  *
  * Allocations obtained from one child pool should usually be freed in the
  * same child pool. Freeing an allocation in a different child pool associated
- * to the same parent is allowed (and requires no locking by the caller), but
- * it is discouraged because it implies a performance penalty.
+ * to the same parent is allowed (and requires no locking by the caller). Such
+ * frees are pushed to a lock-free list of the owning pool, which takes them
+ * back when it runs out of free elements.
+ *
+ * Pages that are completely free when a child pool is destroyed are kept
+ * by the parent and reused by the other child pools.
  *
  * For convenience and to ease the transition, there is also a set of wrapper
  * functions around a single parent-child pair.
@@ -55,6 +59,15 @@ struct slab_parent_pool {
    simple_mtx_t mutex;
    unsigned element_size;
    unsigned num_elements;
+
+   /* Number of slab_free calls currently adding to the migrated list of
+    * another child pool. slab_destroy_child waits for them.
+    */
+   unsigned num_migrating;
+
+   /* Free pages of destroyed child pools, protected by the mutex. */
+   struct slab_page_header *cached_pages;
+   unsigned num_cached_pages;
 };
 
 struct slab_child_pool {
@@ -68,7 +81,8 @@ struct slab_child_pool {
    /* Elements that are owned by this pool but were freed with a different
     * pool as the argument to slab_free.
     *
-    * This list is protected by the parent mutex.
+    * Other pools push to this list with atomic compare-and-swap, and this
+    * pool takes the whole list at once, so it needs no lock.
     */
    struct slab_element_header *migrated;
 };
@@ -0,0 +1,376 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <string.h>
+#include <assert.h>
+
+#include "swiss_table.h"
+#include "ralloc.h"
+
+/* Keep at least 1/8 of the slots empty, so that probing terminates quickly. */
+static uint32_t
+max_entries_for_size(uint32_t size)
+{
+   return size - size / 8;
+}
+
+static bool
+entry_index_is_present(const struct swiss_table *ht, uint32_t idx)
+{
+   return ht->ctrl[idx] < SWISS_TABLE_CTRL_EMPTY;
+}
+
+static bool
+swiss_table_alloc(struct swiss_table *ht, uint32_t size)
+{
+   uint8_t *ctrl = ralloc_array(ht, uint8_t, size);
+   struct hash_entry *table = rzalloc_array(ht, struct hash_entry, size);
+
+   if (!ctrl || !table) {
+      ralloc_free(ctrl);
+      ralloc_free(table);
+      return false;
+   }
+
+   memset(ctrl, SWISS_TABLE_CTRL_EMPTY, size);
+
+   ht->ctrl = ctrl;
+   ht->table = table;
+   ht->size = size;
+   ht->max_entries = max_entries_for_size(size);
+   ht->entries = 0;
+   ht->deleted_entries = 0;
+   return true;
+}
+
+struct swiss_table *
+_mesa_swiss_table_create(void *mem_ctx,
+                         uint32_t (*key_hash_function)(const void *key),
+                         bool (*key_equals_function)(const void *a,
+                                                     const void *b))
+{
+   struct swiss_table *ht = ralloc(mem_ctx, struct swiss_table);
+   if (ht == NULL)
+      return NULL;
+
+   ht->key_hash_function = key_hash_function;
+   ht->key_equals_function = key_equals_function;
+
+   if (!swiss_table_alloc(ht, SWISS_TABLE_GROUP_SIZE)) {
+      ralloc_free(ht);
+      return NULL;
+   }
+
+   return ht;
+}
+
+/**
+ * Helper to create a swiss table with pointer keys.
+ */
+struct swiss_table *
+_mesa_pointer_swiss_table_create(void *mem_ctx)
+{
+   return _mesa_swiss_table_create(mem_ctx, _mesa_hash_pointer,
+                                   _mesa_key_pointer_equal);
+}
+
+/**
+ * Frees the given swiss table.
+ *
+ * If delete_function is passed, it gets called on each entry present before
+ * freeing.
+ */
+void
+_mesa_swiss_table_destroy(struct swiss_table *ht,
+                          void (*delete_function)(struct hash_entry *entry))
+{
+   if (!ht)
+      return;
+
+   if (delete_function) {
+      swiss_table_foreach(ht, entry) {
+         delete_function(entry);
+      }
+   }
+   ralloc_free(ht);
+}
+
+/**
+ * Deletes all entries of the given swiss table without deleting the table
+ * itself or changing its size.
+ *
+ * If delete_function is passed, it gets called on each entry present.
+ */
+void
+_mesa_swiss_table_clear(struct swiss_table *ht,
+                        void (*delete_function)(struct hash_entry *entry))
+{
+   if (!ht)
+      return;
+
+   if (delete_function) {
+      swiss_table_foreach(ht, entry) {
+         delete_function(entry);
+      }
+   }
+
+   memset(ht->ctrl, SWISS_TABLE_CTRL_EMPTY, ht->size);
+   memset(ht->table, 0, ht->size * sizeof(struct hash_entry));
+   ht->entries = 0;
+   ht->deleted_entries = 0;
+}
+
+/* Return the first empty or deleted slot on the probe sequence of hash. */
+static uint32_t
+find_insert_slot(const struct swiss_table *ht, uint32_t hash)
+{
+   uint32_t group_mask = ht->size / SWISS_TABLE_GROUP_SIZE - 1;
+   uint32_t group = _mesa_swiss_table_start_group(group_mask + 1, hash);
+
+   for (uint32_t step = 1;; step++) {
+      uint32_t base = group * SWISS_TABLE_GROUP_SIZE;
+      const uint8_t *ctrl = ht->ctrl + base;
+      uint32_t free_mask =
+         _mesa_swiss_table_group_match(ctrl, SWISS_TABLE_CTRL_EMPTY) |
+         _mesa_swiss_table_group_match(ctrl, SWISS_TABLE_CTRL_DELETED);
+
+      if (free_mask)
+         return base + u_bit_scan(&free_mask);
+
+      group = (group + step) & group_mask;
+   }
+}
+
+static void
+swiss_table_rehash(struct swiss_table *ht, uint32_t new_size)
+{
+   struct swiss_table old_ht = *ht;
+
+   if (!swiss_table_alloc(ht, new_size))
+      return;
+
+   for (uint32_t i = 0; i < old_ht.size; i++) {
+      if (!entry_index_is_present(&old_ht, i))
+         continue;
+
+      struct hash_entry *old_entry = &old_ht.table[i];
+      uint32_t idx = find_insert_slot(ht, old_entry->hash);
+
+      ht->ctrl[idx] = _mesa_swiss_table_h2(old_entry->hash);
+      ht->table[idx] = *old_entry;
+   }
+   ht->entries = old_ht.entries;
+
+   ralloc_free(old_ht.ctrl);
+   ralloc_free(old_ht.table);
+}
+
+static struct hash_entry *
+swiss_table_insert(struct swiss_table *ht, uint32_t hash,
+                   const void *key, void *data)
+{
+   assert(key != NULL);
+
+   /* Implement replacement when another insert happens with a matching key,
+    * like _mesa_hash_table_insert().
+    */
+   struct hash_entry *entry =
+      _mesa_swiss_table_search_inline(ht, hash, key, ht->key_equals_function);
+   if (entry) {
+      entry->key = key;
+      entry->data = data;
+      return entry;
+   }
+
+   if (ht->entries + 1 > ht->max_entries)
+      swiss_table_rehash(ht, ht->size * 2);
+   else if (ht->entries + ht->deleted_entries + 1 > ht->max_entries)
+      swiss_table_rehash(ht, ht->size);
+
+   /* We could hit this if a required resize failed. */
+   if (ht->entries + ht->deleted_entries + 1 > ht->max_entries)
+      return NULL;
+
+   uint32_t idx = find_insert_slot(ht, hash);
+   if (ht->ctrl[idx] == SWISS_TABLE_CTRL_DELETED)
+      ht->deleted_entries--;
+
+   ht->ctrl[idx] = _mesa_swiss_table_h2(hash);
+   entry = &ht->table[idx];
+   entry->hash = hash;
+   entry->key = key;
+   entry->data = data;
+   ht->entries++;
+   return entry;
+}
+
+/**
+ * Inserts the key into the table, replacing the data of an existing entry
+ * with an equal key.
+ *
+ * Note that insertion may rearrange the table on a resize or rehash,
+ * so previously found hash_entries are no longer valid after this function.
+ */
+struct hash_entry *
+_mesa_swiss_table_insert(struct swiss_table *ht, const void *key, void *data)
+{
+   assert(ht->key_hash_function);
+   return swiss_table_insert(ht, ht->key_hash_function(key), key, data);
+}
+
+struct hash_entry *
+_mesa_swiss_table_insert_pre_hashed(struct swiss_table *ht, uint32_t hash,
+                                    const void *key, void *data)
+{
+   assert(ht->key_hash_function == NULL || hash == ht->key_hash_function(key));
+   return swiss_table_insert(ht, hash, key, data);
+}
+
+/**
+ * Finds a swiss table entry with the given key.
+ *
+ * Returns NULL if no entry is found.  Note that the data pointer may be
+ * modified by the user.
+ */
+struct hash_entry *
+_mesa_swiss_table_search(struct swiss_table *ht, const void *key)
+{
+   assert(ht->key_hash_function);
+   if (!ht->entries)
+      return NULL;
+
+   return _mesa_swiss_table_search_inline(ht, ht->key_hash_function(key), key,
+                                          ht->key_equals_function);
+}
+
+struct hash_entry *
+_mesa_swiss_table_search_pre_hashed(struct swiss_table *ht, uint32_t hash,
+                                    const void *key)
+{
+   assert(ht->key_hash_function == NULL || hash == ht->key_hash_function(key));
+   if (!ht->entries)
+      return NULL;
+
+   return _mesa_swiss_table_search_inline(ht, hash, key,
+                                          ht->key_equals_function);
+}
+
+static inline bool
+key_pointer_equal(const void *a, const void *b)
+{
+   return a == b;
+}
+
+/**
+ * Search specialized for tables created with
+ * _mesa_pointer_swiss_table_create(), with the key compare inlined.
+ */
+struct hash_entry *
+_mesa_swiss_table_search_pointer(struct swiss_table *ht, const void *key)
+{
+   assert(ht->key_equals_function == _mesa_key_pointer_equal);
+   if (!ht->entries)
+      return NULL;
+
+   return _mesa_swiss_table_search_inline(ht, _mesa_hash_pointer(key), key,
+                                          key_pointer_equal);
+}
+
+/**
+ * This function deletes the given swiss table entry.
+ *
+ * Note that deletion doesn't otherwise modify the table, so an iteration over
+ * the table deleting entries is safe.
+ */
+void
+_mesa_swiss_table_remove(struct swiss_table *ht, struct hash_entry *entry)
+{
+   if (!entry)
+      return;
+
+   uint32_t idx = entry - ht->table;
+   const uint8_t *group = ht->ctrl + (idx & ~(SWISS_TABLE_GROUP_SIZE - 1));
+
+   assert(entry_index_is_present(ht, idx));
+
+   /* A lookup stops at the first group with an empty slot. If this group
+    * still has one, it has never been full, so no probe sequence continues
+    * past it and the slot can become empty again.
+    */
+   if (_mesa_swiss_table_group_match(group, SWISS_TABLE_CTRL_EMPTY)) {
+      ht->ctrl[idx] = SWISS_TABLE_CTRL_EMPTY;
+   } else {
+      ht->ctrl[idx] = SWISS_TABLE_CTRL_DELETED;
+      ht->deleted_entries++;
+   }
+   entry->key = NULL;
+   ht->entries--;
+}
+
+/**
+ * Removes the entry with the corresponding key, if exists.
+ */
+void
+_mesa_swiss_table_remove_key(struct swiss_table *ht, const void *key)
+{
+   _mesa_swiss_table_remove(ht, _mesa_swiss_table_search(ht, key));
+}
+
+/**
+ * Makes room for at least \p size entries without a rehash.
+ */
+bool
+_mesa_swiss_table_reserve(struct swiss_table *ht, unsigned size)
+{
+   if (size <= ht->max_entries)
+      return true;
+
+   uint32_t new_size = ht->size;
+   while (max_entries_for_size(new_size) < size) {
+      if (new_size >= (1u << 31))
+         return false;
+      new_size *= 2;
+   }
+
+   swiss_table_rehash(ht, new_size);
+   return ht->size == new_size;
+}
+
+/**
+ * This function is an iterator over the swiss table.
+ *
+ * Pass in NULL for the first entry, as in the start of a for loop.  Note that
+ * an iteration over the table is O(table_size) not O(entries).
+ */
+struct hash_entry *
+_mesa_swiss_table_next_entry(struct swiss_table *ht, struct hash_entry *entry)
+{
+   uint32_t idx = entry ? entry - ht->table + 1 : 0;
+
+   for (; idx < ht->size; idx++) {
+      if (entry_index_is_present(ht, idx))
+         return &ht->table[idx];
+   }
+
+   return NULL;
+}
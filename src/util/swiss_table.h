@@ -0,0 +1,206 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * Open-addressing hash table with a separate array of control bytes, probed
+ * a group of 16 slots at a time ("Swiss table").
+ *
+ * Each slot has a control byte that is either empty, deleted, or the low 7
+ * bits of the hash of the key stored in it. A lookup compares the control
+ * bytes of a whole group against the hash with a single SIMD compare, and
+ * only calls the key compare function for the slots that match, which is
+ * almost always just the slot holding the key.
+ *
+ * The entries are struct hash_entry, so code walking them works the same
+ * way as with struct hash_table. Keys can't be NULL, but unlike
+ * struct hash_table there is no reserved deleted key.
+ *
+ * _mesa_swiss_table_search_inline() can be used with a constant compare
+ * function to get it inlined into the probe loop.
+ */
+
+#ifndef _SWISS_TABLE_H
+#define _SWISS_TABLE_H
+
+#include <stdlib.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include "bitscan.h"
+#include "hash_table.h"
+#include "macros.h"
+
+#if defined(__SSE2__) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)) || (defined(_M_X64) && !defined(_M_ARM64EC))
+#include <emmintrin.h>
+#define SWISS_TABLE_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define SWISS_TABLE_NEON
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SWISS_TABLE_GROUP_SIZE 16
+
+#define SWISS_TABLE_CTRL_EMPTY   0x80
+#define SWISS_TABLE_CTRL_DELETED 0xfe
+
+struct swiss_table {
+   uint8_t *ctrl;        /* one control byte per entry */
+   struct hash_entry *table;
+   uint32_t (*key_hash_function)(const void *key);
+   bool (*key_equals_function)(const void *a, const void *b);
+   uint32_t size;        /* power of two, multiple of the group size */
+   uint32_t max_entries; /* 7/8 of size */
+   uint32_t entries;
+   uint32_t deleted_entries;
+};
+
+struct swiss_table *
+_mesa_swiss_table_create(void *mem_ctx,
+                         uint32_t (*key_hash_function)(const void *key),
+                         bool (*key_equals_function)(const void *a,
+                                                     const void *b));
+struct swiss_table *
+_mesa_pointer_swiss_table_create(void *mem_ctx);
+void _mesa_swiss_table_destroy(struct swiss_table *ht,
+                               void (*delete_function)(struct hash_entry *entry));
+void _mesa_swiss_table_clear(struct swiss_table *ht,
+                             void (*delete_function)(struct hash_entry *entry));
+
+static inline uint32_t _mesa_swiss_table_num_entries(struct swiss_table *ht)
+{
+   return ht->entries;
+}
+
+struct hash_entry *
+_mesa_swiss_table_insert(struct swiss_table *ht, const void *key, void *data);
+struct hash_entry *
+_mesa_swiss_table_insert_pre_hashed(struct swiss_table *ht, uint32_t hash,
+                                    const void *key, void *data);
+struct hash_entry *
+_mesa_swiss_table_search(struct swiss_table *ht, const void *key);
+struct hash_entry *
+_mesa_swiss_table_search_pre_hashed(struct swiss_table *ht, uint32_t hash,
+                                    const void *key);
+struct hash_entry *
+_mesa_swiss_table_search_pointer(struct swiss_table *ht, const void *key);
+void _mesa_swiss_table_remove(struct swiss_table *ht,
+                              struct hash_entry *entry);
+void _mesa_swiss_table_remove_key(struct swiss_table *ht,
+                                  const void *key);
+bool _mesa_swiss_table_reserve(struct swiss_table *ht, unsigned size);
+
+struct hash_entry *_mesa_swiss_table_next_entry(struct swiss_table *ht,
+                                                struct hash_entry *entry);
+
+/**
+ * This foreach function is safe against deletion, but not against insertion
+ * (which may rehash the table, making entry a dangling pointer).
+ */
+#define swiss_table_foreach(ht, entry)                                     \
+   for (struct hash_entry *entry = _mesa_swiss_table_next_entry(ht, NULL); \
+        entry != NULL;                                                     \
+        entry = _mesa_swiss_table_next_entry(ht, entry))
+
+/* The low 7 bits of the hash are stored in the control byte. The first
+ * group to probe is picked from the high bits of the hash multiplied by
+ * a Fibonacci constant, so that weak hashes like _mesa_hash_pointer() still
+ * spread over the whole table.
+ */
+static inline uint32_t
+_mesa_swiss_table_start_group(uint32_t num_groups, uint32_t hash)
+{
+   return ((uint64_t)(uint32_t)(hash * 0x9e3779b1u) * num_groups) >> 32;
+}
+
+static inline uint8_t
+_mesa_swiss_table_h2(uint32_t hash)
+{
+   return hash & 0x7f;
+}
+
+/* Return a mask with one bit per slot of the group whose control byte is
+ * equal to \p value.
+ */
+static inline uint32_t
+_mesa_swiss_table_group_match(const uint8_t *group, uint8_t value)
+{
+#if defined(SWISS_TABLE_SSE2)
+   __m128i ctrl = _mm_loadu_si128((const __m128i *)group);
+   return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)value)));
+#elif defined(SWISS_TABLE_NEON)
+   static const uint8_t bits[16] = {
+      1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128,
+   };
+   uint8x16_t eq = vceqq_u8(vld1q_u8(group), vdupq_n_u8(value));
+   uint8x16_t masked = vandq_u8(eq, vld1q_u8(bits));
+   return vaddv_u8(vget_low_u8(masked)) |
+          (vaddv_u8(vget_high_u8(masked)) << 8);
+#else
+   uint32_t mask = 0;
+   for (unsigned i = 0; i < SWISS_TABLE_GROUP_SIZE; i++)
+      mask |= (uint32_t)(group[i] == value) << i;
+   return mask;
+#endif
+}
+
+static ALWAYS_INLINE struct hash_entry *
+_mesa_swiss_table_search_inline(const struct swiss_table *ht, uint32_t hash,
+                                const void *key,
+                                bool (*key_equals_function)(const void *a,
+                                                            const void *b))
+{
+   uint32_t group_mask = ht->size / SWISS_TABLE_GROUP_SIZE - 1;
+   uint32_t group = _mesa_swiss_table_start_group(group_mask + 1, hash);
+   uint8_t h2 = _mesa_swiss_table_h2(hash);
+
+   /* Triangular probing over a power of two number of groups visits every
+    * group, so this terminates as the table always has empty slots.
+    */
+   for (uint32_t step = 1;; step++) {
+      uint32_t base = group * SWISS_TABLE_GROUP_SIZE;
+      const uint8_t *ctrl = ht->ctrl + base;
+      uint32_t match = _mesa_swiss_table_group_match(ctrl, h2);
+
+      while (match) {
+         struct hash_entry *entry = ht->table + base + u_bit_scan(&match);
+
+         if (likely(entry->hash == hash) &&
+             key_equals_function(key, entry->key))
+            return entry;
+      }
+
+      if (_mesa_swiss_table_group_match(ctrl, SWISS_TABLE_CTRL_EMPTY))
+         return NULL;
+
+      group = (group + step) & group_mask;
+   }
+}
+
+#ifdef __cplusplus
+} /* extern C */
+#endif
+
+#endif /* _SWISS_TABLE_H */
@@ -35,8 +35,11 @@
 #include <time.h>
 #include <unistd.h>
 
+#include "util/blob.h"
+#include "util/hash_table.h"
 #include "util/mesa-sha1.h"
 #include "util/disk_cache.h"
+#include "util/disk_cache_os.h"
 
 bool error = false;
 
@@ -587,6 +590,403 @@ test_put_and_get_between_instances()
    disk_cache_destroy(cache1);
    disk_cache_destroy(cache2);
 }
+
+static void
+fill_incompressible(uint8_t *data, size_t size, uint32_t seed)
+{
+   for (size_t i = 0; i < size; i++) {
+      seed = seed * 1103515245 + 12345;
+      data[i] = seed >> 16;
+   }
+}
+
+static void
+test_single_file_size_limit(void)
+{
+   struct disk_cache *cache;
+   uint8_t data[1024];
+   uint8_t used_key[20], unused_key[20], last_key[20];
+   char *result;
+   size_t size;
+
+#ifdef SHADER_CACHE_DISABLE_BY_DEFAULT
+   setenv("MESA_GLSL_CACHE_DISABLE", "false", 1);
+#endif /* SHADER_CACHE_DISABLE_BY_DEFAULT */
+
+   /* Each generation of the single file cache holds half of the maximum
+    * size, so this fits a handful of 1KB items per generation.
+    */
+   setenv("MESA_GLSL_CACHE_MAX_SIZE", "16K", 1);
+   cache = disk_cache_create("test_size_limit", "make_check", 0);
+
+   fill_incompressible(data, sizeof(data), 1);
+   disk_cache_compute_key(cache, data, sizeof(data), used_key);
+   disk_cache_put(cache, used_key, data, sizeof(data), NULL);
+
+   fill_incompressible(data, sizeof(data), 2);
+   disk_cache_compute_key(cache, data, sizeof(data), unused_key);
+   disk_cache_put(cache, unused_key, data, sizeof(data), NULL);
+
+   disk_cache_wait_for_idle(cache);
+
+   /* Keep reading one item while filling the cache well past its maximum
+    * size, the other one is never used again and must get evicted.
+    */
+   for (uint32_t i = 0; i < 64; i++) {
+      fill_incompressible(data, sizeof(data), 3 + i);
+      disk_cache_compute_key(cache, data, sizeof(data), last_key);
+      disk_cache_put(cache, last_key, data, sizeof(data), NULL);
+      disk_cache_wait_for_idle(cache);
+
+      result = disk_cache_get(cache, used_key, &size);
+      expect_non_null(result, "disk_cache_get of item in use with MAX_SIZE=16K");
+      expect_equal(size, sizeof(data), "disk_cache_get of item in use with "
+                   "MAX_SIZE=16K (size)");
+      free(result);
+
+      /* Items read from the previous generation are copied forward by the
+       * cache thread.
+       */
+      disk_cache_wait_for_idle(cache);
+   }
+
+   expect_true(does_cache_contain(cache, last_key),
+               "single file cache contains last item with MAX_SIZE=16K");
+   expect_false(does_cache_contain(cache, unused_key),
+                "single file cache eviction with MAX_SIZE=16K");
+
+   /* Items too big for a generation must not be cached.  If each of them
+    * started a new generation, the last small item would be evicted.
+    */
+   uint8_t big_data[12 * 1024], big_key[20];
+   for (uint32_t i = 0; i < 3; i++) {
+      fill_incompressible(big_data, sizeof(big_data), 100 + i);
+      disk_cache_compute_key(cache, big_data, sizeof(big_data), big_key);
+      disk_cache_put(cache, big_key, big_data, sizeof(big_data), NULL);
+      disk_cache_wait_for_idle(cache);
+
+      expect_false(does_cache_contain(cache, big_key),
+                   "single file cache skips item bigger than a generation");
+   }
+   expect_true(does_cache_contain(cache, last_key),
+               "single file cache keeps items when skipping big items");
+
+   disk_cache_destroy(cache);
+
+   unsetenv("MESA_GLSL_CACHE_MAX_SIZE");
+}
+
+static void
+test_single_file_metadata_promotion(void)
+{
+   struct disk_cache *cache;
+   uint8_t data[1024];
+   uint8_t key[20], filler_key[20];
+   cache_key metadata_keys[2];
+   char *result;
+
+   /* Same generation size as test_single_file_size_limit(). */
+   setenv("MESA_GLSL_CACHE_MAX_SIZE", "16K", 1);
+   cache = disk_cache_create("test_metadata_promotion", "make_check", 0);
+
+   memset(metadata_keys[0], 0x11, sizeof(cache_key));
+   memset(metadata_keys[1], 0x22, sizeof(cache_key));
+   struct cache_item_metadata metadata = {
+      .type = CACHE_ITEM_TYPE_GLSL,
+      .keys = metadata_keys,
+      .num_keys = 2,
+   };
+
+   fill_incompressible(data, sizeof(data), 1000);
+   disk_cache_compute_key(cache, data, sizeof(data), key);
+   disk_cache_put(cache, key, data, sizeof(data), &metadata);
+   disk_cache_wait_for_idle(cache);
+
+   /* Fill the cache until the item has moved to the previous generation. */
+   bool from_prev_gen = false;
+   for (uint32_t i = 0; i < 64 && !from_prev_gen; i++) {
+      fill_incompressible(data, sizeof(data), 1001 + i);
+      disk_cache_compute_key(cache, data, sizeof(data), filler_key);
+      disk_cache_put(cache, filler_key, data, sizeof(data), NULL);
+      disk_cache_wait_for_idle(cache);
+
+      foz_release_entry(&cache->foz_db,
+                        foz_read_entry(&cache->foz_db, key, NULL,
+                                       &from_prev_gen));
+   }
+   expect_true(from_prev_gen, "item moved to the previous generation");
+
+   /* Reading it copies it forward to the current generation. */
+   result = disk_cache_get(cache, key, NULL);
+   expect_non_null(result, "disk_cache_get of item in previous generation");
+   free(result);
+   disk_cache_wait_for_idle(cache);
+
+   size_t size;
+   const uint8_t *item = foz_read_entry(&cache->foz_db, key, &size,
+                                        &from_prev_gen);
+   expect_non_null((void *)item, "promoted item is in the foz db");
+   expect_false(from_prev_gen, "promoted item is in the current generation");
+
+   if (item) {
+      /* The driver keys blob is followed by the metadata. */
+      struct blob_reader blob;
+      blob_reader_init(&blob, item, size);
+      blob_skip_bytes(&blob, cache->driver_keys_blob_size);
+
+      expect_equal(blob_read_uint32(&blob), CACHE_ITEM_TYPE_GLSL,
+                   "promoted item keeps its metadata type");
+      expect_equal(blob_read_uint32(&blob), 2,
+                   "promoted item keeps its metadata keys");
+      const void *keys = blob_read_bytes(&blob, sizeof(metadata_keys));
+      expect_true(!blob.overrun &&
+                  memcmp(keys, metadata_keys, sizeof(metadata_keys)) == 0,
+                  "promoted item keeps its metadata key values");
+      foz_release_entry(&cache->foz_db, item);
+   }
+
+   disk_cache_destroy(cache);
+
+   unsetenv("MESA_GLSL_CACHE_MAX_SIZE");
+}
+
+static unsigned
+count_hash_table_entries(struct disk_cache *cache, unsigned file_idx)
+{
+   unsigned count = 0;
+   hash_table_foreach(cache->foz_db.index_db->table, he) {
+      struct foz_db_entry *entry = he->data;
+      if (entry->file_idx == file_idx)
+         count++;
+   }
+   return count;
+}
+
+static void
+test_single_file_sorted_idx(void)
+{
+   struct disk_cache *cache;
+   uint8_t data[256];
+   uint8_t keys[100][20];
+
+   cache = disk_cache_create("test_sorted_idx", "make_check", 0);
+
+   for (uint32_t i = 0; i < ARRAY_SIZE(keys); i++) {
+      fill_incompressible(data, sizeof(data), 2000 + i);
+      disk_cache_compute_key(cache, data, sizeof(data), keys[i]);
+      disk_cache_put(cache, keys[i], data, sizeof(data), NULL);
+   }
+   disk_cache_wait_for_idle(cache);
+
+   expect_true(count_hash_table_entries(cache, 0) >= ARRAY_SIZE(keys),
+               "entries written are in the hash table");
+   disk_cache_destroy(cache);
+
+   /* The next instance moves them to the sorted idx when loading them. */
+   cache = disk_cache_create("test_sorted_idx", "make_check", 0);
+
+   expect_equal(count_hash_table_entries(cache, 0), 0,
+                "no entries left in the hash table");
+   expect_true(cache->foz_db.sorted_idx_count[0] >= ARRAY_SIZE(keys),
+               "entries in the sorted idx");
+
+   bool found_all = true;
+   for (uint32_t i = 0; i < ARRAY_SIZE(keys); i++) {
+      fill_incompressible(data, sizeof(data), 2000 + i);
+
+      size_t size;
+      void *result = disk_cache_get(cache, keys[i], &size);
+      found_all &= result && size == sizeof(data) &&
+                   memcmp(result, data, sizeof(data)) == 0;
+      free(result);
+   }
+   expect_true(found_all, "disk_cache_get of entries in the sorted idx");
+
+   /* Entries written after it are still found through the hash table. */
+   uint8_t key[20];
+   fill_incompressible(data, sizeof(data), 3000);
+   disk_cache_compute_key(cache, data, sizeof(data), key);
+   disk_cache_put(cache, key, data, sizeof(data), NULL);
+   disk_cache_wait_for_idle(cache);
+
+   expect_equal(count_hash_table_entries(cache, 0), 1,
+                "entry written after the sorted idx in the hash table");
+   expect_true(does_cache_contain(cache, key),
+               "disk_cache_get of entry written after the sorted idx");
+
+   disk_cache_destroy(cache);
+}
+
+/* Fills data with text that mostly repeats across seeds, like the IR of
+ * different shaders does.
+ */
+static void
+fill_shader_like(uint8_t *data, size_t size, uint32_t seed)
+{
+   char line[64];
+   size_t offset = 0;
+
+   for (uint32_t i = 0; offset < size; i++) {
+      seed = seed * 1103515245 + 12345;
+      int len = snprintf(line, sizeof(line),
+                         "vec4 32 ssa_%u = fadd ssa_%u, ssa_%u.xxxx\n",
+                         i, (seed >> 16) % 64, (seed >> 8) % 64);
+      len = MIN2(len, size - offset);
+      memcpy(data + offset, line, len);
+      offset += len;
+   }
+}
+
+static void
+expect_round_trip(struct disk_cache *cache, const cache_key key,
+                  const uint8_t *data, size_t data_size, const char *test)
+{
+   size_t size;
+   void *result = disk_cache_get(cache, key, &size);
+
+   expect_true(result && size == data_size &&
+               memcmp(result, data, data_size) == 0, test);
+   free(result);
+}
+
+static void
+test_compression(void)
+{
+   struct disk_cache *cache;
+   uint8_t small[32], compressible[4096], incompressible[4096];
+   uint8_t small_key[20], compressible_key[20], incompressible_key[20];
+
+   memset(small, 'a', sizeof(small));
+   fill_shader_like(compressible, sizeof(compressible), 1);
+   fill_incompressible(incompressible, sizeof(incompressible), 2);
+
+   setenv("MESA_DISK_CACHE_STATS", "true", 1);
+
+   /* Level 0 stores everything uncompressed. */
+   setenv("MESA_DISK_CACHE_COMPRESSION_LEVEL", "0", 1);
+   cache = disk_cache_create("test_compression_level_0", "make_check", 0);
+
+   disk_cache_compute_key(cache, compressible, sizeof(compressible),
+                          compressible_key);
+   disk_cache_put(cache, compressible_key, compressible,
+                  sizeof(compressible), NULL);
+   disk_cache_wait_for_idle(cache);
+
+   expect_round_trip(cache, compressible_key, compressible,
+                     sizeof(compressible), "round trip with level 0");
+   expect_equal(cache->stats_items_written, 1, "level 0 items written");
+   expect_equal(cache->stats_items_uncompressed, 1,
+                "level 0 items stored uncompressed");
+   expect_equal(cache->stats_bytes_out, cache->stats_bytes_in,
+                "level 0 bytes stored");
+
+   disk_cache_destroy(cache);
+   unsetenv("MESA_DISK_CACHE_COMPRESSION_LEVEL");
+
+   /* With the default level, only items that get smaller are compressed,
+    * and small ones are never tried.
+    */
+   cache = disk_cache_create("test_compression_default", "make_check", 0);
+
+   disk_cache_compute_key(cache, small, sizeof(small), small_key);
+   disk_cache_put(cache, small_key, small, sizeof(small), NULL);
+   disk_cache_compute_key(cache, compressible, sizeof(compressible),
+                          compressible_key);
+   disk_cache_put(cache, compressible_key, compressible,
+                  sizeof(compressible), NULL);
+   disk_cache_compute_key(cache, incompressible, sizeof(incompressible),
+                          incompressible_key);
+   disk_cache_put(cache, incompressible_key, incompressible,
+                  sizeof(incompressible), NULL);
+   disk_cache_wait_for_idle(cache);
+
+   expect_round_trip(cache, small_key, small, sizeof(small),
+                     "round trip of small item");
+   expect_round_trip(cache, compressible_key, compressible,
+                     sizeof(compressible), "round trip of compressed item");
+   expect_round_trip(cache, incompressible_key, incompressible,
+                     sizeof(incompressible),
+                     "round trip of incompressible item");
+
+   expect_equal(cache->stats_items_written, 3, "items written");
+   expect_equal(cache->stats_items_uncompressed, 2,
+                "small and incompressible items stored uncompressed");
+   expect_equal(cache->stats_bytes_in,
+                sizeof(small) + sizeof(compressible) + sizeof(incompressible),
+                "bytes written");
+   expect_true(cache->stats_bytes_out < cache->stats_bytes_in &&
+               cache->stats_bytes_out > sizeof(small) + sizeof(incompressible),
+               "bytes stored");
+   expect_equal(cache->stats_items_read, 3, "items read");
+
+   disk_cache_destroy(cache);
+   unsetenv("MESA_DISK_CACHE_STATS");
+}
+
+static void
+test_compression_dict(void)
+{
+   struct disk_cache *cache;
+   uint8_t data[2048], first_key[20], key[20];
+
+   unsetenv("MESA_GLSL_CACHE_MAX_SIZE");
+   setenv("MESA_DISK_CACHE_STATS", "true", 1);
+   cache = disk_cache_create("test_compression_dict", "make_check", 0);
+
+   /* Enough items to train the dictionary from. */
+   for (uint32_t i = 0; i < 128; i++) {
+      fill_shader_like(data, sizeof(data), i);
+      disk_cache_compute_key(cache, data, sizeof(data), key);
+      disk_cache_put(cache, key, data, sizeof(data), NULL);
+      if (i == 0)
+         memcpy(first_key, key, sizeof(key));
+   }
+   disk_cache_wait_for_idle(cache);
+
+#ifdef HAVE_ZSTD
+   expect_non_null(cache->dict, "dictionary trained from the first items");
+#else
+   expect_null(cache->dict, "no dictionary without zstd");
+#endif
+
+   fill_shader_like(data, sizeof(data), 1000);
+   disk_cache_compute_key(cache, data, sizeof(data), key);
+   disk_cache_put(cache, key, data, sizeof(data), NULL);
+   disk_cache_wait_for_idle(cache);
+
+   expect_round_trip(cache, key, data, sizeof(data),
+                     "round trip of item written with the dictionary");
+#ifdef HAVE_ZSTD
+   expect_equal(cache->stats_items_dict, 1,
+                "items compressed with the dictionary");
+#endif
+
+   disk_cache_destroy(cache);
+   unsetenv("MESA_DISK_CACHE_STATS");
+
+   /* Other instances load the dictionary from the cache directory. */
+   cache = disk_cache_create("test_compression_dict", "make_check", 0);
+#ifdef HAVE_ZSTD
+   expect_non_null(cache->dict, "dictionary loaded by a new instance");
+#endif
+   expect_round_trip(cache, key, data, sizeof(data),
+                     "round trip of item written with the dictionary by "
+                     "another instance");
+   disk_cache_destroy(cache);
+
+   /* Without it, items written with it are a miss. */
+   setenv("MESA_DISK_CACHE_COMPRESSION_DICT", "false", 1);
+   cache = disk_cache_create("test_compression_dict", "make_check", 0);
+   expect_null(cache->dict, "dictionary disabled");
+#ifdef HAVE_ZSTD
+   expect_false(does_cache_contain(cache, key),
+                "item written with the dictionary without it");
+#endif
+   expect_true(does_cache_contain(cache, first_key),
+               "item written before the dictionary without it");
+   disk_cache_destroy(cache);
+   unsetenv("MESA_DISK_CACHE_COMPRESSION_DICT");
+}
 #endif /* ENABLE_SHADER_CACHE */
 
 static void
@@ -602,6 +1002,10 @@ test_multi_file_cache(void)
 
    test_put_key_and_get_key();
 
+   test_compression();
+
+   test_compression_dict();
+
    printf("Test multi file disk cache - End\n");
 
    err = rmrf_local(CACHE_TEST_TMP);
@@ -619,8 +1023,8 @@ test_single_file_cache(void)
 
    test_disk_cache_create(CACHE_DIR_NAME_SF);
 
-   /* We skip testing cache size limit as the single file cache currently
-    * doesn't have any functionality to enforce cache size limits.
+   /* The single file cache evicts whole generations rather than single
+    * items, so it has its own cache size limit test.
     */
    test_put_and_get(false);
 
@@ -628,6 +1032,16 @@ test_single_file_cache(void)
 
    test_put_and_get_between_instances();
 
+   test_single_file_size_limit();
+
+   test_single_file_metadata_promotion();
+
+   test_single_file_sorted_idx();
+
+   test_compression();
+
+   test_compression_dict();
+
    setenv("MESA_DISK_CACHE_SINGLE_FILE", "false", 1);
 
    printf("Test single file disk cache - End\n");
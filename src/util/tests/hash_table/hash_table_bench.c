@@ -0,0 +1,154 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Compares struct hash_table and struct swiss_table for insertions, lookups
+ * of present keys and lookups of missing keys.
+ *
+ *    hash_table_bench [num_keys] [num_lookups]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "hash_table.h"
+#include "swiss_table.h"
+#include "os_time.h"
+#include "rand_xor.h"
+
+struct bench_result {
+   double insert_ns, hit_ns, miss_ns;
+   uintptr_t checksum;
+};
+
+static uint32_t
+key_value_hash(const void *key)
+{
+   return _mesa_hash_uint(key);
+}
+
+static bool
+key_value_equals(const void *a, const void *b)
+{
+   return *(const uint32_t *)a == *(const uint32_t *)b;
+}
+
+#define BENCH(ht, ht_create, insert, search)                               \
+   do {                                                                    \
+      int64_t start = os_time_get_nano();                                  \
+      ht = ht_create;                                                      \
+      for (unsigned i = 0; i < num_keys; i++)                              \
+         insert(ht, keys[i], keys[i]);                                     \
+      int64_t inserted = os_time_get_nano();                               \
+      for (unsigned i = 0; i < num_lookups; i++) {                         \
+         struct hash_entry *entry = search(ht, keys[order[i]]);            \
+         r.checksum += (uintptr_t)entry->data;                             \
+      }                                                                    \
+      int64_t hits = os_time_get_nano();                                   \
+      for (unsigned i = 0; i < num_lookups; i++)                           \
+         r.checksum += search(ht, missing[order[i]]) != NULL;              \
+      int64_t misses = os_time_get_nano();                                 \
+      r.insert_ns = (double)(inserted - start) / num_keys;                 \
+      r.hit_ns = (double)(hits - inserted) / num_lookups;                  \
+      r.miss_ns = (double)(misses - hits) / num_lookups;                   \
+   } while (0)
+
+static void
+print_result(const char *name, struct bench_result r)
+{
+   printf("  %-30s insert %7.2f ns  hit %7.2f ns  miss %7.2f ns\n",
+          name, r.insert_ns, r.hit_ns, r.miss_ns);
+}
+
+int
+main(int argc, char **argv)
+{
+   unsigned num_keys = argc > 1 ? atoi(argv[1]) : 100000;
+   unsigned num_lookups = argc > 2 ? atoi(argv[2]) : 4000000;
+   uint64_t seed[2];
+
+   s_rand_xorshift128plus(seed, false);
+
+   uint32_t *values = malloc(2 * num_keys * sizeof(*values));
+   void **keys = malloc(num_keys * sizeof(*keys));
+   void **missing = malloc(num_keys * sizeof(*missing));
+   unsigned *order = malloc(num_lookups * sizeof(*order));
+
+   /* Heap allocated objects like the CSO and NIR keys, and missing keys
+    * that are allocated the same way.
+    */
+   for (unsigned i = 0; i < num_keys; i++) {
+      values[2 * i] = i;
+      values[2 * i + 1] = num_keys + i;
+      keys[i] = &values[2 * i];
+      missing[i] = &values[2 * i + 1];
+   }
+   for (unsigned i = 0; i < num_lookups; i++)
+      order[i] = rand_xorshift128plus(seed) % num_keys;
+
+   printf("%u keys, %u lookups\n", num_keys, num_lookups);
+
+   for (unsigned pass = 0; pass < 2; pass++) {
+      struct bench_result r;
+      bool pointer_keys = pass == 0;
+
+      printf("%s keys:\n", pointer_keys ? "pointer" : "u32 value");
+
+      struct hash_table *ht;
+      memset(&r, 0, sizeof(r));
+      if (pointer_keys) {
+         BENCH(ht, _mesa_pointer_hash_table_create(NULL),
+               _mesa_hash_table_insert, _mesa_hash_table_search);
+      } else {
+         BENCH(ht, _mesa_hash_table_create(NULL, key_value_hash, key_value_equals),
+               _mesa_hash_table_insert, _mesa_hash_table_search);
+      }
+      _mesa_hash_table_destroy(ht, NULL);
+      print_result("hash_table", r);
+
+      struct swiss_table *st;
+      memset(&r, 0, sizeof(r));
+      if (pointer_keys) {
+         BENCH(st, _mesa_pointer_swiss_table_create(NULL),
+               _mesa_swiss_table_insert, _mesa_swiss_table_search);
+         _mesa_swiss_table_destroy(st, NULL);
+         print_result("swiss_table", r);
+
+         memset(&r, 0, sizeof(r));
+         BENCH(st, _mesa_pointer_swiss_table_create(NULL),
+               _mesa_swiss_table_insert, _mesa_swiss_table_search_pointer);
+         _mesa_swiss_table_destroy(st, NULL);
+         print_result("swiss_table (inlined compare)", r);
+      } else {
+         BENCH(st, _mesa_swiss_table_create(NULL, key_value_hash, key_value_equals),
+               _mesa_swiss_table_insert, _mesa_swiss_table_search);
+         _mesa_swiss_table_destroy(st, NULL);
+         print_result("swiss_table", r);
+      }
+   }
+
+   free(values);
+   free(keys);
+   free(missing);
+   free(order);
+   return 0;
+}
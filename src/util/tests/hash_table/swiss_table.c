@@ -0,0 +1,145 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#undef NDEBUG
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "swiss_table.h"
+
+#define SIZE 10000
+
+static uint32_t
+key_value(const void *key)
+{
+   return *(const uint32_t *)key;
+}
+
+static bool
+uint32_t_key_equals(const void *a, const void *b)
+{
+   return key_value(a) == key_value(b);
+}
+
+/* All keys in the same 16 slot groups, to exercise the probing. */
+static uint32_t
+bad_hash(const void *key)
+{
+   return key_value(key) & 0x3f;
+}
+
+static void
+test_insert_remove(uint32_t (*hash)(const void *key))
+{
+   struct swiss_table *ht;
+   struct hash_entry *entry;
+   static uint32_t keys[SIZE];
+   uint32_t i;
+
+   ht = _mesa_swiss_table_create(NULL, hash, uint32_t_key_equals);
+
+   for (i = 0; i < SIZE; i++) {
+      keys[i] = i;
+      _mesa_swiss_table_insert(ht, keys + i, (void *)(uintptr_t)i);
+   }
+   assert(ht->entries == SIZE);
+
+   /* Replacement keeps a single entry per key. */
+   uint32_t dup = 42;
+   _mesa_swiss_table_insert(ht, &dup, NULL);
+   assert(ht->entries == SIZE);
+   assert(_mesa_swiss_table_search(ht, keys + 42)->key == &dup);
+
+   for (i = 0; i < SIZE; i += 2)
+      _mesa_swiss_table_remove_key(ht, keys + i);
+   assert(ht->entries == SIZE / 2);
+
+   for (i = 0; i < SIZE; i++) {
+      entry = _mesa_swiss_table_search(ht, keys + i);
+      if (i % 2) {
+         assert(entry);
+         assert(key_value(entry->key) == i);
+         assert(entry->data == (void *)(uintptr_t)i);
+      } else {
+         assert(!entry);
+      }
+   }
+
+   /* Reuse the deleted slots. */
+   for (i = 0; i < SIZE; i += 2)
+      _mesa_swiss_table_insert(ht, keys + i, NULL);
+   assert(ht->entries == SIZE);
+
+   uint32_t count = 0;
+   swiss_table_foreach(ht, entry) {
+      assert(_mesa_swiss_table_search(ht, entry->key) == entry);
+      _mesa_swiss_table_remove(ht, entry);
+      count++;
+   }
+   assert(count == SIZE);
+   assert(ht->entries == 0);
+
+   _mesa_swiss_table_destroy(ht, NULL);
+}
+
+static void
+test_pointer_keys(void)
+{
+   struct swiss_table *ht = _mesa_pointer_swiss_table_create(NULL);
+   static char storage[SIZE];
+   uint32_t i;
+
+   assert(_mesa_swiss_table_reserve(ht, SIZE));
+   uint32_t size = ht->size;
+
+   for (i = 0; i < SIZE; i++)
+      _mesa_swiss_table_insert(ht, storage + i, storage + i);
+   assert(ht->size == size);
+
+   for (i = 0; i < SIZE; i++) {
+      struct hash_entry *entry = _mesa_swiss_table_search_pointer(ht, storage + i);
+      assert(entry && entry->data == storage + i);
+      assert(_mesa_swiss_table_search(ht, storage + i) == entry);
+   }
+
+   _mesa_swiss_table_clear(ht, NULL);
+   assert(ht->entries == 0);
+   assert(!_mesa_swiss_table_search_pointer(ht, storage));
+
+   _mesa_swiss_table_destroy(ht, NULL);
+}
+
+int
+main(int argc, char **argv)
+{
+   (void) argc;
+   (void) argv;
+
+   test_insert_remove(key_value);
+   test_insert_remove(bad_hash);
+   test_pointer_keys();
+
+   return 0;
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <string.h>
+#include <gtest/gtest.h>
+#include "util/ralloc.h"
+
+TEST(linear_alloc, zero_size_children_are_distinct)
+{
+   void *parent = linear_alloc_parent(NULL, 0);
+   void *a = linear_alloc_child(parent, 0);
+   void *b = linear_alloc_child(parent, 0);
+
+   EXPECT_NE(parent, a);
+   EXPECT_NE(parent, b);
+   EXPECT_NE(a, b);
+
+   linear_free_parent(parent);
+}
+
+TEST(linear_alloc, realloc_last_child_in_place)
+{
+   void *parent = linear_alloc_parent(NULL, 0);
+   char *a = (char *)linear_alloc_child(parent, 16);
+   memset(a, 'a', 16);
+
+   char *b = (char *)linear_realloc(parent, a, 16, 256);
+   EXPECT_EQ(a, b);
+   for (unsigned i = 0; i < 16; i++)
+      EXPECT_EQ(b[i], 'a');
+   memset(b, 'b', 256);
+
+   /* The grown allocation must not overlap the next one. */
+   char *c = (char *)linear_alloc_child(parent, 16);
+   EXPECT_GE(c, b + 256);
+
+   linear_free_parent(parent);
+}
+
+TEST(linear_alloc, realloc_copies_other_children)
+{
+   void *parent = linear_alloc_parent(NULL, 0);
+   char *a = (char *)linear_alloc_child(parent, 16);
+   memset(a, 'a', 16);
+   char *b = (char *)linear_alloc_child(parent, 16);
+   memset(b, 'b', 16);
+
+   /* a isn't the last allocation anymore, so it has to move. */
+   char *c = (char *)linear_realloc(parent, a, 16, 64);
+   EXPECT_NE(a, c);
+   for (unsigned i = 0; i < 16; i++)
+      EXPECT_EQ(c[i], 'a');
+   for (unsigned i = 0; i < 16; i++)
+      EXPECT_EQ(b[i], 'b');
+
+   /* The last allocation moves too once it no longer fits its buffer. */
+   char *d = (char *)linear_realloc(parent, c, 64, 1024 * 1024);
+   EXPECT_NE(c, d);
+   for (unsigned i = 0; i < 16; i++)
+      EXPECT_EQ(d[i], 'a');
+   memset(d, 'd', 1024 * 1024);
+
+   linear_free_parent(parent);
+}
+
+TEST(linear_alloc, large_child_gets_own_buffer)
+{
+   void *parent = linear_alloc_parent(NULL, 0);
+   char *a = (char *)linear_alloc_child(parent, 8);
+
+   char *big = (char *)linear_alloc_child(parent, 256 * 1024);
+   ASSERT_NE(big, nullptr);
+   memset(big, 'x', 256 * 1024);
+
+   /* Small allocations keep using the space left in the current buffer. */
+   char *b = (char *)linear_alloc_child(parent, 8);
+   EXPECT_EQ(b, a + 8);
+   EXPECT_TRUE(b + 8 <= big || b >= big + 256 * 1024);
+
+   linear_free_parent(parent);
+}
+
+TEST(linear_alloc, strings)
+{
+   void *parent = linear_alloc_parent(NULL, 0);
+   char *first = linear_strdup(parent, "first");
+   char *str = linear_strdup(parent, "a");
+
+   for (unsigned i = 0; i < 1000; i++)
+      EXPECT_TRUE(linear_asprintf_append(parent, &str, "%u", i % 10));
+
+   EXPECT_EQ(strlen(str), 1001u);
+   EXPECT_EQ(str[0], 'a');
+   EXPECT_EQ(str[1000], '9');
+   EXPECT_STREQ(first, "first");
+
+   size_t start = 1;
+   EXPECT_TRUE(linear_asprintf_rewrite_tail(parent, &str, &start, "[%d]", 42));
+   EXPECT_STREQ(str, "a[42]");
+   EXPECT_EQ(start, 5u);
+
+   linear_free_parent(parent);
+}
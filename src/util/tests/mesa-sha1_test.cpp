@@ -22,6 +22,7 @@
  */
 
 #include "mesa-sha1.h"
+#include "macros.h"
 
 #include <gtest/gtest.h>
 
@@ -36,6 +37,10 @@ static const Params test_data[] = {
    {"Mesa Rocks! 273", "7fb99737373d65a73f049cdabc01e73aa6bc60f3"},
    {"Mesa Rocks! 300", "b2180263e37d3bed6a4be0afe41b1a82ebbcf4c3"},
    {"Mesa Rocks! 583", "7fb9734108a62503e8a149c1051facd7fb112d05"},
+   /* FIPS PUB 180-1 */
+   {"abc", "a9993e364706816aba3e25717850c26c9cd0d89d"},
+   {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+    "84983e441c3bd26ebaae4aa1f95129e5e54670f1"},
 };
 
 class MesaSHA1TestFixture : public testing::TestWithParam<Params> {};
@@ -57,3 +62,24 @@ TEST_P(MesaSHA1TestFixture, Match)
       << "\t  Actual: " << buf << "\n"
       << "\tExpected: " << p.expected_sha1 << "\n";
 }
+
+/* Hash a million 'a' in uneven pieces, so that the multi-block path is used
+ * with and without a partially filled buffer.
+ */
+TEST(MesaSHA1Test, MillionA)
+{
+   static char data[1000000];
+   memset(data, 'a', sizeof(data));
+
+   struct mesa_sha1 ctx;
+   _mesa_sha1_init(&ctx);
+   for (size_t i = 0, n = 1; i < sizeof(data); i += n, n = n * 3 + 1)
+      _mesa_sha1_update(&ctx, data + i, MIN2(n, sizeof(data) - i));
+
+   unsigned char sha1[20];
+   _mesa_sha1_final(&ctx, sha1);
+
+   char buf[41];
+   _mesa_sha1_format(buf, sha1);
+   EXPECT_STREQ(buf, "34aa973cd4c4daa4f61eeb2bdbad27316534016f");
+}
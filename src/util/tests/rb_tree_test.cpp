@@ -227,3 +227,68 @@ TEST(RBTreeTest, InsertAndSearch)
         validate_search(&tree, i + 1, ARRAY_SIZE(test_numbers) - 1);
     }
 }
+
+struct rb_count_node {
+    int key;
+    unsigned count; /* Number of nodes in the subtree */
+    struct rb_node node;
+};
+
+static unsigned
+rb_count_subtree(struct rb_node *n)
+{
+    return n ? rb_node_data(struct rb_count_node, n, node)->count : 0;
+}
+
+static void
+rb_count_augment(struct rb_node *n)
+{
+    struct rb_count_node *cn = rb_node_data(struct rb_count_node, n, node);
+    cn->count = 1 + rb_count_subtree(n->left) + rb_count_subtree(n->right);
+}
+
+static unsigned
+validate_counts(struct rb_node *n)
+{
+    if (n == NULL)
+        return 0;
+
+    unsigned count = 1 + validate_counts(n->left) + validate_counts(n->right);
+    assert(rb_count_subtree(n) == count);
+    return count;
+}
+
+TEST(RBTreeTest, Augmented)
+{
+    struct rb_count_node nodes[ARRAY_SIZE(test_numbers)];
+    struct rb_tree tree;
+
+    rb_tree_init(&tree);
+
+    for (unsigned i = 0; i < ARRAY_SIZE(test_numbers); i++) {
+        struct rb_node *parent = NULL;
+        bool insert_left = false;
+        for (struct rb_node *n = tree.root; n;) {
+            parent = n;
+            insert_left = test_numbers[i] <
+                          rb_node_data(struct rb_count_node, n, node)->key;
+            n = insert_left ? n->left : n->right;
+        }
+
+        nodes[i].key = test_numbers[i];
+        rb_augmented_tree_insert_at(&tree, parent, &nodes[i].node,
+                                    insert_left, rb_count_augment);
+        rb_tree_validate(&tree);
+        assert(validate_counts(tree.root) == i + 1);
+    }
+
+    /* Remove from the middle of the array so that both leaves and inner
+     * nodes get removed.
+     */
+    for (unsigned i = 0; i < ARRAY_SIZE(test_numbers); i++) {
+        unsigned idx = (i * 37) % ARRAY_SIZE(test_numbers);
+        rb_augmented_tree_remove(&tree, &nodes[idx].node, rb_count_augment);
+        rb_tree_validate(&tree);
+        assert(validate_counts(tree.root) == ARRAY_SIZE(test_numbers) - i - 1);
+    }
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Times building and coloring synthetic interference graphs, made of the
+ * overlapping live ranges of num_nodes values in a straight-line program.
+ *
+ *    register_allocate_bench [num_nodes] [max_live]
+ *
+ * Values are 1, 2 or 4 registers wide, out of 128, and about max_live of
+ * them are live at any point.  This is run once with contiguous register
+ * classes and once with classes built from register conflicts.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "macros.h"
+#include "os_time.h"
+#include "ralloc.h"
+#include "register_allocate.h"
+
+#define NUM_REGS 128
+
+static const unsigned widths[] = { 1, 2, 4 };
+
+struct live_range {
+   unsigned start, end;
+   unsigned width;
+};
+
+static struct ra_regs *
+make_contig_regs(void *mem_ctx, struct ra_class **classes)
+{
+   struct ra_regs *regs = ra_alloc_reg_set(mem_ctx, NUM_REGS, false);
+
+   for (unsigned c = 0; c < ARRAY_SIZE(widths); c++) {
+      classes[c] = ra_alloc_contig_reg_class(regs, widths[c]);
+      for (unsigned r = 0; r + widths[c] <= NUM_REGS; r += widths[c])
+         ra_class_add_reg(classes[c], r);
+   }
+
+   ra_set_finalize(regs, NULL);
+   return regs;
+}
+
+/* Aligned groups of 1, 2 and 4 registers as separate registers, with
+ * conflicts to the base registers they cover.
+ */
+static struct ra_regs *
+make_conflict_regs(void *mem_ctx, struct ra_class **classes)
+{
+   unsigned count = NUM_REGS + NUM_REGS / 2 + NUM_REGS / 4;
+   struct ra_regs *regs = ra_alloc_reg_set(mem_ctx, count, true);
+   unsigned reg = 0;
+
+   for (unsigned c = 0; c < ARRAY_SIZE(widths); c++) {
+      classes[c] = ra_alloc_reg_class(regs);
+      for (unsigned base = 0; base < NUM_REGS; base += widths[c], reg++) {
+         ra_class_add_reg(classes[c], reg);
+         for (unsigned i = 1; c > 0 && i <= widths[c]; i++)
+            ra_add_transitive_reg_conflict(regs, base + i - 1, reg);
+      }
+   }
+
+   ra_set_finalize(regs, NULL);
+   return regs;
+}
+
+static void
+make_live_ranges(struct live_range *ranges, unsigned num_nodes,
+                 unsigned max_live)
+{
+   /* A value defined every instruction, living for a random length with an
+    * average of max_live instructions.
+    */
+   for (unsigned i = 0; i < num_nodes; i++) {
+      ranges[i].start = i;
+      ranges[i].end = i + 1 + rand() % (2 * max_live);
+      ranges[i].width = widths[rand() % 4 == 0 ? rand() % 3 : 0];
+   }
+}
+
+static void
+run(const char *name, struct ra_regs *regs, struct ra_class **classes,
+    const struct live_range *ranges, unsigned num_nodes, unsigned max_live)
+{
+   int64_t start = os_time_get_nano();
+
+   struct ra_graph *g = ra_alloc_interference_graph(regs, num_nodes);
+   for (unsigned i = 0; i < num_nodes; i++) {
+      unsigned c = ranges[i].width == 1 ? 0 : ranges[i].width == 2 ? 1 : 2;
+      ra_set_node_class(g, i, classes[c]);
+      ra_set_node_spill_cost(g, i, 1.0f);
+   }
+
+   /* Ranges start in order and are at most 2 * max_live long, so the ones
+    * overlapping i are just before it.
+    */
+   uint64_t edges = 0;
+   for (unsigned i = 0; i < num_nodes; i++) {
+      for (unsigned j = i; j-- > 0;) {
+         if (ranges[j].end > ranges[i].start) {
+            ra_add_node_interference(g, i, j);
+            edges++;
+         } else if (ranges[i].start - ranges[j].start > 2 * max_live) {
+            break;
+         }
+      }
+   }
+
+   int64_t built = os_time_get_nano();
+   bool success = ra_allocate(g);
+   int64_t allocated = os_time_get_nano();
+
+   int spill = success ? -1 : ra_get_best_spill_node(g);
+
+   printf("%-9s %u nodes, %" PRIu64 " edges: build %.2f ms, allocate %.2f ms, "
+          "%s (spill node %d)\n",
+          name, num_nodes, edges, (built - start) / 1e6,
+          (allocated - built) / 1e6, success ? "colored" : "failed", spill);
+
+   ralloc_free(g);
+}
+
+int
+main(int argc, char **argv)
+{
+   unsigned num_nodes = argc > 1 ? atoi(argv[1]) : 20000;
+   unsigned max_live = argc > 2 ? atoi(argv[2]) : 64;
+   void *mem_ctx = ralloc_context(NULL);
+   struct ra_class *classes[ARRAY_SIZE(widths)];
+
+   struct live_range *ranges = malloc(num_nodes * sizeof(*ranges));
+   srand(1);
+   make_live_ranges(ranges, num_nodes, max_live);
+
+   run("contig", make_contig_regs(mem_ctx, classes), classes, ranges,
+       num_nodes, max_live);
+   run("conflict", make_conflict_regs(mem_ctx, classes), classes, ranges,
+       num_nodes, max_live);
+
+   free(ranges);
+   ralloc_free(mem_ctx);
+   return 0;
+}
@@ -279,3 +279,65 @@ TEST_F(ra_test, serialization_roundtrip)
    blob_finish(&blob);
 }
 
+
+TEST_F(ra_test, interference_coloring)
+{
+   const unsigned num_regs = 32;
+   struct ra_regs *regs = ra_alloc_reg_set(mem_ctx, num_regs, false);
+
+   struct ra_class *c1 = ra_alloc_contig_reg_class(regs, 1);
+   for (unsigned i = 0; i < num_regs; i++)
+      ra_class_add_reg(c1, i);
+
+   struct ra_class *c2 = ra_alloc_contig_reg_class(regs, 2);
+   for (unsigned i = 0; i < num_regs; i += 2)
+      ra_class_add_reg(c2, i);
+
+   ra_set_finalize(regs, NULL);
+
+   /* Grow the graph a node at a time, so that the interference matrix gets
+    * reallocated with interferences already in it.
+    */
+   const unsigned num_nodes = 300;
+   const unsigned max_len = 24;
+   struct ra_graph *g = ra_alloc_interference_graph(regs, 0);
+   unsigned end[num_nodes];
+
+   srand(0);
+   for (unsigned i = 0; i < num_nodes; i++) {
+      struct ra_class *c = rand() % 4 ? c1 : c2;
+      ASSERT_EQ(ra_add_node(g, c), i);
+      end[i] = i + 1 + rand() % max_len;
+
+      for (unsigned j = i > max_len ? i - max_len : 0; j < i; j++) {
+         if (end[j] > i)
+            ra_add_node_interference(g, i, j);
+      }
+   }
+
+   /* Drop and re-add one node's interferences. */
+   ra_reset_node_interference(g, num_nodes / 2);
+   for (unsigned j = num_nodes / 2 - max_len; j < num_nodes / 2; j++) {
+      if (end[j] > num_nodes / 2)
+         ra_add_node_interference(g, num_nodes / 2, j);
+   }
+   for (unsigned j = num_nodes / 2 + 1; j < end[num_nodes / 2]; j++)
+      ra_add_node_interference(g, j, num_nodes / 2);
+
+   ASSERT_TRUE(ra_allocate(g));
+
+   for (unsigned i = 0; i < num_nodes; i++) {
+      struct ra_class *ci = ra_get_node_class(g, i);
+      unsigned ri = ra_get_node_reg(g, i);
+      ASSERT_TRUE(BITSET_TEST(ci->regs, ri));
+
+      for (unsigned j = i + 1; j < end[i] && j < num_nodes; j++) {
+         EXPECT_FALSE(ra_class_allocations_conflict(ci, ri,
+                                                    ra_get_node_class(g, j),
+                                                    ra_get_node_reg(g, j)))
+            << "nodes " << i << " and " << j << " interfere";
+      }
+   }
+
+   ralloc_free(g);
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Reproduces the u_threaded_context transfer pattern: one thread allocates
+ * from its child pool and hands the objects to a second thread, which frees
+ * them with its own child pool, so that every free is a cross-pool free.
+ *
+ *    slab_bench [num_objects] [num_children]
+ *
+ * The child pools of the allocating thread are recreated num_children times,
+ * like contexts being created and destroyed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "c11/threads.h"
+#include "os_time.h"
+#include "slab.h"
+#include "u_atomic.h"
+
+#define RING_SIZE 256
+#define OBJECT_SIZE 120
+
+struct bench {
+   struct slab_parent_pool parent;
+   void *ring[RING_SIZE];
+   unsigned head, tail; /* written by the producer/consumer respectively */
+   unsigned num_objects;
+};
+
+static int
+consumer_thread(void *data)
+{
+   struct bench *b = data;
+   struct slab_child_pool pool;
+
+   slab_create_child(&pool, &b->parent);
+
+   for (unsigned i = 0; i < b->num_objects; i++) {
+      while (p_atomic_read(&b->head) == b->tail)
+         thrd_yield();
+
+      unsigned char *obj = b->ring[b->tail % RING_SIZE];
+      if (obj[0] != (unsigned char)i || obj[OBJECT_SIZE - 1] != (unsigned char)i) {
+         fprintf(stderr, "object %u corrupted\n", i);
+         abort();
+      }
+      p_atomic_set(&b->tail, b->tail + 1);
+      slab_free(&pool, obj);
+   }
+
+   slab_destroy_child(&pool);
+   return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+   struct bench b;
+   unsigned num_children = argc > 2 ? atoi(argv[2]) : 16;
+   thrd_t consumer;
+
+   memset(&b, 0, sizeof(b));
+   b.num_objects = argc > 1 ? atoi(argv[1]) : 4000000;
+   slab_create_parent(&b.parent, OBJECT_SIZE, 64);
+
+   int64_t start = os_time_get_nano();
+   thrd_create(&consumer, consumer_thread, &b);
+
+   unsigned per_child = (b.num_objects + num_children - 1) / num_children;
+   struct slab_child_pool pool;
+   for (unsigned i = 0; i < b.num_objects; i++) {
+      if (i % per_child == 0) {
+         if (i)
+            slab_destroy_child(&pool);
+         slab_create_child(&pool, &b.parent);
+      }
+
+      unsigned char *obj = slab_alloc(&pool);
+      memset(obj, i & 0xff, OBJECT_SIZE);
+
+      while (b.head - p_atomic_read(&b.tail) == RING_SIZE)
+         thrd_yield();
+
+      b.ring[b.head % RING_SIZE] = obj;
+      p_atomic_set(&b.head, b.head + 1);
+   }
+   slab_destroy_child(&pool);
+
+   thrd_join(consumer, NULL);
+   int64_t end = os_time_get_nano();
+
+   printf("%u objects, %u child pools: %.2f ns per alloc/free pair\n",
+          b.num_objects, num_children, (double)(end - start) / b.num_objects);
+
+   slab_destroy_parent(&b.parent);
+   return 0;
+}
@@ -0,0 +1,242 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <string.h>
+#include <thread>
+#include <gtest/gtest.h>
+#include "util/macros.h"
+#include "util/os_time.h"
+#include "util/u_atomic.h"
+#include "util/u_queue.h"
+
+namespace {
+
+struct test_job {
+   struct util_queue_fence fence;
+   /* if set, the job doesn't finish before this is signalled */
+   struct util_queue_fence *gate;
+   struct util_queue_fence started;
+   int id;
+};
+
+struct test_log {
+   int order[16];
+   int count;
+};
+
+void
+test_job_execute(void *data, void *gdata, int thread_index)
+{
+   struct test_job *job = (struct test_job *)data;
+   struct test_log *log = (struct test_log *)gdata;
+
+   util_queue_fence_signal(&job->started);
+   if (job->gate)
+      util_queue_fence_wait(job->gate);
+
+   log->order[p_atomic_inc_return(&log->count) - 1] = job->id;
+}
+
+class u_queue_test : public ::testing::Test {
+protected:
+   void SetUp() override
+   {
+      memset(&log, 0, sizeof(log));
+      util_queue_fence_init(&gate);
+      util_queue_fence_reset(&gate);
+      for (unsigned i = 0; i < ARRAY_SIZE(jobs); i++) {
+         jobs[i].id = i;
+         jobs[i].gate = NULL;
+         util_queue_fence_init(&jobs[i].fence);
+         util_queue_fence_init(&jobs[i].started);
+         util_queue_fence_reset(&jobs[i].started);
+      }
+   }
+
+   void TearDown() override
+   {
+      util_queue_destroy(&queue);
+      /* jobs that were never added still have these unsignalled */
+      for (unsigned i = 0; i < ARRAY_SIZE(jobs); i++) {
+         if (!util_queue_fence_is_signalled(&jobs[i].started))
+            util_queue_fence_signal(&jobs[i].started);
+         util_queue_fence_destroy(&jobs[i].fence);
+         util_queue_fence_destroy(&jobs[i].started);
+      }
+      if (!util_queue_fence_is_signalled(&gate))
+         util_queue_fence_signal(&gate);
+      util_queue_fence_destroy(&gate);
+   }
+
+   void init_queue(unsigned num_threads)
+   {
+      ASSERT_TRUE(util_queue_init(&queue, "test", 8, num_threads, 0, &log));
+   }
+
+   void add_job(unsigned i, enum util_queue_priority priority,
+                struct util_queue_fence *depends_on)
+   {
+      util_queue_add_job_ext(&queue, &jobs[i], &jobs[i].fence, test_job_execute,
+                             NULL, 0, priority, depends_on);
+   }
+
+   /* Start job 0 and keep it running until the gate is signalled. */
+   void add_blocking_job()
+   {
+      jobs[0].gate = &gate;
+      add_job(0, UTIL_QUEUE_PRIORITY_NORMAL, NULL);
+      util_queue_fence_wait(&jobs[0].started);
+   }
+
+   struct util_queue queue;
+   struct util_queue_fence gate;
+   struct test_job jobs[8];
+   struct test_log log;
+};
+
+} /* namespace */
+
+TEST_F(u_queue_test, high_priority_runs_first)
+{
+   init_queue(1);
+   add_blocking_job();
+
+   add_job(1, UTIL_QUEUE_PRIORITY_NORMAL, NULL);
+   add_job(2, UTIL_QUEUE_PRIORITY_NORMAL, NULL);
+   add_job(3, UTIL_QUEUE_PRIORITY_HIGH, NULL);
+   add_job(4, UTIL_QUEUE_PRIORITY_NORMAL, NULL);
+   add_job(5, UTIL_QUEUE_PRIORITY_HIGH, NULL);
+
+   util_queue_fence_signal(&gate);
+   util_queue_finish(&queue);
+
+   const int expected[] = { 0, 3, 5, 1, 2, 4 };
+   ASSERT_EQ(log.count, (int)ARRAY_SIZE(expected));
+   for (unsigned i = 0; i < ARRAY_SIZE(expected); i++)
+      EXPECT_EQ(log.order[i], expected[i]) << "at position " << i;
+}
+
+TEST_F(u_queue_test, dependency_defers_job)
+{
+   init_queue(2);
+   add_blocking_job();
+
+   /* Job 1 waits for job 0, job 2 can run on the other thread meanwhile. */
+   add_job(1, UTIL_QUEUE_PRIORITY_NORMAL, &jobs[0].fence);
+   add_job(2, UTIL_QUEUE_PRIORITY_NORMAL, NULL);
+
+   util_queue_fence_wait(&jobs[2].fence);
+   EXPECT_FALSE(util_queue_fence_is_signalled(&jobs[1].started));
+
+   util_queue_fence_signal(&gate);
+   util_queue_fence_wait(&jobs[1].fence);
+
+   const int expected[] = { 2, 0, 1 };
+   ASSERT_EQ(log.count, (int)ARRAY_SIZE(expected));
+   for (unsigned i = 0; i < ARRAY_SIZE(expected); i++)
+      EXPECT_EQ(log.order[i], expected[i]) << "at position " << i;
+}
+
+TEST_F(u_queue_test, signalled_dependency_does_not_defer)
+{
+   init_queue(1);
+
+   add_job(0, UTIL_QUEUE_PRIORITY_NORMAL, NULL);
+   util_queue_fence_wait(&jobs[0].fence);
+   add_job(1, UTIL_QUEUE_PRIORITY_NORMAL, &jobs[0].fence);
+   util_queue_fence_wait(&jobs[1].fence);
+
+   EXPECT_EQ(log.count, 2);
+}
+
+TEST_F(u_queue_test, finish_waits_for_blocked_jobs)
+{
+   init_queue(2);
+   add_blocking_job();
+   add_job(1, UTIL_QUEUE_PRIORITY_NORMAL, &jobs[0].fence);
+   add_job(2, UTIL_QUEUE_PRIORITY_HIGH, &jobs[1].fence);
+
+   bool finished = false;
+   bool deps_done = false;
+   std::thread finisher([&] {
+      util_queue_finish(&queue);
+      deps_done = util_queue_fence_is_signalled(&jobs[1].fence) &&
+                  util_queue_fence_is_signalled(&jobs[2].fence);
+      p_atomic_set(&finished, true);
+   });
+
+   /* Nothing can complete while job 0 is blocked. */
+   std::this_thread::sleep_for(std::chrono::milliseconds(20));
+   EXPECT_FALSE(p_atomic_read(&finished));
+
+   util_queue_fence_signal(&gate);
+   finisher.join();
+
+   EXPECT_TRUE(finished);
+   EXPECT_TRUE(deps_done);
+   EXPECT_EQ(log.count, 3);
+}
+
+TEST_F(u_queue_test, high_priority_dependency_behind_finish)
+{
+   init_queue(1);
+   add_blocking_job();
+
+   struct util_queue_fence finished;
+   util_queue_fence_init(&finished);
+   util_queue_fence_reset(&finished);
+   std::thread finisher([&] {
+      util_queue_finish(&queue);
+      util_queue_fence_signal(&finished);
+   });
+
+   /* Wait for the finish barrier to be queued. */
+   int num_queued;
+   do {
+      std::this_thread::yield();
+      mtx_lock(&queue.lock);
+      num_queued = queue.num_queued;
+      mtx_unlock(&queue.lock);
+   } while (num_queued < 1);
+
+   /* Job 2 must not be moved ahead of the barrier, which can't overtake it
+    * while it waits for job 1 behind the barrier.
+    */
+   add_job(1, UTIL_QUEUE_PRIORITY_NORMAL, NULL);
+   add_job(2, UTIL_QUEUE_PRIORITY_HIGH, &jobs[1].fence);
+
+   util_queue_fence_signal(&gate);
+   /* If the queue got stuck, this fails and terminates on the unjoined
+    * thread instead of hanging.
+    */
+   ASSERT_TRUE(util_queue_fence_wait_timeout(&finished,
+                                             os_time_get_absolute_timeout(5000000000)));
+   finisher.join();
+   util_queue_fence_destroy(&finished);
+   util_queue_fence_wait(&jobs[2].fence);
+
+   const int expected[] = { 0, 1, 2 };
+   ASSERT_EQ(log.count, (int)ARRAY_SIZE(expected));
+   for (unsigned i = 0; i < ARRAY_SIZE(expected); i++)
+      EXPECT_EQ(log.order[i], expected[i]) << "at position " << i;
+}
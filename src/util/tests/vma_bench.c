@@ -0,0 +1,174 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Times util_vma_heap on the allocation patterns of a driver managing a
+ * large GPU virtual address space, and prints how fragmented the heap is
+ * afterwards.
+ *
+ *    vma_bench [num_live] [num_ops]
+ *
+ * Each pattern first fills the heap with num_live buffers, then does
+ * num_ops rounds of freeing a random buffer and allocating a new one, so
+ * that the heap ends up with thousands of holes.  The heaps are sized so
+ * that the default num_live buffers use about a third of them.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "macros.h"
+#include "os_time.h"
+#include "vma.h"
+
+#define HEAP_START (1ull << 21)
+
+struct buffer {
+   uint64_t offset, size;
+};
+
+struct pattern {
+   const char *name;
+   bool alloc_high;
+   uint64_t heap_size;
+   void (*pick)(uint64_t *size, uint64_t *alignment);
+};
+
+static uint64_t
+rand64(void)
+{
+   return ((uint64_t)rand() << 32) ^ ((uint64_t)rand() << 16) ^ rand();
+}
+
+/* Mostly small buffers, with the odd multi-megabyte one, like BOs. */
+static void
+pick_mixed(uint64_t *size, uint64_t *alignment)
+{
+   unsigned order = rand() % 8 == 0 ? 16 + rand() % 11 : 12 + rand() % 5;
+   *size = (1ull << order) + (rand64() % (1ull << order) & ~4095ull);
+   *alignment = *size >= (2u << 20) ? 2u << 20 : 4096;
+}
+
+/* Same-sized 64 KiB buffers, like a suballocator's slabs. */
+static void
+pick_uniform(uint64_t *size, uint64_t *alignment)
+{
+   *size = 64 * 1024;
+   *alignment = 4096;
+}
+
+/* Sparse resources: buffers bound at 64 KiB page granularity with large
+ * alignments, leaving many holes too misaligned to be used.
+ */
+static void
+pick_sparse(uint64_t *size, uint64_t *alignment)
+{
+   *size = (1 + rand() % 64) * 64 * 1024ull;
+   *alignment = 64 * 1024ull << (rand() % 6);
+}
+
+static const struct pattern patterns[] = {
+   { "mixed",        true,  1ull << 37, pick_mixed },
+   { "mixed-low",    false, 1ull << 37, pick_mixed },
+   { "uniform",      true,  1ull << 32, pick_uniform },
+   { "sparse",       true,  1ull << 37, pick_sparse },
+   { "sparse-low",   false, 1ull << 37, pick_sparse },
+};
+
+static void
+run(const struct pattern *p, struct buffer *buffers, unsigned num_live,
+    unsigned num_ops)
+{
+   struct util_vma_heap heap;
+   uint64_t size, alignment;
+   unsigned failed = 0;
+
+   util_vma_heap_init(&heap, HEAP_START, p->heap_size);
+   heap.alloc_high = p->alloc_high;
+   srand(1);
+
+   int64_t start = os_time_get_nano();
+
+   for (unsigned i = 0; i < num_live; i++) {
+      p->pick(&size, &alignment);
+      buffers[i].offset = util_vma_heap_alloc(&heap, size, alignment);
+      buffers[i].size = size;
+      failed += buffers[i].offset == 0;
+   }
+
+   int64_t filled = os_time_get_nano();
+
+   for (unsigned i = 0; i < num_ops; i++) {
+      struct buffer *b = &buffers[rand() % num_live];
+      if (b->offset)
+         util_vma_heap_free(&heap, b->offset, b->size);
+
+      p->pick(&size, &alignment);
+      b->offset = util_vma_heap_alloc(&heap, size, alignment);
+      b->size = size;
+      failed += b->offset == 0;
+   }
+
+   int64_t churned = os_time_get_nano();
+
+   /* Fixed-address allocations of a capture being replayed on top of the
+    * fragmented heap, which mostly land in holes.
+    */
+   for (unsigned i = 0; i < num_ops; i++) {
+      uint64_t addr = HEAP_START + (rand64() % p->heap_size & ~4095ull);
+      if (util_vma_heap_alloc_addr(&heap, addr, 4096))
+         util_vma_heap_free(&heap, addr, 4096);
+   }
+
+   int64_t replayed = os_time_get_nano();
+
+   struct util_vma_heap_stats stats;
+   util_vma_heap_get_stats(&heap, &stats);
+
+   printf("%-10s fill %6.1f ns/alloc, churn %6.1f ns/op, alloc_addr %6.1f "
+          "ns/op, %u failed\n",
+          p->name, (filled - start) / (double)num_live,
+          (churned - filled) / (double)num_ops,
+          (replayed - churned) / (double)num_ops, failed);
+   printf("%-10s %u holes, %" PRIu64 " MiB free, largest %" PRIu64 " MiB, "
+          "%.2f%% fragmented\n",
+          "", stats.num_holes, stats.free_size >> 20,
+          stats.largest_hole >> 20, stats.fragmentation * 100);
+
+   util_vma_heap_finish(&heap);
+}
+
+int
+main(int argc, char **argv)
+{
+   unsigned num_live = argc > 1 ? atoi(argv[1]) : 20000;
+   unsigned num_ops = argc > 2 ? atoi(argv[2]) : 200000;
+
+   struct buffer *buffers = calloc(num_live, sizeof(*buffers));
+
+   for (unsigned i = 0; i < ARRAY_SIZE(patterns); i++)
+      run(&patterns[i], buffers, num_live, num_ops);
+
+   free(buffers);
+   return 0;
+}
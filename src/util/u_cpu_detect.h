@@ -114,6 +114,8 @@ struct util_cpu_caps_t {
    unsigned has_avx512vl:1;
    unsigned has_avx512vbmi:1;
 
+   unsigned has_sha:1;
+
    unsigned num_L3_caches;
    unsigned num_cpu_mask_bits;
 
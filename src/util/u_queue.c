@@ -46,6 +46,8 @@
 static void
 util_queue_kill_threads(struct util_queue *queue, unsigned keep_num_threads,
                         bool finish_locked);
+static void
+util_queue_finish_execute(void *data, void *gdata, int num_thread);
 
 /****************************************************************************
  * Wait for all queues to assert idle when exit() is called.
@@ -247,6 +249,57 @@ struct thread_input {
    int thread_index;
 };
 
+/* Return the index of the first job that can be executed, or -1 if all
+ * queued jobs are waiting for their dependencies.
+ */
+static int
+util_queue_find_runnable_job(struct util_queue *queue)
+{
+   if (queue->num_queued == 0)
+      return -1;
+
+   if (!queue->num_deferred)
+      return queue->read_idx;
+
+   bool blocked = false;
+   unsigned i = queue->read_idx;
+
+   for (int n = 0; n < queue->num_queued; n++, i = (i + 1) % queue->max_jobs) {
+      struct util_queue_job *job = &queue->jobs[i];
+
+      /* Dropped or already taken. Only pop it at the start of the ring. */
+      if (!job->job) {
+         if (i == queue->read_idx)
+            return i;
+         continue;
+      }
+
+      /* util_queue_finish barriers must not overtake blocked jobs, or
+       * util_queue_finish could return before they have executed.
+       */
+      if (blocked && job->execute == util_queue_finish_execute)
+         return -1;
+
+      if (!job->depends_on || util_queue_fence_is_signalled(job->depends_on))
+         return i;
+
+      blocked = true;
+   }
+   return -1;
+}
+
+/* Wake up threads waiting for the dependencies of deferred jobs. */
+static void
+util_queue_wake_deferred(struct util_queue *queue)
+{
+   if (!p_atomic_read(&queue->num_deferred))
+      return;
+
+   mtx_lock(&queue->lock);
+   cnd_broadcast(&queue->has_queued_cond);
+   mtx_unlock(&queue->lock);
+}
+
 static int
 util_queue_thread_func(void *input)
 {
@@ -285,12 +338,14 @@ util_queue_thread_func(void *input)
 
    while (1) {
       struct util_queue_job job;
+      int idx = -1;
 
       mtx_lock(&queue->lock);
       assert(queue->num_queued >= 0 && queue->num_queued <= queue->max_jobs);
 
-      /* wait if the queue is empty */
-      while (thread_index < queue->num_threads && queue->num_queued == 0)
+      /* wait if the queue is empty or all jobs are waiting for dependencies */
+      while (thread_index < queue->num_threads &&
+             (idx = util_queue_find_runnable_job(queue)) < 0)
          cnd_wait(&queue->has_queued_cond, &queue->lock);
 
       /* only kill threads that are above "num_threads" */
@@ -299,20 +354,34 @@ util_queue_thread_func(void *input)
          break;
       }
 
-      job = queue->jobs[queue->read_idx];
-      memset(&queue->jobs[queue->read_idx], 0, sizeof(struct util_queue_job));
-      queue->read_idx = (queue->read_idx + 1) % queue->max_jobs;
+      job = queue->jobs[idx];
+      memset(&queue->jobs[idx], 0, sizeof(struct util_queue_job));
+
+      if (idx == queue->read_idx) {
+         if (job.priority == UTIL_QUEUE_PRIORITY_HIGH)
+            queue->num_high_queued--;
+         queue->read_idx = (queue->read_idx + 1) % queue->max_jobs;
+         queue->num_queued--;
+         cnd_signal(&queue->has_space_cond);
+      } else {
+         /* Leave a hole that is popped when it reaches the start of the
+          * ring. It keeps its priority for num_high_queued.
+          */
+         queue->jobs[idx].priority = job.priority;
+      }
 
-      queue->num_queued--;
-      cnd_signal(&queue->has_space_cond);
+      if (job.depends_on)
+         queue->num_deferred--;
       if (job.job)
          queue->total_jobs_size -= job.job_size;
       mtx_unlock(&queue->lock);
 
       if (job.job) {
          job.execute(job.job, job.global_data, thread_index);
-         if (job.fence)
+         if (job.fence) {
             util_queue_fence_signal(job.fence);
+            util_queue_wake_deferred(queue);
+         }
          if (job.cleanup)
             job.cleanup(job.job, job.global_data, thread_index);
       }
@@ -331,6 +400,8 @@ util_queue_thread_func(void *input)
       }
       queue->read_idx = queue->write_idx;
       queue->num_queued = 0;
+      queue->num_high_queued = 0;
+      queue->num_deferred = 0;
    }
    mtx_unlock(&queue->lock);
    return 0;
@@ -549,12 +620,14 @@ util_queue_destroy(struct util_queue *queue)
 }
 
 void
-util_queue_add_job(struct util_queue *queue,
-                   void *job,
-                   struct util_queue_fence *fence,
-                   util_queue_execute_func execute,
-                   util_queue_execute_func cleanup,
-                   const size_t job_size)
+util_queue_add_job_ext(struct util_queue *queue,
+                       void *job,
+                       struct util_queue_fence *fence,
+                       util_queue_execute_func execute,
+                       util_queue_execute_func cleanup,
+                       const size_t job_size,
+                       enum util_queue_priority priority,
+                       struct util_queue_fence *depends_on)
 {
    struct util_queue_job *ptr;
 
@@ -614,23 +687,66 @@ util_queue_add_job(struct util_queue *queue,
       }
    }
 
-   ptr = &queue->jobs[queue->write_idx];
-   assert(ptr->job == NULL);
+   assert(queue->jobs[queue->write_idx].job == NULL);
+
+   if (depends_on && util_queue_fence_is_signalled(depends_on))
+      depends_on = NULL;
+
+   /* A job that has to wait can't be moved ahead of anything: its
+    * dependency may be queued after util_queue_finish barriers, which
+    * don't overtake blocked jobs.
+    */
+   if (depends_on)
+      priority = UTIL_QUEUE_PRIORITY_NORMAL;
+
+   if (priority == UTIL_QUEUE_PRIORITY_HIGH) {
+      /* Insert after the other high priority jobs, moving the normal
+       * priority jobs one slot back.
+       */
+      unsigned slot = (queue->read_idx + queue->num_high_queued) % queue->max_jobs;
+
+      for (unsigned i = queue->write_idx; i != slot;) {
+         unsigned prev = (i + queue->max_jobs - 1) % queue->max_jobs;
+         queue->jobs[i] = queue->jobs[prev];
+         i = prev;
+      }
+      ptr = &queue->jobs[slot];
+      queue->num_high_queued++;
+   } else {
+      ptr = &queue->jobs[queue->write_idx];
+   }
+
    ptr->job = job;
    ptr->global_data = queue->global_data;
    ptr->fence = fence;
+   ptr->depends_on = depends_on;
    ptr->execute = execute;
    ptr->cleanup = cleanup;
    ptr->job_size = job_size;
+   ptr->priority = priority;
 
    queue->write_idx = (queue->write_idx + 1) % queue->max_jobs;
    queue->total_jobs_size += ptr->job_size;
 
+   if (depends_on)
+      queue->num_deferred++;
    queue->num_queued++;
    cnd_signal(&queue->has_queued_cond);
    mtx_unlock(&queue->lock);
 }
 
+void
+util_queue_add_job(struct util_queue *queue,
+                   void *job,
+                   struct util_queue_fence *fence,
+                   util_queue_execute_func execute,
+                   util_queue_execute_func cleanup,
+                   const size_t job_size)
+{
+   util_queue_add_job_ext(queue, job, fence, execute, cleanup, job_size,
+                          UTIL_QUEUE_PRIORITY_NORMAL, NULL);
+}
+
 /**
  * Remove a queued job. If the job hasn't started execution, it's removed from
  * the queue. If the job has started execution, the function waits for it to
@@ -653,20 +769,26 @@ util_queue_drop_job(struct util_queue *queue, struct util_queue_fence *fence)
    for (unsigned i = queue->read_idx; i != queue->write_idx;
         i = (i + 1) % queue->max_jobs) {
       if (queue->jobs[i].fence == fence) {
+         enum util_queue_priority priority = queue->jobs[i].priority;
+
          if (queue->jobs[i].cleanup)
             queue->jobs[i].cleanup(queue->jobs[i].job, queue->global_data, -1);
+         if (queue->jobs[i].depends_on)
+            queue->num_deferred--;
 
          /* Just clear it. The threads will treat as a no-op job. */
          memset(&queue->jobs[i], 0, sizeof(queue->jobs[i]));
+         queue->jobs[i].priority = priority;
          removed = true;
          break;
       }
    }
    mtx_unlock(&queue->lock);
 
-   if (removed)
+   if (removed) {
       util_queue_fence_signal(fence);
-   else
+      util_queue_wake_deferred(queue);
+   } else
       util_queue_fence_wait(fence);
 }
 
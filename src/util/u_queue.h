@@ -193,13 +193,23 @@ util_queue_fence_wait_timeout(struct util_queue_fence *fence,
 
 typedef void (*util_queue_execute_func)(void *job, void *gdata, int thread_index);
 
+enum util_queue_priority {
+   UTIL_QUEUE_PRIORITY_NORMAL,
+   /* Executed before all normal priority jobs, e.g. compiles that the
+    * application is waiting for vs. background cache writes.
+    */
+   UTIL_QUEUE_PRIORITY_HIGH,
+};
+
 struct util_queue_job {
    void *job;
    void *global_data;
    size_t job_size;
    struct util_queue_fence *fence;
+   struct util_queue_fence *depends_on;
    util_queue_execute_func execute;
    util_queue_execute_func cleanup;
+   enum util_queue_priority priority;
 };
 
 /* Put this into your context. */
@@ -216,6 +226,8 @@ struct util_queue {
    unsigned num_threads; /* decreasing this number will terminate threads */
    int max_jobs;
    int write_idx, read_idx; /* ring buffer pointers */
+   int num_high_queued;     /* high priority jobs at the start of the ring */
+   int num_deferred;        /* queued jobs with a dependency */
    size_t total_jobs_size;  /* memory use of all jobs in the queue */
    struct util_queue_job *jobs;
    void *global_data;
@@ -239,6 +251,22 @@ void util_queue_add_job(struct util_queue *queue,
                         util_queue_execute_func execute,
                         util_queue_execute_func cleanup,
                         const size_t job_size);
+
+/* Like util_queue_add_job, with a priority and an optional dependency.
+ *
+ * The job doesn't start before \p depends_on is signalled. The dependency
+ * must be the fence of a job previously added to the same queue, or already
+ * signalled, so that the queue can't stall on it. A job whose dependency
+ * isn't signalled yet is queued at the end regardless of \p priority.
+ */
+void util_queue_add_job_ext(struct util_queue *queue,
+                            void *job,
+                            struct util_queue_fence *fence,
+                            util_queue_execute_func execute,
+                            util_queue_execute_func cleanup,
+                            const size_t job_size,
+                            enum util_queue_priority priority,
+                            struct util_queue_fence *depends_on);
 void util_queue_drop_job(struct util_queue *queue,
                          struct util_queue_fence *fence);
 
@@ -27,81 +27,189 @@
 #include "util/u_math.h"
 #include "util/vma.h"
 
+/* Holes are kept in a red-black tree ordered by offset, lowest first.  Each
+ * node also has the size of the largest hole in its subtree, which lets the
+ * allocation paths find the first hole that is big enough in O(log n)
+ * instead of walking every hole.
+ */
 struct util_vma_hole {
-   struct list_head link;
+   struct rb_node node;
    uint64_t offset;
    uint64_t size;
+
+   /** Largest size of a hole in the subtree rooted at this hole */
+   uint64_t max_size;
 };
 
-#define util_vma_foreach_hole(_hole, _heap) \
-   list_for_each_entry(struct util_vma_hole, _hole, &(_heap)->holes, link)
+static inline struct util_vma_hole *
+util_vma_hole(struct rb_node *node)
+{
+   return node ? rb_node_data(struct util_vma_hole, node, node) : NULL;
+}
+
+static inline uint64_t
+util_vma_subtree_max_size(struct rb_node *node)
+{
+   return node ? util_vma_hole(node)->max_size : 0;
+}
+
+static void
+util_vma_hole_augment(struct rb_node *node)
+{
+   struct util_vma_hole *hole = util_vma_hole(node);
 
-#define util_vma_foreach_hole_safe(_hole, _heap) \
-   list_for_each_entry_safe(struct util_vma_hole, _hole, &(_heap)->holes, link)
+   hole->max_size = MAX3(hole->size,
+                         util_vma_subtree_max_size(node->left),
+                         util_vma_subtree_max_size(node->right));
+}
+
+#define util_vma_foreach_hole(_hole, _heap) \
+   rb_tree_foreach(struct util_vma_hole, _hole, &(_heap)->holes, node)
 
-#define util_vma_foreach_hole_safe_rev(_hole, _heap) \
-   list_for_each_entry_safe_rev(struct util_vma_hole, _hole, &(_heap)->holes, link)
+#define util_vma_foreach_hole_rev(_hole, _heap) \
+   rb_tree_foreach_rev(struct util_vma_hole, _hole, &(_heap)->holes, node)
 
 void
 util_vma_heap_init(struct util_vma_heap *heap,
                    uint64_t start, uint64_t size)
 {
-   list_inithead(&heap->holes);
+   rb_tree_init(&heap->holes);
+   heap->num_holes = 0;
+   heap->free_size = 0;
    util_vma_heap_free(heap, start, size);
 
    /* Default to using high addresses */
    heap->alloc_high = true;
 }
 
+/* Frees a subtree of holes without rebalancing anything.  rb_node_next()
+ * walks back up through parents, so the tree can't be freed while iterating
+ * over it in order.
+ */
+static void
+util_vma_hole_free_subtree(struct rb_node *node)
+{
+   if (!node)
+      return;
+
+   util_vma_hole_free_subtree(node->left);
+   util_vma_hole_free_subtree(node->right);
+   free(util_vma_hole(node));
+}
+
 void
 util_vma_heap_finish(struct util_vma_heap *heap)
 {
-   util_vma_foreach_hole_safe(hole, heap)
-      free(hole);
+   util_vma_hole_free_subtree(heap->holes.root);
+   rb_tree_init(&heap->holes);
+   heap->num_holes = 0;
+   heap->free_size = 0;
 }
 
 #ifndef NDEBUG
 static void
 util_vma_heap_validate(struct util_vma_heap *heap)
 {
-   uint64_t prev_offset = 0;
+   struct util_vma_hole *prev = NULL;
+   uint64_t free_size = 0;
+   uint32_t num_holes = 0;
+
    util_vma_foreach_hole(hole, heap) {
       assert(hole->offset > 0);
       assert(hole->size > 0);
 
-      if (&hole->link == heap->holes.next) {
-         /* This must be the top-most hole.  Assert that, if it overflows, it
-          * overflows to 0, i.e. 2^64.
-          */
-         assert(hole->size + hole->offset == 0 ||
-                hole->size + hole->offset > hole->offset);
-      } else {
-         /* This is not the top-most hole so it must not overflow and, in
-          * fact, must be strictly lower than the top-most hole.  If
-          * hole->size + hole->offset == prev_offset, then we failed to join
-          * holes during a util_vma_heap_free.
+      if (prev) {
+         /* The previous hole is not the top-most hole so it must not
+          * overflow and, in fact, must end strictly below this hole.  If it
+          * ends right at hole->offset, then we failed to join holes during
+          * a util_vma_heap_free.
           */
-         assert(hole->size + hole->offset > hole->offset &&
-                hole->size + hole->offset < prev_offset);
+         assert(prev->size + prev->offset > prev->offset &&
+                prev->size + prev->offset < hole->offset);
       }
-      prev_offset = hole->offset;
+
+      /* Only the top-most hole may overflow, and only to 0, i.e. 2^64. */
+      assert(hole->size + hole->offset == 0 ||
+             hole->size + hole->offset > hole->offset);
+
+      assert(hole->max_size ==
+             MAX3(hole->size, util_vma_subtree_max_size(hole->node.left),
+                  util_vma_subtree_max_size(hole->node.right)));
+
+      free_size += hole->size;
+      num_holes++;
+      prev = hole;
    }
+
+   assert(free_size == heap->free_size);
+   assert(num_holes == heap->num_holes);
 }
 #else
 #define util_vma_heap_validate(heap)
 #endif
 
 static void
-util_vma_hole_alloc(struct util_vma_hole *hole,
+util_vma_heap_add_hole(struct util_vma_heap *heap,
+                       uint64_t offset, uint64_t size)
+{
+   struct util_vma_hole *hole = calloc(1, sizeof(*hole));
+   hole->offset = offset;
+   hole->size = size;
+
+   struct rb_node *parent = NULL;
+   bool insert_left = false;
+   for (struct rb_node *n = heap->holes.root; n;) {
+      parent = n;
+      insert_left = offset < util_vma_hole(n)->offset;
+      n = insert_left ? n->left : n->right;
+   }
+
+   rb_augmented_tree_insert_at(&heap->holes, parent, &hole->node,
+                               insert_left, util_vma_hole_augment);
+   heap->num_holes++;
+}
+
+static void
+util_vma_heap_remove_hole(struct util_vma_heap *heap,
+                          struct util_vma_hole *hole)
+{
+   rb_augmented_tree_remove(&heap->holes, &hole->node,
+                            util_vma_hole_augment);
+   free(hole);
+   heap->num_holes--;
+}
+
+/* Returns the hole with the highest offset <= offset, if any. */
+static struct util_vma_hole *
+util_vma_heap_find_hole_below(struct util_vma_heap *heap, uint64_t offset)
+{
+   struct util_vma_hole *below = NULL;
+
+   for (struct rb_node *n = heap->holes.root; n;) {
+      struct util_vma_hole *hole = util_vma_hole(n);
+      if (hole->offset <= offset) {
+         below = hole;
+         n = n->right;
+      } else {
+         n = n->left;
+      }
+   }
+
+   return below;
+}
+
+static void
+util_vma_hole_alloc(struct util_vma_heap *heap, struct util_vma_hole *hole,
                     uint64_t offset, uint64_t size)
 {
    assert(hole->offset <= offset);
    assert(hole->size >= offset - hole->offset + size);
 
+   heap->free_size -= size;
+
    if (offset == hole->offset && size == hole->size) {
       /* Just get rid of the hole. */
-      list_del(&hole->link);
-      free(hole);
+      util_vma_heap_remove_hole(heap, hole);
       return;
    }
 
@@ -110,32 +218,104 @@ util_vma_hole_alloc(struct util_vma_hole *hole,
    if (waste == 0) {
       /* We allocated at the top.  Shrink the hole down. */
       hole->size -= size;
+      rb_augmented_tree_update(&hole->node, util_vma_hole_augment);
       return;
    }
 
    if (offset == hole->offset) {
-      /* We allocated at the bottom. Shrink the hole up. */
+      /* We allocated at the bottom. Shrink the hole up.  It stays between
+       * the same neighbours, so the tree order is unchanged.
+       */
       hole->offset += size;
       hole->size -= size;
+      rb_augmented_tree_update(&hole->node, util_vma_hole_augment);
       return;
    }
 
    /* We allocated in the middle.  We need to split the old hole into two
     * holes, one high and one low.
-    */
-   struct util_vma_hole *high_hole = calloc(1, sizeof(*hole));
-   high_hole->offset = offset + size;
-   high_hole->size = waste;
-
-   /* Adjust the hole to be the amount of space left at he bottom of the
-    * original hole.
+    *
+    * Adjust the hole to be the amount of space left at the bottom of the
+    * original hole, and add a new hole for the space left at the top.
     */
    hole->size = offset - hole->offset;
+   rb_augmented_tree_update(&hole->node, util_vma_hole_augment);
 
-   /* Place the new hole before the old hole so that the list is in order
-    * from high to low.
-    */
-   list_addtail(&high_hole->link, &hole->link);
+   util_vma_heap_add_hole(heap, offset + size, waste);
+}
+
+/* Returns the highest hole where size bytes aligned to alignment fit, when
+ * allocating from the top of the hole.
+ *
+ * Subtrees without a hole of at least size bytes are skipped, so unless
+ * alignment gets in the way this only walks down a single path.
+ */
+static struct util_vma_hole *
+util_vma_hole_find_high(struct rb_node *node, uint64_t size,
+                        uint64_t alignment, uint64_t *offset_out)
+{
+   if (util_vma_subtree_max_size(node) < size)
+      return NULL;
+
+   struct util_vma_hole *found =
+      util_vma_hole_find_high(node->right, size, alignment, offset_out);
+   if (found)
+      return found;
+
+   struct util_vma_hole *hole = util_vma_hole(node);
+   if (size <= hole->size) {
+      /* Compute the offset as the highest address where a chunk of the
+       * given size can be without going over the top of the hole.
+       *
+       * This calculation is known to not overflow because we know that
+       * hole->size + hole->offset can only overflow to 0 and size > 0.
+       */
+      uint64_t offset = (hole->size - size) + hole->offset;
+
+      /* Align the offset.  We align down and not up because we are
+       * allocating from the top of the hole and not the bottom.
+       */
+      offset = (offset / alignment) * alignment;
+
+      if (offset >= hole->offset) {
+         *offset_out = offset;
+         return hole;
+      }
+   }
+
+   return util_vma_hole_find_high(node->left, size, alignment, offset_out);
+}
+
+/* Returns the lowest hole where size bytes aligned to alignment fit, when
+ * allocating from the bottom of the hole.
+ */
+static struct util_vma_hole *
+util_vma_hole_find_low(struct rb_node *node, uint64_t size,
+                       uint64_t alignment, uint64_t *offset_out)
+{
+   if (util_vma_subtree_max_size(node) < size)
+      return NULL;
+
+   struct util_vma_hole *found =
+      util_vma_hole_find_low(node->left, size, alignment, offset_out);
+   if (found)
+      return found;
+
+   struct util_vma_hole *hole = util_vma_hole(node);
+   if (size <= hole->size) {
+      uint64_t offset = hole->offset;
+
+      /* Align the offset */
+      uint64_t misalign = offset % alignment;
+      uint64_t pad = misalign ? alignment - misalign : 0;
+
+      if (pad <= hole->size - size) {
+         *offset_out = offset + pad;
+         return hole;
+      }
+   }
+
+   return util_vma_hole_find_low(node->right, size, alignment, offset_out);
 }
 
 uint64_t
@@ -148,56 +328,24 @@ util_vma_heap_alloc(struct util_vma_heap *heap,
 
    util_vma_heap_validate(heap);
 
+   struct util_vma_hole *hole;
+   uint64_t offset;
    if (heap->alloc_high) {
-      util_vma_foreach_hole_safe(hole, heap) {
-         if (size > hole->size)
-            continue;
-
-         /* Compute the offset as the highest address where a chunk of the
-          * given size can be without going over the top of the hole.
-          *
-          * This calculation is known to not overflow because we know that
-          * hole->size + hole->offset can only overflow to 0 and size > 0.
-          */
-         uint64_t offset = (hole->size - size) + hole->offset;
-
-         /* Align the offset.  We align down and not up because we are
-          * allocating from the top of the hole and not the bottom.
-          */
-         offset = (offset / alignment) * alignment;
-
-         if (offset < hole->offset)
-            continue;
-
-         util_vma_hole_alloc(hole, offset, size);
-         util_vma_heap_validate(heap);
-         return offset;
-      }
+      hole = util_vma_hole_find_high(heap->holes.root, size, alignment,
+                                     &offset);
    } else {
-      util_vma_foreach_hole_safe_rev(hole, heap) {
-         if (size > hole->size)
-            continue;
-
-         uint64_t offset = hole->offset;
-
-         /* Align the offset */
-         uint64_t misalign = offset % alignment;
-         if (misalign) {
-            uint64_t pad = alignment - misalign;
-            if (pad > hole->size - size)
-               continue;
-
-            offset += pad;
-         }
+      hole = util_vma_hole_find_low(heap->holes.root, size, alignment,
+                                    &offset);
+   }
 
-         util_vma_hole_alloc(hole, offset, size);
-         util_vma_heap_validate(heap);
-         return offset;
-      }
+   if (!hole) {
+      /* Failed to allocate */
+      return 0;
    }
 
-   /* Failed to allocate */
-   return 0;
+   util_vma_hole_alloc(heap, hole, offset, size);
+   util_vma_heap_validate(heap);
+   return offset;
 }
 
 bool
@@ -217,25 +365,16 @@ util_vma_heap_alloc_addr(struct util_vma_heap *heap,
     */
    assert(offset + size == 0 || offset + size > offset);
 
-   /* Find the hole if one exists. */
-   util_vma_foreach_hole_safe(hole, heap) {
-      if (hole->offset > offset)
-         continue;
-
-      /* Holes are ordered high-to-low so the first hole we find with
-       * hole->offset <= is our hole.  If it's not big enough to contain the
-       * requested range, then the allocation fails.
-       */
-      assert(hole->offset <= offset);
-      if (hole->size < offset - hole->offset + size)
-         return false;
-
-      util_vma_hole_alloc(hole, offset, size);
-      return true;
-   }
+   /* The only hole that can contain the range is the highest one starting
+    * at or below it.  If it's not big enough to contain the requested
+    * range, then the allocation fails.
+    */
+   struct util_vma_hole *hole = util_vma_heap_find_hole_below(heap, offset);
+   if (!hole || hole->size < offset - hole->offset + size)
+      return false;
 
-   /* We didn't find a suitable hole */
-   return false;
+   util_vma_hole_alloc(heap, hole, offset, size);
+   return true;
 }
 
 void
@@ -258,14 +397,11 @@ util_vma_heap_free(struct util_vma_heap *heap,
    util_vma_heap_validate(heap);
 
    /* Find immediately higher and lower holes if they exist. */
-   struct util_vma_hole *high_hole = NULL, *low_hole = NULL;
-   util_vma_foreach_hole(hole, heap) {
-      if (hole->offset <= offset) {
-         low_hole = hole;
-         break;
-      }
-      high_hole = hole;
-   }
+   struct util_vma_hole *low_hole =
+      util_vma_heap_find_hole_below(heap, offset);
+   struct util_vma_hole *high_hole = low_hole ?
+      util_vma_hole(rb_node_next(&low_hole->node)) :
+      util_vma_hole(rb_tree_first(&heap->holes));
 
    if (high_hole)
       assert(offset + size <= high_hole->offset);
@@ -277,50 +413,64 @@ util_vma_heap_free(struct util_vma_heap *heap,
    }
    bool low_adjacent = low_hole && low_hole->offset + low_hole->size == offset;
 
+   heap->free_size += size;
+
    if (low_adjacent && high_adjacent) {
       /* Merge the two holes */
-      low_hole->size += size + high_hole->size;
-      list_del(&high_hole->link);
-      free(high_hole);
+      uint64_t high_size = high_hole->size;
+      util_vma_heap_remove_hole(heap, high_hole);
+      low_hole->size += size + high_size;
+      rb_augmented_tree_update(&low_hole->node, util_vma_hole_augment);
    } else if (low_adjacent) {
       /* Merge into the low hole */
       low_hole->size += size;
+      rb_augmented_tree_update(&low_hole->node, util_vma_hole_augment);
    } else if (high_adjacent) {
       /* Merge into the high hole */
       high_hole->offset = offset;
       high_hole->size += size;
+      rb_augmented_tree_update(&high_hole->node, util_vma_hole_augment);
    } else {
       /* Neither hole is adjacent; make a new one */
-      struct util_vma_hole *hole = calloc(1, sizeof(*hole));
-
-      hole->offset = offset;
-      hole->size = size;
-
-      /* Add it after the high hole so we maintain high-to-low ordering */
-      if (high_hole)
-         list_add(&hole->link, &high_hole->link);
-      else
-         list_add(&hole->link, &heap->holes);
+      util_vma_heap_add_hole(heap, offset, size);
    }
 
    util_vma_heap_validate(heap);
 }
 
+void
+util_vma_heap_get_stats(const struct util_vma_heap *heap,
+                        struct util_vma_heap_stats *stats)
+{
+   stats->free_size = heap->free_size;
+   stats->num_holes = heap->num_holes;
+   stats->largest_hole = util_vma_subtree_max_size(heap->holes.root);
+   stats->fragmentation = heap->free_size == 0 ? 0.0 :
+      1.0 - (double)stats->largest_hole / (double)heap->free_size;
+}
+
 void
 util_vma_heap_print(struct util_vma_heap *heap, FILE *fp,
                     const char *tab, uint64_t total_size)
 {
    fprintf(fp, "%sutil_vma_heap:\n", tab);
 
-   uint64_t total_free = 0;
-   util_vma_foreach_hole(hole, heap) {
+   util_vma_foreach_hole_rev(hole, heap) {
       fprintf(fp, "%s    hole: offset = %"PRIu64" (0x%"PRIx64", "
               "size = %"PRIu64" (0x%"PRIx64")\n",
               tab, hole->offset, hole->offset, hole->size, hole->size);
-      total_free += hole->size;
    }
+
+   struct util_vma_heap_stats stats;
+   util_vma_heap_get_stats(heap, &stats);
+
+   uint64_t total_free = stats.free_size;
    assert(total_free <= total_size);
    fprintf(fp, "%s%"PRIu64"B (0x%"PRIx64") free (%.2f%% full)\n",
            tab, total_free, total_free,
            ((double)(total_size - total_free) / (double)total_size) * 100);
+   fprintf(fp, "%s%u holes, largest %"PRIu64"B (0x%"PRIx64"), "
+           "%.2f%% fragmented\n",
+           tab, stats.num_holes, stats.largest_hole, stats.largest_hole,
+           stats.fragmentation * 100);
 }
@@ -27,14 +27,23 @@
 #include <stdint.h>
 #include <stdio.h>
 
-#include "list.h"
+#include "rb_tree.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 struct util_vma_heap {
-   struct list_head holes;
+   /** Free ranges, ordered by offset
+    *
+    * Each hole also stores the size of the largest hole in its subtree so
+    * that allocations can skip over subtrees that are too fragmented.
+    */
+   struct rb_tree holes;
+
+   /** Number of holes and total number of bytes in them */
+   uint32_t num_holes;
+   uint64_t free_size;
 
    /** If true, util_vma_heap_alloc will prefer high addresses
     *
@@ -56,6 +65,23 @@ bool util_vma_heap_alloc_addr(struct util_vma_heap *heap,
 void util_vma_heap_free(struct util_vma_heap *heap,
                         uint64_t offset, uint64_t size);
 
+struct util_vma_heap_stats {
+   uint64_t free_size;
+   uint64_t largest_hole;
+   uint32_t num_holes;
+
+   /** 1 - largest_hole / free_size, or 0 if the heap is full
+    *
+    * This is 0 when all of the free space can be handed out by a single
+    * allocation, and goes towards 1 as it gets split into more, smaller
+    * holes.
+    */
+   double fragmentation;
+};
+
+void util_vma_heap_get_stats(const struct util_vma_heap *heap,
+                             struct util_vma_heap_stats *stats);
+
 void util_vma_heap_print(struct util_vma_heap *heap, FILE *fp,
                          const char *tab, uint64_t total_size);
 